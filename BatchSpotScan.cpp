@@ -0,0 +1,271 @@
+/*
+*批量查找光斑：遍历目录（包括子目录）中的所有图片，多线程解码并查找光斑，结果写入一个带索引的结果文件
+*每个线程解码一张图片后立即查找光斑（include/BrightSpotExtractor.h），同时在内存中的图片数不超过线程数，
+*等待写入的结果数不超过队列容量，处理几十万张图片时内存占用不变
+*结果文件的格式见include/SpotResultFile.h；中断后用相同的参数再次运行，跳过已处理的图片继续处理，解码失败的图片重新处理
+*用法：BatchSpotScan 目录 [-o 结果文件] [-t 线程数] [-q 队列容量]
+*/
+
+//光点的亮度阈值，所有颜色分量都大于阈值的像素为光点
+#define brightThreshold 200
+//面积小于此值的光斑不输出
+#define minSpotArea 1
+//每写入多少张图片的结果刷新一次文件，中断时最多丢失这么多张图片的结果
+#define flushInterval 256
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "include/BrightSpotExtractor.h"
+#include "include/SpotResultFile.h"
+
+using namespace cv;
+using namespace std;
+
+//一张图片的处理结果
+struct SImageResult
+{
+    string path;
+    ESpotResultStatus status;
+    int width;
+    int height;
+    vector<SBrightSpot> spots;
+};
+
+//工作线程向写入线程传递结果的有界队列，队列满时工作线程等待
+class CResultQueue
+{
+public:
+    explicit CResultQueue(size_t capacity)
+        : m_capacity(capacity)
+        , m_producers(0)
+    {
+    }
+
+    void AddProducer()
+    {
+        lock_guard<mutex> lock(m_lock);
+        ++m_producers;
+    }
+
+    //工作线程结束时调用，所有工作线程结束后Pop()返回false
+    void RemoveProducer()
+    {
+        lock_guard<mutex> lock(m_lock);
+        --m_producers;
+        m_notEmpty.notify_all();
+    }
+
+    void Push(SImageResult& result)
+    {
+        unique_lock<mutex> lock(m_lock);
+        m_notFull.wait(lock, [this]{ return m_results.size() < m_capacity; });
+        m_results.push_back(SImageResult());
+        swap(m_results.back(), result);
+        m_notEmpty.notify_one();
+    }
+
+    bool Pop(SImageResult& result)
+    {
+        unique_lock<mutex> lock(m_lock);
+        m_notEmpty.wait(lock, [this]{ return !m_results.empty() || m_producers == 0; });
+        if (m_results.empty())
+        {
+            return false;
+        }
+        swap(result, m_results.front());
+        m_results.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+private:
+    size_t m_capacity;
+    size_t m_producers;
+    deque<SImageResult> m_results;
+    mutex m_lock;
+    condition_variable m_notEmpty;
+    condition_variable m_notFull;
+};
+
+//OpenCV能读取的图片格式
+static bool IsImageFile(const string& path)
+{
+    static const char* const extensions[] = { ".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff", ".pgm", ".ppm" };
+    const size_t dot = path.find_last_of('.');
+    if (dot == string::npos)
+    {
+        return false;
+    }
+    string extension = path.substr(dot);
+    transform(extension.begin(), extension.end(), extension.begin(), [](char c){ return (char)tolower((unsigned char)c); });
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i)
+    {
+        if (extension == extensions[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//解码一张图片并查找光斑；灰度图按Mono8、彩色图按BGR8或BGRA8扫描，16位图片转换为8位
+static void ProcessImage(const string& path, CBrightSpotExtractor& extractor, SImageResult& result)
+{
+    result.path = path;
+    result.width = 0;
+    result.height = 0;
+    result.spots.clear();
+
+    Mat image = imread(path, IMREAD_ANYCOLOR);
+    if (image.empty())
+    {
+        result.status = SpotResultStatus_DecodeFailed;
+        return;
+    }
+    result.width = image.cols;
+    result.height = image.rows;
+    if (image.depth() != CV_8U || !CBrightSpotScanner::IsSupportedBytesPerPixel(image.channels()))
+    {
+        result.status = SpotResultStatus_UnsupportedFormat;
+        return;
+    }
+
+    extractor.Extract(image.data, image.cols, image.rows, (ptrdiff_t)image.step, image.channels(), result.spots);
+    result.status = SpotResultStatus_Ok;
+}
+
+int main(int argc, char* argv[])
+{
+    string directory;
+    string resultFileName("spots.bin");
+    size_t threadCount = thread::hardware_concurrency();
+    size_t queueCapacity = 64;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            resultFileName = argv[++i];
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            threadCount = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+        {
+            queueCapacity = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            directory = argv[i];
+        }
+    }
+    if (directory.empty())
+    {
+        cerr << "用法：BatchSpotScan 目录 [-o 结果文件] [-t 线程数] [-q 队列容量]" << endl;
+        return 1;
+    }
+    threadCount = max<size_t>(threadCount, 1);
+    queueCapacity = max<size_t>(queueCapacity, 1);
+
+    //打开结果文件，已有的结果保留
+    CSpotResultWriter writer;
+    vector<string> donePaths;
+    if (!writer.Open(resultFileName, donePaths))
+    {
+        cerr << "无法打开结果文件：" << resultFileName << endl;
+        return 1;
+    }
+    const unordered_set<string> done(donePaths.begin(), donePaths.end());
+
+    //按路径排序，每次运行的处理顺序相同
+    vector<String> files;
+    glob(directory, files, true);
+    vector<string> pending;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (IsImageFile(files[i]) && done.count(files[i]) == 0)
+        {
+            pending.push_back(files[i]);
+        }
+    }
+    sort(pending.begin(), pending.end());
+    cerr << "图片：" << pending.size() + done.size() << " 张，已处理：" << done.size() << " 张，线程数：" << threadCount << endl;
+
+    //工作线程依次领取图片，处理后放入结果队列
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    CResultQueue queue(queueCapacity);
+    atomic<size_t> nextImage(0);
+    vector<thread> workers;
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        queue.AddProducer();
+        workers.push_back(thread([&]()
+        {
+            CBrightSpotExtractor extractor(brightThreshold, minSpotArea);
+            SImageResult result;
+            for (size_t index = nextImage++; index < pending.size(); index = nextImage++)
+            {
+                ProcessImage(pending[index], extractor, result);
+                queue.Push(result);
+            }
+            queue.RemoveProducer();
+        }));
+    }
+
+    //主线程写入结果
+    uint64_t written = 0;
+    uint64_t failed = 0;
+    uint64_t spotCount = 0;
+    bool writeError = false;
+    SImageResult result;
+    while (queue.Pop(result))
+    {
+        if (writeError)
+        {
+            continue;
+        }
+        if (!writer.Write(result.path, result.status, result.width, result.height, result.spots))
+        {
+            cerr << "写入结果文件失败" << endl;
+            writeError = true;
+            continue;
+        }
+        ++written;
+        failed += (result.status != SpotResultStatus_Ok) ? 1 : 0;
+        spotCount += result.spots.size();
+        if (written % flushInterval == 0)
+        {
+            writer.Flush();
+            cerr << "已处理 " << written << " / " << pending.size() << '\r';
+        }
+    }
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+    if (!writer.Close())
+    {
+        writeError = true;
+    }
+
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "处理 " << written << " 张图片，光斑 " << spotCount << " 个，无法处理 " << failed << " 张，用时 " << seconds << " s，"
+         << (seconds > 0 ? written / seconds : 0) << " 张/秒" << endl;
+    return writeError ? 1 : 0;
+}
@@ -1,17 +1,106 @@
 //搜索图片，找到第一个光点，输出坐标
 //时间：2020年5月27日
 //整理：hanchen
+//直接扫描图像缓冲区（include/BrightSpotScanner.h），每次用SIMD比较32个像素，不再逐像素调用GetPixel
+//Windows下用GDI+读取图片，其他平台用pylon读取
+
+//定义输出方式：0 输出所有光点的坐标，1 找到第一个光点后立即停止搜索
+//2 把相连的光点合并为光斑，把每个光斑的质心（按亮度加权，亚像素精度）、面积和外接矩形写入color.txt
+#define outputMode 0
+//光点的亮度阈值，R、G、B都大于阈值的像素为光点
+#define brightThreshold 200
+
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+
+#include "include/BrightSpotExtractor.h"
+#include "include/BrightSpotScanner.h"
+
+#ifdef _WIN32
 #include <windows.h>
 #include <gdiplus.h>
 #pragma comment(lib, "gdiplus.lib")
+using namespace Gdiplus;
+#else
+#include <pylon/PylonIncludes.h>
+#endif
 
 using namespace std;
-using namespace Gdiplus;
+
+//一次扫描找出所有光斑，每个光斑写一行：质心x,质心y,面积,左,上,宽,高,亮度
+static void ExtractSpots(const uint8_t* pImage, int width, int height, ptrdiff_t stride, int bytesPerPixel, const string& outfilename)
+{
+    CBrightSpotExtractor extractor(brightThreshold);
+    vector<SBrightSpot> spots;
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    extractor.Extract(pImage, width, height, stride, bytesPerPixel, spots);
+    const double scanTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    FILE* pFile = fopen(outfilename.c_str(), "w");
+    if (pFile == NULL)
+    {
+        cerr << "无法创建结果文件：" << outfilename << endl;
+        return;
+    }
+    fputs("centroidX,centroidY,area,left,top,width,height,intensity\n", pFile);
+    for (size_t i = 0; i < spots.size(); ++i)
+    {
+        const SBrightSpot& spot = spots[i];
+        fprintf(pFile, "%.3f,%.3f,%llu,%d,%d,%d,%d,%.0f\n", spot.centroidX, spot.centroidY, static_cast<unsigned long long>(spot.area),
+            spot.left, spot.top, spot.width, spot.height, spot.intensity);
+    }
+    fclose(pFile);
+    cerr << width << "x" << height << "，光斑数：" << spots.size() << "，扫描用时：" << scanTime << " ms" << endl;
+}
+
+//扫描并输出光点坐标，返回找到的光点数
+static size_t ScanAndPrint(const uint8_t* pImage, int width, int height, ptrdiff_t stride, int bytesPerPixel)
+{
+    CBrightSpotScanner scanner(brightThreshold);
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<SBrightPixel> pixels;
+    if (outputMode == 1)
+    {
+        SBrightPixel pixel;
+        if (scanner.FindFirst(pImage, width, height, stride, bytesPerPixel, pixel))
+        {
+            pixels.push_back(pixel);
+        }
+    }
+    else
+    {
+        scanner.FindAll(pImage, width, height, stride, bytesPerPixel, pixels);
+    }
+    const double scanTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    //逐行输出，最后统一刷新，不在每行调用endl
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        cout << pixels[i].x << "," << pixels[i].y << '\n';
+    }
+    cout.flush();
+    cerr << width << "x" << height << "，光点数：" << pixels.size() << "，扫描用时：" << scanTime << " ms" << endl;
+    return pixels.size();
+}
+
+static void Search(const uint8_t* pImage, int width, int height, ptrdiff_t stride, int bytesPerPixel, const string& outfilename)
+{
+    if (outputMode == 2)
+    {
+        ExtractSpots(pImage, width, height, stride, bytesPerPixel, outfilename);
+    }
+    else
+    {
+        ScanAndPrint(pImage, width, height, stride, bytesPerPixel);
+    }
+}
 
 int main() {
+#ifdef _WIN32
     GdiplusStartupInput gdiplusstartupinput;
     ULONG_PTR gdiplustoken;
     GdiplusStartup(&gdiplustoken, &gdiplusstartupinput, NULL);
@@ -23,20 +112,49 @@ int main() {
     UINT height = bmp->GetHeight();
     UINT width = bmp->GetWidth();
 
-    Color color;
-
-    for (UINT y = 0; y < height; y++)
-        for (UINT x = 0; x < width; x++) {
-            bmp->GetPixel(x, y, &color);
-            if ((int)color.GetRed() > 200
-                && (int)color.GetGreen() > 200
-                && (int)color.GetBlue() > 200) {
-                cout << x << "," << y << endl;
-                //goto EXIT; 
-            }
-        }
-//EXIT:
+    //锁定整幅图像，按24位BGR格式读取像素数据
+    Rect rect(0, 0, width, height);
+    BitmapData bitmapData;
+    if (bmp->LockBits(&rect, ImageLockModeRead, PixelFormat24bppRGB, &bitmapData) == Ok)
+    {
+        Search(static_cast<const uint8_t*>(bitmapData.Scan0), (int)bitmapData.Width, (int)bitmapData.Height, bitmapData.Stride, 3, outfilename);
+        bmp->UnlockBits(&bitmapData);
+    }
+    else
+    {
+        cerr << "无法读取图片" << endl;
+    }
+
     delete bmp;
     GdiplusShutdown(gdiplustoken);
+#else
+    using namespace Pylon;
+    PylonAutoInitTerm autoInitTerm;
+    try
+    {
+        string outfilename("color.txt");
+        CPylonImage image;
+        CImagePersistence::Load("2.jpg", image);
+
+        //扫描器支持Mono8、BGR8/RGB8和BGRA8，其他格式先转换为BGR8
+        if (image.GetPixelType() != PixelType_Mono8 && image.GetPixelType() != PixelType_BGR8packed
+            && image.GetPixelType() != PixelType_RGB8packed && image.GetPixelType() != PixelType_BGRA8packed)
+        {
+            CImageFormatConverter converter;
+            converter.OutputPixelFormat = PixelType_BGR8packed;
+            converter.Convert(image, CPylonImage(image));
+        }
+
+        size_t stride = 0;
+        image.GetStride(stride);
+        const int bytesPerPixel = (int)(BitPerPixel(image.GetPixelType()) / 8);
+        Search(static_cast<const uint8_t*>(image.GetBuffer()), (int)image.GetWidth(), (int)image.GetHeight(), (ptrdiff_t)stride, bytesPerPixel, outfilename);
+    }
+    catch (const GenericException& e)
+    {
+        cerr << "无法读取图片：" << e.GetDescription() << endl;
+        return 1;
+    }
+#endif
     return 0;
 }
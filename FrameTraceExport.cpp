@@ -0,0 +1,46 @@
+/*
+*把帧时间线文件（include/FrameTrace.h）转换为Chrome trace event格式的JSON文件，用chrome://tracing或https://ui.perfetto.dev查看
+*每个线程一行，显示曝光结束、取得图像、等待RetrieveResult、处理和输出的时间；每一帧（每次开始采集后的块ID）还有一个从第一条到最后一条记录的生命周期
+*可以在采集程序运行时转换，正在写入的记录会被跳过
+*用法：FrameTraceExport [时间线文件] [JSON文件]
+*默认时间线文件为frames.trace，JSON文件为时间线文件名加.json
+*/
+
+#include <cstdio>
+#include <string>
+
+#include "include/FrameTrace.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    const string traceFileName = (argc > 1) ? argv[1] : "frames.trace";
+    const string jsonFileName = (argc > 2) ? argv[2] : traceFileName + ".json";
+
+    CFrameTraceReader reader;
+    if (!reader.Open(traceFileName))
+    {
+        fprintf(stderr, "无法打开时间线文件：%s\n", traceFileName.c_str());
+        return 1;
+    }
+
+    FILE* pFile = fopen(jsonFileName.c_str(), "w");
+    if (pFile == NULL)
+    {
+        fprintf(stderr, "无法创建JSON文件：%s\n", jsonFileName.c_str());
+        return 1;
+    }
+    setvbuf(pFile, NULL, _IOFBF, 1 << 20);
+    const size_t records = reader.WriteChromeTrace(pFile);
+    fclose(pFile);
+
+    const uint64_t written = reader.GetWriteCount();
+    fprintf(stderr, "写入 %zu 条记录到 %s", records, jsonFileName.c_str());
+    if (written > records)
+    {
+        fprintf(stderr, "，%llu 条记录已被覆盖或正在写入", (unsigned long long)(written - records));
+    }
+    fprintf(stderr, "\n");
+    return 0;
+}
@@ -0,0 +1,358 @@
+/*
+*比较各采集策略（GrabStrategy_OneByOne/LatestImageOnly/LatestImages，以及include/AdaptiveGrabStrategy.h）的性能：
+*软件触发线程按设定的帧率触发，处理线程按设定的处理时间模拟处理，依次测试不同的触发帧率和处理时间
+*每次测试统计从触发到RetrieveResult返回的延迟分布、GetNumberOfSkippedImages的总数和处理线程的CPU占用率
+*触发线程的忙等待不计入CPU占用率；第n次触发对应的图像为ImageNumber加上至今跳过的帧数
+*结果以JSON格式输出，包括pylon版本、主机和相机信息，可以比较不同的pylon版本和主机配置
+*没有相机时设置环境变量PYLON_CAMEMU=1使用pylon的相机仿真器
+*GrabStrategy_UpcomingImage只在RetrieveResult时才提供缓冲区，触发和图像不能一一对应，不参与比较
+*用法：GrabStrategyBenchmark [-o 结果文件] [-t 每项测试的秒数]
+*/
+
+//LatestImages策略的输出队列长度
+#define latestImagesQueueSize 4
+//相机的缓冲区个数
+#define bufferCount 16
+//触发线程在每次触发前忙等待的时间（微秒），之前的时间休眠
+#define triggerSpinTime 100
+
+#include <pylon/PylonIncludes.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#   include <windows.h>
+#else
+#   include <time.h>
+#   include <unistd.h>
+#endif
+
+#include "include/AdaptiveGrabStrategy.h"
+#include "include/LatencyHistogram.h"
+
+using namespace Pylon;
+using namespace std;
+
+//测试的触发帧率和每帧处理时间（微秒）
+static const double c_triggerRates[] = { 50, 200, 1000 };
+static const int c_processingTimes[] = { 0, 2000, 10000 };
+
+//参与比较的策略，Adaptive表示CAdaptiveGrabStrategy
+enum EBenchmarkStrategy
+{
+    BenchmarkStrategy_OneByOne,
+    BenchmarkStrategy_LatestImageOnly,
+    BenchmarkStrategy_LatestImages,
+    BenchmarkStrategy_Adaptive
+};
+
+static const char* const c_strategyNames[] = { "OneByOne", "LatestImageOnly", "LatestImages", "Adaptive" };
+
+//一次测试的结果
+struct SRunResult
+{
+    EBenchmarkStrategy strategy;
+    double triggerRate;
+    int processingTime;
+    double duration;
+    uint64_t triggers;
+    uint64_t triggerOverruns;
+    uint64_t images;
+    uint64_t skippedImages;
+    uint64_t latencyP50;
+    uint64_t latencyP90;
+    uint64_t latencyP99;
+    uint64_t latencyMax;
+    double cpuUsage;            //处理线程的CPU时间除以测试时间
+};
+
+static uint64_t GetNow()
+{
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//调用线程的CPU时间（用户态和内核态之和，秒）
+static double GetThreadCpuTime()
+{
+#if defined(_WIN32)
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime);
+    const uint64_t kernel = ((uint64_t)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime;
+    const uint64_t user = ((uint64_t)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime;
+    return (kernel + user) * 100e-9;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+}
+
+static string GetHostName()
+{
+    char name[256] = { 0 };
+#if defined(_WIN32)
+    DWORD size = sizeof(name);
+    GetComputerNameA(name, &size);
+#else
+    gethostname(name, sizeof(name) - 1);
+#endif
+    return name;
+}
+
+//模拟处理，忙等待而不是休眠，与实际处理一样占用CPU
+static void Process(int microseconds)
+{
+    const uint64_t end = GetNow() + (uint64_t)microseconds * 1000;
+    while (GetNow() < end)
+    {
+    }
+}
+
+//触发线程记录每次触发的时间；ImageNumber不计跳过的帧，第n次触发对应ImageNumber加至今跳过的帧数为n的图像
+class CTriggerTimes
+{
+public:
+    CTriggerTimes()
+    {
+        for (size_t i = 0; i < c_slots; ++i)
+        {
+            m_times[i].store(0, memory_order_relaxed);
+        }
+    }
+
+    void Set(uint64_t imageNumber, uint64_t time)
+    {
+        m_times[imageNumber % c_slots].store(time, memory_order_release);
+    }
+
+    uint64_t Get(uint64_t imageNumber) const
+    {
+        return m_times[imageNumber % c_slots].load(memory_order_acquire);
+    }
+
+private:
+    //大于缓冲区个数，图像被取出之前对应的时间不会被覆盖
+    static const size_t c_slots = 4096;
+    atomic<uint64_t> m_times[c_slots];
+};
+
+//按设定帧率触发，相机未准备好时跳过这一次触发并计数
+static void RunTrigger(CInstantCamera& camera, double rate, const atomic<bool>& stop, CTriggerTimes& triggerTimes,
+    uint64_t& triggers, uint64_t& overruns)
+{
+    const uint64_t period = (uint64_t)(1e9 / rate);
+    const uint64_t spinTime = (uint64_t)triggerSpinTime * 1000;
+    uint64_t next = GetNow();
+    while (!stop)
+    {
+        //休眠到触发前triggerSpinTime，只在最后一段时间忙等待，不占满一个CPU核
+        if (next > GetNow() + spinTime)
+        {
+            const chrono::nanoseconds wakeUp(next - spinTime);
+            this_thread::sleep_until(chrono::steady_clock::time_point(chrono::duration_cast<chrono::steady_clock::duration>(wakeUp)));
+        }
+        while (GetNow() < next)
+        {
+        }
+        next += period;
+        if (!camera.WaitForFrameTriggerReady(0, TimeoutHandling_Return))
+        {
+            ++overruns;
+            continue;
+        }
+        //先记录时间再触发，图像可能在ExecuteSoftwareTrigger返回之前就已到达
+        triggerTimes.Set(triggers + 1, GetNow());
+        camera.ExecuteSoftwareTrigger();
+        ++triggers;
+    }
+}
+
+static SRunResult RunOnce(CInstantCamera& camera, EBenchmarkStrategy strategy, double rate, int processingTime, double seconds)
+{
+    SRunResult result;
+    memset(&result, 0, sizeof(result));
+    result.strategy = strategy;
+    result.triggerRate = rate;
+    result.processingTime = processingTime;
+
+    CTriggerTimes triggerTimes;
+    CLatencyHistogram latency;
+    //CAdaptiveGrabStrategy只在测试它时创建
+    unique_ptr<CAdaptiveGrabStrategy> pAdaptive;
+    uint64_t skippedImages = 0;
+    switch (strategy)
+    {
+    case BenchmarkStrategy_OneByOne:
+        camera.StartGrabbing(GrabStrategy_OneByOne);
+        break;
+    case BenchmarkStrategy_LatestImageOnly:
+        camera.StartGrabbing(GrabStrategy_LatestImageOnly);
+        break;
+    case BenchmarkStrategy_LatestImages:
+        camera.OutputQueueSize = latestImagesQueueSize;
+        camera.StartGrabbing(GrabStrategy_LatestImages);
+        break;
+    case BenchmarkStrategy_Adaptive:
+        pAdaptive.reset(new CAdaptiveGrabStrategy(camera));
+        pAdaptive->StartGrabbing();
+        break;
+    }
+
+    const double cpuStart = GetThreadCpuTime();
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    atomic<bool> stop(false);
+    thread trigger(RunTrigger, ref(camera), rate, cref(stop), ref(triggerTimes), ref(result.triggers), ref(result.triggerOverruns));
+
+    CGrabResultPtr ptrGrabResult;
+    while (chrono::duration<double>(chrono::steady_clock::now() - start).count() < seconds)
+    {
+        const bool retrieved = pAdaptive
+            ? pAdaptive->RetrieveResult(100, ptrGrabResult, TimeoutHandling_Return)
+            : camera.RetrieveResult(100, ptrGrabResult, TimeoutHandling_Return);
+        if (!retrieved)
+        {
+            continue;
+        }
+        const uint64_t now = GetNow();
+        skippedImages += ptrGrabResult->GetNumberOfSkippedImages();
+        const uint64_t triggerTime = triggerTimes.Get((uint64_t)ptrGrabResult->GetImageNumber() + skippedImages);
+        if (triggerTime != 0 && now > triggerTime)
+        {
+            latency.Record(now - triggerTime);
+        }
+        ++result.images;
+        Process(processingTime);
+    }
+
+    stop = true;
+    trigger.join();
+    result.duration = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.cpuUsage = (GetThreadCpuTime() - cpuStart) / result.duration;
+    result.skippedImages = skippedImages;
+    if (pAdaptive)
+    {
+        pAdaptive->EndProcessing();
+    }
+    camera.StopGrabbing();
+    ptrGrabResult.Release();
+
+    result.latencyP50 = latency.GetPercentile(0.5);
+    result.latencyP90 = latency.GetPercentile(0.9);
+    result.latencyP99 = latency.GetPercentile(0.99);
+    result.latencyMax = latency.GetMaximum();
+    return result;
+}
+
+//JSON字符串中的引号和反斜杠需要转义
+static string Escape(const string& text)
+{
+    string escaped;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == '"' || text[i] == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += ((unsigned char)text[i] < 0x20) ? ' ' : text[i];
+    }
+    return escaped;
+}
+
+static void WriteReport(FILE* pFile, CInstantCamera& camera, const vector<SRunResult>& results)
+{
+    fprintf(pFile, "{\n");
+    fprintf(pFile, "  \"pylonVersion\": \"%s\",\n", Escape(GetPylonVersionString()).c_str());
+    fprintf(pFile, "  \"host\": { \"name\": \"%s\", \"cpus\": %u },\n", Escape(GetHostName()).c_str(), thread::hardware_concurrency());
+    fprintf(pFile, "  \"device\": { \"model\": \"%s\", \"serialNumber\": \"%s\", \"maxNumBuffer\": %d },\n",
+        Escape(camera.GetDeviceInfo().GetModelName().c_str()).c_str(), Escape(camera.GetDeviceInfo().GetSerialNumber().c_str()).c_str(),
+        bufferCount);
+    fprintf(pFile, "  \"runs\": [\n");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const SRunResult& r = results[i];
+        fprintf(pFile, "    { \"strategy\": \"%s\", \"triggerRate\": %.1f, \"processingTimeUs\": %d, \"duration\": %.3f, "
+            "\"triggers\": %llu, \"triggerOverruns\": %llu, \"images\": %llu, \"skippedImages\": %llu, "
+            "\"latencyUs\": { \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f }, \"consumerCpuUsage\": %.3f }%s\n",
+            c_strategyNames[r.strategy], r.triggerRate, r.processingTime, r.duration,
+            (unsigned long long)r.triggers, (unsigned long long)r.triggerOverruns, (unsigned long long)r.images,
+            (unsigned long long)r.skippedImages, r.latencyP50 / 1000.0, r.latencyP90 / 1000.0, r.latencyP99 / 1000.0,
+            r.latencyMax / 1000.0, r.cpuUsage, (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(pFile, "  ]\n}\n");
+}
+
+int main(int argc, char* argv[])
+{
+    string reportFileName;
+    double seconds = 2;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            reportFileName = argv[++i];
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            seconds = atof(argv[++i]);
+        }
+    }
+
+    //Pylon自动初始化和终止
+    PylonAutoInitTerm autoInitTerm;
+    int result = 0;
+    try
+    {
+        CInstantCamera camera(CTlFactory::GetInstance().CreateFirstDevice());
+        camera.RegisterConfiguration(new CSoftwareTriggerConfiguration, RegistrationMode_ReplaceAll, Cleanup_Delete);
+        camera.MaxNumBuffer = bufferCount;
+        camera.Open();
+        if (!camera.CanWaitForFrameTriggerReady())
+        {
+            cerr << "相机不能查询是否可以接受触发" << endl;
+            return 1;
+        }
+        cerr << "Using device " << camera.GetDeviceInfo().GetModelName() << endl;
+
+        vector<SRunResult> results;
+        for (int strategy = BenchmarkStrategy_OneByOne; strategy <= BenchmarkStrategy_Adaptive; ++strategy)
+        {
+            for (size_t r = 0; r < sizeof(c_triggerRates) / sizeof(c_triggerRates[0]); ++r)
+            {
+                for (size_t p = 0; p < sizeof(c_processingTimes) / sizeof(c_processingTimes[0]); ++p)
+                {
+                    const SRunResult run = RunOnce(camera, (EBenchmarkStrategy)strategy, c_triggerRates[r], c_processingTimes[p], seconds);
+                    cerr << c_strategyNames[strategy] << " " << c_triggerRates[r] << " fps, 处理 " << c_processingTimes[p] << " us："
+                         << run.images << " 帧，跳过 " << run.skippedImages << " 帧，p99 " << run.latencyP99 / 1000.0 << " us" << endl;
+                    results.push_back(run);
+                }
+            }
+        }
+
+        FILE* pFile = reportFileName.empty() ? stdout : fopen(reportFileName.c_str(), "w");
+        if (pFile == NULL)
+        {
+            cerr << "无法创建结果文件：" << reportFileName << endl;
+            return 1;
+        }
+        WriteReport(pFile, camera, results);
+        if (pFile != stdout)
+        {
+            fclose(pFile);
+        }
+    }
+    catch (const GenericException& e)
+    {
+        cerr << "An exception occurred." << endl
+            << e.GetDescription() << endl;
+        result = 1;
+    }
+    return result;
+}
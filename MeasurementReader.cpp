@@ -0,0 +1,73 @@
+/*
+*读取流水线写入的测量结果环形文件（include/MeasurementSink.h），可以在流水线运行时实时跟踪
+*用法：MeasurementReader [文件名] [-f]
+*默认文件名为measurements.bin；-f 表示持续等待新的记录（类似tail -f），否则读完现有记录后退出
+*输出为CSV格式，可以重定向到文件
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "include/MeasurementSink.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    string fileName = "measurements.bin";
+    bool follow = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-f") == 0)
+        {
+            follow = true;
+        }
+        else
+        {
+            fileName = argv[i];
+        }
+    }
+
+    CMappedRingFileReader reader;
+    if (!reader.Open(fileName, true))
+    {
+        fprintf(stderr, "无法打开测量结果文件：%s\n", fileName.c_str());
+        return 1;
+    }
+
+    printf("frameIndex,cameraTimestamp,hostTimestamp,blobIndex,blobCount,area,perimeter,left,top,width,height,centroidX,centroidY\n");
+
+    SMeasurementRecord record;
+    uint64_t reportedLostRecords = 0;
+    for (;;)
+    {
+        if (reader.Read(record))
+        {
+            printf("%llu,%llu,%llu,%u,%u,%.3f,%.3f,%d,%d,%d,%d,%.3f,%.3f\n",
+                static_cast<unsigned long long>(record.frameIndex),
+                static_cast<unsigned long long>(record.cameraTimestamp),
+                static_cast<unsigned long long>(record.hostTimestamp),
+                record.blobIndex, record.blobCount, record.area, record.perimeter,
+                record.left, record.top, record.width, record.height, record.centroidX, record.centroidY);
+            continue;
+        }
+
+        //读取速度跟不上写入速度时，被覆盖的记录会丢失
+        if (reader.GetLostRecords() != reportedLostRecords)
+        {
+            reportedLostRecords = reader.GetLostRecords();
+            fprintf(stderr, "丢失的记录数：%llu\n", static_cast<unsigned long long>(reportedLostRecords));
+        }
+
+        if (!follow)
+        {
+            break;
+        }
+        fflush(stdout);
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+*比较处理线程读取本节点和其他NUMA节点上的采集缓冲区的带宽（include/NumaBufferFactory.h）
+*在每个节点上用缓冲区工厂分配和相机采集时同样的缓冲区，处理线程依次绑定到每个节点，统计每个像素是否大于阈值
+*输出“缓冲区节点 x 线程节点”的带宽矩阵，对角线是本节点的带宽；只有一个节点时只输出一项
+*节点号不一定连续；线程无法绑定到的节点（例如没有处理器的节点）输出“-”，不计入平均值
+*多相机时每台相机使用自己的CNumaBufferFactory，创建时传入处理线程所在的节点：
+*    CNumaBufferFactory factory(CNumaTopology::GetCurrentNode());
+*    camera.SetBufferFactory(&factory, Cleanup_None);
+*用法：NumaBandwidthBenchmark [每帧字节数] [重复次数]
+*/
+
+//每个节点上分配的缓冲区个数，与相机的MaxNumBuffer对应
+#define bufferCount 10
+//统计的像素亮度阈值
+#define brightThreshold 200
+
+#include <pylon/PylonIncludes.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "include/NumaBufferFactory.h"
+
+using namespace Pylon;
+using namespace std;
+
+//一个节点上的缓冲区，与相机采集时一样由缓冲区工厂分配
+struct SNodeBuffers
+{
+    int node;
+    CNumaBufferFactory* pFactory;
+    vector<void*> buffers;
+    vector<intptr_t> contexts;
+};
+
+//统计大于阈值的像素数，代表读取整个缓冲区的处理
+static size_t CountBrightPixels(const uint8_t* pBuffer, size_t size)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        count += (pBuffer[i] > brightThreshold) ? 1 : 0;
+    }
+    return count;
+}
+
+//在绑定到threadNode的线程中处理所有缓冲区，带宽单位为GB/s；线程无法绑定到threadNode时返回false
+static bool MeasureBandwidth(const SNodeBuffers& nodeBuffers, size_t frameSize, int repetitions, int threadNode, size_t& checksum, double& bandwidth)
+{
+    bandwidth = 0;
+    bool isBound = false;
+    thread worker([&]()
+    {
+        isBound = CNumaTopology::BindCurrentThread(threadNode);
+        if (!isBound)
+        {
+            return;
+        }
+        //预热一遍，之后计时
+        for (size_t i = 0; i < nodeBuffers.buffers.size(); ++i)
+        {
+            checksum += CountBrightPixels(static_cast<const uint8_t*>(nodeBuffers.buffers[i]), frameSize);
+        }
+        const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; ++r)
+        {
+            for (size_t i = 0; i < nodeBuffers.buffers.size(); ++i)
+            {
+                checksum += CountBrightPixels(static_cast<const uint8_t*>(nodeBuffers.buffers[i]), frameSize);
+            }
+        }
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        bandwidth = (seconds > 0) ? static_cast<double>(frameSize) * nodeBuffers.buffers.size() * repetitions / seconds / 1e9 : 0;
+    });
+    worker.join();
+    return isBound;
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t frameSize = (argc > 1) ? strtoul(argv[1], NULL, 10) : 2048 * 1536;
+    const int repetitions = (argc > 2) ? atoi(argv[2]) : 20;
+    vector<int> nodeIds;
+    CNumaTopology::GetNodes(nodeIds);
+
+    //Pylon自动初始化和终止
+    PylonAutoInitTerm autoInitTerm;
+    int result = 0;
+    vector<SNodeBuffers> nodes;
+    try
+    {
+        SPooledBufferFactoryConfiguration configuration;
+        configuration.arenaSize = (frameSize + configuration.alignment) * bufferCount;
+        for (size_t n = 0; n < nodeIds.size(); ++n)
+        {
+            const int node = nodeIds[n];
+            SNodeBuffers nodeBuffers;
+            nodeBuffers.node = node;
+            nodeBuffers.pFactory = new CNumaBufferFactory(node, configuration);
+            nodes.push_back(nodeBuffers);
+            for (int i = 0; i < bufferCount; ++i)
+            {
+                void* pBuffer = NULL;
+                intptr_t context = 0;
+                nodes.back().pFactory->AllocateBuffer(frameSize, &pBuffer, context);
+                nodes.back().buffers.push_back(pBuffer);
+                nodes.back().contexts.push_back(context);
+                //缓冲区上下文中包含节点号，可以直接把采集结果交给该节点上的线程
+                if (CNumaBufferFactory::GetNode(context) != node)
+                {
+                    cerr << "缓冲区上下文中的节点号错误：" << context << endl;
+                    result = 1;
+                }
+                //写入一些亮点，相当于采集到的图像
+                uint8_t* pPixels = static_cast<uint8_t*>(pBuffer);
+                for (size_t p = 0; p < frameSize; ++p)
+                {
+                    pPixels[p] = static_cast<uint8_t>(p * 131 + i);
+                }
+            }
+            const SPooledBufferFactoryStatistics statistics = nodes.back().pFactory->GetStatistics();
+            cout << "节点 " << node << "：缓冲区 " << bufferCount << " x " << frameSize << " 字节，绑定到节点 " << statistics.numaNode
+                 << "，大页 " << statistics.usesHugePages << "，锁定 " << statistics.isLocked << endl;
+        }
+
+        //带宽矩阵，行是缓冲区所在的节点，列是处理线程所在的节点
+        size_t checksum = 0;
+        cout << "带宽（GB/s），行：缓冲区节点，列：线程节点" << endl;
+        cout << setw(6) << "";
+        for (size_t t = 0; t < nodes.size(); ++t)
+        {
+            cout << setw(10) << nodes[t].node;
+        }
+        cout << endl;
+        double localSum = 0;
+        double remoteSum = 0;
+        int localCount = 0;
+        int remoteCount = 0;
+        for (size_t b = 0; b < nodes.size(); ++b)
+        {
+            cout << setw(6) << nodes[b].node;
+            for (size_t t = 0; t < nodes.size(); ++t)
+            {
+                double bandwidth = 0;
+                if (!MeasureBandwidth(nodes[b], frameSize, repetitions, nodes[t].node, checksum, bandwidth))
+                {
+                    cout << setw(10) << "-";
+                    continue;
+                }
+                if (b == t)
+                {
+                    localSum += bandwidth;
+                    ++localCount;
+                }
+                else
+                {
+                    remoteSum += bandwidth;
+                    ++remoteCount;
+                }
+                cout << setw(10) << fixed << setprecision(2) << bandwidth;
+            }
+            cout << endl;
+        }
+        if (localCount > 0)
+        {
+            cout << "本节点平均 " << localSum / localCount << " GB/s";
+        }
+        else
+        {
+            cout << "没有可以绑定线程的节点";
+        }
+        if (remoteCount > 0)
+        {
+            cout << "，跨节点平均 " << remoteSum / remoteCount << " GB/s";
+        }
+        cout << "（校验和 " << checksum << "）" << endl;
+    }
+    catch (const GenericException& e)
+    {
+        cerr << "An exception occurred." << endl
+            << e.GetDescription() << endl;
+        result = 1;
+    }
+
+    //与相机停止采集时一样释放缓冲区
+    for (size_t n = 0; n < nodes.size(); ++n)
+    {
+        for (size_t i = 0; i < nodes[n].buffers.size(); ++i)
+        {
+            nodes[n].pFactory->FreeBuffer(nodes[n].buffers[i], nodes[n].contexts[i]);
+        }
+        delete nodes[n].pFactory;
+    }
+    return result;
+}
@@ -0,0 +1,409 @@
+/*
+*离线回放基准测试：不连接相机，把录制的图片或SampleImageCreator生成的合成图像按设定的帧率送入
+*与pylon_opencv_demo.cpp相同的流水线（include/ContourPipeline.h），经过同样的格式转换、滤波、轮廓分析和保存阶段
+*输出各阶段处理时间和端到端延迟的p50/p99、处理帧率以及每帧的内存分配次数，用于发现性能退化和评估部署硬件
+*用法：ReplayBenchmark [-r 帧率] [-n 帧数] [-w 预热帧数] [-s] [-d 丢帧概率] [-c 损坏概率] [图片文件...]
+*帧率为0（默认）时全速送入，流水线满时等待；不指定图片时使用合成图像
+*-s：由模拟相机的合成帧源（include/SyntheticFrameSource.h）按帧率送入，带块ID和时间戳，可以随机丢帧和损坏图像，
+*    用于以超过真实相机的帧率（1000帧/秒以上）测试流水线
+*/
+
+//与pylon_opencv_demo.cpp的设置对应
+//定义是否直接处理原始数据（Mono8/Mono16等，不转换为BGR8）
+#define zeroCopyGrab 1
+//定义是否用融合的SIMD内核完成高斯模糊、三角法二值化和闭运算
+#define fusedFrontEnd 1
+//定义是否用游程编码的连通域分析代替findContours
+#define rleBlobAnalysis 1
+//定义是否把每一帧分成多个水平条带并行处理
+#define bandParallel 1
+//定义是否保存图片（测量磁盘速度时打开）
+#define saveImages 0
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/opencv.hpp>
+#include <pylon/PylonIncludes.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/ContourPipeline.h"
+#include "include/SampleImageCreator.h"
+#include "include/SyntheticFrameSource.h"
+
+using namespace Pylon;
+using namespace cv;
+using namespace std;
+
+//默认的帧数和预热帧数
+static const uint64_t c_defaultFrameCount = 500;
+static const uint64_t c_defaultWarmUpFrames = 20;
+//合成图像的尺寸
+static const uint32_t c_syntheticWidth = 2048;
+static const uint32_t c_syntheticHeight = 1536;
+
+//内存分配计数：本程序中的operator new和cv::Mat的图像缓冲区
+//pylon库内部的分配不计入
+static atomic<uint64_t> s_allocations(0);
+
+void* operator new(size_t size)
+{
+    ++s_allocations;
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == NULL)
+    {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+//cv::Mat分配图像缓冲区时计数，分配和释放仍由OpenCV默认的分配器完成
+class CCountingMatAllocator : public MatAllocator
+{
+public:
+    CCountingMatAllocator()
+        : m_pAllocator(Mat::getStdAllocator())
+    {
+    }
+
+    virtual UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, AccessFlag flags, UMatUsageFlags usageFlags) const
+    {
+        ++s_allocations;
+        return m_pAllocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    virtual bool allocate(UMatData* data, AccessFlag accessFlags, UMatUsageFlags usageFlags) const
+    {
+        return m_pAllocator->allocate(data, accessFlags, usageFlags);
+    }
+
+    virtual void deallocate(UMatData* data) const
+    {
+        m_pAllocator->deallocate(data);
+    }
+
+private:
+    MatAllocator* m_pAllocator;
+};
+
+//把OpenCV读取的图片复制为pylon图像，像素格式与相机输出的格式对应
+static bool LoadImage(const string& fileName, CPylonImage& image)
+{
+    Mat srcImg = imread(fileName, IMREAD_UNCHANGED);
+    if (srcImg.empty())
+    {
+        return false;
+    }
+
+    EPixelType pixelType = PixelType_Mono8;
+    if (srcImg.type() == CV_16UC1)
+    {
+        pixelType = PixelType_Mono16;
+    }
+    else if (srcImg.type() == CV_8UC3)
+    {
+        pixelType = PixelType_BGR8packed;
+    }
+    else if (srcImg.type() != CV_8UC1)
+    {
+        srcImg = imread(fileName, IMREAD_GRAYSCALE);
+    }
+
+    const size_t paddingX = srcImg.step - srcImg.cols * srcImg.elemSize();
+    image.CopyImage(srcImg.data, srcImg.step * srcImg.rows, pixelType, srcImg.cols, srcImg.rows, paddingX, ImageOrientation_TopDown);
+    return true;
+}
+
+//等到指定的时间；Windows的sleep精度较低，最后2 ms忙等
+static void WaitUntil(chrono::steady_clock::time_point deadline)
+{
+    for (;;)
+    {
+        const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+            return;
+        }
+        if (deadline - now > chrono::milliseconds(2))
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        else
+        {
+            this_thread::yield();
+        }
+    }
+}
+
+//送入count帧，返回流水线拒绝的次数
+//设定帧率时与相机一样按固定间隔送入，流水线满时丢弃该帧；全速时重试直到流水线接收
+static uint64_t Replay(CContourPipeline& pipeline, const vector<CPylonImage>& images, uint64_t count, double frameRate, uint64_t& timestamp)
+{
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    const chrono::nanoseconds period(frameRate > 0 ? static_cast<int64_t>(1e9 / frameRate) : 0);
+    uint64_t rejected = 0;
+    for (uint64_t i = 0; i < count; ++i, ++timestamp)
+    {
+        const CPylonImage& image = images[i % images.size()];
+        if (frameRate > 0)
+        {
+            WaitUntil(start + period * static_cast<int64_t>(i));
+            if (!pipeline.PushImage(image, timestamp))
+            {
+                ++rejected;
+            }
+            continue;
+        }
+
+        while (!pipeline.PushImage(image, timestamp))
+        {
+            ++rejected;
+            this_thread::yield();
+        }
+    }
+    return rejected;
+}
+
+//从合成帧源取count帧送入流水线，返回流水线拒绝的次数
+//帧源按设定的帧率发出图像，流水线满时丢弃该帧，与相机相同
+static uint64_t ReplaySynthetic(CContourPipeline& pipeline, CSyntheticFrameSource& source, uint64_t count)
+{
+    uint64_t rejected = 0;
+    source.Start();
+    SSyntheticFrame frame;
+    for (uint64_t i = 0; i < count && source.RetrieveFrame(5000, frame); ++i)
+    {
+        if (!pipeline.PushImage(*frame.pImage, frame.timestamp))
+        {
+            ++rejected;
+        }
+    }
+    source.Stop();
+    return rejected;
+}
+
+//预热后按设定的帧率回放frameCount帧，输出测量结果；pSource不为NULL时从合成帧源取图像
+static void RunBenchmark(const vector<CPylonImage>& images, bool synthetic, double frameRate, uint64_t frameCount, uint64_t warmUpFrames,
+    CSyntheticFrameSource* pSource)
+{
+    //与pylon_opencv_demo.cpp相同的流水线配置，不显示图像
+    SContourPipelineConfiguration pipelineConfiguration;
+    pipelineConfiguration.framePoolSize = 8;
+    pipelineConfiguration.queueCapacity = 4;
+    const uint32_t width = (pSource != NULL) ? pSource->GetConfiguration().width : images[0].GetWidth();
+    const uint32_t height = (pSource != NULL) ? pSource->GetConfiguration().height : images[0].GetHeight();
+    pipelineConfiguration.imageWidth = (int)width;
+    pipelineConfiguration.imageHeight = (int)height;
+    pipelineConfiguration.saveImageFiles = (saveImages != 0);
+    pipelineConfiguration.imageWriter.format = ImageWriterFormat_Jpeg;
+    pipelineConfiguration.imageWriter.threadCount = 2;
+    pipelineConfiguration.imageWriter.bufferCount = 8;
+    pipelineConfiguration.useNativePixelData = (zeroCopyGrab != 0);
+    pipelineConfiguration.useFusedFrontEnd = (fusedFrontEnd != 0);
+    pipelineConfiguration.useRleBlobAnalysis = (rleBlobAnalysis != 0);
+    pipelineConfiguration.useBandParallelism = (bandParallel != 0);
+    pipelineConfiguration.bandThreadCount = 0;
+    pipelineConfiguration.showImages = false;
+
+    //测量结果写入环形文件，与pylon_opencv_demo.cpp的默认输出方式相同
+    CMappedRingFileSink ringFileSink;
+    if (ringFileSink.Create("replay_measurements.bin", 1 << 16))
+    {
+        pipelineConfiguration.pMeasurementSink = &ringFileSink;
+    }
+    else
+    {
+        cerr << "无法创建测量结果文件，结果将打印到控制台" << endl;
+    }
+    CContourPipeline pipeline(pipelineConfiguration);
+
+    //预热：线程启动和第一次处理时分配的缓冲区不计入结果
+    uint64_t timestamp = 0;
+    pipeline.Start();
+    if (pSource != NULL)
+    {
+        ReplaySynthetic(pipeline, *pSource, warmUpFrames);
+    }
+    else
+    {
+        Replay(pipeline, images, warmUpFrames, frameRate, timestamp);
+    }
+    pipeline.Stop();
+    pipeline.ResetStatistics();
+
+    //正式测量，计时到流水线处理完所有图像为止
+    pipeline.Start();
+    s_allocations = 0;
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    const uint64_t rejected = (pSource != NULL) ? ReplaySynthetic(pipeline, *pSource, frameCount)
+        : Replay(pipeline, images, frameCount, frameRate, timestamp);
+    pipeline.Stop();
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    const uint64_t allocations = s_allocations;
+
+    const uint64_t processedFrames = pipeline.GetStatistics(PipelineStage_Acquisition).processedFrames;
+    const size_t imageCount = (pSource != NULL) ? pSource->GetConfiguration().cycleLength : images.size();
+    cout << "图像 " << width << "x" << height << "，" << imageCount << (synthetic ? " 张合成图像" : " 张图片") << endl;
+    if (frameRate > 0)
+    {
+        cout << "设定帧率: " << frameRate << " 帧/秒" << endl;
+    }
+    else
+    {
+        cout << "设定帧率: 全速" << endl;
+    }
+    cout << "处理 " << processedFrames << " 帧，用时 " << seconds << " s，处理帧率 "
+         << (seconds > 0 ? processedFrames / seconds : 0) << " 帧/秒" << endl;
+    //全速时拒绝次数是重试次数，同样计入采集阶段的丢弃帧数
+    cout << "流水线拒绝的次数: " << rejected << endl;
+    if (pSource != NULL)
+    {
+        cout << "合成帧源：发出 " << pSource->GetEmittedFrames() << " 帧，注入丢帧 " << pSource->GetDroppedFrames()
+             << " 帧，损坏 " << pSource->GetCorruptedFrames() << " 帧，缓冲区满丢失 " << pSource->GetLostFrames() << " 帧" << endl;
+    }
+    cout << "每帧内存分配次数: " << (processedFrames > 0 ? static_cast<double>(allocations) / processedFrames : 0) << endl;
+    pipeline.PrintStatistics(cout);
+}
+
+int main(int argc, char* argv[])
+{
+    double frameRate = 0;
+    uint64_t frameCount = c_defaultFrameCount;
+    uint64_t warmUpFrames = c_defaultWarmUpFrames;
+    bool useSource = false;
+    double dropProbability = 0;
+    double corruptionProbability = 0;
+    vector<string> fileNames;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            frameRate = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            frameCount = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+        {
+            warmUpFrames = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-s") == 0)
+        {
+            useSource = true;
+        }
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        {
+            dropProbability = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            corruptionProbability = atof(argv[++i]);
+        }
+        else
+        {
+            fileNames.push_back(argv[i]);
+        }
+    }
+
+    //Pylon自动初始化和终止
+    PylonAutoInitTerm autoInitTerm;
+    CCountingMatAllocator matAllocator;
+    Mat::setDefaultAllocator(&matAllocator);
+    int result = 0;
+    try
+    {
+        if (useSource)
+        {
+            //合成帧源自己生成图像，不读取图片文件
+            SSyntheticFrameSourceConfiguration sourceConfiguration;
+            sourceConfiguration.width = c_syntheticWidth;
+            sourceConfiguration.height = c_syntheticHeight;
+            sourceConfiguration.frameRate = frameRate;
+            sourceConfiguration.dropProbability = dropProbability;
+            sourceConfiguration.corruptionProbability = corruptionProbability;
+            CSyntheticFrameSource source(sourceConfiguration);
+            RunBenchmark(vector<CPylonImage>(), true, frameRate, frameCount, warmUpFrames, &source);
+        }
+        else
+        {
+            //准备回放的图像，回放过程中不再修改
+            vector<CPylonImage> images;
+            for (size_t i = 0; i < fileNames.size(); ++i)
+            {
+                CPylonImage image;
+                if (LoadImage(fileNames[i], image))
+                {
+                    images.push_back(image);
+                }
+                else
+                {
+                    cerr << "无法读取图片：" << fileNames[i] << endl;
+                }
+            }
+            if (fileNames.empty())
+            {
+                images.push_back(SampleImageCreator::CreateMandelbrotFractal(PixelType_Mono8, c_syntheticWidth, c_syntheticHeight));
+                images.push_back(SampleImageCreator::CreateJuliaFractal(PixelType_Mono8, c_syntheticWidth, c_syntheticHeight));
+            }
+
+            if (images.empty())
+            {
+                result = 1;
+            }
+            else
+            {
+                RunBenchmark(images, fileNames.empty(), frameRate, frameCount, warmUpFrames, NULL);
+            }
+        }
+    }
+    catch (const GenICam::GenericException& e)
+    {
+        cerr << "An exception occurred." << endl
+            << e.GetDescription() << endl;
+        result = 1;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "An exception occurred." << endl
+            << e.what() << endl;
+        result = 1;
+    }
+
+    //恢复默认的分配器，之后分配的缓冲区不再计数
+    Mat::setDefaultAllocator(NULL);
+    return result;
+}
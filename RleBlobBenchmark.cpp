@@ -0,0 +1,184 @@
+/*
+*比较两种轮廓测量方法的速度和结果：
+*1. OpenCV：findContours + boundingRect + contourArea + arcLength（pylon_opencv_demo.cpp原来的做法）
+*2. 游程编码的连通域分析（include/RleBlobAnalyzer.h）
+*两种方法处理同样的二值图像（高斯模糊、三角法二值化和闭运算之后），同样丢弃宽度小于图像一半的对象
+*另外测量按行分块并行处理（include/BandParallelMeasurement.h）在不同线程数下的速度
+*用法：RleBlobBenchmark [图片文件...]，默认读取流水线保存的image_0.jpg
+*/
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "include/BandParallelMeasurement.h"
+#include "include/FusedContourFrontEnd.h"
+#include "include/RleBlobAnalyzer.h"
+
+using namespace cv;
+using namespace std;
+
+//每张图片重复测量的次数
+static const int c_repetitions = 100;
+
+//一个对象的测量结果
+struct SObject
+{
+    Rect boundingRect;
+    double area;
+    double perimeter;
+};
+
+static bool CompareByPosition(const SObject& a, const SObject& b)
+{
+    return (a.boundingRect.y != b.boundingRect.y) ? a.boundingRect.y < b.boundingRect.y : a.boundingRect.x < b.boundingRect.x;
+}
+
+//原来的做法：先找出所有轮廓，再按宽度过滤
+static void MeasureWithContours(const Mat& binary, vector<vector<Point> >& contours, vector<SObject>& objects)
+{
+    objects.clear();
+    findContours(binary, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+    for (size_t i = 0; i < contours.size(); ++i)
+    {
+        const Rect rect = boundingRect(contours[i]);
+        if (rect.width < binary.cols / 2)
+        {
+            continue;
+        }
+        SObject object;
+        object.boundingRect = rect;
+        object.area = contourArea(contours[i]);
+        object.perimeter = arcLength(contours[i], true);
+        objects.push_back(object);
+    }
+}
+
+//游程编码：一次扫描完成连通域标记和测量，小对象在输出前就被过滤掉
+static void MeasureWithRuns(const Mat& binary, CRleBlobAnalyzer& analyzer, vector<SRleBlob>& blobs, vector<SObject>& objects)
+{
+    objects.clear();
+    SRleBlobFilter filter;
+    filter.minWidth = binary.cols / 2;
+    analyzer.Analyze(binary.ptr<uint8_t>(), binary.cols, binary.rows, binary.step, filter, blobs);
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+        SObject object;
+        object.boundingRect = Rect(blobs[i].left, blobs[i].top, blobs[i].Width(), blobs[i].Height());
+        object.area = static_cast<double>(blobs[i].area);
+        object.perimeter = blobs[i].perimeter;
+        objects.push_back(object);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    vector<string> fileNames;
+    for (int i = 1; i < argc; ++i)
+    {
+        fileNames.push_back(argv[i]);
+    }
+    if (fileNames.empty())
+    {
+        fileNames.push_back("image_0.jpg");
+    }
+
+    CFusedContourFrontEnd frontEnd;
+    CRleBlobAnalyzer analyzer;
+    vector<vector<Point> > contours;
+    vector<SRleBlob> blobs;
+    vector<SObject> contourObjects;
+    vector<SObject> runObjects;
+    Mat gaussImg, morphImg;
+
+    for (size_t f = 0; f < fileNames.size(); ++f)
+    {
+        const Mat srcImg = imread(fileNames[f], IMREAD_GRAYSCALE);
+        if (srcImg.empty())
+        {
+            cerr << "无法读取图片：" << fileNames[f] << endl;
+            continue;
+        }
+
+        //高斯模糊、二值化和闭运算
+        frontEnd.Process(srcImg, gaussImg, morphImg);
+
+        //计时，结果缓冲区在重复测量时复用
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int i = 0; i < c_repetitions; ++i)
+        {
+            MeasureWithContours(morphImg, contours, contourObjects);
+        }
+        const double contourTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / c_repetitions;
+
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < c_repetitions; ++i)
+        {
+            MeasureWithRuns(morphImg, analyzer, blobs, runObjects);
+        }
+        const double runTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / c_repetitions;
+
+        cout << fileNames[f] << " (" << srcImg.cols << "x" << srcImg.rows << ")" << endl;
+        cout << "  findContours: " << contourTime << " ms, " << contourObjects.size() << " 个对象" << endl;
+        cout << "  游程编码:     " << runTime << " ms, " << runObjects.size() << " 个对象" << endl;
+        if (runTime > 0)
+        {
+            cout << "  加速比:       " << contourTime / runTime << endl;
+        }
+
+        //比较外接矩形相同的对象的面积和周长
+        //游程编码的面积是像素数（不含孔洞），周长是像素边界的长度，因此都比多边形的结果略大
+        sort(contourObjects.begin(), contourObjects.end(), CompareByPosition);
+        sort(runObjects.begin(), runObjects.end(), CompareByPosition);
+        for (size_t i = 0; i < contourObjects.size(); ++i)
+        {
+            for (size_t k = 0; k < runObjects.size(); ++k)
+            {
+                if (runObjects[k].boundingRect == contourObjects[i].boundingRect)
+                {
+                    cout << "  对象 " << contourObjects[i].boundingRect
+                         << " 面积 " << contourObjects[i].area << " / " << runObjects[k].area
+                         << " 周长 " << contourObjects[i].perimeter << " / " << runObjects[k].perimeter << endl;
+                    break;
+                }
+            }
+        }
+
+        //串行处理（前端+游程编码）作为基准
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < c_repetitions; ++i)
+        {
+            frontEnd.Process(srcImg, gaussImg, morphImg);
+            MeasureWithRuns(morphImg, analyzer, blobs, runObjects);
+        }
+        const double serialTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / c_repetitions;
+        cout << "  串行 前端+游程编码: " << serialTime << " ms" << endl;
+
+        //按行分块并行，线程数依次加倍
+        const size_t maxThreads = max(1u, thread::hardware_concurrency());
+        SRleBlobFilter filter;
+        filter.minWidth = srcImg.cols / 2;
+        for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+        {
+            CWorkStealingPool pool(threads);
+            CBandParallelFrontEnd parallelFrontEnd(pool);
+            CBandParallelBlobAnalyzer parallelAnalyzer(pool);
+            start = chrono::steady_clock::now();
+            for (int i = 0; i < c_repetitions; ++i)
+            {
+                parallelFrontEnd.Process(srcImg, gaussImg, morphImg);
+                parallelAnalyzer.Analyze(morphImg, filter, blobs);
+            }
+            const double parallelTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / c_repetitions;
+            cout << "  并行 " << threads << " 线程: " << parallelTime << " ms, 加速比 " << serialTime / parallelTime
+                 << ", " << blobs.size() << " 个对象" << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,271 @@
+/*
+*用已知几何参数的合成场景（include/SyntheticScene.h）同时检验测量精度和速度：
+*1. 矩形和圆的面积、周长已知，用游程编码的连通域分析（include/RleBlobAnalyzer.h）测量，统计与理论值的偏差
+*2. 光斑的中心已知，用光斑跟踪（include/BrightSpotTracker.h）测量，统计质心的偏差
+*3. 统计每帧的渲染时间和测量时间；场景只重新渲染运动对象经过的区域，同时输出每帧渲染的像素数
+*最后用同样的场景测量RGB8和Bayer格式的渲染速度
+*用法：SceneBenchmark [帧数]
+*/
+
+//图像的宽和高
+#define sceneWidth 1280
+#define sceneHeight 1024
+//默认的帧数
+#define framesToRender 1000
+//二值化阈值，大于阈值的像素为对象，应在背景和对象的亮度之间
+#define binaryThreshold 100
+//光点的亮度阈值，应大于矩形和圆的亮度
+#define brightThreshold 200
+
+#include <pylon/PylonIncludes.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "include/BrightSpotTracker.h"
+#include "include/LatencyHistogram.h"
+#include "include/RleBlobAnalyzer.h"
+#include "include/SyntheticScene.h"
+
+using namespace Pylon;
+using namespace std;
+
+//一类对象的测量偏差
+struct SErrorStatistics
+{
+    SErrorStatistics()
+        : count(0)
+        , sum(0)
+        , maximum(0)
+    {
+    }
+
+    void Add(double error)
+    {
+        ++count;
+        sum += fabs(error);
+        maximum = max(maximum, fabs(error));
+    }
+
+    uint64_t count;
+    double sum;
+    double maximum;
+};
+
+static void PrintError(const char* name, const SErrorStatistics& statistics, const char* unit)
+{
+    cout << name << "：平均 " << (statistics.count > 0 ? statistics.sum / statistics.count : 0) << unit
+         << "，最大 " << statistics.maximum << unit << "（" << statistics.count << " 次测量）" << endl;
+}
+
+static void PrintLatency(const char* name, const CLatencyHistogram& histogram)
+{
+    cout << name << "：p50 " << histogram.GetPercentile(0.5) / 1000.0 << " us，p99 " << histogram.GetPercentile(0.99) / 1000.0
+         << " us，最大 " << histogram.GetMaximum() / 1000.0 << " us" << endl;
+}
+
+static uint64_t GetElapsed(chrono::steady_clock::time_point start)
+{
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+}
+
+//测试场景：静止和水平运动的矩形、圆，以及一个斜向运动的光斑
+//光斑经过其他对象时与对象连成一个连通域，这些帧不统计偏差
+static void AddObjects(CSyntheticScene& scene)
+{
+    SSceneObject object;
+    object.red = object.green = object.blue = 160;
+
+    object.type = SceneObjectType_Rectangle;
+    object.x = 200;
+    object.y = 150;
+    object.width = 120;
+    object.height = 80;
+    scene.AddObject(object);
+    object.x = 600;
+    object.y = 550;
+    object.width = 41;
+    object.height = 200;
+    object.velocityX = 3.3;
+    scene.AddObject(object);
+
+    object.type = SceneObjectType_Circle;
+    object.x = 1000;
+    object.y = 300;
+    object.width = 150;
+    object.velocityX = 0;
+    scene.AddObject(object);
+    object.x = 300;
+    object.y = 800;
+    object.width = 60;
+    object.velocityX = -2.7;
+    scene.AddObject(object);
+
+    object.type = SceneObjectType_Spot;
+    object.x = 640;
+    object.y = 512;
+    object.width = 3;
+    object.velocityX = 4.1;
+    object.velocityY = 2.9;
+    object.red = object.green = object.blue = 255;
+    scene.AddObject(object);
+}
+
+//每个对象对应质心最近的连通域
+static const SRleBlob* FindClosestBlob(const SSceneObject& object, const vector<SRleBlob>& blobs)
+{
+    const SRleBlob* pClosest = NULL;
+    double closestDistance = 0;
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+        //连通域的坐标是像素的序号，像素x的中心在场景坐标x + 0.5处
+        const double dx = blobs[i].centroidX + 0.5 - object.x;
+        const double dy = blobs[i].centroidY + 0.5 - object.y;
+        const double distance = dx * dx + dy * dy;
+        if (pClosest == NULL || distance < closestDistance)
+        {
+            pClosest = &blobs[i];
+            closestDistance = distance;
+        }
+    }
+    return pClosest;
+}
+
+//测量Mono8场景
+static void MeasureScene(int frameCount)
+{
+    SSyntheticSceneConfiguration configuration;
+    configuration.width = sceneWidth;
+    configuration.height = sceneHeight;
+    CSyntheticScene scene(configuration);
+    AddObjects(scene);
+
+    CRleBlobAnalyzer analyzer;
+    CBrightSpotTracker tracker(brightThreshold);
+    SRleBlobFilter filter;
+    vector<SRleBlob> blobs;
+    vector<uint8_t> binary(static_cast<size_t>(sceneWidth) * sceneHeight);
+    CLatencyHistogram renderTime;
+    CLatencyHistogram measureTime;
+    CLatencyHistogram trackTime;
+    SErrorStatistics rectangleArea, rectanglePerimeter, circleArea, circlePerimeter, spotCentroid;
+    uint64_t renderedPixels = 0;
+    int overlappingFrames = 0;
+
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        const CPylonImage& image = scene.RenderFrame();
+        renderTime.Record(GetElapsed(start));
+        renderedPixels += scene.GetRenderedPixels();
+
+        size_t stride = 0;
+        image.GetStride(stride);
+        const uint8_t* pImage = static_cast<const uint8_t*>(image.GetBuffer());
+
+        //二值化和连通域分析
+        start = chrono::steady_clock::now();
+        for (int y = 0; y < sceneHeight; ++y)
+        {
+            const uint8_t* pRow = pImage + y * stride;
+            uint8_t* pBinary = &binary[static_cast<size_t>(y) * sceneWidth];
+            for (int x = 0; x < sceneWidth; ++x)
+            {
+                pBinary[x] = (pRow[x] > binaryThreshold) ? 255 : 0;
+            }
+        }
+        analyzer.Analyze(&binary[0], sceneWidth, sceneHeight, sceneWidth, filter, blobs);
+        measureTime.Record(GetElapsed(start));
+
+        //跟踪光斑
+        start = chrono::steady_clock::now();
+        SBrightSpot spot;
+        const bool found = tracker.Track(pImage, sceneWidth, sceneHeight, static_cast<ptrdiff_t>(stride), 1, 0, 0, spot);
+        trackTime.Record(GetElapsed(start));
+
+        //每个对象一个连通域时才比较，否则有对象重叠
+        if (blobs.size() != scene.GetObjectCount())
+        {
+            ++overlappingFrames;
+            continue;
+        }
+        for (size_t i = 0; i < scene.GetObjectCount(); ++i)
+        {
+            const SSceneObject& object = scene.GetObject(i);
+            if (object.type == SceneObjectType_Spot)
+            {
+                if (found)
+                {
+                    spotCentroid.Add(hypot(spot.centroidX + 0.5 - object.x, spot.centroidY + 0.5 - object.y));
+                }
+                continue;
+            }
+            const SRleBlob* pBlob = FindClosestBlob(object, blobs);
+            const double areaError = (pBlob->area - CSyntheticScene::GetExpectedArea(object)) / CSyntheticScene::GetExpectedArea(object);
+            const double perimeterError = (pBlob->perimeter - CSyntheticScene::GetExpectedPerimeter(object)) / CSyntheticScene::GetExpectedPerimeter(object);
+            (object.type == SceneObjectType_Rectangle ? rectangleArea : circleArea).Add(areaError * 100);
+            (object.type == SceneObjectType_Rectangle ? rectanglePerimeter : circlePerimeter).Add(perimeterError * 100);
+        }
+    }
+
+    cout << "Mono8 " << sceneWidth << "x" << sceneHeight << "，" << frameCount << " 帧，对象重叠 " << overlappingFrames << " 帧" << endl;
+    PrintError("矩形面积偏差", rectangleArea, "%");
+    PrintError("矩形周长偏差", rectanglePerimeter, "%");
+    PrintError("圆面积偏差", circleArea, "%");
+    PrintError("圆周长偏差", circlePerimeter, "%");
+    PrintError("光斑质心偏差", spotCentroid, " 像素");
+    PrintLatency("渲染", renderTime);
+    PrintLatency("二值化+连通域分析", measureTime);
+    PrintLatency("光斑跟踪", trackTime);
+    cout << "平均每帧渲染 " << renderedPixels / max(frameCount, 1) << " 像素，整幅图像 " << sceneWidth * sceneHeight << " 像素" << endl;
+}
+
+//只渲染，测量其他像素格式的渲染速度
+static void MeasureRenderSpeed(EPixelType pixelType, const char* name, int frameCount)
+{
+    SSyntheticSceneConfiguration configuration;
+    configuration.pixelType = pixelType;
+    configuration.width = sceneWidth;
+    configuration.height = sceneHeight;
+    CSyntheticScene scene(configuration);
+    AddObjects(scene);
+
+    CLatencyHistogram renderTime;
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        scene.RenderFrame();
+        renderTime.Record(GetElapsed(start));
+    }
+    PrintLatency(name, renderTime);
+}
+
+int main(int argc, char* argv[])
+{
+    const int frameCount = (argc > 1) ? atoi(argv[1]) : framesToRender;
+
+    //Pylon自动初始化和终止
+    PylonAutoInitTerm autoInitTerm;
+    try
+    {
+        MeasureScene(frameCount);
+        MeasureRenderSpeed(PixelType_RGB8packed, "渲染 RGB8", frameCount);
+        MeasureRenderSpeed(PixelType_BayerRG8, "渲染 BayerRG8", frameCount);
+    }
+    catch (const GenICam::GenericException& e)
+    {
+        cerr << "An exception occurred." << endl
+            << e.GetDescription() << endl;
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "An exception occurred." << endl
+            << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+*采集图像到命名共享内存中（include/SharedMemoryBufferFactory.h），其他进程用SharedFrameReader.cpp直接读取，不复制图像
+*相机直接采集到共享内存的缓冲区中，每一帧的元数据（缓冲区序号、块ID、时间戳、宽高等）写入共享内存中的无锁环形队列
+*读取进程处理完一帧后释放缓冲区，本进程再把缓冲区还给相机；读取进程跟不上时相机的空闲缓冲区减少，按相机的设置丢帧
+*采集结束后通知读取进程，读取进程处理完队列中剩余的帧后退出
+*用法：SharedFrameGrab [共享内存名称]，默认/basler_frames
+*/
+
+//共享内存中的缓冲区个数，也是相机的MaxNumBuffer，应大于读取进程同时持有的帧数
+#define sharedSlotCount 16
+//环形队列中最多等待读取的帧数
+#define sharedRingCapacity 64
+//采集的帧数
+#define framesToGrab 100000
+//RetrieveResult的超时（毫秒），超时后回收读取进程释放的缓冲区；应小于一帧的时间，否则相机可能等待空闲缓冲区
+#define retrieveTimeoutMs 5
+
+#include <pylon/PylonIncludes.h>
+
+#include <iostream>
+#include <string>
+
+#include "include/SharedMemoryBufferFactory.h"
+
+using namespace Pylon;
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    const string name = (argc > 1) ? argv[1] : "/basler_frames";
+
+    //Pylon自动初始化和终止
+    PylonAutoInitTerm autoInitTerm;
+    int result = 0;
+    try
+    {
+        CInstantCamera camera(CTlFactory::GetInstance().CreateFirstDevice());
+        cerr << "Using device " << camera.GetDeviceInfo().GetModelName() << endl;
+        camera.Open();
+
+        //缓冲区的大小按当前的PayloadSize确定，采集期间不能修改图像大小
+        //相机销毁时删除缓冲区工厂（Cleanup_Delete），保证缓冲区工厂在相机之后销毁
+        const int64_t payloadSize = CIntegerParameter(camera.GetNodeMap(), "PayloadSize").GetValue();
+        CSharedMemoryBufferFactory* pFactory = new CSharedMemoryBufferFactory(name, sharedSlotCount, (size_t)payloadSize, sharedRingCapacity);
+        camera.SetBufferFactory(pFactory, Cleanup_Delete);
+        camera.MaxNumBuffer = sharedSlotCount;
+        cerr << "共享内存：" << name << "，缓冲区 " << sharedSlotCount << " x " << payloadSize << " 字节" << endl;
+
+        camera.StartGrabbing(framesToGrab);
+        CGrabResultPtr ptrGrabResult;
+        uint64_t failedFrames = 0;
+        while (camera.IsGrabbing())
+        {
+            //每次等待之前回收读取进程释放的缓冲区，相机才能尽早使用；只有本线程能把缓冲区还给相机，所以超时要短
+            pFactory->ReclaimReleasedSlots();
+            if (!camera.RetrieveResult(retrieveTimeoutMs, ptrGrabResult, TimeoutHandling_Return))
+            {
+                continue;
+            }
+            if (ptrGrabResult->GrabSucceeded())
+            {
+                pFactory->Publish(ptrGrabResult);
+            }
+            else
+            {
+                ++failedFrames;
+                cerr << "Error: " << ptrGrabResult->GetErrorCode() << " " << ptrGrabResult->GetErrorDescription() << endl;
+            }
+            //发布后共享内存中的缓冲区由读取进程释放
+            ptrGrabResult.Release();
+        }
+
+        //读取进程处理完队列中的帧后退出
+        pFactory->Close();
+        cerr << "发布 " << pFactory->GetPublishedFrames() << " 帧，队列满丢弃 " << pFactory->GetDroppedFrames()
+             << " 帧，采集失败 " << failedFrames << " 帧，未释放 " << pFactory->GetHeldFrames() << " 帧" << endl;
+        pFactory->ReleaseAll();
+    }
+    catch (const GenericException& e)
+    {
+        cerr << "An exception occurred." << endl
+            << e.GetDescription() << endl;
+        result = 1;
+    }
+    return result;
+}
@@ -0,0 +1,82 @@
+/*
+*读取SharedFrameGrab.cpp采集到共享内存中的图像，直接在共享内存中查找光斑，不复制图像（include/SharedFrameRing.h）
+*可以同时运行多个读取进程，每一帧只由其中一个进程处理；处理完立即释放缓冲区，采集进程再把缓冲区还给相机
+*输出每一帧的光斑个数，结束时输出从发布到读取的延迟分布；只处理Mono8图像，其他像素格式的帧只计数
+*用法：SharedFrameReader [共享内存名称] [帧数]，默认/basler_frames，帧数为0表示读取到采集进程结束
+*/
+
+//光点的亮度阈值，所有颜色分量都大于阈值的像素为光点
+#define brightThreshold 200
+//Pylon::PixelType_Mono8的值，读取进程不需要pylon
+#define pixelTypeMono8 0x01080001u
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/BrightSpotExtractor.h"
+#include "include/LatencyHistogram.h"
+#include "include/SharedFrameRing.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    const string name = (argc > 1) ? argv[1] : "/basler_frames";
+    const uint64_t frameCount = (argc > 2) ? strtoull(argv[2], NULL, 10) : 0;
+
+    //等待采集进程创建共享内存
+    CSharedFrameConsumer consumer;
+    while (!consumer.Open(name))
+    {
+        fprintf(stderr, "等待共享内存：%s\r", name.c_str());
+        this_thread::sleep_for(chrono::milliseconds(500));
+    }
+
+    CBrightSpotExtractor extractor(brightThreshold);
+    CLatencyHistogram latency;
+    vector<SBrightSpot> spots;
+    SSharedFrameRecord record;
+    const uint8_t* pImage = NULL;
+    uint64_t received = 0;
+    uint64_t unsupported = 0;
+    printf("blockId,width,height,spots\n");
+    while (frameCount == 0 || received < frameCount)
+    {
+        //先读取结束标志：采集进程结束且队列为空时退出
+        const bool isClosed = consumer.IsProducerClosed();
+        if (!consumer.Receive(record, pImage))
+        {
+            if (isClosed)
+            {
+                break;
+            }
+            this_thread::sleep_for(chrono::microseconds(100));
+            continue;
+        }
+        const uint64_t now = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+        latency.Record(now > record.publishTime ? now - record.publishTime : 0);
+
+        //只处理Mono8图像，一行的字节数包括PaddingX
+        if (record.pixelType == pixelTypeMono8 && record.payloadSize >= (uint64_t)(record.width + record.paddingX) * record.height)
+        {
+            extractor.Extract(pImage, (int)record.width, (int)record.height, (ptrdiff_t)(record.width + record.paddingX), 1, spots);
+        }
+        else
+        {
+            ++unsupported;
+            spots.clear();
+        }
+        consumer.Release(record);
+        ++received;
+        printf("%llu,%u,%u,%u\n", (unsigned long long)record.blockId, record.width, record.height, (unsigned int)spots.size());
+    }
+
+    fprintf(stderr, "读取 %llu 帧，不支持的格式 %llu 帧，延迟 p50 %.1f us，p99 %.1f us，最大 %.1f us\n",
+        (unsigned long long)received, (unsigned long long)unsupported,
+        latency.GetPercentile(0.5) / 1000.0, latency.GetPercentile(0.99) / 1000.0, latency.GetMaximum() / 1000.0);
+    return 0;
+}
@@ -0,0 +1,341 @@
+/*
+*光斑跟踪：从相机连续采集图像，跟踪光斑（如激光光斑）的位置，输出每一帧的质心坐标
+*根据最近两帧的位置预测下一帧的位置，只在预测位置附近的窗口内搜索（include/BrightSpotTracker.h）
+*丢失光斑时重新搜索整幅图像，每帧的处理时间与光斑大小成正比，与图像大小无关
+*可选地让相机的AOI（OffsetX/OffsetY/Width/Height，与include/PixelFormatAndAoiConfiguration.h相同的参数）跟随光斑，
+*只传输光斑附近的图像，减少传输时间
+*每一帧曝光结束、取得图像、等待RetrieveResult、跟踪、输出和移动AOI的时间记录在帧时间线文件中（include/FrameTrace.h），
+*用FrameTraceExport转换为JSON后可以在chrome://tracing中查看；从曝光结束到取得图像的时间包括传输和在输出队列中等待的时间
+*/
+
+//定义是否让相机AOI跟随光斑
+#define cameraAoi 1
+//光点的亮度阈值，所有颜色分量都大于阈值的像素为光点
+#define brightThreshold 200
+//搜索窗口超出光斑外接矩形的像素数，应大于两帧之间速度的变化
+#define searchMargin 32
+//相机AOI跟随光斑时的宽和高
+#define aoiSize 256
+//采集的帧数
+#define framesToGrab 1000
+//帧时间线文件，为空字符串时不记录
+#define frameTraceFile "frames.trace"
+//帧时间线文件中保留的最新记录数
+#define frameTraceCapacity 65536
+//定义是否在帧时间线中记录相机的曝光结束事件，相机不支持时忽略
+#define exposureEndEvents 1
+
+#include <pylon/PylonIncludes.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "include/BrightSpotTracker.h"
+#include "include/FrameTraceHandlers.h"
+#include "include/LatencyHistogram.h"
+
+using namespace Pylon;
+using namespace std;
+
+//相机AOI，修改Width和Height时必须停止采集
+//大多数相机可以在采集时修改OffsetX和OffsetY，否则移动AOI时也停止采集
+class CCameraAoi
+{
+public:
+    explicit CCameraAoi(CInstantCamera& camera)
+        : m_camera(camera)
+        , m_width(camera.GetNodeMap(), "Width")
+        , m_height(camera.GetNodeMap(), "Height")
+        , m_offsetX(camera.GetNodeMap(), "OffsetX")
+        , m_offsetY(camera.GetNodeMap(), "OffsetY")
+        , m_isSmall(false)
+    {
+    }
+
+    //恢复整个传感器的AOI
+    void SetFull()
+    {
+        StopGrabbing();
+        m_offsetX.TrySetToMinimum();
+        m_offsetY.TrySetToMinimum();
+        m_width.SetToMaximum();
+        m_height.SetToMaximum();
+        m_isSmall = false;
+        StartGrabbing();
+    }
+
+    //把AOI缩小为aoiSize，中心为(x, y)
+    void SetSmall(double x, double y)
+    {
+        StopGrabbing();
+        m_offsetX.TrySetToMinimum();
+        m_offsetY.TrySetToMinimum();
+        m_width.SetValue(Align(aoiSize, m_width));
+        m_height.SetValue(Align(aoiSize, m_height));
+        m_isSmall = true;
+        SetOffsets(x, y);
+        StartGrabbing();
+    }
+
+    //移动AOI，中心为(x, y)
+    void Move(double x, double y)
+    {
+        if (m_offsetX.IsWritable() && m_offsetY.IsWritable())
+        {
+            SetOffsets(x, y);
+            return;
+        }
+        StopGrabbing();
+        SetOffsets(x, y);
+        StartGrabbing();
+    }
+
+    bool IsSmall() const
+    {
+        return m_isSmall;
+    }
+
+    void StartGrabbing()
+    {
+        //只取最新的图像，避免处理缓存的旧图像增加延迟
+        m_camera.StartGrabbing(GrabStrategy_LatestImageOnly);
+    }
+
+private:
+    void StopGrabbing()
+    {
+        if (m_camera.IsGrabbing())
+        {
+            m_camera.StopGrabbing();
+        }
+    }
+
+    //偏移量按步长取整并限制在有效范围内
+    void SetOffsets(double x, double y)
+    {
+        m_offsetX.TrySetValue(Align((int64_t)floor(x) - m_width.GetValue() / 2, m_offsetX));
+        m_offsetY.TrySetValue(Align((int64_t)floor(y) - m_height.GetValue() / 2, m_offsetY));
+    }
+
+    static int64_t Align(int64_t value, const CIntegerParameter& parameter)
+    {
+        const int64_t minimum = parameter.GetMin();
+        const int64_t maximum = parameter.GetMax();
+        const int64_t increment = parameter.GetInc();
+        value = (value < minimum) ? minimum : (value > maximum ? maximum : value);
+        return minimum + (value - minimum) / increment * increment;
+    }
+
+    CInstantCamera& m_camera;
+    CIntegerParameter m_width;
+    CIntegerParameter m_height;
+    CIntegerParameter m_offsetX;
+    CIntegerParameter m_offsetY;
+    bool m_isSmall;
+};
+
+//移动AOI在帧时间线中的阶段
+static const EFrameTracePhase c_aoiPhase = FrameTracePhase_User;
+
+//扫描器支持Mono8、BGR8/RGB8和BGRA8
+static int GetBytesPerPixel(EPixelType pixelType)
+{
+    switch (pixelType)
+    {
+    case PixelType_Mono8:
+        return 1;
+    case PixelType_BGR8packed:
+    case PixelType_RGB8packed:
+        return 3;
+    case PixelType_BGRA8packed:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+//打开或关闭相机的曝光结束事件，相机不支持时返回false
+static bool SetExposureEndEvents(CInstantCamera& camera, bool enable)
+{
+    CEnumParameter eventSelector(camera.GetNodeMap(), "EventSelector");
+    CEnumParameter eventNotification(camera.GetNodeMap(), "EventNotification");
+    if (!eventSelector.TrySetValue("ExposureEnd"))
+    {
+        return false;
+    }
+    if (!enable)
+    {
+        return eventNotification.TrySetValue("Off");
+    }
+    //较早的GigE相机没有On，使用GenICamEvent
+    return eventNotification.TrySetValue("On") || eventNotification.TrySetValue("GenICamEvent");
+}
+
+static void PrintLatency(const char* name, const CLatencyHistogram& histogram)
+{
+    cerr << name << "：" << histogram.GetCount() << " 帧，p50 " << histogram.GetPercentile(0.5) / 1000.0
+         << " us，p99 " << histogram.GetPercentile(0.99) / 1000.0 << " us，最大 " << histogram.GetMaximum() / 1000.0 << " us" << endl;
+}
+
+int main()
+{
+    //Pylon自动初始化和终止
+    PylonAutoInitTerm autoInitTerm;
+    int result = 0;
+    //时间线必须比相机存在得更久，相机销毁之前还会调用事件处理器
+    CFrameTrace trace;
+    if (strlen(frameTraceFile) > 0)
+    {
+        if (trace.Create(frameTraceFile, frameTraceCapacity))
+        {
+            trace.SetPhaseName(c_aoiPhase, "MoveAoi");
+        }
+        else
+        {
+            cerr << "无法创建帧时间线文件：" << frameTraceFile << endl;
+        }
+    }
+    try
+    {
+        CInstantCamera camera(CTlFactory::GetInstance().CreateFirstDevice());
+        cerr << "Using device " << camera.GetDeviceInfo().GetModelName() << endl;
+        camera.MaxNumBuffer = 5;
+        camera.RegisterImageEventHandler(new CFrameTraceImageHandler(trace), RegistrationMode_Append, Cleanup_Delete);
+        //移动AOI时重新开始采集，块ID从1开始，时间线中按采集的次数区分同一块ID的不同帧
+        camera.RegisterConfiguration(new CFrameTraceConfigurationHandler(trace), RegistrationMode_Append, Cleanup_Delete);
+        camera.Open();
+
+        //曝光结束事件按帧ID记录在时间线中；SFNC 2.0及以上的相机（如USB相机）和较早的相机的节点名称不同
+        bool isExposureEndTraced = false;
+        if (exposureEndEvents && trace.IsEnabled())
+        {
+            const char* frameIdNode = (camera.GetNodeMap().GetNode("EventExposureEndFrameID") != NULL)
+                ? "EventExposureEndFrameID" : "ExposureEndEventFrameID";
+            if (camera.GetNodeMap().GetNode(frameIdNode) != NULL && SetExposureEndEvents(camera, true))
+            {
+                //开始采集之前打开相机事件的处理
+                camera.GrabCameraEvents = true;
+                camera.RegisterCameraEventHandler(new CFrameTraceCameraEventHandler(trace), frameIdNode, 0, RegistrationMode_Append, Cleanup_Delete);
+                isExposureEndTraced = true;
+            }
+            else
+            {
+                cerr << "相机不支持曝光结束事件，时间线中不记录曝光结束" << endl;
+            }
+        }
+
+        //直接扫描相机输出的Mono8数据，不支持Mono8的相机输出其他格式时再转换
+        CEnumParameter(camera.GetNodeMap(), "PixelFormat").TrySetValue("Mono8");
+
+        CBrightSpotTracker tracker(brightThreshold, 1, searchMargin);
+        CCameraAoi aoi(camera);
+        if (cameraAoi)
+        {
+            aoi.SetFull();
+        }
+        else
+        {
+            aoi.StartGrabbing();
+        }
+
+        //全图搜索和窗口搜索的处理时间分别统计
+        CLatencyHistogram fullScanTime;
+        CLatencyHistogram windowScanTime;
+        CImageFormatConverter converter;
+        converter.OutputPixelFormat = PixelType_BGR8packed;
+        CPylonImage convertedImage;
+        CGrabResultPtr ptrGrabResult;
+
+        cout << "frame,centroidX,centroidY,area\n";
+        for (int frame = 0; frame < framesToGrab && camera.IsGrabbing(); ++frame)
+        {
+            const uint64_t retrieveStart = trace.Now();
+            camera.RetrieveResult(5000, ptrGrabResult, TimeoutHandling_ThrowException);
+            const uint64_t blockId = ptrGrabResult->GetBlockID();
+            trace.RecordSpan(FrameTracePhase_Retrieve, blockId, retrieveStart);
+            if (!ptrGrabResult->GrabSucceeded())
+            {
+                cerr << "Error: " << ptrGrabResult->GetErrorCode() << " " << ptrGrabResult->GetErrorDescription() << endl;
+                continue;
+            }
+
+            const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            const uint64_t processingStart = trace.Now();
+            const uint8_t* pImage = static_cast<const uint8_t*>(ptrGrabResult->GetBuffer());
+            int bytesPerPixel = GetBytesPerPixel(ptrGrabResult->GetPixelType());
+            size_t stride = 0;
+            ptrGrabResult->GetStride(stride);
+            if (bytesPerPixel == 0)
+            {
+                converter.Convert(convertedImage, ptrGrabResult);
+                convertedImage.GetStride(stride);
+                pImage = static_cast<const uint8_t*>(convertedImage.GetBuffer());
+                bytesPerPixel = 3;
+            }
+
+            //图像在传感器上的位置以采集结果为准，修改AOI之前采集的图像仍使用原来的偏移量
+            const uint64_t fullScans = tracker.GetFullScanCount();
+            SBrightSpot spot;
+            const bool found = tracker.Track(pImage, (int)ptrGrabResult->GetWidth(), (int)ptrGrabResult->GetHeight(), (ptrdiff_t)stride,
+                bytesPerPixel, (int)ptrGrabResult->GetOffsetX(), (int)ptrGrabResult->GetOffsetY(), spot);
+            const uint64_t processingTime = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+            (tracker.GetFullScanCount() == fullScans ? windowScanTime : fullScanTime).Record(processingTime);
+            //参数为是否进行了全图搜索
+            trace.RecordSpan(FrameTracePhase_Processing, blockId, processingStart, tracker.GetFullScanCount() - fullScans);
+
+            {
+                CFrameTraceScope outputScope(trace, FrameTracePhase_Output, blockId);
+                if (found)
+                {
+                    cout << frame << "," << spot.centroidX << "," << spot.centroidY << "," << spot.area << '\n';
+                }
+                else
+                {
+                    cout << frame << ",,,0\n";
+                }
+            }
+
+            if (cameraAoi)
+            {
+                CFrameTraceScope aoiScope(trace, c_aoiPhase, blockId);
+                //找到光斑后AOI跟随预测位置，丢失后恢复整个传感器
+                double x = 0;
+                double y = 0;
+                tracker.GetPredictedPosition(x, y);
+                if (found && aoi.IsSmall())
+                {
+                    aoi.Move(x, y);
+                }
+                else if (found)
+                {
+                    aoi.SetSmall(x, y);
+                }
+                else if (aoi.IsSmall())
+                {
+                    aoi.SetFull();
+                }
+            }
+        }
+        cout.flush();
+
+        camera.StopGrabbing();
+        if (isExposureEndTraced)
+        {
+            SetExposureEndEvents(camera, false);
+        }
+        trace.Flush();
+        PrintLatency("全图搜索", fullScanTime);
+        PrintLatency("窗口搜索", windowScanTime);
+        cerr << "窗口内找到光斑的帧数：" << tracker.GetTrackedFrameCount() << "，全图搜索次数：" << tracker.GetFullScanCount() << endl;
+    }
+    catch (const GenericException& e)
+    {
+        cerr << "An exception occurred." << endl
+            << e.GetDescription() << endl;
+        result = 1;
+    }
+
+    return result;
+}
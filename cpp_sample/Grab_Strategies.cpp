@@ -14,6 +14,7 @@
 // Include files used by samples.
 #include "../include/ConfigurationEventPrinter.h"
 #include "../include/ImageEventPrinter.h"
+#include "../include/AdaptiveGrabStrategy.h"
 
 // Namespace for using pylon objects.
 using namespace Pylon;
@@ -206,6 +207,58 @@ int main(int argc, char* argv[])
 
 
 
+            cout << endl << "Grab using an adaptive strategy:" << endl << endl;
+
+            // CAdaptiveGrabStrategy uses GrabStrategy_LatestImages and adapts the OutputQueueSize during grabbing.
+            // While the images are processed in time, the queue holds MaxNumBuffer images and no image is skipped.
+            // If the images waiting in the output queue can't be processed within the latency budget,
+            // the queue is shortened and older images are skipped instead of waiting.
+            {
+                SAdaptiveGrabConfiguration adaptiveConfiguration;
+                adaptiveConfiguration.latencyBudget = 100 * 1000 * 1000;
+                adaptiveConfiguration.evaluationInterval = 8;
+                adaptiveConfiguration.recoveryIntervals = 2;
+                CAdaptiveGrabStrategy adaptiveStrategy( camera, adaptiveConfiguration);
+                adaptiveStrategy.StartGrabbing();
+
+                // Simulate a processing load that rises for a while: In the second phase, two images are triggered
+                // per image processed and the processing takes 20 ms, so the backlog grows by one image per image processed.
+                // Once more than four images wait, (backlog + 1) * 20 ms exceeds the budget of 100 ms and the queue
+                // is shortened to 100 ms / 20 ms = 5 images. In the third phase, the backlog is processed quickly
+                // and the strategy returns to lossless queuing.
+                for ( int phase = 0; phase < 3; ++phase)
+                {
+                    const bool isOverloaded = (phase == 1);
+                    for ( int i = 0; i < 50; ++i)
+                    {
+                        for ( int trigger = 0; trigger < (isOverloaded ? 2 : 1); ++trigger)
+                        {
+                            if ( camera.WaitForFrameTriggerReady( 1000, TimeoutHandling_ThrowException))
+                            {
+                                camera.ExecuteSoftwareTrigger();
+                            }
+                        }
+                        if ( adaptiveStrategy.RetrieveResult( 1000, ptrGrabResult, TimeoutHandling_Return))
+                        {
+                            WaitObject::Sleep( isOverloaded ? 20 : 1);
+                        }
+                    }
+                    adaptiveStrategy.EndProcessing();
+                    cout << "Phase " << phase << ": output queue size " << adaptiveStrategy.GetOutputQueueSize()
+                        << (adaptiveStrategy.IsLossless() ? " (lossless)" : " (latest images)")
+                        << ", skipped " << adaptiveStrategy.GetSkippedImages() << " images"
+                        << ", p99 latency " << adaptiveStrategy.GetLatency().GetPercentile( 0.99) / 1000000.0 << " ms" << endl << endl;
+                }
+
+                cout << "Processed " << adaptiveStrategy.GetProcessedImages() << " images, switched the mode "
+                    << adaptiveStrategy.GetModeSwitches() << " times." << endl << endl;
+
+                //Stop the grabbing.
+                camera.StopGrabbing();
+            }
+
+
+
             // The Upcoming Image grab strategy can't be used together with USB camera devices.
             // For more information, see the advanced topics section of the pylon Programmer's Guide.
             if ( !camera.IsUsb())
@@ -8,6 +8,10 @@
     This sample demonstrates how to use a user-provided buffer factory.
     Using a buffer factory is optional and intended for advanced use cases only.
     A buffer factory is only necessary if you want to grab into externally supplied buffers.
+
+    MyBufferFactory shows the interface and allocates every buffer with new.
+    CPooledBufferFactory (include/PooledBufferFactory.h) carves the buffers out of one locked, optionally
+    huge page backed memory arena and uses the same memory again when grabbing is started again.
 */
 
 // Include files to use the pylon API.
@@ -16,6 +20,8 @@
 #include <pylon/PylonGUI.h>
 #endif
 
+#include "../include/PooledBufferFactory.h"
+
 // Namespace for using pylon objects.
 using namespace Pylon;
 
@@ -25,6 +31,12 @@ using namespace std;
 // Number of images to be grabbed.
 static const uint32_t c_countOfImagesToGrab = 5;
 
+// Number of times grabbing is started. The pooled buffer factory uses the same buffers every time.
+static const int c_grabCycles = 2;
+
+// Set to false to use MyBufferFactory instead of CPooledBufferFactory.
+static const bool c_usePooledBufferFactory = true;
+
 
 // A user-provided buffer factory.
 class MyBufferFactory : public IBufferFactory
@@ -122,6 +134,11 @@ int main(int argc, char* argv[])
         // in this sample.
         MyBufferFactory myFactory;
 
+        // The arena must hold MaxNumBuffer buffers of the largest payload size.
+        SPooledBufferFactoryConfiguration pooledConfiguration;
+        pooledConfiguration.arenaSize = 64 * 1024 * 1024;
+        CPooledBufferFactory pooledFactory( pooledConfiguration);
+
         // Create an instant camera object with the camera device found first.
         CInstantCamera camera( CTlFactory::GetInstance().CreateFirstDevice());
 
@@ -130,45 +147,69 @@ int main(int argc, char* argv[])
 
         // Use our own implementation of a buffer factory.
         // Since we control the lifetime of the factory object, we pass Cleanup_None.
-        camera.SetBufferFactory(&myFactory, Cleanup_None);
+        if (c_usePooledBufferFactory)
+        {
+            camera.SetBufferFactory(&pooledFactory, Cleanup_None);
+        }
+        else
+        {
+            camera.SetBufferFactory(&myFactory, Cleanup_None);
+        }
 
         // The parameter MaxNumBuffer can be used to control the count of buffers
         // allocated for grabbing. The default value of this parameter is 10.
         camera.MaxNumBuffer = 5;
 
-        // Start the grabbing of c_countOfImagesToGrab images.
-        // The camera device is parameterized with a default configuration which
-        // sets up free-running continuous acquisition.
-        camera.StartGrabbing( c_countOfImagesToGrab);
-
-        // This smart pointer will receive the grab result data.
-        CGrabResultPtr ptrGrabResult;
-
-        // Camera.StopGrabbing() is called automatically by the RetrieveResult() method
-        // when c_countOfImagesToGrab images have been retrieved.
-        while ( camera.IsGrabbing())
+        for (int cycle = 0; cycle < c_grabCycles; ++cycle)
         {
-            // Wait for an image and then retrieve it. A timeout of 5000 ms is used.
-            camera.RetrieveResult( 5000, ptrGrabResult, TimeoutHandling_ThrowException);
+            // Start the grabbing of c_countOfImagesToGrab images.
+            // The camera device is parameterized with a default configuration which
+            // sets up free-running continuous acquisition.
+            camera.StartGrabbing( c_countOfImagesToGrab);
 
-            // Image grabbed successfully?
-            if (ptrGrabResult->GrabSucceeded())
+            // This smart pointer will receive the grab result data.
+            CGrabResultPtr ptrGrabResult;
+
+            // Camera.StopGrabbing() is called automatically by the RetrieveResult() method
+            // when c_countOfImagesToGrab images have been retrieved.
+            while ( camera.IsGrabbing())
             {
-                // Access the image data.
-                cout << "Context: " << ptrGrabResult->GetBufferContext() << endl;
-                cout << "SizeX: " << ptrGrabResult->GetWidth() << endl;
-                cout << "SizeY: " << ptrGrabResult->GetHeight() << endl;
-                const uint8_t *pImageBuffer = (uint8_t *) ptrGrabResult->GetBuffer();
-                cout << "First value of pixel data: " << (uint32_t) pImageBuffer[0] << endl << endl;
+                // Wait for an image and then retrieve it. A timeout of 5000 ms is used.
+                camera.RetrieveResult( 5000, ptrGrabResult, TimeoutHandling_ThrowException);
+
+                // Image grabbed successfully?
+                if (ptrGrabResult->GrabSucceeded())
+                {
+                    // Access the image data.
+                    cout << "Context: " << ptrGrabResult->GetBufferContext() << endl;
+                    cout << "SizeX: " << ptrGrabResult->GetWidth() << endl;
+                    cout << "SizeY: " << ptrGrabResult->GetHeight() << endl;
+                    const uint8_t *pImageBuffer = (uint8_t *) ptrGrabResult->GetBuffer();
+                    cout << "First value of pixel data: " << (uint32_t) pImageBuffer[0] << endl << endl;
 
 #ifdef PYLON_WIN_BUILD
-                // Display the grabbed image.
-                Pylon::DisplayImage(1, ptrGrabResult);
+                    // Display the grabbed image.
+                    Pylon::DisplayImage(1, ptrGrabResult);
 #endif
+                }
+                else
+                {
+                    cout << "Error: " << ptrGrabResult->GetErrorCode() << " " << ptrGrabResult->GetErrorDescription();
+                }
             }
-            else
+
+            // The last grab result still holds its buffer. The buffer can't be freed before it is released.
+            ptrGrabResult.Release();
+
+            // The buffers have been freed by StopGrabbing() and by releasing the last grab result.
+            // They are used again in the next cycle.
+            if (c_usePooledBufferFactory)
             {
-                cout << "Error: " << ptrGrabResult->GetErrorCode() << " " << ptrGrabResult->GetErrorDescription();
+                const SPooledBufferFactoryStatistics statistics = pooledFactory.GetStatistics();
+                cout << "Arena: " << statistics.arenaSize << " bytes, huge pages: " << statistics.usesHugePages
+                    << ", locked: " << statistics.isLocked << endl;
+                cout << "Buffers allocated: " << statistics.allocations << ", on the heap: " << statistics.heapAllocations
+                    << ", freed: " << statistics.frees << ", peak use: " << statistics.peakBytesInUse << " bytes" << endl << endl;
             }
         }
     }
@@ -17,12 +17,15 @@
 
 // Include files used by samples.
 #include "../include/ConfigurationEventPrinter.h"
+#include "../include/LatencyHistogram.h"
+#include "../include/SpscQueue.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iomanip>
-
-#ifdef PYLON_UNIX_BUILD
-#    include <sys/time.h>
-#endif
+#include <thread>
+#include <vector>
 
 // Include file to use pylon universal instant camera parameters.
 #include <pylon/BaslerUniversalInstantCamera.h>
@@ -56,81 +59,262 @@ const char* MyEventNames[] =
     "NoEvent              "
 };
 
+// Threads adding items to the log. Each thread has its own ring in the log.
+enum MyLogProducers
+{
+    eMyCameraEventProducer,   // The thread calling OnCameraEvent().
+    eMyImageProducer,         // The thread calling OnImageGrabbed().
+    eMyProducerCount
+};
+
 // Used for logging received events without outputting the information on the screen
 // because outputting will change the timing.
 // This class is used for demonstration purposes only.
 struct LogItem
 {
     LogItem()
-        : eventType( eMyNoEvent)
+        : time( 0)
+        , eventType( eMyNoEvent)
         , frameNumber(0)
     {
     }
 
     LogItem( MyEvents event, uint16_t frameNr)
-        : eventType(event)
+        : time( static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count()))
+        , eventType(event)
         , frameNumber(frameNr)
     {
-        //Warning, measured values can be wrong on older computer hardware.
-#if defined(PYLON_WIN_BUILD)
-        QueryPerformanceCounter(&time);
-#elif defined(PYLON_UNIX_BUILD)
-        struct timeval tv;
-
-        gettimeofday(&tv, NULL);
-        time = static_cast<unsigned long long>(tv.tv_sec) * 1000L + static_cast<unsigned long long>(tv.tv_usec) / 1000LL;
-#endif
     }
 
-
-#if defined(PYLON_WIN_BUILD)
-    LARGE_INTEGER time; // Recorded time stamps.
-#elif defined(PYLON_UNIX_BUILD)
-    unsigned long long time; // Recorded time stamps.
-#endif
+    uint64_t time; // Recorded time stamp in ns, steady clock.
     MyEvents eventType; // Type of the received event.
     uint16_t frameNumber; // Frame number of the received event.
 };
 
 
-// Helper function for printing a log.
-// This function is used for demonstration purposes only.
-void PrintLog( const std::vector<LogItem>& aLog)
+// Log receiving items from the camera event thread and the image thread.
+// Each producer pushes its items into its own lock-free ring, so logging takes no lock and allocates no memory.
+// A background thread takes the items from the rings, merges them by time and computes the latency from the
+// Exposure End event to the receipt of the image of the same frame while grabbing. Events and images without a partner
+// within c_pairTimeout are counted as missing. Only the most recent items are kept for printing, so the log can run
+// for any length of time.
+// This class is used for demonstration purposes only.
+class CEventLog
 {
-#if defined(PYLON_WIN_BUILD)
-    // Get the computer timer frequency.
-    LARGE_INTEGER timerFrequency;
-    QueryPerformanceFrequency(&timerFrequency);
-#endif
-
-    cout << std::endl << "Warning, the printed time values can be wrong on older computer hardware." << std::endl << std::endl;
-    // Print the event information header.
-    cout << "Time [ms]    " << "Event                 " << "FrameNumber" << std::endl;
-    cout << "------------ " << "--------------------- " << "-----------" << std::endl;
-
-    // Print the logged information.
-    size_t logSize = aLog.size();
-    for ( size_t i = 0; i < logSize; ++i)
+public:
+    CEventLog()
+        : m_cameraEventRing( c_ringCapacity)
+        , m_imageRing( c_ringCapacity)
+        , m_history( c_historySize)
+        , m_historyCount( 0)
+        , m_exposureEndTimes( 65536, 0)
+        , m_imageTimes( 65536, 0)
+        , m_imagesBeforeExposureEnd( 0)
+        , m_missingImages( 0)
+        , m_missingExposureEnds( 0)
+        , m_droppedItems( 0)
+        , m_stop( false)
+    {
+        m_pending.reserve( 2 * eMyProducerCount * c_ringCapacity);
+        m_mergeThread = std::thread( &CEventLog::Merge, this);
+    }
+
+    ~CEventLog()
+    {
+        Stop();
+    }
+
+    // Called by the producer thread only. Never blocks, items that don't fit are counted as dropped.
+    void Add( MyLogProducers producer, const LogItem& item)
     {
-        // Calculate the elapsed time between the events.
-        double time_ms = 0;
-        if ( i)
+        CSpscQueue<LogItem>& ring = (producer == eMyCameraEventProducer) ? m_cameraEventRing : m_imageRing;
+        if ( !ring.TryPush( item))
         {
-#if defined(PYLON_WIN_BUILD)
-            __int64 oldTicks = ((__int64)aLog[i-1].time.HighPart << 32) + (__int64)aLog[i-1].time.LowPart;
-            __int64 newTicks = ((__int64)aLog[i].time.HighPart << 32) + (__int64)aLog[i].time.LowPart;
-            long double timeDifference = (long double) (newTicks - oldTicks);
-            long double ticksPerSecond = (long double) (((__int64)timerFrequency.HighPart << 32) + (__int64)timerFrequency.LowPart);
-            time_ms = (timeDifference / ticksPerSecond) * 1000;
-#elif defined(PYLON_UNIX_BUILD)
-            time_ms = aLog[i].time - aLog[i-1].time;
-#endif
+            m_droppedItems.fetch_add( 1, std::memory_order_relaxed);
         }
+    }
 
-        // Print the event information.
-        cout << setw(12) << fixed << setprecision(4) << time_ms <<" "<< MyEventNames[ aLog[i].eventType ] <<" "<< aLog[i].frameNumber << std::endl;
+    // Merges the remaining items and stops the background thread.
+    void Stop()
+    {
+        if ( m_mergeThread.joinable())
+        {
+            m_stop.store( true, std::memory_order_release);
+            m_mergeThread.join();
+        }
+    }
+
+    // Prints the most recent items and the latency distribution. Call Stop() first.
+    void Print() const
+    {
+        cout << std::endl << "Time [ms]    " << "Event                 " << "FrameNumber" << std::endl;
+        cout << "------------ " << "--------------------- " << "-----------" << std::endl;
+
+        const uint64_t first = (m_historyCount > c_historySize) ? m_historyCount - c_historySize : 0;
+        for ( uint64_t i = first; i < m_historyCount; ++i)
+        {
+            const LogItem& item = m_history[i % c_historySize];
+            // Elapsed time between the events.
+            const double time_ms = (i > first) ? (item.time - m_history[(i - 1) % c_historySize].time) / 1e6 : 0;
+            cout << setw(12) << fixed << setprecision(4) << time_ms << " " << MyEventNames[ item.eventType ] << " " << item.frameNumber << std::endl;
+        }
+        if ( first > 0)
+        {
+            cout << "(" << first << " earlier items not shown)" << std::endl;
+        }
+        PrintLatency();
+    }
+
+private:
+    // Items per producer that can wait for the background thread.
+    static const size_t c_ringCapacity = 4096;
+    // Number of the most recent items kept for printing.
+    static const size_t c_historySize = 1000;
+    // Items are merged when they are older than this. Producers take the time immediately before adding the item,
+    // so no item older than this can still arrive from another producer.
+    static const uint64_t c_mergeDelay = 50 * 1000 * 1000;
+    // The Exposure End event and the image of a frame are paired only if they arrive within this time. An older partner
+    // is left over from a frame whose event or image has been lost and whose frame number has been reused by the wrapped counter.
+    static const uint64_t c_pairTimeout = 1000 * 1000 * 1000;
+
+    static bool IsEarlier( const LogItem& a, const LogItem& b)
+    {
+        return a.time < b.time;
+    }
+
+    // Body of the background thread.
+    void Merge()
+    {
+        uint64_t lastReport = LogItem( eMyNoEvent, 0).time;
+        for (;;)
+        {
+            const bool stop = m_stop.load( std::memory_order_acquire);
+            LogItem item;
+            while ( m_pending.size() < m_pending.capacity() && m_cameraEventRing.TryPop( item))
+            {
+                m_pending.push_back( item);
+            }
+            while ( m_pending.size() < m_pending.capacity() && m_imageRing.TryPop( item))
+            {
+                m_pending.push_back( item);
+            }
+
+            // Items older than the merge delay are complete and can be taken in the order of time.
+            std::sort( m_pending.begin(), m_pending.end(), IsEarlier);
+            const uint64_t now = LogItem( eMyNoEvent, 0).time;
+            size_t count = 0;
+            while ( count < m_pending.size() && (stop || m_pending[count].time + c_mergeDelay < now))
+            {
+                Take( m_pending[count]);
+                ++count;
+            }
+            m_pending.erase( m_pending.begin(), m_pending.begin() + count);
+
+            // Printing from this thread doesn't change the timing of the camera event and image threads.
+            if ( now - lastReport >= 1000 * 1000 * 1000 && m_exposureToImage.GetCount() > 0)
+            {
+                PrintLatency();
+                lastReport = now;
+            }
+            if ( stop)
+            {
+                CountUnpaired();
+                return;
+            }
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10));
+        }
+    }
+
+    // Called by the background thread for each item in the order of time.
+    void Take( const LogItem& item)
+    {
+        m_history[m_historyCount % c_historySize] = item;
+        ++m_historyCount;
+
+        // Pair the Exposure End event and the image of each frame, whichever comes first.
+        if ( item.eventType == eMyExposureEndEvent)
+        {
+            if ( m_imageTimes[item.frameNumber] != 0 && item.time - m_imageTimes[item.frameNumber] <= c_pairTimeout)
+            {
+                ++m_imagesBeforeExposureEnd;
+                m_imageTimes[item.frameNumber] = 0;
+            }
+            else
+            {
+                ExpireUnpaired( item.frameNumber);
+                m_exposureEndTimes[item.frameNumber] = item.time;
+            }
+        }
+        else if ( item.eventType == eMyImageReceivedEvent)
+        {
+            if ( m_exposureEndTimes[item.frameNumber] != 0 && item.time - m_exposureEndTimes[item.frameNumber] <= c_pairTimeout)
+            {
+                m_exposureToImage.Record( item.time - m_exposureEndTimes[item.frameNumber]);
+                m_exposureEndTimes[item.frameNumber] = 0;
+            }
+            else
+            {
+                ExpireUnpaired( item.frameNumber);
+                m_imageTimes[item.frameNumber] = item.time;
+            }
+        }
+    }
+
+    // Counts a partner left over from an earlier frame with the same frame number as a missing event or image.
+    void ExpireUnpaired( uint16_t frameNumber)
+    {
+        if ( m_exposureEndTimes[frameNumber] != 0)
+        {
+            ++m_missingImages;
+            m_exposureEndTimes[frameNumber] = 0;
+        }
+        if ( m_imageTimes[frameNumber] != 0)
+        {
+            ++m_missingExposureEnds;
+            m_imageTimes[frameNumber] = 0;
+        }
+    }
+
+    // Called after taking the last item. Frames still waiting for their partner have lost it.
+    void CountUnpaired()
+    {
+        for ( size_t frameNumber = 0; frameNumber < m_exposureEndTimes.size(); ++frameNumber)
+        {
+            ExpireUnpaired( static_cast<uint16_t>(frameNumber));
+        }
     }
-}
+
+    void PrintLatency() const
+    {
+        cout << "Exposure End -> image received: " << m_exposureToImage.GetCount() << " frames, p50 "
+             << m_exposureToImage.GetPercentile( 0.5) / 1000.0 << " us, p99 " << m_exposureToImage.GetPercentile( 0.99) / 1000.0
+             << " us, max " << m_exposureToImage.GetMaximum() / 1000.0 << " us, images before the event: " << m_imagesBeforeExposureEnd
+             << ", missing images: " << m_missingImages << ", missing events: " << m_missingExposureEnds
+             << ", dropped log items: " << m_droppedItems.load( std::memory_order_relaxed) << std::endl;
+    }
+
+    // Not copyable.
+    CEventLog( const CEventLog&);
+    CEventLog& operator=( const CEventLog&);
+
+    CSpscQueue<LogItem> m_cameraEventRing;
+    CSpscQueue<LogItem> m_imageRing;
+
+    // Used by the background thread only.
+    std::vector<LogItem> m_pending;
+    std::vector<LogItem> m_history;
+    uint64_t m_historyCount;
+    std::vector<uint64_t> m_exposureEndTimes;   // Indexed by frame number, 0 if not waiting for the image.
+    std::vector<uint64_t> m_imageTimes;         // Indexed by frame number, 0 if not waiting for the event.
+    CLatencyHistogram m_exposureToImage;
+    uint64_t m_imagesBeforeExposureEnd;
+    uint64_t m_missingImages;                   // Exposure End events whose image hasn't arrived in time.
+    uint64_t m_missingExposureEnds;             // Images whose Exposure End event hasn't arrived in time.
+
+    std::atomic<uint64_t> m_droppedItems;
+    std::atomic<bool> m_stop;
+    std::thread m_mergeThread;
+};
 
 
 // Number of images to be grabbed.
@@ -143,16 +327,15 @@ class CEventHandler : public CBaslerUniversalCameraEventHandler, public CBaslerU
 {
 public:
     CEventHandler()
+        : m_nextFrameNumberForMove( 0)
     {
-        // Reserve space to log camera, image and move events.
-        m_log.reserve( c_countOfImagesToGrab * 3);
     }
 
     void Initialize(int value , bool isGigE) 
     {
         m_nextExpectedFrameNumberImage = value;
         m_nextExpectedFrameNumberExposureEnd = value;
-        m_nextFrameNumberForMove = value;
+        m_nextFrameNumberForMove.store( value);
         m_isGigE = isGigE;
     }
 
@@ -171,16 +354,13 @@ public:
             {
                 frameNumber = (uint16_t)camera.EventExposureEndFrameID.GetValue();
             }
-            m_log.push_back( LogItem( eMyExposureEndEvent, frameNumber));
+            m_log.Add( eMyCameraEventProducer, LogItem( eMyExposureEndEvent, frameNumber));
 
             // If Exposure End event is not doubled.
             if ( GetIncrementedFrameNumber( frameNumber) != m_nextExpectedFrameNumberExposureEnd)
             {
                 // Check whether the imaged item or the sensor head can be moved.
-                if ( frameNumber == m_nextFrameNumberForMove)
-                {
-                    MoveImagedItemOrSensorHead();
-                }
+                MoveImagedItemOrSensorHead( frameNumber, eMyCameraEventProducer);
 
                 // Check for missing Exposure End events.
                 if ( frameNumber != m_nextExpectedFrameNumberExposureEnd)
@@ -193,7 +373,7 @@ public:
         else if ( userProvidedId == eMyFrameStartOvertrigger)
         {
             // The camera has been overtriggered.
-            m_log.push_back( LogItem( eMyFrameStartOvertrigger, 0));
+            m_log.Add( eMyCameraEventProducer, LogItem( eMyFrameStartOvertrigger, 0));
 
             // Handle this error...
         }
@@ -208,14 +388,11 @@ public:
     {
         // An image has been received.
         uint16_t frameNumber = (uint16_t)ptrGrabResult->GetBlockID();
-        m_log.push_back( LogItem( eMyImageReceivedEvent, frameNumber));
+        m_log.Add( eMyImageProducer, LogItem( eMyImageReceivedEvent, frameNumber));
 
         // Check whether the imaged item or the sensor head can be moved.
         // This will be the case if the Exposure End has been lost or if the Exposure End is received later than the image.
-        if ( frameNumber == m_nextFrameNumberForMove)
-        {
-            MoveImagedItemOrSensorHead();
-        }
+        MoveImagedItemOrSensorHead( frameNumber, eMyImageProducer);
 
         // Check for missing images.
         if ( frameNumber != m_nextExpectedFrameNumberImage)
@@ -225,18 +402,24 @@ public:
         IncrementFrameNumber( m_nextExpectedFrameNumberImage);
     }
 
-    void MoveImagedItemOrSensorHead()
+    // Called by the camera event thread and the image thread. Only the first call for a frame moves.
+    void MoveImagedItemOrSensorHead( uint16_t frameNumber, MyLogProducers producer)
     {
+        uint16_t expected = frameNumber;
+        if ( !m_nextFrameNumberForMove.compare_exchange_strong( expected, GetIncrementedFrameNumber( frameNumber)))
+        {
+            return;
+        }
         // The imaged item or the sensor head can be moved now...
         // The camera may not be ready for a trigger at this point yet because the sensor is still being read out.
         // See the documentation of the CInstantCamera::WaitForFrameTriggerReady() method for more information.
-        m_log.push_back( LogItem( eMyMoveEvent, m_nextFrameNumberForMove));
-        IncrementFrameNumber( m_nextFrameNumberForMove);
+        m_log.Add( producer, LogItem( eMyMoveEvent, frameNumber));
     }
 
     void PrintLog()
     {
-        ::PrintLog( m_log);
+        m_log.Stop();
+        m_log.Print();
     }
 
 private:
@@ -264,11 +447,11 @@ private:
 
     uint16_t m_nextExpectedFrameNumberImage;
     uint16_t m_nextExpectedFrameNumberExposureEnd;
-    uint16_t m_nextFrameNumberForMove;
+    std::atomic<uint16_t> m_nextFrameNumberForMove;
 
     bool m_isGigE;
 
-    std::vector<LogItem> m_log;
+    CEventLog m_log;
 };
 
 
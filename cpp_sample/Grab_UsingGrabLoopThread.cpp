@@ -18,6 +18,7 @@
 // Include files used by samples.
 #include "../include/ConfigurationEventPrinter.h"
 #include "../include/ImageEventPrinter.h"
+#include "../include/AsyncEventPrinter.h"
 
 // Namespace for using pylon objects.
 using namespace Pylon;
@@ -25,6 +26,10 @@ using namespace Pylon;
 // Namespace for using cout.
 using namespace std;
 
+// Set to false to print the events synchronously from the grab engine thread using CImageEventPrinter and
+// CConfigurationEventPrinter. The asynchronous printers print them from the background thread of CAsyncEventLog.
+static const bool c_useAsyncEventPrinters = true;
+
 //Example of an image event handler.
 class CSampleImageEventHandler : public CImageEventHandler
 {
@@ -62,12 +67,28 @@ int main(int argc, char* argv[])
 
         // For demonstration purposes only, add a sample configuration event handler to print out information
         // about camera use.
-        camera.RegisterConfiguration( new CConfigurationEventPrinter, RegistrationMode_Append, Cleanup_Delete);
+        if (c_useAsyncEventPrinters)
+        {
+            camera.RegisterConfiguration( new CAsyncConfigurationEventPrinter, RegistrationMode_Append, Cleanup_Delete);
+        }
+        else
+        {
+            camera.RegisterConfiguration( new CConfigurationEventPrinter, RegistrationMode_Append, Cleanup_Delete);
+        }
 
         // The image event printer serves as sample image processing.
         // When using the grab loop thread provided by the Instant Camera object, an image event handler processing the grab
         // results must be created and registered.
-        camera.RegisterImageEventHandler( new CImageEventPrinter, RegistrationMode_Append, Cleanup_Delete);
+        if (c_useAsyncEventPrinters)
+        {
+            // Print the image size and the value of the first pixel, too. Raise the sampling interval for high frame rates.
+            CAsyncEventLog::GetDefault().SetVerbosity( AsyncEventVerbosity_Details);
+            camera.RegisterImageEventHandler( new CAsyncImageEventPrinter, RegistrationMode_Append, Cleanup_Delete);
+        }
+        else
+        {
+            camera.RegisterImageEventHandler( new CImageEventPrinter, RegistrationMode_Append, Cleanup_Delete);
+        }
 
         // For demonstration purposes only, register another image event handler.
         camera.RegisterImageEventHandler( new CSampleImageEventHandler, RegistrationMode_Append, Cleanup_Delete);
@@ -0,0 +1,222 @@
+// Contains a grab strategy that switches between lossless queuing and keeping only the latest images,
+// depending on the latency of the processing.
+//
+// Grabbing uses GrabStrategy_LatestImages, whose OutputQueueSize can be changed while grabbing. With an
+// output queue as large as MaxNumBuffer no image is dropped, like with GrabStrategy_OneByOne. When the latency
+// exceeds the latency budget, the output queue is shortened to the number of images that can be processed within
+// the budget, so older images are skipped instead of waiting. When the latency has stayed well below the budget
+// for a while, the queue is lengthened again step by step.
+//
+// The time an image has waited in the output queue can't be taken on the host: OnImageGrabbed() is called inside
+// RetrieveResult() by the retrieving thread, not when the grab engine puts the image into the output queue.
+// Therefore the latency is estimated from the backlog instead. When an image has been retrieved, NumReadyBuffers
+// tells how many images wait behind it. The newest of them is processed after all images before it, so its latency
+// is (backlog + 1) * processing time.
+
+#ifndef INCLUDED_ADAPTIVEGRABSTRATEGY_H_3063874
+#define INCLUDED_ADAPTIVEGRABSTRATEGY_H_3063874
+
+#include <pylon/PylonIncludes.h>
+
+#include "LatencyHistogram.h"
+
+#include <chrono>
+#include <cstdint>
+
+struct SAdaptiveGrabConfiguration
+{
+    SAdaptiveGrabConfiguration()
+        : latencyBudget( 50 * 1000 * 1000)
+        , minOutputQueueSize( 1)
+        , evaluationInterval( 32)
+        , recoveryIntervals( 4)
+        , recoveryFraction( 0.5)
+    {
+    }
+
+    uint64_t latencyBudget;         // Maximum estimated time in ns an image waits in the output queue and is processed.
+    int64_t minOutputQueueSize;     // The queue is never shortened below this size.
+    uint32_t evaluationInterval;    // Number of processed images after which the queue size is adapted.
+    uint32_t recoveryIntervals;     // Intervals with low latency after which the queue is lengthened.
+    double recoveryFraction;        // Latency is low if it stays below this fraction of the budget.
+};
+
+
+class CAdaptiveGrabStrategy
+{
+public:
+    // The camera must exist longer than the strategy.
+    CAdaptiveGrabStrategy( Pylon::CInstantCamera& camera, const SAdaptiveGrabConfiguration& configuration = SAdaptiveGrabConfiguration())
+        : m_camera( camera)
+        , m_configuration( configuration)
+        , m_maxQueueSize( 0)
+        , m_queueSize( 0)
+        , m_processedImages( 0)
+        , m_skippedImages( 0)
+        , m_modeSwitches( 0)
+        , m_intervalImages( 0)
+        , m_intervalMaximum( 0)
+        , m_intervalProcessingTime( 0)
+        , m_lowLatencyIntervals( 0)
+        , m_processingStart( 0)
+        , m_backlog( 0)
+    {
+    }
+
+    // Starts grabbing without dropping images.
+    void StartGrabbing()
+    {
+        m_maxQueueSize = m_camera.MaxNumBuffer.GetValue();
+        SetQueueSize( m_maxQueueSize);
+        m_lowLatencyIntervals = 0;
+        ResetInterval();
+        m_camera.StartGrabbing( Pylon::GrabStrategy_LatestImages);
+    }
+
+    // Retrieves the next image like CInstantCamera::RetrieveResult(). Processing starts when the call returns
+    // and ends with the next call or with EndProcessing().
+    bool RetrieveResult( unsigned int timeoutMs, Pylon::CGrabResultPtr& ptrGrabResult,
+        Pylon::ETimeoutHandling timeoutHandling = Pylon::TimeoutHandling_ThrowException)
+    {
+        EndProcessing();
+        if ( !m_camera.RetrieveResult( timeoutMs, ptrGrabResult, timeoutHandling))
+        {
+            return false;
+        }
+        m_skippedImages += ptrGrabResult->GetNumberOfSkippedImages();
+        // The images waiting in the output queue behind the retrieved one.
+        m_backlog = static_cast<uint64_t>(m_camera.NumReadyBuffers.GetValue());
+        m_processingStart = GetNow();
+        return true;
+    }
+
+    // Records the latency of the image retrieved last and adapts the queue size. Called by RetrieveResult() if not called before.
+    void EndProcessing()
+    {
+        if ( m_processingStart == 0)
+        {
+            return;
+        }
+        const uint64_t processingTime = GetNow() - m_processingStart;
+        // The estimated latency of the newest image waiting in the output queue.
+        const uint64_t latency = (m_backlog + 1) * processingTime;
+        m_latency.Record( latency);
+        m_intervalMaximum = (latency > m_intervalMaximum) ? latency : m_intervalMaximum;
+        m_intervalProcessingTime += processingTime;
+        m_processingStart = 0;
+        ++m_processedImages;
+        if ( ++m_intervalImages >= m_configuration.evaluationInterval)
+        {
+            Adapt();
+        }
+    }
+
+    // The output queue holds as many images as there are buffers, so no image is skipped.
+    bool IsLossless() const
+    {
+        return m_queueSize >= m_maxQueueSize;
+    }
+
+    int64_t GetOutputQueueSize() const
+    {
+        return m_queueSize;
+    }
+
+    uint64_t GetProcessedImages() const
+    {
+        return m_processedImages;
+    }
+
+    // Images skipped by the output queue, see GetNumberOfSkippedImages().
+    uint64_t GetSkippedImages() const
+    {
+        return m_skippedImages;
+    }
+
+    // Number of switches between lossless and bounded queuing.
+    uint64_t GetModeSwitches() const
+    {
+        return m_modeSwitches;
+    }
+
+    // Estimated time the newest waiting image spends in the output queue and in processing, one value per processed image.
+    const CLatencyHistogram& GetLatency() const
+    {
+        return m_latency;
+    }
+
+private:
+    static uint64_t GetNow()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void Adapt()
+    {
+        const uint64_t averageProcessingTime = m_intervalProcessingTime / m_intervalImages;
+        if ( m_intervalMaximum > m_configuration.latencyBudget)
+        {
+            // An image waits for the images before it, so the budget allows budget / processing time images in the queue.
+            int64_t queueSize = (averageProcessingTime > 0) ? static_cast<int64_t>(m_configuration.latencyBudget / averageProcessingTime) : 1;
+            queueSize = (queueSize < m_configuration.minOutputQueueSize) ? m_configuration.minOutputQueueSize : queueSize;
+            if ( queueSize < m_queueSize)
+            {
+                SetQueueSize( queueSize);
+            }
+            m_lowLatencyIntervals = 0;
+        }
+        else if ( m_intervalMaximum < m_configuration.latencyBudget * m_configuration.recoveryFraction && m_queueSize < m_maxQueueSize)
+        {
+            if ( ++m_lowLatencyIntervals >= m_configuration.recoveryIntervals)
+            {
+                SetQueueSize( (m_queueSize * 2 < m_maxQueueSize) ? m_queueSize * 2 : m_maxQueueSize);
+                m_lowLatencyIntervals = 0;
+            }
+        }
+        else
+        {
+            m_lowLatencyIntervals = 0;
+        }
+        ResetInterval();
+    }
+
+    void SetQueueSize( int64_t queueSize)
+    {
+        const bool wasLossless = IsLossless();
+        m_camera.OutputQueueSize.SetValue( queueSize);
+        m_queueSize = queueSize;
+        if ( wasLossless != IsLossless())
+        {
+            ++m_modeSwitches;
+        }
+    }
+
+    void ResetInterval()
+    {
+        m_intervalImages = 0;
+        m_intervalMaximum = 0;
+        m_intervalProcessingTime = 0;
+    }
+
+    // Not copyable.
+    CAdaptiveGrabStrategy( const CAdaptiveGrabStrategy&);
+    CAdaptiveGrabStrategy& operator=( const CAdaptiveGrabStrategy&);
+
+    Pylon::CInstantCamera& m_camera;
+    const SAdaptiveGrabConfiguration m_configuration;
+    int64_t m_maxQueueSize;
+    int64_t m_queueSize;
+    uint64_t m_processedImages;
+    uint64_t m_skippedImages;
+    uint64_t m_modeSwitches;
+    uint32_t m_intervalImages;
+    uint64_t m_intervalMaximum;
+    uint64_t m_intervalProcessingTime;
+    uint32_t m_lowLatencyIntervals;
+    uint64_t m_processingStart;
+    uint64_t m_backlog;             // Images waiting behind the image being processed.
+    CLatencyHistogram m_latency;
+};
+
+#endif /* INCLUDED_ADAPTIVEGRABSTRATEGY_H_3063874 */
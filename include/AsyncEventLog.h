@@ -0,0 +1,577 @@
+// Contains an event log that takes fixed-size binary records from the threads calling the event handlers and
+// formats them in a background thread.
+//
+// Each producing thread gets its own single-producer/single-consumer ring on its first record, so logging takes
+// no lock and, after that, allocates no memory. Records that don't fit into a full ring are counted and reported
+// as dropped instead of blocking the producer. The background thread drains all rings periodically, orders the
+// records by time and writes them to the output stream, so slow console I/O never delays the grab engine.
+// When a thread exits, the background thread drains its ring and hands it to the next thread that starts logging.
+//
+// The verbosity and the sampling interval can be changed at any time, so the logging can stay enabled in
+// production with a low verbosity or a high sampling interval. See AsyncEventPrinter.h for the event handlers.
+
+#ifndef INCLUDED_ASYNCEVENTLOG_H_5172046
+#define INCLUDED_ASYNCEVENTLOG_H_5172046
+
+#include "SpscQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Records are only logged if the verbosity is at least the verbosity of the record.
+enum EAsyncEventVerbosity
+{
+    AsyncEventVerbosity_Off,
+    AsyncEventVerbosity_Errors,     // Failed grabs, grab errors, skipped images and device removal.
+    AsyncEventVerbosity_Events,     // All events, identified by the camera and the event.
+    AsyncEventVerbosity_Details     // All events with the data printed by the synchronous event printers.
+};
+
+enum EAsyncEventType
+{
+    AsyncEventType_ImageGrabbed,
+    AsyncEventType_ImageGrabFailed,
+    AsyncEventType_ImagesSkipped,
+    AsyncEventType_CameraEvent,
+    AsyncEventType_Attach,
+    AsyncEventType_Attached,
+    AsyncEventType_Open,
+    AsyncEventType_Opened,
+    AsyncEventType_GrabStart,
+    AsyncEventType_GrabStarted,
+    AsyncEventType_GrabStop,
+    AsyncEventType_GrabStopped,
+    AsyncEventType_Close,
+    AsyncEventType_Closed,
+    AsyncEventType_Destroy,
+    AsyncEventType_Destroyed,
+    AsyncEventType_Detach,
+    AsyncEventType_Detached,
+    AsyncEventType_GrabError,
+    AsyncEventType_CameraDeviceRemoved
+};
+
+// One logged event. The meaning of the values depends on the type, texts are truncated to fit.
+struct SAsyncEventRecord
+{
+    uint64_t time;          // Steady clock in ns.
+    uint32_t type;          // EAsyncEventType
+    uint32_t verbosity;     // Verbosity at the time of logging.
+    int64_t values[4];
+    char camera[32];        // Model name of the device.
+    char text[48];
+};
+
+
+struct SAsyncEventLogConfiguration
+{
+    SAsyncEventLogConfiguration()
+        : verbosity( AsyncEventVerbosity_Events)
+        , samplingInterval( 1)
+        , ringCapacity( 1024)
+        , drainIntervalMs( 20)
+    {
+    }
+
+    EAsyncEventVerbosity verbosity;
+    uint32_t samplingInterval;      // Only every n-th image grabbed and camera event is logged by each thread.
+    size_t ringCapacity;            // Records per producing thread.
+    unsigned int drainIntervalMs;   // Time the background thread sleeps when all rings are empty.
+};
+
+
+class CAsyncEventLog
+{
+public:
+    // Starts the background thread. The log must exist longer than the event handlers using it.
+    explicit CAsyncEventLog( const SAsyncEventLogConfiguration& configuration = SAsyncEventLogConfiguration(), std::ostream& output = std::cout)
+        : m_id( GetNextId())
+        , m_output( output)
+        , m_ringCapacity( configuration.ringCapacity)
+        , m_drainIntervalMs( configuration.drainIntervalMs)
+        , m_verbosity( configuration.verbosity)
+        , m_samplingInterval( configuration.samplingInterval == 0 ? 1 : configuration.samplingInterval)
+        , m_unassignedDropped( 0)
+        , m_reportedUnassignedDropped( 0)
+        , m_startTime( GetNow())
+        , m_stop( false)
+    {
+        for ( size_t i = 0; i < c_maxThreads; ++i)
+        {
+            m_threads[i].owner.store( NULL, std::memory_order_relaxed);
+            m_threads[i].pRing.store( NULL, std::memory_order_relaxed);
+            m_threads[i].released.store( false, std::memory_order_relaxed);
+            m_threads[i].dropped.store( 0, std::memory_order_relaxed);
+            m_threads[i].reportedDropped = 0;
+            m_threads[i].sampleCount = 0;
+        }
+        for ( size_t i = 0; i < c_maxCameras; ++i)
+        {
+            m_cameras[i].key.store( NULL, std::memory_order_relaxed);
+            m_cameras[i].ready.store( false, std::memory_order_relaxed);
+        }
+        m_batch.reserve( c_maxThreads * m_ringCapacity);
+        {
+            SLogRegistry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock( registry.lock);
+            registry.logIds.push_back( m_id);
+        }
+        m_drainThread = std::thread( &CAsyncEventLog::Drain, this);
+    }
+
+    // Writes the remaining records and stops the background thread.
+    ~CAsyncEventLog()
+    {
+        // Threads exiting from now on don't touch the rings of this log anymore.
+        {
+            SLogRegistry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock( registry.lock);
+            registry.logIds.erase( std::remove( registry.logIds.begin(), registry.logIds.end(), m_id), registry.logIds.end());
+        }
+        m_stop.store( true, std::memory_order_release);
+        m_drainThread.join();
+        for ( size_t i = 0; i < c_maxThreads; ++i)
+        {
+            delete m_threads[i].pRing.load( std::memory_order_relaxed);
+        }
+    }
+
+    // The log used by the event printers created without a log. Created on first use, flushed at exit.
+    static CAsyncEventLog& GetDefault()
+    {
+        static CAsyncEventLog s_log;
+        return s_log;
+    }
+
+    void SetVerbosity( EAsyncEventVerbosity verbosity)
+    {
+        m_verbosity.store( verbosity, std::memory_order_relaxed);
+    }
+
+    EAsyncEventVerbosity GetVerbosity() const
+    {
+        return static_cast<EAsyncEventVerbosity>(m_verbosity.load( std::memory_order_relaxed));
+    }
+
+    void SetSamplingInterval( uint32_t samplingInterval)
+    {
+        m_samplingInterval.store( samplingInterval == 0 ? 1 : samplingInterval, std::memory_order_relaxed);
+    }
+
+    // Returns true if records of the given verbosity are logged. Lets handlers skip collecting the data.
+    bool IsEnabled( EAsyncEventVerbosity verbosity) const
+    {
+        return verbosity != AsyncEventVerbosity_Off && m_verbosity.load( std::memory_order_relaxed) >= verbosity;
+    }
+
+    // Returns true for every n-th call of the calling thread, n being the sampling interval.
+    bool Sample()
+    {
+        SThreadRing* pThread = GetThreadRing();
+        if ( pThread == NULL)
+        {
+            return false;
+        }
+        return (pThread->sampleCount++ % m_samplingInterval.load( std::memory_order_relaxed)) == 0;
+    }
+
+    // Copies the record into the ring of the calling thread. Fills in the time and the verbosity.
+    // Returns false if the verbosity is too low or the ring is full.
+    bool Log( SAsyncEventRecord& record, EAsyncEventVerbosity verbosity)
+    {
+        if ( !IsEnabled( verbosity))
+        {
+            return false;
+        }
+        record.time = GetNow();
+        record.verbosity = m_verbosity.load( std::memory_order_relaxed);
+        SThreadRing* pThread = GetThreadRing();
+        if ( pThread == NULL)
+        {
+            m_unassignedDropped.fetch_add( 1, std::memory_order_relaxed);
+            return false;
+        }
+        if ( !pThread->pRing.load( std::memory_order_relaxed)->TryPush( record))
+        {
+            pThread->dropped.fetch_add( 1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Copies the model name of the device into the record. The name is read from the camera only once per camera,
+    // because GetModelName() allocates. key identifies the camera, usually its address.
+    template <typename Camera>
+    void SetCamera( SAsyncEventRecord& record, const void* key, Camera& camera)
+    {
+        for ( size_t i = 0; i < c_maxCameras; ++i)
+        {
+            SCameraName& entry = m_cameras[i];
+            const void* entryKey = entry.key.load( std::memory_order_acquire);
+            if ( entryKey == key)
+            {
+                if ( entry.ready.load( std::memory_order_acquire))
+                {
+                    memcpy( record.camera, entry.name, sizeof( record.camera));
+                    return;
+                }
+                break;
+            }
+            if ( entryKey == NULL || entryKey == GetForgottenKey())
+            {
+                if ( entry.key.compare_exchange_strong( entryKey, key, std::memory_order_acq_rel))
+                {
+                    CopyText( entry.name, sizeof( entry.name), camera.GetDeviceInfo().GetModelName().c_str());
+                    entry.ready.store( true, std::memory_order_release);
+                    memcpy( record.camera, entry.name, sizeof( record.camera));
+                    return;
+                }
+                if ( entryKey == key)
+                {
+                    // Another thread is just reading the name of the same camera.
+                    break;
+                }
+            }
+        }
+        // The table is full or the name is not yet available.
+        CopyText( record.camera, sizeof( record.camera), camera.GetDeviceInfo().GetModelName().c_str());
+    }
+
+    // Removes the cached name when the camera is destroyed, because another camera may be created at the same address.
+    void ForgetCamera( const void* key)
+    {
+        for ( size_t i = 0; i < c_maxCameras; ++i)
+        {
+            if ( m_cameras[i].key.load( std::memory_order_acquire) == key)
+            {
+                m_cameras[i].ready.store( false, std::memory_order_relaxed);
+                m_cameras[i].key.store( GetForgottenKey(), std::memory_order_release);
+            }
+        }
+    }
+
+    // Copies a text into a fixed-size field, truncating it if needed.
+    static void CopyText( char* pDestination, size_t size, const char* pText)
+    {
+        size_t i = 0;
+        for ( ; pText != NULL && pText[i] != 0 && i + 1 < size; ++i)
+        {
+            pDestination[i] = pText[i];
+        }
+        memset( pDestination + i, 0, size - i);
+    }
+
+    // Number of records not logged because a ring was full or too many threads were logging.
+    uint64_t GetDroppedRecords() const
+    {
+        uint64_t dropped = m_unassignedDropped.load( std::memory_order_relaxed);
+        for ( size_t i = 0; i < c_maxThreads; ++i)
+        {
+            dropped += m_threads[i].dropped.load( std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+
+    // Number of records not logged because all rings were taken by other threads. Included in GetDroppedRecords().
+    uint64_t GetUnassignedDroppedRecords() const
+    {
+        return m_unassignedDropped.load( std::memory_order_relaxed);
+    }
+
+private:
+    // Number of threads that can log at a time, e.g., the grab engine and event threads of several cameras.
+    static const size_t c_maxThreads = 64;
+    // Number of cameras whose names are cached.
+    static const size_t c_maxCameras = 32;
+
+    struct SThreadRing
+    {
+        std::atomic<const void*> owner;                     // Identifies the thread. NULL if the ring is free.
+        std::atomic<CSpscQueue<SAsyncEventRecord>*> pRing;  // Kept when the owner exits and reused by the next owner.
+        std::atomic<bool> released;                         // Set when the owner exits. The background thread frees the ring.
+        std::atomic<uint64_t> dropped;
+        uint64_t reportedDropped;                           // Only used by the background thread.
+        uint64_t sampleCount;                               // Only used by the owner.
+    };
+
+    struct SCameraName
+    {
+        std::atomic<const void*> key;
+        std::atomic<bool> ready;
+        char name[32];
+    };
+
+    static uint64_t GetNow()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Marks entries of the camera name table that can be used again.
+    const void* GetForgottenKey() const
+    {
+        return m_cameras;
+    }
+
+    static uint64_t GetNextId()
+    {
+        static std::atomic<uint64_t> s_nextId( 1);
+        return s_nextId.fetch_add( 1, std::memory_order_relaxed);
+    }
+
+    // The ids of the logs that exist. A thread may exit after a log it has used has been destroyed.
+    struct SLogRegistry
+    {
+        std::mutex lock;
+        std::vector<uint64_t> logIds;
+    };
+
+    static SLogRegistry& GetRegistry()
+    {
+        static SLogRegistry s_registry;
+        return s_registry;
+    }
+
+    // The rings taken by a thread. Released when the thread exits.
+    struct SThreadRings
+    {
+        struct SEntry
+        {
+            uint64_t logId;
+            SThreadRing* pThread;
+        };
+
+        ~SThreadRings()
+        {
+            SLogRegistry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock( registry.lock);
+            for ( size_t i = 0; i < entries.size(); ++i)
+            {
+                if ( std::find( registry.logIds.begin(), registry.logIds.end(), entries[i].logId) != registry.logIds.end())
+                {
+                    entries[i].pThread->released.store( true, std::memory_order_release);
+                }
+            }
+        }
+
+        std::vector<SEntry> entries;
+    };
+
+    // Returns the ring of the calling thread, taking a free ring on the first call. Returns NULL if all rings are taken.
+    SThreadRing* GetThreadRing()
+    {
+        // Cache of the ring used last by this thread. The id tells whether it belongs to this log.
+        struct SThreadCache
+        {
+            uint64_t logId;
+            SThreadRing* pThread;
+        };
+        static thread_local SThreadCache s_cache = { 0, NULL };
+        static thread_local SThreadRings s_rings;
+        if ( s_cache.logId == m_id)
+        {
+            return s_cache.pThread;
+        }
+
+        // The thread may log to several logs. Look for the ring it has already taken in this log.
+        SThreadRing* pThread = NULL;
+        for ( size_t i = 0; i < s_rings.entries.size() && pThread == NULL; ++i)
+        {
+            if ( s_rings.entries[i].logId == m_id)
+            {
+                pThread = s_rings.entries[i].pThread;
+            }
+        }
+        // The rings of exited threads are free again once the background thread has drained them.
+        const void* token = &s_rings;
+        for ( size_t i = 0; i < c_maxThreads && pThread == NULL; ++i)
+        {
+            const void* expected = NULL;
+            if ( m_threads[i].owner.compare_exchange_strong( expected, token, std::memory_order_acq_rel))
+            {
+                pThread = &m_threads[i];
+                pThread->sampleCount = 0;
+                if ( pThread->pRing.load( std::memory_order_relaxed) == NULL)
+                {
+                    pThread->pRing.store( new CSpscQueue<SAsyncEventRecord>( m_ringCapacity), std::memory_order_release);
+                }
+                SThreadRings::SEntry entry = { m_id, pThread };
+                s_rings.entries.push_back( entry);
+            }
+        }
+        if ( pThread == NULL)
+        {
+            return NULL;
+        }
+        s_cache.logId = m_id;
+        s_cache.pThread = pThread;
+        return pThread;
+    }
+
+    static bool IsEarlier( const SAsyncEventRecord& a, const SAsyncEventRecord& b)
+    {
+        return a.time < b.time;
+    }
+
+    // Body of the background thread.
+    void Drain()
+    {
+        for ( ;;)
+        {
+            // Read the flag first, so the records logged before stopping are drained in the last pass.
+            const bool stop = m_stop.load( std::memory_order_acquire);
+            m_batch.clear();
+            for ( size_t i = 0; i < c_maxThreads; ++i)
+            {
+                SThreadRing& threadRing = m_threads[i];
+                // Read the flag first. If the owner has exited, all its records are in the ring already.
+                const bool released = threadRing.released.load( std::memory_order_acquire);
+                CSpscQueue<SAsyncEventRecord>* pRing = threadRing.pRing.load( std::memory_order_acquire);
+                SAsyncEventRecord record;
+                while ( pRing != NULL && pRing->TryPop( record))
+                {
+                    m_batch.push_back( record);
+                }
+                if ( released)
+                {
+                    // The ring is empty and can be taken by another thread.
+                    threadRing.released.store( false, std::memory_order_relaxed);
+                    threadRing.owner.store( NULL, std::memory_order_release);
+                }
+            }
+            // The rings are ordered by time each, the batch is ordered across threads.
+            std::stable_sort( m_batch.begin(), m_batch.end(), IsEarlier);
+            for ( size_t i = 0; i < m_batch.size(); ++i)
+            {
+                Format( m_batch[i]);
+            }
+            ReportDropped();
+            if ( !m_batch.empty())
+            {
+                m_output.flush();
+            }
+            if ( stop)
+            {
+                return;
+            }
+            if ( m_batch.empty())
+            {
+                std::this_thread::sleep_for( std::chrono::milliseconds( m_drainIntervalMs));
+            }
+        }
+    }
+
+    void ReportDropped()
+    {
+        uint64_t dropped = 0;
+        for ( size_t i = 0; i < c_maxThreads; ++i)
+        {
+            const uint64_t total = m_threads[i].dropped.load( std::memory_order_relaxed);
+            dropped += total - m_threads[i].reportedDropped;
+            m_threads[i].reportedDropped = total;
+        }
+        if ( dropped > 0)
+        {
+            m_output << FormatTime( GetNow()).text << dropped << " event records dropped, the log can't keep up.\n";
+        }
+        const uint64_t unassignedDropped = m_unassignedDropped.load( std::memory_order_relaxed);
+        if ( unassignedDropped > m_reportedUnassignedDropped)
+        {
+            m_output << FormatTime( GetNow()).text << unassignedDropped - m_reportedUnassignedDropped
+                     << " event records dropped, more than " << c_maxThreads << " threads are logging.\n";
+            m_reportedUnassignedDropped = unassignedDropped;
+        }
+    }
+
+    struct STimeText
+    {
+        char text[32];
+    };
+
+    // Seconds since the log has been created, without changing the format of the output stream.
+    STimeText FormatTime( uint64_t time) const
+    {
+        STimeText timeText;
+        snprintf( timeText.text, sizeof( timeText.text), "[%.6f] ", (time > m_startTime) ? (time - m_startTime) / 1e9 : 0.0);
+        return timeText;
+    }
+
+    void Format( const SAsyncEventRecord& record)
+    {
+        static const char* const c_configurationEvents[] =
+        {
+            "OnAttach", "OnAttached", "OnOpen", "OnOpened", "OnGrabStart", "OnGrabStarted", "OnGrabStop", "OnGrabStopped",
+            "OnClose", "OnClosed", "OnDestroy", "OnDestroyed", "OnDetach", "OnDetached", "OnGrabError", "OnCameraDeviceRemoved"
+        };
+        const bool details = record.verbosity >= AsyncEventVerbosity_Details;
+        m_output << FormatTime( record.time).text;
+        switch ( record.type)
+        {
+        case AsyncEventType_ImageGrabbed:
+            m_output << "OnImageGrabbed event for device " << record.camera;
+            if ( details)
+            {
+                m_output << ": SizeX: " << record.values[0] << ", SizeY: " << record.values[1]
+                         << ", Gray value of first pixel: " << record.values[2] << ", Image number: " << record.values[3];
+            }
+            break;
+        case AsyncEventType_ImageGrabFailed:
+            m_output << "OnImageGrabbed event for device " << record.camera << ": Error: " << record.values[0] << " " << record.text;
+            break;
+        case AsyncEventType_ImagesSkipped:
+            m_output << "OnImagesSkipped event for device " << record.camera << ": " << record.values[0] << " images have been skipped.";
+            break;
+        case AsyncEventType_CameraEvent:
+            m_output << "OnCameraEvent event for device " << record.camera << ", User provided ID: " << record.values[0];
+            if ( details)
+            {
+                m_output << ", " << record.text;
+            }
+            break;
+        default:
+            if ( record.type >= AsyncEventType_Attach && record.type <= AsyncEventType_CameraDeviceRemoved)
+            {
+                m_output << c_configurationEvents[record.type - AsyncEventType_Attach] << " event";
+                if ( record.camera[0] != 0)
+                {
+                    m_output << " for device " << record.camera;
+                }
+                if ( record.type == AsyncEventType_GrabError)
+                {
+                    m_output << ": Error Message: " << record.text;
+                }
+            }
+            break;
+        }
+        m_output << '\n';
+    }
+
+    // Not copyable.
+    CAsyncEventLog( const CAsyncEventLog&);
+    CAsyncEventLog& operator=( const CAsyncEventLog&);
+
+    const uint64_t m_id;
+    std::ostream& m_output;
+    const size_t m_ringCapacity;
+    const unsigned int m_drainIntervalMs;
+    std::atomic<uint32_t> m_verbosity;
+    std::atomic<uint32_t> m_samplingInterval;
+    std::atomic<uint64_t> m_unassignedDropped;  // Records of threads that didn't get a ring.
+    uint64_t m_reportedUnassignedDropped;       // Only used by the background thread.
+    const uint64_t m_startTime;
+    SThreadRing m_threads[c_maxThreads];
+    SCameraName m_cameras[c_maxCameras];
+    std::vector<SAsyncEventRecord> m_batch;     // Only used by the background thread.
+    std::atomic<bool> m_stop;
+    std::thread m_drainThread;
+};
+
+#endif /* INCLUDED_ASYNCEVENTLOG_H_5172046 */
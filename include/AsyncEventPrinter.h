@@ -0,0 +1,230 @@
+// Contains event handlers that log the events printed by CImageEventPrinter, CCameraEventPrinter and
+// CConfigurationEventPrinter to a CAsyncEventLog instead of writing them to std::cout, see AsyncEventLog.h.
+//
+// The handlers can replace the synchronous printers without other changes. They only copy a fixed-size record
+// into the ring of the calling thread, so the grab engine and event threads are not blocked by console I/O and
+// cameras don't wait for each other on the stream lock. Image grabbed and camera events are subject to the
+// sampling interval of the log; failed grabs, skipped images and configuration events are never sampled out.
+
+#ifndef INCLUDED_ASYNCEVENTPRINTER_H_2280419
+#define INCLUDED_ASYNCEVENTPRINTER_H_2280419
+
+#include <pylon/ImageEventHandler.h>
+#include <pylon/CameraEventHandler.h>
+#include <pylon/ConfigurationEventHandler.h>
+#include <pylon/GrabResultPtr.h>
+#include <pylon/ParameterIncludes.h>
+
+#include "AsyncEventLog.h"
+
+class CAsyncImageEventPrinter : public Pylon::CImageEventHandler
+{
+public:
+    explicit CAsyncImageEventPrinter( CAsyncEventLog& log = CAsyncEventLog::GetDefault())
+        : m_log( log)
+    {
+    }
+
+    virtual void OnImagesSkipped( Pylon::CInstantCamera& camera, size_t countOfSkippedImages)
+    {
+        if ( !m_log.IsEnabled( AsyncEventVerbosity_Errors))
+        {
+            return;
+        }
+        SAsyncEventRecord record = SAsyncEventRecord();
+        record.type = AsyncEventType_ImagesSkipped;
+        record.values[0] = static_cast<int64_t>(countOfSkippedImages);
+        m_log.SetCamera( record, &camera, camera);
+        m_log.Log( record, AsyncEventVerbosity_Errors);
+    }
+
+    virtual void OnImageGrabbed( Pylon::CInstantCamera& camera, const Pylon::CGrabResultPtr& ptrGrabResult)
+    {
+        SAsyncEventRecord record = SAsyncEventRecord();
+        if ( ptrGrabResult->GrabSucceeded())
+        {
+            if ( !m_log.IsEnabled( AsyncEventVerbosity_Events) || !m_log.Sample())
+            {
+                return;
+            }
+            record.type = AsyncEventType_ImageGrabbed;
+            record.values[0] = ptrGrabResult->GetWidth();
+            record.values[1] = ptrGrabResult->GetHeight();
+            const uint8_t* pImageBuffer = static_cast<const uint8_t*>(ptrGrabResult->GetBuffer());
+            record.values[2] = (pImageBuffer != NULL) ? pImageBuffer[0] : 0;
+            record.values[3] = ptrGrabResult->GetImageNumber();
+            m_log.SetCamera( record, &camera, camera);
+            m_log.Log( record, AsyncEventVerbosity_Events);
+        }
+        else
+        {
+            if ( !m_log.IsEnabled( AsyncEventVerbosity_Errors))
+            {
+                return;
+            }
+            record.type = AsyncEventType_ImageGrabFailed;
+            record.values[0] = ptrGrabResult->GetErrorCode();
+            // Failed grabs are rare, reading the description doesn't matter then.
+            CAsyncEventLog::CopyText( record.text, sizeof( record.text), ptrGrabResult->GetErrorDescription().c_str());
+            m_log.SetCamera( record, &camera, camera);
+            m_log.Log( record, AsyncEventVerbosity_Errors);
+        }
+    }
+
+private:
+    CAsyncEventLog& m_log;
+};
+
+
+class CAsyncCameraEventPrinter : public Pylon::CCameraEventHandler
+{
+public:
+    explicit CAsyncCameraEventPrinter( CAsyncEventLog& log = CAsyncEventLog::GetDefault())
+        : m_log( log)
+    {
+    }
+
+    // With AsyncEventVerbosity_Details the node name and value are read as text, which allocates.
+    virtual void OnCameraEvent( Pylon::CInstantCamera& camera, intptr_t userProvidedId, GenApi::INode* pNode)
+    {
+        if ( !m_log.IsEnabled( AsyncEventVerbosity_Events) || !m_log.Sample())
+        {
+            return;
+        }
+        SAsyncEventRecord record = SAsyncEventRecord();
+        record.type = AsyncEventType_CameraEvent;
+        record.values[0] = userProvidedId;
+        if ( m_log.IsEnabled( AsyncEventVerbosity_Details) && pNode != NULL)
+        {
+            CAsyncEventLog::CopyText( record.text, sizeof( record.text), pNode->GetName().c_str());
+            Pylon::CParameter value( pNode);
+            if ( value.IsValid())
+            {
+                const size_t nameLength = strlen( record.text);
+                CAsyncEventLog::CopyText( record.text + nameLength, sizeof( record.text) - nameLength, ": ");
+                const size_t length = strlen( record.text);
+                CAsyncEventLog::CopyText( record.text + length, sizeof( record.text) - length, value.ToString().c_str());
+            }
+        }
+        m_log.SetCamera( record, &camera, camera);
+        m_log.Log( record, AsyncEventVerbosity_Events);
+    }
+
+private:
+    CAsyncEventLog& m_log;
+};
+
+
+class CAsyncConfigurationEventPrinter : public Pylon::CConfigurationEventHandler
+{
+public:
+    explicit CAsyncConfigurationEventPrinter( CAsyncEventLog& log = CAsyncEventLog::GetDefault())
+        : m_log( log)
+    {
+    }
+
+    // The device info is not available before attaching and after destroying.
+    void OnAttach( Pylon::CInstantCamera& /*camera*/)
+    {
+        Log( AsyncEventType_Attach, NULL);
+    }
+
+    void OnAttached( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_Attached, &camera);
+    }
+
+    void OnOpen( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_Open, &camera);
+    }
+
+    void OnOpened( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_Opened, &camera);
+    }
+
+    void OnGrabStart( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_GrabStart, &camera);
+    }
+
+    void OnGrabStarted( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_GrabStarted, &camera);
+    }
+
+    void OnGrabStop( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_GrabStop, &camera);
+    }
+
+    void OnGrabStopped( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_GrabStopped, &camera);
+    }
+
+    void OnClose( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_Close, &camera);
+    }
+
+    void OnClosed( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_Closed, &camera);
+    }
+
+    void OnDestroy( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_Destroy, &camera);
+    }
+
+    void OnDestroyed( Pylon::CInstantCamera& camera)
+    {
+        m_log.ForgetCamera( &camera);
+        Log( AsyncEventType_Destroyed, NULL);
+    }
+
+    void OnDetach( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_Detach, &camera);
+    }
+
+    void OnDetached( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_Detached, &camera);
+    }
+
+    void OnGrabError( Pylon::CInstantCamera& camera, const char* errorMessage)
+    {
+        Log( AsyncEventType_GrabError, &camera, errorMessage);
+    }
+
+    void OnCameraDeviceRemoved( Pylon::CInstantCamera& camera)
+    {
+        Log( AsyncEventType_CameraDeviceRemoved, &camera);
+    }
+
+private:
+    void Log( EAsyncEventType type, Pylon::CInstantCamera* pCamera, const char* pText = NULL)
+    {
+        const EAsyncEventVerbosity verbosity = (type == AsyncEventType_GrabError || type == AsyncEventType_CameraDeviceRemoved)
+            ? AsyncEventVerbosity_Errors : AsyncEventVerbosity_Events;
+        if ( !m_log.IsEnabled( verbosity))
+        {
+            return;
+        }
+        SAsyncEventRecord record = SAsyncEventRecord();
+        record.type = type;
+        if ( pCamera != NULL)
+        {
+            m_log.SetCamera( record, pCamera, *pCamera);
+        }
+        CAsyncEventLog::CopyText( record.text, sizeof( record.text), pText);
+        m_log.Log( record, verbosity);
+    }
+
+    CAsyncEventLog& m_log;
+};
+
+#endif /* INCLUDED_ASYNCEVENTPRINTER_H_2280419 */
@@ -0,0 +1,179 @@
+// Contains the band parallel versions of the fused front end and the RLE blob analysis.
+// A frame is split into horizontal bands that are processed as tasks of a CWorkStealingPool:
+//
+// 1. Blur all bands and count their histograms. A band reads c_blurRadius source rows above and below (halo).
+// 2. Add up the histograms and compute the triangle threshold of the frame.
+// 3. Binarize and close all bands. A band reads c_closeHalo blurred rows above and below.
+// 4. Run the blob analysis on all bands without halo and join the blobs touching the seams.
+//
+// The results are the same as the results of CFusedContourFrontEnd and CRleBlobAnalyzer.
+// The front end and the blob analysis use separate objects and can be called by different threads.
+
+#ifndef INCLUDED_BANDPARALLELMEASUREMENT_H_2290461
+#define INCLUDED_BANDPARALLELMEASUREMENT_H_2290461
+
+#include <opencv2/core/core.hpp>
+
+#include "FusedContourFrontEnd.h"
+#include "RleBlobAnalyzer.h"
+#include "WorkStealingPool.h"
+
+#include <memory>
+#include <vector>
+
+// Rows of a band. endRow is the first row after the band.
+struct SImageBand
+{
+    int firstRow;
+    int endRow;
+};
+
+// Splits an image into bandCount bands of nearly equal height. Bands are at least minRows rows high.
+inline void SplitIntoBands( int height, size_t bandCount, int minRows, std::vector<SImageBand>& bands)
+{
+    size_t count = bandCount < 1 ? 1 : bandCount;
+    if ( minRows > 0 && count > static_cast<size_t>(height / minRows))
+    {
+        count = height / minRows < 1 ? 1 : static_cast<size_t>(height / minRows);
+    }
+
+    bands.resize( count);
+    for ( size_t i = 0; i < count; ++i)
+    {
+        bands[i].firstRow = static_cast<int>(height * i / count);
+        bands[i].endRow = static_cast<int>(height * (i + 1) / count);
+    }
+}
+
+
+// Band parallel version of CFusedContourFrontEnd::Process().
+class CBandParallelFrontEnd
+{
+public:
+    // If bandCount is 0, four bands per thread of the pool are used so that the pool can balance the load.
+    CBandParallelFrontEnd( CWorkStealingPool& pool, size_t bandCount = 0)
+        : m_pool( pool)
+        , m_bandCount( bandCount == 0 ? 4 * pool.GetThreadCount() : bandCount)
+    {
+    }
+
+    // Returns the threshold that has been used for binarization.
+    int Process( const cv::Mat& source, cv::Mat& blurred, cv::Mat& closed)
+    {
+        CV_Assert( source.type() == CV_8UC1);
+        blurred.create( source.size(), CV_8UC1);
+        closed.create( source.size(), CV_8UC1);
+
+        // Smaller bands would mostly process the halo.
+        SplitIntoBands( source.rows, m_bandCount, c_minBandRows, m_bands);
+        while ( m_frontEnds.size() < m_bands.size())
+        {
+            m_frontEnds.push_back( std::unique_ptr<SFrontEndBand>( new SFrontEndBand));
+        }
+
+        m_pool.ParallelFor( m_bands.size(), [&]( size_t i)
+        {
+            m_frontEnds[i]->frontEnd.BlurBand( source, blurred, m_bands[i].firstRow, m_bands[i].endRow, m_frontEnds[i]->histogram);
+        });
+
+        unsigned int histogram[256] = { 0 };
+        for ( size_t i = 0; i < m_bands.size(); ++i)
+        {
+            for ( int v = 0; v < 256; ++v)
+            {
+                histogram[v] += m_frontEnds[i]->histogram[v];
+            }
+        }
+        const int threshold = CFusedContourFrontEnd::ComputeTriangleThreshold( histogram);
+
+        m_pool.ParallelFor( m_bands.size(), [&]( size_t i)
+        {
+            m_frontEnds[i]->frontEnd.CloseBand( blurred, threshold, closed, m_bands[i].firstRow, m_bands[i].endRow);
+        });
+        return threshold;
+    }
+
+private:
+    static const int c_minBandRows = 8 * CFusedContourFrontEnd::c_closeHalo;
+
+    struct SFrontEndBand
+    {
+        CFusedContourFrontEnd frontEnd;
+        unsigned int histogram[256];
+    };
+
+    // Not copyable.
+    CBandParallelFrontEnd( const CBandParallelFrontEnd&);
+    CBandParallelFrontEnd& operator=( const CBandParallelFrontEnd&);
+
+    CWorkStealingPool& m_pool;
+    const size_t m_bandCount;
+    std::vector<SImageBand> m_bands;
+    std::vector<std::unique_ptr<SFrontEndBand> > m_frontEnds;
+};
+
+
+// Band parallel version of CRleBlobAnalyzer::Analyze().
+class CBandParallelBlobAnalyzer
+{
+public:
+    // If bandCount is 0, four bands per thread of the pool are used so that the pool can balance the load.
+    CBandParallelBlobAnalyzer( CWorkStealingPool& pool, size_t bandCount = 0)
+        : m_pool( pool)
+        , m_bandCount( bandCount == 0 ? 4 * pool.GetThreadCount() : bandCount)
+    {
+    }
+
+    // Analyzes an 8 bit single channel image. Pixels that aren't 0 are foreground.
+    // blobs is cleared and receives the blobs passing the filter. The order of the blobs isn't defined.
+    void Analyze( const cv::Mat& binary, const SRleBlobFilter& filter, std::vector<SRleBlob>& blobs)
+    {
+        CV_Assert( binary.type() == CV_8UC1);
+
+        SplitIntoBands( binary.rows, m_bandCount, c_minBandRows, m_bands);
+        while ( m_analyzers.size() < m_bands.size())
+        {
+            m_analyzers.push_back( std::unique_ptr<SAnalyzerBand>( new SAnalyzerBand));
+        }
+
+        const size_t count = m_bands.size();
+        m_pool.ParallelFor( count, [&]( size_t i)
+        {
+            m_analyzers[i]->analyzer.AnalyzeBand( binary.ptr<uint8_t>(), binary.cols, m_bands[i].firstRow, m_bands[i].endRow, binary.step,
+                i > 0, i + 1 < count, filter, m_analyzers[i]->blobs);
+        });
+
+        // Collect the blobs lying inside a band, then join the blobs crossing the seams.
+        blobs.clear();
+        m_bandAnalyzers.resize( count);
+        for ( size_t i = 0; i < count; ++i)
+        {
+            blobs.insert( blobs.end(), m_analyzers[i]->blobs.begin(), m_analyzers[i]->blobs.end());
+            m_bandAnalyzers[i] = &m_analyzers[i]->analyzer;
+        }
+        m_merger.MergeBands( &m_bandAnalyzers[0], count, filter, blobs);
+    }
+
+private:
+    // The seams are processed serially. Don't create more seams than needed.
+    static const int c_minBandRows = 64;
+
+    struct SAnalyzerBand
+    {
+        CRleBlobAnalyzer analyzer;
+        std::vector<SRleBlob> blobs;
+    };
+
+    // Not copyable.
+    CBandParallelBlobAnalyzer( const CBandParallelBlobAnalyzer&);
+    CBandParallelBlobAnalyzer& operator=( const CBandParallelBlobAnalyzer&);
+
+    CWorkStealingPool& m_pool;
+    const size_t m_bandCount;
+    std::vector<SImageBand> m_bands;
+    std::vector<std::unique_ptr<SAnalyzerBand> > m_analyzers;
+    std::vector<CRleBlobAnalyzer*> m_bandAnalyzers;
+    CRleBlobAnalyzer m_merger;
+};
+
+#endif /* INCLUDED_BANDPARALLELMEASUREMENT_H_2290461 */
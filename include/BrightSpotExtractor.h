@@ -0,0 +1,132 @@
+// Contains an extractor grouping bright pixels into spots, e.g. for tracking laser spots.
+// The rows are scanned once using CBrightSpotScanner. The bright pixels of a row are encoded as runs and labeled
+// by CRleBlobAnalyzer, so each spot is reported with its area, bounding box and intensity weighted centroid
+// without storing the pixels. No memory is allocated once the buffers have grown to the number of spots.
+
+#ifndef INCLUDED_BRIGHTSPOTEXTRACTOR_H_9067342
+#define INCLUDED_BRIGHTSPOTEXTRACTOR_H_9067342
+
+#include "BrightSpotScanner.h"
+#include "RleBlobAnalyzer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A group of 8-connected bright pixels.
+struct SBrightSpot
+{
+    double centroidX;       // Intensity weighted centroid with sub-pixel precision.
+    double centroidY;
+    uint64_t area;          // Number of pixels.
+    double intensity;       // Sum of the weights of the pixels, see CBrightSpotExtractor.
+    int left;               // Bounding box.
+    int top;
+    int width;
+    int height;
+};
+
+
+class CBrightSpotExtractor
+{
+public:
+    // A pixel is bright if all its color components are greater than threshold. Spots with fewer than minArea pixels are ignored.
+    explicit CBrightSpotExtractor( uint8_t threshold = 200, uint64_t minArea = 1)
+        : m_scanner( threshold)
+    {
+        m_filter.minArea = minArea;
+    }
+
+    // Finds the spots of an image in one pass. The pixel layouts are those of CBrightSpotScanner.
+    // Each pixel is weighted by the amount by which its color components exceed the threshold, so the centroid
+    // isn't biased by the pixels at the edge of the spot. spots is cleared first.
+    void Extract( const uint8_t* pImage, int width, int height, ptrdiff_t stride, int bytesPerPixel, std::vector<SBrightSpot>& spots)
+    {
+        spots.clear();
+        if ( !CBrightSpotScanner::IsSupportedBytesPerPixel( bytesPerPixel))
+        {
+            return;
+        }
+
+        m_analyzer.BeginFrame( width, m_filter, m_blobs);
+        for ( int y = 0; y < height; ++y)
+        {
+            SRowVisitor visitor( pImage + y * stride, bytesPerPixel, m_scanner.GetThreshold(), m_runs, m_intensities);
+            m_scanner.ScanRow( pImage + y * stride, width, y, bytesPerPixel, visitor);
+            m_analyzer.AddRow( m_runs.empty() ? NULL : &m_runs[0], m_intensities.empty() ? NULL : &m_intensities[0], m_runs.size());
+        }
+        m_analyzer.EndFrame();
+
+        for ( size_t i = 0; i < m_blobs.size(); ++i)
+        {
+            const SRleBlob& blob = m_blobs[i];
+            SBrightSpot spot;
+            spot.centroidX = blob.weightedCentroidX;
+            spot.centroidY = blob.weightedCentroidY;
+            spot.area = blob.area;
+            spot.intensity = blob.intensity;
+            spot.left = blob.left;
+            spot.top = blob.top;
+            spot.width = blob.Width();
+            spot.height = blob.Height();
+            spots.push_back( spot);
+        }
+    }
+
+private:
+    // Collects the bright pixels of a row as runs. The scanner reports them in ascending order.
+    struct SRowVisitor
+    {
+        SRowVisitor( const uint8_t* pRow, int bytesPerPixel, uint8_t threshold, std::vector<SRleRun>& runs, std::vector<SRleRunIntensity>& intensities)
+            : m_pRow( pRow)
+            , m_bytesPerPixel( bytesPerPixel)
+            , m_components( bytesPerPixel == 4 ? 3 : bytesPerPixel)
+            , m_threshold( threshold)
+            , m_runs( runs)
+            , m_intensities( intensities)
+        {
+            m_runs.clear();
+            m_intensities.clear();
+        }
+
+        bool operator()( int x, int)
+        {
+            const uint8_t* pPixel = m_pRow + x * m_bytesPerPixel;
+            int weight = 0;
+            for ( int i = 0; i < m_components; ++i)
+            {
+                weight += pPixel[i] - m_threshold;
+            }
+
+            if ( m_runs.empty() || m_runs.back().end != x)
+            {
+                m_runs.push_back( SRleRun( x, x));
+                m_intensities.push_back( SRleRunIntensity());
+            }
+            ++m_runs.back().end;
+            m_intensities.back().sum += weight;
+            m_intensities.back().sumX += static_cast<double>(weight) * x;
+            return true;
+        }
+
+        const uint8_t* m_pRow;
+        int m_bytesPerPixel;
+        int m_components;
+        int m_threshold;
+        std::vector<SRleRun>& m_runs;
+        std::vector<SRleRunIntensity>& m_intensities;
+    };
+
+    // Not copyable.
+    CBrightSpotExtractor( const CBrightSpotExtractor&);
+    CBrightSpotExtractor& operator=( const CBrightSpotExtractor&);
+
+    CBrightSpotScanner m_scanner;
+    CRleBlobAnalyzer m_analyzer;
+    SRleBlobFilter m_filter;
+    std::vector<SRleRun> m_runs;
+    std::vector<SRleRunIntensity> m_intensities;
+    std::vector<SRleBlob> m_blobs;
+};
+
+#endif /* INCLUDED_BRIGHTSPOTEXTRACTOR_H_9067342 */
@@ -0,0 +1,272 @@
+// Contains a scanner searching an image buffer for bright pixels, i.e. pixels whose color components all exceed a threshold.
+// The buffer is read directly, e.g. a buffer locked using Gdiplus::Bitmap::LockBits() or the buffer of a CPylonImage.
+// Blocks of 32 pixels are compared using AVX2 or SSE2 if available. Blocks without bright pixels are skipped
+// after a few vector compares, so searching a dark 20 MP image takes milliseconds.
+
+#ifndef INCLUDED_BRIGHTSPOTSCANNER_H_5286013
+#define INCLUDED_BRIGHTSPOTSCANNER_H_5286013
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define BRIGHTSPOTSCANNER_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define BRIGHTSPOTSCANNER_USE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+// Position of a bright pixel.
+struct SBrightPixel
+{
+    SBrightPixel()
+        : x( 0)
+        , y( 0)
+    {
+    }
+
+    SBrightPixel( int x_, int y_)
+        : x( x_)
+        , y( y_)
+    {
+    }
+
+    int x;
+    int y;
+};
+
+
+// Supported pixel layouts are 1 byte (Mono8), 3 bytes (BGR8 or RGB8, e.g. GDI+ PixelFormat24bppRGB) and 4 bytes per pixel
+// (BGRA8, e.g. PixelFormat32bppARGB). The 4th byte of 4 byte pixels is alpha or padding and is ignored.
+// The order of the color components doesn't matter because the same threshold is used for all of them.
+class CBrightSpotScanner
+{
+public:
+    // A pixel is bright if all its color components are greater than threshold.
+    explicit CBrightSpotScanner( uint8_t threshold = 200)
+        : m_threshold( threshold)
+    {
+    }
+
+    static bool IsSupportedBytesPerPixel( int bytesPerPixel)
+    {
+        return bytesPerPixel == 1 || bytesPerPixel == 3 || bytesPerPixel == 4;
+    }
+
+    // Finds the first bright pixel in row-major order and stops searching. Returns false if there is none.
+    // stride is the distance between two rows in bytes. It is negative for bottom-up images.
+    bool FindFirst( const uint8_t* pImage, int width, int height, ptrdiff_t stride, int bytesPerPixel, SBrightPixel& pixel) const
+    {
+        SFirstPixelVisitor visitor( pixel);
+        return !Scan( pImage, width, height, stride, bytesPerPixel, visitor);
+    }
+
+    // Stores all bright pixels in row-major order. pixels is cleared first. Returns the number of bright pixels.
+    size_t FindAll( const uint8_t* pImage, int width, int height, ptrdiff_t stride, int bytesPerPixel, std::vector<SBrightPixel>& pixels) const
+    {
+        pixels.clear();
+        SAllPixelsVisitor visitor( pixels);
+        Scan( pImage, width, height, stride, bytesPerPixel, visitor);
+        return pixels.size();
+    }
+
+    // Calls visitor( x, y) for every bright pixel in row-major order until it returns false.
+    // Returns false if the visitor has stopped the scan.
+    template <typename TVisitor>
+    bool Scan( const uint8_t* pImage, int width, int height, ptrdiff_t stride, int bytesPerPixel, TVisitor& visitor) const
+    {
+        if ( !IsSupportedBytesPerPixel( bytesPerPixel))
+        {
+            return true;
+        }
+        for ( int y = 0; y < height; ++y)
+        {
+            if ( !ScanRow( pImage + y * stride, width, y, bytesPerPixel, visitor))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Scans a single row. Used by Scan() and by callers processing the rows themselves, e.g. while they are being received.
+    template <typename TVisitor>
+    bool ScanRow( const uint8_t* pRow, int width, int y, int bytesPerPixel, TVisitor& visitor) const
+    {
+        int x = 0;
+        for ( ; x + c_blockPixels <= width; x += c_blockPixels)
+        {
+            // Bit i is set if the pixel starting at byte i of the block is bright.
+            uint64_t low = 0;
+            uint64_t high = 0;
+            GetBrightPixels( pRow + x * bytesPerPixel, bytesPerPixel, low, high);
+
+            for ( ; low != 0; low &= low - 1)
+            {
+                if ( !visitor( x + static_cast<int>(CountTrailingZeros( low)) / bytesPerPixel, y))
+                {
+                    return false;
+                }
+            }
+            for ( ; high != 0; high &= high - 1)
+            {
+                if ( !visitor( x + (64 + static_cast<int>(CountTrailingZeros( high))) / bytesPerPixel, y))
+                {
+                    return false;
+                }
+            }
+        }
+
+        // Remaining pixels at the end of the row.
+        for ( ; x < width; ++x)
+        {
+            if ( IsBright( pRow + x * bytesPerPixel, bytesPerPixel) && !visitor( x, y))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint8_t GetThreshold() const
+    {
+        return m_threshold;
+    }
+
+private:
+    // Number of pixels compared at once.
+    static const int c_blockPixels = 32;
+
+    struct SFirstPixelVisitor
+    {
+        explicit SFirstPixelVisitor( SBrightPixel& pixel)
+            : m_pixel( pixel)
+        {
+        }
+
+        bool operator()( int x, int y)
+        {
+            m_pixel = SBrightPixel( x, y);
+            return false;
+        }
+
+        SBrightPixel& m_pixel;
+    };
+
+    struct SAllPixelsVisitor
+    {
+        explicit SAllPixelsVisitor( std::vector<SBrightPixel>& pixels)
+            : m_pixels( pixels)
+        {
+        }
+
+        bool operator()( int x, int y)
+        {
+            m_pixels.push_back( SBrightPixel( x, y));
+            return true;
+        }
+
+        std::vector<SBrightPixel>& m_pixels;
+    };
+
+    bool IsBright( const uint8_t* pPixel, int bytesPerPixel) const
+    {
+        const int components = (bytesPerPixel == 4) ? 3 : bytesPerPixel;
+        for ( int i = 0; i < components; ++i)
+        {
+            if ( pPixel[i] <= m_threshold)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Finds the bright pixels of a block of 32 pixels. Bytes 0 ... 63 of the block are mapped to the bits of low,
+    // bytes 64 ... 127 to the bits of high. Only the bit of the first byte of a bright pixel is set.
+    void GetBrightPixels( const uint8_t* pBlock, int bytesPerPixel, uint64_t& low, uint64_t& high) const
+    {
+        if ( bytesPerPixel == 1)
+        {
+            low = GetBrightBytes( pBlock);
+            high = 0;
+            return;
+        }
+
+        // A pixel is bright if the bits of all its color bytes are set. Combine the bits of the pixel in its first bit.
+        if ( bytesPerPixel == 3)
+        {
+            const uint64_t bytes0 = GetBrightBytes( pBlock) | (static_cast<uint64_t>(GetBrightBytes( pBlock + 32)) << 32);
+            const uint64_t bytes1 = GetBrightBytes( pBlock + 64);
+            if ( (bytes0 | bytes1) == 0)
+            {
+                low = high = 0;
+                return;
+            }
+            // Pixels start at the bytes 0, 3, ..., 63 and 66, 69, ..., 93. Pixel 21 spans both words.
+            low = bytes0 & ((bytes0 >> 1) | (bytes1 << 63)) & ((bytes0 >> 2) | (bytes1 << 62)) & 0x9249249249249249ULL;
+            high = bytes1 & (bytes1 >> 1) & (bytes1 >> 2) & 0x24924924ULL;
+            return;
+        }
+
+        const uint64_t bytes0 = GetBrightBytes( pBlock) | (static_cast<uint64_t>(GetBrightBytes( pBlock + 32)) << 32);
+        const uint64_t bytes1 = GetBrightBytes( pBlock + 64) | (static_cast<uint64_t>(GetBrightBytes( pBlock + 96)) << 32);
+        low = bytes0 & (bytes0 >> 1) & (bytes0 >> 2) & 0x1111111111111111ULL;
+        high = bytes1 & (bytes1 >> 1) & (bytes1 >> 2) & 0x1111111111111111ULL;
+    }
+
+    // Returns a mask with bit i set if byte i of the 32 bytes is greater than the threshold.
+    uint32_t GetBrightBytes( const uint8_t* pBytes) const
+    {
+#if defined(BRIGHTSPOTSCANNER_USE_AVX2)
+        // There is no unsigned byte compare. A saturated subtraction yields 0 for all bytes not greater than the threshold.
+        const __m256i bytes = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pBytes));
+        const __m256i excess = _mm256_subs_epu8( bytes, _mm256_set1_epi8( static_cast<char>(m_threshold)));
+        return ~static_cast<uint32_t>(_mm256_movemask_epi8( _mm256_cmpeq_epi8( excess, _mm256_setzero_si256())));
+#elif defined(BRIGHTSPOTSCANNER_USE_SSE2)
+        const __m128i threshold = _mm_set1_epi8( static_cast<char>(m_threshold));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i excess0 = _mm_subs_epu8( _mm_loadu_si128( reinterpret_cast<const __m128i*>(pBytes)), threshold);
+        const __m128i excess1 = _mm_subs_epu8( _mm_loadu_si128( reinterpret_cast<const __m128i*>(pBytes + 16)), threshold);
+        const uint32_t dark = static_cast<uint32_t>(_mm_movemask_epi8( _mm_cmpeq_epi8( excess0, zero)))
+            | (static_cast<uint32_t>(_mm_movemask_epi8( _mm_cmpeq_epi8( excess1, zero))) << 16);
+        return ~dark;
+#else
+        uint32_t mask = 0;
+        for ( int i = 0; i < 32; ++i)
+        {
+            mask |= static_cast<uint32_t>(pBytes[i] > m_threshold) << i;
+        }
+        return mask;
+#endif
+    }
+
+    static unsigned int CountTrailingZeros( uint64_t value)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64( &index, value);
+        return index;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if ( _BitScanForward( &index, static_cast<unsigned long>(value)))
+        {
+            return index;
+        }
+        _BitScanForward( &index, static_cast<unsigned long>(value >> 32));
+        return index + 32;
+#else
+        return static_cast<unsigned int>(__builtin_ctzll( value));
+#endif
+    }
+
+    uint8_t m_threshold;
+};
+
+#endif /* INCLUDED_BRIGHTSPOTSCANNER_H_5286013 */
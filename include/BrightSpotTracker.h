@@ -0,0 +1,225 @@
+// Contains a tracker following a bright spot, e.g. a laser spot, from frame to frame.
+// The position of the spot in the next frame is predicted from its last two positions. Only a window around the
+// predicted position is searched using CBrightSpotExtractor, so the time per frame depends on the size of the spot
+// instead of the size of the image. The whole image is searched only if the spot is lost.
+// Positions are sensor coordinates. Pass the offsets of the image, e.g. the camera AOI of the grab result, so the
+// camera AOI can follow the spot using GetPredictedPosition().
+
+#ifndef INCLUDED_BRIGHTSPOTTRACKER_H_3318605
+#define INCLUDED_BRIGHTSPOTTRACKER_H_3318605
+
+#include "BrightSpotExtractor.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A rectangle in sensor coordinates.
+struct SSpotWindow
+{
+    SSpotWindow()
+        : left( 0)
+        , top( 0)
+        , width( 0)
+        , height( 0)
+    {
+    }
+
+    SSpotWindow( int left_, int top_, int width_, int height_)
+        : left( left_)
+        , top( top_)
+        , width( width_)
+        , height( height_)
+    {
+    }
+
+    bool IsEmpty() const
+    {
+        return width <= 0 || height <= 0;
+    }
+
+    // Returns the part of the window inside other.
+    SSpotWindow Intersect( const SSpotWindow& other) const
+    {
+        const int l = left > other.left ? left : other.left;
+        const int t = top > other.top ? top : other.top;
+        const int r = (left + width < other.left + other.width) ? left + width : other.left + other.width;
+        const int b = (top + height < other.top + other.height) ? top + height : other.top + other.height;
+        return SSpotWindow( l, t, r > l ? r - l : 0, b > t ? b - t : 0);
+    }
+
+    int left;
+    int top;
+    int width;
+    int height;
+};
+
+
+class CBrightSpotTracker
+{
+public:
+    // The search window extends margin pixels beyond the predicted bounding box of the spot in each direction.
+    // The margin must cover the change of velocity between two frames.
+    explicit CBrightSpotTracker( uint8_t threshold = 200, uint64_t minArea = 1, int margin = 32)
+        : m_extractor( threshold, minArea)
+        , m_margin( margin)
+        , m_tracking( false)
+        , m_velocityX( 0)
+        , m_velocityY( 0)
+        , m_spot()
+        , m_trackedFrames( 0)
+        , m_fullScans( 0)
+    {
+    }
+
+    // Searches the spot in an image covering the sensor area starting at offsetX, offsetY.
+    // Returns false if there is no spot in the image. Otherwise spot is set in sensor coordinates.
+    // If several spots are found, the one closest to the predicted position is tracked, or the brightest one after a full scan.
+    bool Track( const uint8_t* pImage, int width, int height, ptrdiff_t stride, int bytesPerPixel, int offsetX, int offsetY, SBrightSpot& spot)
+    {
+        const SSpotWindow imageWindow( offsetX, offsetY, width, height);
+        bool found = false;
+        if ( m_tracking)
+        {
+            const SSpotWindow window = GetSearchWindow().Intersect( imageWindow);
+            if ( !window.IsEmpty())
+            {
+                const uint8_t* pWindow = pImage + (window.top - offsetY) * stride + (window.left - offsetX) * bytesPerPixel;
+                m_extractor.Extract( pWindow, window.width, window.height, stride, bytesPerPixel, m_spots);
+                found = SelectClosest( window.left, window.top, spot);
+            }
+            if ( found)
+            {
+                ++m_trackedFrames;
+            }
+        }
+
+        if ( !found)
+        {
+            m_extractor.Extract( pImage, width, height, stride, bytesPerPixel, m_spots);
+            found = SelectBrightest( offsetX, offsetY, spot);
+            ++m_fullScans;
+        }
+
+        if ( !found)
+        {
+            Reset();
+            return false;
+        }
+
+        // Constant velocity model. The velocity is only known from the second frame on.
+        m_velocityX = m_tracking ? spot.centroidX - m_spot.centroidX : 0;
+        m_velocityY = m_tracking ? spot.centroidY - m_spot.centroidY : 0;
+        m_spot = spot;
+        m_tracking = true;
+        return true;
+    }
+
+    // Forgets the spot. The next frame is searched completely.
+    void Reset()
+    {
+        m_tracking = false;
+        m_velocityX = 0;
+        m_velocityY = 0;
+    }
+
+    bool IsTracking() const
+    {
+        return m_tracking;
+    }
+
+    // The predicted centroid of the spot in the next frame. Only valid while tracking.
+    void GetPredictedPosition( double& x, double& y) const
+    {
+        x = m_spot.centroidX + m_velocityX;
+        y = m_spot.centroidY + m_velocityY;
+    }
+
+    // The window searched in the next frame: the bounding box of the spot moved to the predicted position, plus the margin.
+    // Only valid while tracking. It may extend beyond the image.
+    SSpotWindow GetSearchWindow() const
+    {
+        double x = 0;
+        double y = 0;
+        GetPredictedPosition( x, y);
+        const int left = static_cast<int>(std::floor( m_spot.left + (x - m_spot.centroidX))) - m_margin;
+        const int top = static_cast<int>(std::floor( m_spot.top + (y - m_spot.centroidY))) - m_margin;
+        return SSpotWindow( left, top, m_spot.width + 2 * m_margin + 1, m_spot.height + 2 * m_margin + 1);
+    }
+
+    // Number of frames in which the spot was found in the search window.
+    uint64_t GetTrackedFrameCount() const
+    {
+        return m_trackedFrames;
+    }
+
+    // Number of frames searched completely, i.e. the first frame and the frames after the spot was lost.
+    uint64_t GetFullScanCount() const
+    {
+        return m_fullScans;
+    }
+
+private:
+    // Selects the spot closest to the predicted position and moves it to sensor coordinates.
+    bool SelectClosest( int offsetX, int offsetY, SBrightSpot& spot) const
+    {
+        double x = 0;
+        double y = 0;
+        GetPredictedPosition( x, y);
+        const SBrightSpot* pBest = NULL;
+        double bestDistance = 0;
+        for ( size_t i = 0; i < m_spots.size(); ++i)
+        {
+            const double dx = m_spots[i].centroidX + offsetX - x;
+            const double dy = m_spots[i].centroidY + offsetY - y;
+            const double distance = dx * dx + dy * dy;
+            if ( pBest == NULL || distance < bestDistance)
+            {
+                pBest = &m_spots[i];
+                bestDistance = distance;
+            }
+        }
+        return pBest != NULL && ToSensor( *pBest, offsetX, offsetY, spot);
+    }
+
+    // Selects the spot with the highest intensity and moves it to sensor coordinates.
+    bool SelectBrightest( int offsetX, int offsetY, SBrightSpot& spot) const
+    {
+        const SBrightSpot* pBest = NULL;
+        for ( size_t i = 0; i < m_spots.size(); ++i)
+        {
+            if ( pBest == NULL || m_spots[i].intensity > pBest->intensity)
+            {
+                pBest = &m_spots[i];
+            }
+        }
+        return pBest != NULL && ToSensor( *pBest, offsetX, offsetY, spot);
+    }
+
+    static bool ToSensor( const SBrightSpot& source, int offsetX, int offsetY, SBrightSpot& spot)
+    {
+        spot = source;
+        spot.centroidX += offsetX;
+        spot.centroidY += offsetY;
+        spot.left += offsetX;
+        spot.top += offsetY;
+        return true;
+    }
+
+    // Not copyable.
+    CBrightSpotTracker( const CBrightSpotTracker&);
+    CBrightSpotTracker& operator=( const CBrightSpotTracker&);
+
+    CBrightSpotExtractor m_extractor;
+    std::vector<SBrightSpot> m_spots;
+    int m_margin;
+    bool m_tracking;
+    double m_velocityX;
+    double m_velocityY;
+    SBrightSpot m_spot;
+    uint64_t m_trackedFrames;
+    uint64_t m_fullScans;
+};
+
+#endif /* INCLUDED_BRIGHTSPOTTRACKER_H_3318605 */
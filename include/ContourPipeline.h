@@ -0,0 +1,990 @@
+// Contains a multi-threaded pipeline that grabs, converts, filters and measures the contours of images.
+// The stages are connected by bounded lock-free queues. Frames are taken from a fixed pool and
+// handed from stage to stage. If a stage can't forward a frame because the next stage is busy,
+// it waits (backpressure). When the pool is exhausted, the acquisition stage drops the grab result.
+// Recorded or synthetic images can be pushed instead of grab results for measuring the pipeline without a camera.
+
+#ifndef INCLUDED_CONTOURPIPELINE_H_8830412
+#define INCLUDED_CONTOURPIPELINE_H_8830412
+
+#include <opencv2/opencv.hpp>
+#include <pylon/PylonIncludes.h>
+
+#include "BandParallelMeasurement.h"
+#include "FrameWorkspace.h"
+#include "FusedContourFrontEnd.h"
+#include "ImageWriterPool.h"
+#include "LatencyHistogram.h"
+#include "LiveView.h"
+#include "MeasurementSink.h"
+#include "RleBlobAnalyzer.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The stages of the pipeline in processing order.
+enum EPipelineStage
+{
+    PipelineStage_Acquisition,
+    PipelineStage_Conversion,
+    PipelineStage_Filtering,
+    PipelineStage_ContourAnalysis,
+    PipelineStage_Persistence,
+    PipelineStage_Display,
+    PipelineStage_Count
+};
+
+// Names of the stages for printed output.
+static const char* const c_pipelineStageNames[PipelineStage_Count] =
+{
+    "Acquisition    ",
+    "Conversion     ",
+    "Filtering      ",
+    "ContourAnalysis",
+    "Persistence    ",
+    "Display        "
+};
+
+
+// Settings of the pipeline. Must be set before calling Start().
+struct SContourPipelineConfiguration
+{
+    SContourPipelineConfiguration()
+        : framePoolSize( 8)
+        , queueCapacity( 4)
+        , imageWidth( 0)
+        , imageHeight( 0)
+        , persistenceBacklogLimit( 2)
+        , saveImageFiles( false)
+        , appendToVideo( false)
+        , pVideoWriter( NULL)
+        , pMeasurementSink( NULL)
+        , showImages( true)
+        , displayFrameRate( 25.0)
+        , useNativePixelData( false)
+        , useFusedFrontEnd( false)
+        , useRleBlobAnalysis( false)
+        , useBandParallelism( false)
+        , bandThreadCount( 0)
+    {
+    }
+
+    size_t framePoolSize;           // Number of frames that can be in flight at the same time.
+    size_t queueCapacity;           // Capacity of each queue connecting two stages.
+    int imageWidth;                 // Image size used for allocating the workspaces of all frames in advance.
+    int imageHeight;                // If 0, the buffers are allocated when the first frames are processed.
+    size_t persistenceBacklogLimit; // Images are not saved while more frames than this wait for the persistence stage.
+    bool saveImageFiles;            // Save every image using an image writer pool.
+    SImageWriterConfiguration imageWriter; // Format, file names and threads used for saving images.
+    bool appendToVideo;             // Append every image to pVideoWriter.
+    cv::VideoWriter* pVideoWriter;  // Used by the persistence stage only.
+    IMeasurementSink* pMeasurementSink; // Receives the measurements from the persistence stage. If NULL, they are printed.
+    bool showImages;                // Show the images in OpenCV windows. Set to false for running headless.
+    double displayFrameRate;        // Maximum number of images shown per second.
+    bool useNativePixelData;        // Process Mono8, Mono10/12/16, Mono12p and Bayer 8 data without converting it to BGR8.
+                                    // The grab result is then held until the frame leaves the pipeline,
+                                    // so MaxNumBuffer must be larger than framePoolSize.
+    bool useFusedFrontEnd;          // Compute blur, triangle threshold and closing using CFusedContourFrontEnd.
+    bool useRleBlobAnalysis;        // Measure the objects using CRleBlobAnalyzer instead of cv::findContours.
+                                    // No contour points are available then.
+    bool useBandParallelism;        // Split each frame into horizontal bands processed by a work-stealing thread pool.
+                                    // Applies to the fused front end and the RLE blob analysis.
+    size_t bandThreadCount;         // Threads of the pool. If 0, one thread per hardware thread is started.
+};
+
+
+// Result of measuring a single contour.
+struct SContourMeasurement
+{
+    size_t contourIndex;    // Index of the contour or, if the RLE blob analysis is used, of the blob.
+    double area;
+    double perimeter;
+    cv::Rect boundingRect;
+    cv::Point2d centroid;
+};
+
+
+// A frame travelling through the pipeline. Frames are owned by the pipeline and reused.
+struct SPipelineFrame
+{
+    SPipelineFrame()
+        : frameIndex( 0)
+        , cameraTimestamp( 0)
+        , hostTimestamp( 0)
+        , pSourceImage( NULL)
+        , bitDepth( 8)
+    {
+    }
+
+    uint64_t frameIndex;                            // Index of the frame in acquisition order.
+    uint64_t cameraTimestamp;                       // Time stamp of the grab result in camera ticks.
+    uint64_t hostTimestamp;                         // Time the grab result has been pushed in ns, steady clock.
+    Pylon::CGrabResultPtr ptrGrabResult;            // Released by the conversion stage unless openCvImage refers to its buffer.
+    const Pylon::IImage* pSourceImage;              // Image pushed using PushImage() instead of a grab result. Owned by the caller.
+    cv::Mat openCvImage;                            // OpenCV view of the grab result buffer or of an image of the workspace.
+    uint32_t bitDepth;                              // Number of valid bits per pixel of openCvImage.
+    CFrameWorkspace workspace;                      // Buffers reused for every frame processed using this object.
+    std::vector<SContourMeasurement> measurements;  // Contours that passed the size filter.
+};
+
+
+// Counters of one stage. Written by the stage's thread and read by any thread.
+struct SPipelineStageStatistics
+{
+    SPipelineStageStatistics()
+        : processedFrames( 0)
+        , droppedFrames( 0)
+        , failedFrames( 0)
+        , backpressureWaits( 0)
+    {
+    }
+
+    std::atomic<uint64_t> processedFrames;   // Frames handled completely by this stage.
+    std::atomic<uint64_t> droppedFrames;     // Frames for which the work of this stage was skipped or which were discarded.
+    std::atomic<uint64_t> failedFrames;      // Frames that couldn't be processed, e.g. grab results of failed grabs. Also counted as dropped.
+    std::atomic<uint64_t> backpressureWaits; // Number of times the stage had to wait for its successor.
+    CLatencyHistogram processingTime;        // Time in ns the stage has spent on each frame, excluding waits.
+};
+
+
+class CContourPipeline
+{
+public:
+    explicit CContourPipeline( const SContourPipelineConfiguration& configuration)
+        : m_configuration( configuration)
+        , m_frames( configuration.framePoolSize)
+        , m_freeFrames( configuration.framePoolSize)
+        , m_pSpareFrame( NULL)
+        , m_nextFrameIndex( 0)
+        , m_imageIndex( 0)
+        , m_lastBacklogReport( 0)
+        , m_abort( false)
+        , m_running( false)
+    {
+        for ( size_t i = 0; i < PipelineStage_Count; ++i)
+        {
+            m_stageFinished[i] = false;
+            m_pStrandedFrames[i] = NULL;
+            m_queues[i] = (i + 1 < PipelineStage_Count) ? new CSpscQueue<SPipelineFrame*>( configuration.queueCapacity) : NULL;
+        }
+
+        // All frames are available initially.
+        for ( size_t i = 0; i < m_frames.size(); ++i)
+        {
+            if ( configuration.imageWidth > 0 && configuration.imageHeight > 0)
+            {
+                m_frames[i].workspace.Allocate( configuration.imageWidth, configuration.imageHeight, !configuration.useNativePixelData);
+                m_frames[i].measurements.reserve( c_reservedMeasurements);
+            }
+            m_freeFrames.TryPush( &m_frames[i]);
+        }
+
+        m_records.reserve( c_reservedMeasurements);
+
+        // The structuring element is the same for all frames.
+        m_closeKernel = cv::getStructuringElement( cv::MORPH_RECT, cv::Size( 5, 5), cv::Point( -1, -1));
+
+        // If the native pixel data is used, the converter is only used for pixel formats that can't be wrapped.
+        // A single channel image is sufficient then.
+        m_formatConverter.OutputPixelFormat = configuration.useNativePixelData ? Pylon::PixelType_Mono8 : Pylon::PixelType_BGR8packed;
+
+        // Images are encoded and written by a separate thread pool so that the persistence stage doesn't wait for the disk.
+        if ( configuration.saveImageFiles)
+        {
+            m_pImageWriter.reset( new CImageWriterPool( configuration.imageWriter));
+        }
+
+        // The images are shown by the display thread of the live view. The display stage only hands them over.
+        if ( configuration.showImages)
+        {
+            m_pLiveView.reset( new CLiveView( configuration.displayFrameRate));
+        }
+
+        // The filtering and the contour analysis stage share the pool. Each stage uses its own band objects.
+        if ( configuration.useBandParallelism)
+        {
+            m_pBandPool.reset( new CWorkStealingPool( configuration.bandThreadCount));
+            m_pBandFrontEnd.reset( new CBandParallelFrontEnd( *m_pBandPool));
+            m_pBandBlobAnalyzer.reset( new CBandParallelBlobAnalyzer( *m_pBandPool));
+        }
+    }
+
+    ~CContourPipeline()
+    {
+        try
+        {
+            Stop();
+        }
+        catch (...)
+        {
+        }
+
+        for ( size_t i = 0; i < PipelineStage_Count; ++i)
+        {
+            delete m_queues[i];
+        }
+    }
+
+    // Starts one thread per stage except for the acquisition stage, which runs in the thread calling Push().
+    void Start()
+    {
+        if ( m_running)
+        {
+            return;
+        }
+
+        m_abort = false;
+        for ( size_t i = 0; i < PipelineStage_Count; ++i)
+        {
+            m_stageFinished[i] = false;
+        }
+
+        for ( int stage = PipelineStage_Conversion; stage < PipelineStage_Count; ++stage)
+        {
+            m_threads.push_back( std::thread( &CContourPipeline::RunStage, this, static_cast<EPipelineStage>(stage)));
+        }
+        m_running = true;
+    }
+
+    // Acquisition stage. Hands a grab result over to the pipeline.
+    // Never blocks. Returns false if the grab result has been dropped because all frames
+    // are in use or the conversion stage is busy.
+    bool Push( const Pylon::CGrabResultPtr& ptrGrabResult)
+    {
+        return PushFrame( ptrGrabResult, NULL, ptrGrabResult->GetTimeStamp());
+    }
+
+    // Acquisition stage. Hands a recorded or synthetic image over to the pipeline, e.g. for replaying images without a camera.
+    // The image takes the same path as a grab result. It isn't copied and must not be changed or destroyed before Stop() has returned.
+    // Never blocks. Returns false if the image has been dropped.
+    bool PushImage( const Pylon::IImage& image, uint64_t cameraTimestamp)
+    {
+        return PushFrame( Pylon::CGrabResultPtr(), &image, cameraTimestamp);
+    }
+
+    // Processes all frames that are in flight, stops the stage threads and rethrows the first error of a stage.
+    void Stop()
+    {
+        if ( !m_running)
+        {
+            return;
+        }
+
+        m_stageFinished[PipelineStage_Acquisition] = true;
+        for ( size_t i = 0; i < m_threads.size(); ++i)
+        {
+            m_threads[i].join();
+        }
+        m_threads.clear();
+        m_running = false;
+
+        // Wait until all queued images and measurements have been written.
+        if ( m_pImageWriter)
+        {
+            m_pImageWriter->Flush();
+        }
+        if ( m_configuration.pMeasurementSink != NULL)
+        {
+            m_configuration.pMeasurementSink->Flush();
+        }
+
+        // Take back the frames still in flight if a stage has been aborted.
+        // The stage threads have been joined, so this thread may return the frames to the pool.
+        if ( m_pSpareFrame != NULL)
+        {
+            ReleaseFrame( m_pSpareFrame);
+            m_pSpareFrame = NULL;
+        }
+        for ( size_t i = 0; i < PipelineStage_Count; ++i)
+        {
+            if ( m_pStrandedFrames[i] != NULL)
+            {
+                ReleaseFrame( m_pStrandedFrames[i]);
+                m_pStrandedFrames[i] = NULL;
+            }
+        }
+        for ( size_t i = 0; i + 1 < PipelineStage_Count; ++i)
+        {
+            SPipelineFrame* pFrame = NULL;
+            while ( m_queues[i]->TryPop( pFrame))
+            {
+                ReleaseFrame( pFrame);
+            }
+        }
+
+        ThrowIfFailed();
+    }
+
+    // Sets all counters and latency histograms to zero, e.g. after warming up. Must not be called while the pipeline is running.
+    void ResetStatistics()
+    {
+        for ( size_t i = 0; i < PipelineStage_Count; ++i)
+        {
+            m_statistics[i].processedFrames = 0;
+            m_statistics[i].droppedFrames = 0;
+            m_statistics[i].failedFrames = 0;
+            m_statistics[i].backpressureWaits = 0;
+            m_statistics[i].processingTime.Reset();
+        }
+        m_frameLatency.Reset();
+    }
+
+    const SPipelineStageStatistics& GetStatistics( EPipelineStage stage) const
+    {
+        return m_statistics[stage];
+    }
+
+    // Time in ns from pushing a frame until it has left the last stage.
+    const CLatencyHistogram& GetFrameLatency() const
+    {
+        return m_frameLatency;
+    }
+
+    void PrintStatistics( std::ostream& os) const
+    {
+        os << "Stage           " << " Processed" << "   Dropped" << "    Failed" << " Backpressure waits" << "  p50 [us]" << "  p99 [us]" << std::endl;
+        for ( size_t i = 0; i < PipelineStage_Count; ++i)
+        {
+            os << c_pipelineStageNames[i]
+               << " " << std::setw( 9) << m_statistics[i].processedFrames.load()
+               << " " << std::setw( 9) << m_statistics[i].droppedFrames.load()
+               << " " << std::setw( 9) << m_statistics[i].failedFrames.load()
+               << " " << std::setw( 18) << m_statistics[i].backpressureWaits.load()
+               << " " << std::setw( 9) << m_statistics[i].processingTime.GetPercentile( 0.5) / 1000
+               << " " << std::setw( 9) << m_statistics[i].processingTime.GetPercentile( 0.99) / 1000
+               << std::endl;
+        }
+        os << "Frame latency: p50 " << m_frameLatency.GetPercentile( 0.5) / 1000
+           << " us, p99 " << m_frameLatency.GetPercentile( 0.99) / 1000
+           << " us, max " << m_frameLatency.GetMaximum() / 1000 << " us" << std::endl;
+
+        if ( m_pImageWriter)
+        {
+            m_pImageWriter->PrintStatistics( os);
+        }
+        if ( m_pLiveView)
+        {
+            os << "Live view: " << m_pLiveView->GetShownFrames() << " shown" << std::endl;
+        }
+    }
+
+private:
+    // Number of measurements per frame reserved in advance.
+    static const size_t c_reservedMeasurements = 64;
+
+    bool PushFrame( const Pylon::CGrabResultPtr& ptrGrabResult, const Pylon::IImage* pSourceImage, uint64_t cameraTimestamp)
+    {
+        ThrowIfFailed();
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const uint64_t frameIndex = m_nextFrameIndex++;
+
+        // A frame that couldn't be forwarded last time is used first.
+        SPipelineFrame* pFrame = m_pSpareFrame;
+        m_pSpareFrame = NULL;
+        if ( pFrame == NULL && !m_freeFrames.TryPop( pFrame))
+        {
+            ++m_statistics[PipelineStage_Acquisition].droppedFrames;
+            return false;
+        }
+
+        pFrame->frameIndex = frameIndex;
+        pFrame->ptrGrabResult = ptrGrabResult;
+        pFrame->pSourceImage = pSourceImage;
+        pFrame->cameraTimestamp = cameraTimestamp;
+        pFrame->hostTimestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>( start.time_since_epoch()).count());
+
+        if ( !m_queues[PipelineStage_Acquisition]->TryPush( pFrame))
+        {
+            // Don't block the grab loop. Keep the frame for the next grab result.
+            pFrame->ptrGrabResult.Release();
+            pFrame->pSourceImage = NULL;
+            m_pSpareFrame = pFrame;
+            ++m_statistics[PipelineStage_Acquisition].backpressureWaits;
+            ++m_statistics[PipelineStage_Acquisition].droppedFrames;
+            return false;
+        }
+
+        ++m_statistics[PipelineStage_Acquisition].processedFrames;
+        RecordProcessingTime( PipelineStage_Acquisition, start);
+        return true;
+    }
+
+    // The loop executed by the thread of a stage.
+    void RunStage( EPipelineStage stage)
+    {
+        CSpscQueue<SPipelineFrame*>& input = *m_queues[stage - 1];
+        CBackoff backoff;
+        SPipelineFrame* pFrame = NULL;
+
+        try
+        {
+            // Stop taking frames once the pipeline has been aborted. The frames left in the queues are released by Stop().
+            while ( !m_abort)
+            {
+                // Read the flag first. If the predecessor has finished, all its frames are in the queue already.
+                const bool predecessorFinished = m_stageFinished[stage - 1];
+
+                if ( input.TryPop( pFrame))
+                {
+                    backoff.Reset();
+                    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    if ( ProcessFrame( stage, *pFrame))
+                    {
+                        ++m_statistics[stage].processedFrames;
+                    }
+                    else
+                    {
+                        ++m_statistics[stage].droppedFrames;
+                    }
+                    RecordProcessingTime( stage, start);
+                    ForwardFrame( stage, pFrame);
+                    pFrame = NULL;
+                }
+                else if ( predecessorFinished)
+                {
+                    break;
+                }
+                else
+                {
+                    backoff.Wait();
+                }
+            }
+        }
+        catch (const GenICam::GenericException& e)
+        {
+            SetError( stage, e.GetDescription());
+        }
+        catch (const std::exception& e)
+        {
+            SetError( stage, e.what());
+        }
+
+        // Keep the frame the stage has failed on. It is returned to the pool by Stop().
+        if ( pFrame != NULL)
+        {
+            m_pStrandedFrames[stage] = pFrame;
+        }
+        m_stageFinished[stage] = true;
+    }
+
+    void RecordProcessingTime( EPipelineStage stage, std::chrono::steady_clock::time_point start)
+    {
+        const std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - start;
+        m_statistics[stage].processingTime.Record( static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>( duration).count()));
+    }
+
+    // Passes a frame on to the next stage. The last stage returns the frame to the pool.
+    void ForwardFrame( EPipelineStage stage, SPipelineFrame* pFrame)
+    {
+        if ( stage + 1 == PipelineStage_Count)
+        {
+            const uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch()).count());
+            m_frameLatency.Record( now - pFrame->hostTimestamp);
+            ReleaseFrame( pFrame);
+            return;
+        }
+
+        CSpscQueue<SPipelineFrame*>& output = *m_queues[stage];
+        if ( output.TryPush( pFrame))
+        {
+            return;
+        }
+
+        ++m_statistics[stage].backpressureWaits;
+        CBackoff backoff;
+        while ( !output.TryPush( pFrame))
+        {
+            if ( m_abort)
+            {
+                // The successor has failed and won't take any more frames. Only the last stage may return
+                // frames to the pool while the pipeline is running, so keep the frame for Stop().
+                m_pStrandedFrames[stage] = pFrame;
+                return;
+            }
+            backoff.Wait();
+        }
+    }
+
+    void ReleaseFrame( SPipelineFrame* pFrame)
+    {
+        // Release the view first. It may refer to the buffer of the grab result.
+        pFrame->openCvImage.release();
+        pFrame->ptrGrabResult.Release();
+        pFrame->pSourceImage = NULL;
+        pFrame->measurements.clear();
+        m_freeFrames.TryPush( pFrame);
+    }
+
+    // Returns false if the work of the stage has been skipped for this frame.
+    bool ProcessFrame( EPipelineStage stage, SPipelineFrame& frame)
+    {
+        switch ( stage)
+        {
+        case PipelineStage_Conversion:
+            return ConvertFrame( frame);
+        case PipelineStage_Filtering:
+            return FilterFrame( frame);
+        case PipelineStage_ContourAnalysis:
+            return AnalyzeContours( frame);
+        case PipelineStage_Persistence:
+            return PersistFrame( frame);
+        case PipelineStage_Display:
+            return DisplayFrame( frame);
+        default:
+            return true;
+        }
+    }
+
+    bool ConvertFrame( SPipelineFrame& frame)
+    {
+        if ( frame.pSourceImage == NULL && !frame.ptrGrabResult->GrabSucceeded())
+        {
+            // Counted instead of printed. Console output would stall the conversion stage.
+            ++m_statistics[PipelineStage_Conversion].failedFrames;
+            frame.ptrGrabResult.Release();
+            frame.openCvImage.release();
+            return false;
+        }
+
+        // A pushed image is processed exactly like the buffer of a grab result.
+        const Pylon::IImage& image = (frame.pSourceImage != NULL) ? *frame.pSourceImage : static_cast<const Pylon::IImage&>(frame.ptrGrabResult);
+
+        // Use the grabbed data directly if possible.
+        if ( m_configuration.useNativePixelData && WrapImage( frame, image))
+        {
+            return true;
+        }
+
+        // Convert the grabbed buffer to a pylon image.
+        m_formatConverter.Convert( frame.workspace.pylonImage, image);
+
+        // Create an OpenCV image from the pylon image. No data is copied.
+        const int type = (frame.workspace.pylonImage.GetPixelType() == Pylon::PixelType_Mono8) ? CV_8UC1 : CV_8UC3;
+        frame.openCvImage = cv::Mat( image.GetHeight(), image.GetWidth(), type, (uint8_t*) frame.workspace.pylonImage.GetBuffer());
+        frame.bitDepth = 8;
+
+        // The grab result isn't needed anymore. Give the buffer back to the camera as early as possible.
+        frame.ptrGrabResult.Release();
+        frame.pSourceImage = NULL;
+        return true;
+    }
+
+    // Creates an OpenCV image referring to the buffer of the grab result or pushed image, without converting the pixel data.
+    // Returns false if the pixel format isn't supported.
+    bool WrapImage( SPipelineFrame& frame, const Pylon::IImage& image)
+    {
+        const int width = static_cast<int>(image.GetWidth());
+        const int height = static_cast<int>(image.GetHeight());
+        // The pipeline only reads the pixel data of openCvImage.
+        void* pBuffer = const_cast<void*>(image.GetBuffer());
+
+        size_t stride = 0;
+        if ( !image.GetStride( stride))
+        {
+            return false;
+        }
+
+        switch ( image.GetPixelType())
+        {
+        case Pylon::PixelType_Mono8:
+        case Pylon::PixelType_BayerGR8:
+        case Pylon::PixelType_BayerRG8:
+        case Pylon::PixelType_BayerGB8:
+        case Pylon::PixelType_BayerBG8:
+            // The Bayer pattern is processed as it is. The 7x7 Gaussian blur removes the mosaic structure.
+            frame.openCvImage = cv::Mat( height, width, CV_8UC1, pBuffer, stride);
+            frame.bitDepth = 8;
+            return true;
+
+        case Pylon::PixelType_Mono10:
+        case Pylon::PixelType_Mono12:
+        case Pylon::PixelType_Mono16:
+            frame.openCvImage = cv::Mat( height, width, CV_16UC1, pBuffer, stride);
+            frame.bitDepth = Pylon::BitDepth( image.GetPixelType());
+            return true;
+
+        case Pylon::PixelType_Mono12p:
+        case Pylon::PixelType_Mono12packed:
+            // Packed data can't be described by a cv::Mat. Unpack the upper 8 bits in a single pass.
+            UnpackMono12ToMono8( image.GetPixelType(), static_cast<const uint8_t*>(pBuffer), width, height, frame.workspace.unpackedImage);
+            frame.openCvImage = frame.workspace.unpackedImage;
+            frame.bitDepth = 8;
+            // The unpacked image doesn't refer to the grab result.
+            frame.ptrGrabResult.Release();
+            frame.pSourceImage = NULL;
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    // Unpacks Mono12p (PFNC) or Mono12packed (GigE Vision) data and keeps the 8 most significant bits.
+    // The pixels of both formats are packed without padding at the end of a line.
+    static void UnpackMono12ToMono8( Pylon::EPixelType pixelType, const uint8_t* pSource, int width, int height, cv::Mat& destination)
+    {
+        destination.create( height, width, CV_8UC1);
+        uint8_t* pDestination = destination.ptr<uint8_t>();
+        const size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
+        const bool isPfnc = (pixelType == Pylon::PixelType_Mono12p);
+
+        size_t i = 0;
+        for ( ; i + 1 < pixelCount; i += 2, pSource += 3)
+        {
+            if ( isPfnc)
+            {
+                // Byte 0: p0[7:0], byte 1: p1[3:0] p0[11:8], byte 2: p1[11:4]
+                pDestination[i] = static_cast<uint8_t>((pSource[0] >> 4) | (pSource[1] << 4));
+            }
+            else
+            {
+                // Byte 0: p0[11:4], byte 1: p1[3:0] p0[3:0], byte 2: p1[11:4]
+                pDestination[i] = pSource[0];
+            }
+            pDestination[i + 1] = pSource[2];
+        }
+
+        // Odd number of pixels.
+        if ( i < pixelCount)
+        {
+            pDestination[i] = isPfnc ? static_cast<uint8_t>((pSource[0] >> 4) | (pSource[1] << 4)) : pSource[0];
+        }
+    }
+
+    bool FilterFrame( SPipelineFrame& frame)
+    {
+        if ( frame.openCvImage.empty())
+        {
+            return false;
+        }
+
+        if ( m_configuration.useFusedFrontEnd)
+        {
+            // The fused front end needs 8 bit gray data. Reduce it first, the blur is linear.
+            const cv::Mat* pGray = &frame.openCvImage;
+            if ( frame.openCvImage.channels() == 3)
+            {
+                cv::cvtColor( frame.openCvImage, frame.workspace.grayImg, cv::COLOR_BGR2GRAY);
+                pGray = &frame.workspace.grayImg;
+            }
+            else if ( frame.openCvImage.depth() == CV_16U)
+            {
+                frame.openCvImage.convertTo( frame.workspace.grayImg, CV_8U, 1.0 / (1 << (frame.bitDepth - 8)));
+                pGray = &frame.workspace.grayImg;
+            }
+            if ( m_pBandFrontEnd)
+            {
+                m_pBandFrontEnd->Process( *pGray, frame.workspace.gaussImg, frame.workspace.morphImg);
+            }
+            else
+            {
+                m_frontEnd.Process( *pGray, frame.workspace.gaussImg, frame.workspace.morphImg);
+            }
+            return true;
+        }
+
+        // Gaussian blur.
+        if ( frame.openCvImage.channels() == 3)
+        {
+            cv::GaussianBlur( frame.openCvImage, frame.workspace.gaussImg, cv::Size( 7, 7), 0, 0);
+            cv::cvtColor( frame.workspace.gaussImg, frame.workspace.gaussImg, cv::COLOR_BGR2GRAY);
+        }
+        else if ( frame.openCvImage.depth() == CV_16U)
+        {
+            // Blur with full precision, then scale the result to 8 bit as required by the triangle threshold.
+            cv::GaussianBlur( frame.openCvImage, frame.workspace.gauss16Img, cv::Size( 7, 7), 0, 0);
+            frame.workspace.gauss16Img.convertTo( frame.workspace.gaussImg, CV_8U, 1.0 / (1 << (frame.bitDepth - 8)));
+        }
+        else
+        {
+            cv::GaussianBlur( frame.openCvImage, frame.workspace.gaussImg, cv::Size( 7, 7), 0, 0);
+        }
+
+        // Binarization.
+        cv::threshold( frame.workspace.gaussImg, frame.workspace.binary, 0, 255, cv::THRESH_BINARY | cv::THRESH_TRIANGLE);
+
+        // Morphological closing.
+        cv::morphologyEx( frame.workspace.binary, frame.workspace.morphImg, cv::MORPH_CLOSE, m_closeKernel, cv::Point( -1, -1), 1);
+        return true;
+    }
+
+    bool AnalyzeContours( SPipelineFrame& frame)
+    {
+        if ( frame.openCvImage.empty())
+        {
+            return false;
+        }
+
+        // Clear the contour image. Its buffer is only reallocated if the image size has changed.
+        frame.workspace.contoursImg.create( frame.openCvImage.size(), CV_8UC3);
+        frame.workspace.contoursImg.setTo( cv::Scalar::all( 0));
+
+        if ( m_configuration.useRleBlobAnalysis)
+        {
+            AnalyzeBlobs( frame);
+            return true;
+        }
+
+        cv::findContours( frame.workspace.morphImg, frame.workspace.contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, cv::Point( -1, -1));
+
+        for ( size_t i = 0; i < frame.workspace.contours.size(); ++i)
+        {
+            const cv::Rect rect = cv::boundingRect( frame.workspace.contours[i]);
+            if ( rect.width < frame.openCvImage.cols / 2)
+            {
+                continue;
+            }
+
+            cv::drawContours( frame.workspace.contoursImg, frame.workspace.contours, static_cast<int>(i),
+                cv::Scalar( 0, 0, 255), 2, 8, frame.workspace.hierarchy, 0, cv::Point( 0, 0));
+
+            SContourMeasurement measurement;
+            measurement.contourIndex = i;
+            measurement.area = cv::contourArea( frame.workspace.contours[i]);
+            measurement.perimeter = cv::arcLength( frame.workspace.contours[i], true);
+            measurement.boundingRect = rect;
+            const cv::Moments moments = cv::moments( frame.workspace.contours[i]);
+            measurement.centroid = (moments.m00 != 0)
+                ? cv::Point2d( moments.m10 / moments.m00, moments.m01 / moments.m00)
+                : cv::Point2d( rect.x + rect.width / 2.0, rect.y + rect.height / 2.0);
+            frame.measurements.push_back( measurement);
+        }
+        return true;
+    }
+
+    // Measures the objects in a single pass over the run-length encoded image. Small objects are filtered out
+    // before any further work is done for them. The objects are marked by their bounding boxes.
+    void AnalyzeBlobs( SPipelineFrame& frame)
+    {
+        frame.workspace.contours.clear();
+
+        const cv::Mat& morphImg = frame.workspace.morphImg;
+        SRleBlobFilter filter;
+        filter.minWidth = frame.openCvImage.cols / 2;
+        if ( m_pBandBlobAnalyzer)
+        {
+            m_pBandBlobAnalyzer->Analyze( morphImg, filter, m_blobs);
+        }
+        else
+        {
+            m_blobAnalyzer.Analyze( morphImg.ptr<uint8_t>(), morphImg.cols, morphImg.rows, morphImg.step, filter, m_blobs);
+        }
+
+        for ( size_t i = 0; i < m_blobs.size(); ++i)
+        {
+            const SRleBlob& blob = m_blobs[i];
+            SContourMeasurement measurement;
+            measurement.contourIndex = i;
+            measurement.area = static_cast<double>(blob.area);
+            measurement.perimeter = blob.perimeter;
+            measurement.boundingRect = cv::Rect( blob.left, blob.top, blob.Width(), blob.Height());
+            measurement.centroid = cv::Point2d( blob.centroidX, blob.centroidY);
+            frame.measurements.push_back( measurement);
+
+            cv::rectangle( frame.workspace.contoursImg, measurement.boundingRect, cv::Scalar( 0, 0, 255), 2);
+        }
+    }
+
+    bool PersistFrame( SPipelineFrame& frame)
+    {
+        if ( frame.openCvImage.empty())
+        {
+            return false;
+        }
+
+        // Report the measurements.
+        if ( m_configuration.pMeasurementSink != NULL)
+        {
+            WriteMeasurements( frame);
+        }
+        else
+        {
+            PrintMeasurements( frame);
+        }
+
+        if ( !m_configuration.saveImageFiles && !m_configuration.appendToVideo)
+        {
+            return true;
+        }
+
+        // Don't let encoding slow down the pipeline if the disk can't keep up.
+        if ( m_queues[PipelineStage_Persistence - 1]->Size() > m_configuration.persistenceBacklogLimit)
+        {
+            return false;
+        }
+
+        bool saved = true;
+        if ( m_configuration.saveImageFiles)
+        {
+            // Raw files keep the bit depth of the camera. The other formats are saved with 8 bit.
+            const cv::Mat& image = (m_configuration.imageWriter.format == ImageWriterFormat_Raw) ? frame.openCvImage : Get8BitImage( frame);
+            saved = m_pImageWriter->Submit( image, m_imageIndex);
+            if ( saved)
+            {
+                ++m_imageIndex;
+            }
+            else
+            {
+                ReportWriterBacklog();
+            }
+        }
+
+        if ( m_configuration.appendToVideo && m_configuration.pVideoWriter != NULL)
+        {
+            m_configuration.pVideoWriter->write( Get8BitImage( frame));
+        }
+        return saved;
+    }
+
+    void PrintMeasurements( const SPipelineFrame& frame)
+    {
+        for ( size_t i = 0; i < frame.measurements.size(); ++i)
+        {
+            const SContourMeasurement& measurement = frame.measurements[i];
+            printf( "对象图像面积为:%f\n", measurement.area);
+            printf( "对象图像周长为:%f\n", measurement.perimeter);
+            if ( m_configuration.useRleBlobAnalysis)
+            {
+                std::cout << "对象的外接矩形为：" << measurement.boundingRect << "，质心为：" << measurement.centroid << std::endl;
+            }
+            else
+            {
+                std::cout << "轮廓的坐标为：" << frame.workspace.contours[measurement.contourIndex] << std::endl;
+            }
+        }
+    }
+
+    // Passes the measurements to the sink as records. Frames without measurements are recorded using one record.
+    void WriteMeasurements( const SPipelineFrame& frame)
+    {
+        const size_t count = frame.measurements.size();
+        m_records.resize( count > 0 ? count : 1);
+        for ( size_t i = 0; i < m_records.size(); ++i)
+        {
+            SMeasurementRecord& record = m_records[i];
+            memset( &record, 0, sizeof( record));
+            record.frameIndex = frame.frameIndex;
+            record.cameraTimestamp = frame.cameraTimestamp;
+            record.hostTimestamp = frame.hostTimestamp;
+            record.blobIndex = static_cast<uint32_t>(i);
+            record.blobCount = static_cast<uint32_t>(count);
+            if ( i < count)
+            {
+                const SContourMeasurement& measurement = frame.measurements[i];
+                record.area = measurement.area;
+                record.perimeter = measurement.perimeter;
+                record.left = measurement.boundingRect.x;
+                record.top = measurement.boundingRect.y;
+                record.width = measurement.boundingRect.width;
+                record.height = measurement.boundingRect.height;
+                record.centroidX = measurement.centroid.x;
+                record.centroidY = measurement.centroid.y;
+            }
+        }
+        m_configuration.pMeasurementSink->Write( &m_records[0], m_records.size());
+    }
+
+    // Tells the user that images are dropped because the disk can't keep up. Printed at most once per second.
+    void ReportWriterBacklog()
+    {
+        const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch()).count();
+        if ( now - m_lastBacklogReport < 1000)
+        {
+            return;
+        }
+        m_lastBacklogReport = now;
+
+        const SImageWriterStatistics statistics = m_pImageWriter->GetStatistics();
+        std::cerr << "The image writer can't keep up. Queue depth: " << statistics.queueDepth
+                  << ", dropped images: " << statistics.droppedImages << std::endl;
+    }
+
+    // Hands the frame over to the live view. Returns false if the previous frame has been replaced before it was shown,
+    // because frames arrive faster than the display frame rate.
+    bool DisplayFrame( SPipelineFrame& frame)
+    {
+        if ( frame.openCvImage.empty() || !m_pLiveView)
+        {
+            return false;
+        }
+        return m_pLiveView->Publish( Get8BitImage( frame), frame.workspace.contoursImg);
+    }
+
+    // Returns openCvImage or, if it has more than 8 bit per pixel, a copy scaled to 8 bit.
+    static const cv::Mat& Get8BitImage( SPipelineFrame& frame)
+    {
+        if ( frame.openCvImage.depth() == CV_8U)
+        {
+            return frame.openCvImage;
+        }
+        frame.openCvImage.convertTo( frame.workspace.scaled8Img, CV_8U, 1.0 / (1 << (frame.bitDepth - 8)));
+        return frame.workspace.scaled8Img;
+    }
+
+    void SetError( EPipelineStage stage, const std::string& message)
+    {
+        std::lock_guard<std::mutex> lock( m_errorLock);
+        if ( m_errorMessage.empty())
+        {
+            m_errorMessage = std::string( c_pipelineStageNames[stage]) + ": " + message;
+        }
+        m_abort = true;
+    }
+
+    void ThrowIfFailed()
+    {
+        if ( m_abort)
+        {
+            std::lock_guard<std::mutex> lock( m_errorLock);
+            throw RUNTIME_EXCEPTION( "The contour pipeline has stopped. %s", m_errorMessage.c_str());
+        }
+    }
+
+    // Not copyable.
+    CContourPipeline( const CContourPipeline&);
+    CContourPipeline& operator=( const CContourPipeline&);
+
+    const SContourPipelineConfiguration m_configuration;
+    std::vector<SPipelineFrame> m_frames;
+    CSpscQueue<SPipelineFrame*> m_freeFrames;              // Filled by the last stage, emptied by the acquisition stage.
+    CSpscQueue<SPipelineFrame*>* m_queues[PipelineStage_Count]; // m_queues[i] connects stage i with stage i + 1.
+    SPipelineStageStatistics m_statistics[PipelineStage_Count];
+    std::atomic<bool> m_stageFinished[PipelineStage_Count];
+    SPipelineFrame* m_pStrandedFrames[PipelineStage_Count]; // Frame a stage held when the pipeline was aborted. Released by Stop().
+    std::vector<std::thread> m_threads;
+
+    Pylon::CImageFormatConverter m_formatConverter; // Used by the conversion stage only.
+    CFusedContourFrontEnd m_frontEnd;               // Used by the filtering stage only.
+    cv::Mat m_closeKernel;                          // Used by the filtering stage only.
+    CRleBlobAnalyzer m_blobAnalyzer;                // Used by the contour analysis stage only.
+    std::vector<SRleBlob> m_blobs;                  // Used by the contour analysis stage only.
+    std::unique_ptr<CWorkStealingPool> m_pBandPool; // Used by the filtering and the contour analysis stage.
+    std::unique_ptr<CBandParallelFrontEnd> m_pBandFrontEnd;         // Used by the filtering stage only.
+    std::unique_ptr<CBandParallelBlobAnalyzer> m_pBandBlobAnalyzer; // Used by the contour analysis stage only.
+    SPipelineFrame* m_pSpareFrame;                  // Used by the acquisition stage only.
+    uint64_t m_nextFrameIndex;                      // Used by the acquisition stage only.
+    uint64_t m_imageIndex;                          // Used by the persistence stage only.
+    std::unique_ptr<CImageWriterPool> m_pImageWriter; // Used by the persistence stage only.
+    int64_t m_lastBacklogReport;                    // Used by the persistence stage only. Time in ms.
+    std::vector<SMeasurementRecord> m_records;      // Used by the persistence stage only.
+    std::unique_ptr<CLiveView> m_pLiveView;         // Used by the display stage only.
+    CLatencyHistogram m_frameLatency;               // Written by the display stage only.
+
+    std::atomic<bool> m_abort;
+    std::mutex m_errorLock;
+    std::string m_errorMessage;
+    bool m_running;
+};
+
+#endif /* INCLUDED_CONTOURPIPELINE_H_8830412 */
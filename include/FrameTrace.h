@@ -0,0 +1,515 @@
+// Contains a trace of the lifecycle of each frame: nanosecond time stamped spans and instants keyed by the grab session
+// and the block ID, written into a ring buffer in a memory-mapped file. Block IDs restart on every StartGrabbing(), so
+// each record also carries the epoch of the grab session, see CFrameTraceConfigurationHandler in FrameTraceHandlers.h.
+//
+// Recording a span is an atomic increment and a 48 byte copy, so the trace can be recorded from the grab engine,
+// event and processing threads at full frame rate. The ring keeps the latest records. As long as no trace file
+// has been created, the trace is disabled and recording costs a single branch without reading the clock.
+// The file survives a crash of the process. CFrameTraceReader exports it to the Chrome trace event format,
+// which can be viewed with chrome://tracing or https://ui.perfetto.dev.
+// See FrameTraceHandlers.h for recording the events of the Instant Camera.
+
+#ifndef INCLUDED_FRAMETRACE_H_6619380
+#define INCLUDED_FRAMETRACE_H_6619380
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#   error "The trace file needs lock-free 64 bit atomics for sharing the write position between threads."
+#endif
+
+// Phases of a frame. Phases from FrameTracePhase_User on can be named using CFrameTrace::SetPhaseName().
+enum EFrameTracePhase
+{
+    FrameTracePhase_ExposureEnd,    // Instant, the Exposure End event has been received.
+    FrameTracePhase_Grabbed,        // Instant, the grab result is being retrieved (OnImageGrabbed, called inside RetrieveResult()).
+    FrameTracePhase_ImagesSkipped,  // Instant, the argument is the number of skipped images.
+    FrameTracePhase_Retrieve,       // Span, waiting in RetrieveResult().
+    FrameTracePhase_Processing,     // Span, processing of the grab result.
+    FrameTracePhase_Output,         // Span, writing or displaying the results.
+    FrameTracePhase_User            // First phase for the application.
+};
+
+static const size_t c_frameTracePhaseCount = 16;
+static const size_t c_frameTracePhaseNameSize = 16;
+
+// One span or instant. Instants have the same begin and end time. The layout is fixed.
+struct SFrameTraceRecord
+{
+    std::atomic<uint64_t> sequence;     // Position in the trace + 1, written last. 0 while the record is being written.
+    uint64_t blockId;
+    uint64_t begin;                     // Steady clock in ns.
+    uint64_t end;
+    uint64_t argument;                  // Depends on the phase, e.g., the camera time stamp for FrameTracePhase_Grabbed.
+    uint16_t phase;                     // EFrameTracePhase
+    uint16_t epoch;                     // Grab session, see CFrameTrace::NextEpoch(). Wraps around.
+    uint32_t thread;                    // Number of the recording thread in the order of their first record.
+};
+
+static_assert( sizeof( SFrameTraceRecord) == 48, "The layout of SFrameTraceRecord must not change.");
+
+// A record copied out of the trace file by CFrameTraceReader.
+struct SFrameTraceEvent
+{
+    uint64_t position;                  // Position in the trace.
+    uint64_t blockId;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t argument;
+    uint32_t phase;
+    uint32_t thread;
+    uint32_t epoch;
+};
+
+// Header at the start of the trace file.
+struct SFrameTraceHeader
+{
+    char magic[8];                      // c_frameTraceMagic
+    uint32_t version;
+    uint32_t recordSize;                // sizeof( SFrameTraceRecord)
+    uint64_t capacity;                  // Number of records in the ring.
+    std::atomic<uint64_t> writeCount;   // Number of records started. Record i is stored in slot i % capacity.
+    uint64_t startTime;                 // Steady clock in ns when the trace has been created.
+    uint32_t processId;
+    uint32_t reserved;
+    char phaseNames[c_frameTracePhaseCount][c_frameTracePhaseNameSize];
+    uint8_t padding[16];
+};
+
+static const char c_frameTraceMagic[8] = { 'F', 'R', 'M', 'T', 'R', 'A', 'C', 'E' };
+static const uint32_t c_frameTraceVersion = 1;
+// A block ID recorded again after this time (ns) starts a new lifecycle, e.g., after the 16 bit block IDs of GigE cameras have wrapped.
+static const uint64_t c_frameTraceLifecycleGap = 1000000000;
+
+static_assert( sizeof( SFrameTraceHeader) == 320, "The layout of SFrameTraceHeader must not change.");
+
+
+class CFrameTrace
+{
+public:
+    // The trace is disabled until Create() is called.
+    CFrameTrace()
+        : m_pHeader( NULL)
+        , m_pRecords( NULL)
+        , m_capacity( 0)
+        , m_epoch( 0)
+    {
+    }
+
+    // Creates the trace file. An existing file is overwritten. Returns false if the file can't be created.
+    // Must not be called while other threads are recording.
+    bool Create( const std::string& fileName, uint64_t capacity)
+    {
+        m_pRecords = NULL;
+        if ( capacity == 0 || !m_file.Create( fileName, sizeof( SFrameTraceHeader) + capacity * sizeof( SFrameTraceRecord)))
+        {
+            return false;
+        }
+
+        m_pHeader = new (m_file.GetData()) SFrameTraceHeader;
+        memcpy( m_pHeader->magic, c_frameTraceMagic, sizeof( m_pHeader->magic));
+        m_pHeader->version = c_frameTraceVersion;
+        m_pHeader->recordSize = sizeof( SFrameTraceRecord);
+        m_pHeader->capacity = capacity;
+        m_pHeader->writeCount.store( 0, std::memory_order_relaxed);
+        m_pHeader->startTime = GetNow();
+        m_pHeader->processId = GetProcessId();
+        m_pHeader->reserved = 0;
+        memset( m_pHeader->phaseNames, 0, sizeof( m_pHeader->phaseNames));
+        memset( m_pHeader->padding, 0, sizeof( m_pHeader->padding));
+        static const char* const c_phaseNames[] = { "ExposureEnd", "Grabbed", "ImagesSkipped", "Retrieve", "Processing", "Output" };
+        for ( size_t i = 0; i < sizeof( c_phaseNames) / sizeof( c_phaseNames[0]); ++i)
+        {
+            SetPhaseName( i, c_phaseNames[i]);
+        }
+
+        SFrameTraceRecord* pRecords = reinterpret_cast<SFrameTraceRecord*>(m_file.GetData() + sizeof( SFrameTraceHeader));
+        for ( uint64_t i = 0; i < capacity; ++i)
+        {
+            new (&pRecords[i].sequence) std::atomic<uint64_t>( 0);
+        }
+        m_capacity = capacity;
+        m_pRecords = pRecords;
+        return true;
+    }
+
+    // Writes the modified pages to the file.
+    void Flush()
+    {
+        m_file.Flush();
+    }
+
+    bool IsEnabled() const
+    {
+        return m_pRecords != NULL;
+    }
+
+    // Names the phase in the exported trace. Names are truncated to 15 characters.
+    void SetPhaseName( size_t phase, const char* pName)
+    {
+        if ( m_pHeader == NULL || phase >= c_frameTracePhaseCount)
+        {
+            return;
+        }
+        char* pPhaseName = m_pHeader->phaseNames[phase];
+        size_t i = 0;
+        for ( ; pName[i] != 0 && i + 1 < c_frameTracePhaseNameSize; ++i)
+        {
+            pPhaseName[i] = pName[i];
+        }
+        memset( pPhaseName + i, 0, c_frameTracePhaseNameSize - i);
+    }
+
+    // Returns the time to pass to RecordSpan(), or 0 if the trace is disabled.
+    uint64_t Now() const
+    {
+        return IsEnabled() ? GetNow() : 0;
+    }
+
+    // Records a span from begin to now. Can be called by any thread.
+    void RecordSpan( EFrameTracePhase phase, uint64_t blockId, uint64_t begin, uint64_t argument = 0)
+    {
+        if ( IsEnabled())
+        {
+            Record( phase, blockId, begin, GetNow(), argument, GetEpoch());
+        }
+    }
+
+    // Records an instant. Can be called by any thread.
+    void RecordInstant( EFrameTracePhase phase, uint64_t blockId, uint64_t argument = 0)
+    {
+        if ( IsEnabled())
+        {
+            const uint64_t now = GetNow();
+            Record( phase, blockId, now, now, argument, GetEpoch());
+        }
+    }
+
+    // Starts a new grab session. Records of different sessions with the same block ID belong to different frames.
+    // Can be called by any thread.
+    void NextEpoch()
+    {
+        m_epoch.fetch_add( 1, std::memory_order_relaxed);
+    }
+
+    uint16_t GetEpoch() const
+    {
+        return static_cast<uint16_t>(m_epoch.load( std::memory_order_relaxed));
+    }
+
+    uint64_t GetRecordCount() const
+    {
+        return IsEnabled() ? m_pHeader->writeCount.load( std::memory_order_relaxed) : 0;
+    }
+
+    static uint64_t GetNow()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+private:
+    friend class CFrameTraceScope;
+
+    void Record( EFrameTracePhase phase, uint64_t blockId, uint64_t begin, uint64_t end, uint64_t argument, uint16_t epoch)
+    {
+        const uint64_t position = m_pHeader->writeCount.fetch_add( 1, std::memory_order_relaxed);
+        SFrameTraceRecord& record = m_pRecords[position % m_capacity];
+        // Readers discard the record while it is being overwritten.
+        record.sequence.store( 0, std::memory_order_relaxed);
+        std::atomic_thread_fence( std::memory_order_release);
+        record.blockId = blockId;
+        record.begin = begin;
+        record.end = end;
+        record.argument = argument;
+        record.phase = static_cast<uint16_t>(phase);
+        record.epoch = epoch;
+        record.thread = GetThreadNumber();
+        record.sequence.store( position + 1, std::memory_order_release);
+    }
+
+    static uint32_t GetThreadNumber()
+    {
+        static std::atomic<uint32_t> s_threadCount( 0);
+        static thread_local uint32_t s_thread = s_threadCount.fetch_add( 1, std::memory_order_relaxed) + 1;
+        return s_thread;
+    }
+
+    static uint32_t GetProcessId()
+    {
+#if defined(_WIN32)
+        return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+        return static_cast<uint32_t>(getpid());
+#endif
+    }
+
+    // Not copyable.
+    CFrameTrace( const CFrameTrace&);
+    CFrameTrace& operator=( const CFrameTrace&);
+
+    CMappedFile m_file;
+    SFrameTraceHeader* m_pHeader;
+    SFrameTraceRecord* m_pRecords;      // NULL while the trace is disabled.
+    uint64_t m_capacity;
+    std::atomic<uint32_t> m_epoch;
+};
+
+
+// Records a span from construction to destruction. The span belongs to the grab session current at construction,
+// even if grabbing is restarted within the scope.
+class CFrameTraceScope
+{
+public:
+    CFrameTraceScope( CFrameTrace& trace, EFrameTracePhase phase, uint64_t blockId, uint64_t argument = 0)
+        : m_trace( trace)
+        , m_phase( phase)
+        , m_blockId( blockId)
+        , m_argument( argument)
+        , m_begin( trace.Now())
+        , m_epoch( trace.GetEpoch())
+    {
+    }
+
+    ~CFrameTraceScope()
+    {
+        if ( m_begin != 0 && m_trace.IsEnabled())
+        {
+            m_trace.Record( m_phase, m_blockId, m_begin, CFrameTrace::GetNow(), m_argument, m_epoch);
+        }
+    }
+
+private:
+    // Not copyable.
+    CFrameTraceScope( const CFrameTraceScope&);
+    CFrameTraceScope& operator=( const CFrameTraceScope&);
+
+    CFrameTrace& m_trace;
+    const EFrameTracePhase m_phase;
+    const uint64_t m_blockId;
+    const uint64_t m_argument;
+    const uint64_t m_begin;
+    const uint16_t m_epoch;
+};
+
+
+// Reads a trace file, also while it is being written.
+class CFrameTraceReader
+{
+public:
+    CFrameTraceReader()
+        : m_pHeader( NULL)
+        , m_pRecords( NULL)
+    {
+    }
+
+    // Returns false if the file doesn't exist or isn't a trace file.
+    bool Open( const std::string& fileName)
+    {
+        if ( !m_file.OpenForReading( fileName) || m_file.GetSize() < sizeof( SFrameTraceHeader))
+        {
+            return false;
+        }
+
+        m_pHeader = reinterpret_cast<const SFrameTraceHeader*>(m_file.GetData());
+        if ( memcmp( m_pHeader->magic, c_frameTraceMagic, sizeof( m_pHeader->magic)) != 0
+            || m_pHeader->version != c_frameTraceVersion
+            || m_pHeader->recordSize != sizeof( SFrameTraceRecord)
+            || m_pHeader->capacity == 0
+            || m_file.GetSize() < sizeof( SFrameTraceHeader) + m_pHeader->capacity * sizeof( SFrameTraceRecord))
+        {
+            m_file.Close();
+            m_pHeader = NULL;
+            return false;
+        }
+        m_pRecords = reinterpret_cast<const SFrameTraceRecord*>(m_file.GetData() + sizeof( SFrameTraceHeader));
+        return true;
+    }
+
+    // Copies the complete records still in the ring, ordered by their position in the trace.
+    // Records being written or overwritten while copying are skipped.
+    void ReadRecords( std::vector<SFrameTraceEvent>& events) const
+    {
+        events.clear();
+        const uint64_t capacity = m_pHeader->capacity;
+        const uint64_t writeCount = m_pHeader->writeCount.load( std::memory_order_acquire);
+        const uint64_t first = (writeCount > capacity) ? writeCount - capacity : 0;
+        events.reserve( static_cast<size_t>(writeCount - first));
+        for ( uint64_t position = first; position < writeCount; ++position)
+        {
+            const SFrameTraceRecord& record = m_pRecords[position % capacity];
+            if ( record.sequence.load( std::memory_order_acquire) != position + 1)
+            {
+                continue;
+            }
+            SFrameTraceEvent event;
+            event.position = position;
+            event.blockId = record.blockId;
+            event.begin = record.begin;
+            event.end = record.end;
+            event.argument = record.argument;
+            event.phase = record.phase;
+            event.thread = record.thread;
+            event.epoch = record.epoch;
+            std::atomic_thread_fence( std::memory_order_acquire);
+            if ( record.sequence.load( std::memory_order_relaxed) == position + 1)
+            {
+                events.push_back( event);
+            }
+        }
+    }
+
+    // Number of records written, including those already overwritten.
+    uint64_t GetWriteCount() const
+    {
+        return m_pHeader->writeCount.load( std::memory_order_acquire);
+    }
+
+    std::string GetPhaseName( size_t phase) const
+    {
+        if ( phase < c_frameTracePhaseCount && m_pHeader->phaseNames[phase][0] != 0)
+        {
+            return std::string( m_pHeader->phaseNames[phase], strnlen( m_pHeader->phaseNames[phase], c_frameTracePhaseNameSize));
+        }
+        char name[32];
+        snprintf( name, sizeof( name), "Phase%u", static_cast<unsigned int>(phase));
+        return name;
+    }
+
+    // Writes the records in the Chrome trace event format. Spans are complete events and instants are instant events
+    // on the recording thread. Each frame, i.e., block ID within a grab session, gets an async event from its first to its
+    // last record, so the lifecycle of a frame can be followed across threads. Returns the number of records written.
+    size_t WriteChromeTrace( FILE* pFile) const
+    {
+        std::vector<SFrameTraceEvent> records;
+        ReadRecords( records);
+        std::vector<std::string> phaseNames;
+        for ( size_t i = 0; i < c_frameTracePhaseCount; ++i)
+        {
+            phaseNames.push_back( EscapeJson( GetPhaseName( i)));
+        }
+
+        const uint64_t startTime = m_pHeader->startTime;
+        const unsigned int processId = m_pHeader->processId;
+        std::vector<SFrameLifecycle> frames;
+        std::map<std::pair<uint32_t, uint64_t>, size_t> openFrames;     // Epoch and block ID -> index of the latest lifecycle.
+        fprintf( pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        fprintf( pFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":0,\"args\":{\"name\":\"Frame trace\"}}", processId);
+        for ( size_t i = 0; i < records.size(); ++i)
+        {
+            const SFrameTraceEvent& record = records[i];
+            const std::string& name = (record.phase < c_frameTracePhaseCount) ? phaseNames[record.phase] : EscapeJson( GetPhaseName( record.phase));
+            if ( record.end > record.begin)
+            {
+                fprintf( pFile, ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u,"
+                    "\"args\":{\"epoch\":%u,\"blockId\":%llu,\"argument\":%llu}}", name.c_str(), ToMicroseconds( record.begin, startTime),
+                    (record.end - record.begin) / 1000.0, processId, record.thread, record.epoch,
+                    static_cast<unsigned long long>(record.blockId), static_cast<unsigned long long>(record.argument));
+            }
+            else
+            {
+                fprintf( pFile, ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u,"
+                    "\"args\":{\"epoch\":%u,\"blockId\":%llu,\"argument\":%llu}}", name.c_str(), ToMicroseconds( record.begin, startTime),
+                    processId, record.thread, record.epoch,
+                    static_cast<unsigned long long>(record.blockId), static_cast<unsigned long long>(record.argument));
+            }
+
+            // A block ID seen again long after the last record of its frame belongs to a new frame.
+            const std::pair<uint32_t, uint64_t> key( record.epoch, record.blockId);
+            std::map<std::pair<uint32_t, uint64_t>, size_t>::iterator open = openFrames.find( key);
+            if ( open == openFrames.end() || record.begin > frames[open->second].end + c_frameTraceLifecycleGap)
+            {
+                SFrameLifecycle frame;
+                frame.epoch = record.epoch;
+                frame.blockId = record.blockId;
+                frame.begin = record.begin;
+                frame.end = record.end;
+                openFrames[key] = frames.size();
+                frames.push_back( frame);
+            }
+            else
+            {
+                SFrameLifecycle& frame = frames[open->second];
+                frame.begin = std::min( frame.begin, record.begin);
+                frame.end = std::max( frame.end, record.end);
+            }
+        }
+
+        // The index of the lifecycle is the async event ID, because the block ID is only unique within a grab session.
+        for ( size_t i = 0; i < frames.size(); ++i)
+        {
+            const SFrameLifecycle& frame = frames[i];
+            if ( frame.end <= frame.begin)
+            {
+                continue;
+            }
+            const unsigned long long blockId = static_cast<unsigned long long>(frame.blockId);
+            fprintf( pFile, ",\n{\"name\":\"Frame %llu\",\"cat\":\"lifecycle\",\"ph\":\"b\",\"id\":%llu,\"ts\":%.3f,\"pid\":%u,\"tid\":0,"
+                "\"args\":{\"epoch\":%u,\"blockId\":%llu}}",
+                blockId, static_cast<unsigned long long>(i), ToMicroseconds( frame.begin, startTime), processId, frame.epoch, blockId);
+            fprintf( pFile, ",\n{\"name\":\"Frame %llu\",\"cat\":\"lifecycle\",\"ph\":\"e\",\"id\":%llu,\"ts\":%.3f,\"pid\":%u,\"tid\":0}",
+                blockId, static_cast<unsigned long long>(i), ToMicroseconds( frame.end, startTime), processId);
+        }
+        fprintf( pFile, "\n]}\n");
+        return records.size();
+    }
+
+private:
+    // The records of one frame in the exported trace.
+    struct SFrameLifecycle
+    {
+        uint32_t epoch;
+        uint64_t blockId;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // Phase names are set by the application and may contain any character.
+    static std::string EscapeJson( const std::string& text)
+    {
+        std::string escaped;
+        for ( size_t i = 0; i < text.size(); ++i)
+        {
+            const unsigned char c = static_cast<unsigned char>(text[i]);
+            if ( c == '"' || c == '\\')
+            {
+                escaped += '\\';
+                escaped += static_cast<char>(c);
+            }
+            else if ( c < 0x20)
+            {
+                char code[8];
+                snprintf( code, sizeof( code), "\\u%04x", static_cast<unsigned int>(c));
+                escaped += code;
+            }
+            else
+            {
+                escaped += static_cast<char>(c);
+            }
+        }
+        return escaped;
+    }
+
+    // Time stamps of the Chrome trace event format are in µs.
+    static double ToMicroseconds( uint64_t time, uint64_t startTime)
+    {
+        return (time > startTime) ? (time - startTime) / 1000.0 : 0.0;
+    }
+
+    CMappedFile m_file;
+    const SFrameTraceHeader* m_pHeader;
+    const SFrameTraceRecord* m_pRecords;
+};
+
+#endif /* INCLUDED_FRAMETRACE_H_6619380 */
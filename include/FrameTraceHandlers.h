@@ -0,0 +1,107 @@
+// Contains event handlers recording the events of the Instant Camera in a CFrameTrace, see FrameTrace.h.
+//
+// CFrameTraceImageHandler records each grab result. OnImageGrabbed() is called inside RetrieveResult() by the
+// retrieving thread, so the Grabbed instant lies at the end of the Retrieve span. It doesn't show how long the
+// frame has waited in the output queue. CFrameTraceCameraEventHandler records the arrival of camera events such as
+// Exposure End, keyed by the frame ID carried by the event. The time from the Exposure End instant to the Grabbed
+// instant of the same frame includes the transfer and the time the frame has waited in the output queue.
+// CFrameTraceConfigurationHandler starts a new epoch on every StartGrabbing(), because the block IDs restart.
+// The grab loop records the Retrieve, Processing and Output spans itself, using CFrameTraceScope.
+
+#ifndef INCLUDED_FRAMETRACEHANDLERS_H_1947725
+#define INCLUDED_FRAMETRACEHANDLERS_H_1947725
+
+#include <pylon/ConfigurationEventHandler.h>
+#include <pylon/ImageEventHandler.h>
+#include <pylon/CameraEventHandler.h>
+#include <pylon/GrabResultPtr.h>
+#include <pylon/ParameterIncludes.h>
+
+#include "FrameTrace.h"
+
+// Register the handler before the first StartGrabbing().
+class CFrameTraceConfigurationHandler : public Pylon::CConfigurationEventHandler
+{
+public:
+    // The trace must exist longer than the handler.
+    explicit CFrameTraceConfigurationHandler( CFrameTrace& trace)
+        : m_trace( trace)
+    {
+    }
+
+    // The block IDs of the new grab session start again at 1.
+    virtual void OnGrabStarted( Pylon::CInstantCamera& /*camera*/)
+    {
+        m_trace.NextEpoch();
+    }
+
+private:
+    CFrameTrace& m_trace;
+};
+
+
+class CFrameTraceImageHandler : public Pylon::CImageEventHandler
+{
+public:
+    // The trace must exist longer than the handler.
+    explicit CFrameTraceImageHandler( CFrameTrace& trace)
+        : m_trace( trace)
+        , m_lastBlockId( 0)
+    {
+    }
+
+    // The skipped images are recorded with the block ID of the image grabbed last.
+    virtual void OnImagesSkipped( Pylon::CInstantCamera& /*camera*/, size_t countOfSkippedImages)
+    {
+        m_trace.RecordInstant( FrameTracePhase_ImagesSkipped, m_lastBlockId, countOfSkippedImages);
+    }
+
+    // Called inside RetrieveResult(). The argument is the time stamp of the camera, in ticks.
+    virtual void OnImageGrabbed( Pylon::CInstantCamera& /*camera*/, const Pylon::CGrabResultPtr& ptrGrabResult)
+    {
+        if ( m_trace.IsEnabled())
+        {
+            m_lastBlockId = ptrGrabResult->GetBlockID();
+            m_trace.RecordInstant( FrameTracePhase_Grabbed, m_lastBlockId, ptrGrabResult->GetTimeStamp());
+        }
+    }
+
+private:
+    CFrameTrace& m_trace;
+    uint64_t m_lastBlockId;
+};
+
+
+// Register the handler for the frame ID node of the event, e.g., EventExposureEndFrameID.
+// The frame ID matches the block ID of USB3 Vision cameras. GigE cameras without extended IDs send a 16 bit frame ID,
+// so only its lower bits match the block ID.
+class CFrameTraceCameraEventHandler : public Pylon::CCameraEventHandler
+{
+public:
+    // The trace must exist longer than the handler.
+    explicit CFrameTraceCameraEventHandler( CFrameTrace& trace, EFrameTracePhase phase = FrameTracePhase_ExposureEnd)
+        : m_trace( trace)
+        , m_phase( phase)
+    {
+    }
+
+    // The argument is the user-provided ID of the registration.
+    virtual void OnCameraEvent( Pylon::CInstantCamera& /*camera*/, intptr_t userProvidedId, GenApi::INode* pNode)
+    {
+        if ( !m_trace.IsEnabled())
+        {
+            return;
+        }
+        Pylon::CIntegerParameter frameId( pNode);
+        if ( frameId.IsReadable())
+        {
+            m_trace.RecordInstant( m_phase, static_cast<uint64_t>(frameId.GetValue()), static_cast<uint64_t>(userProvidedId));
+        }
+    }
+
+private:
+    CFrameTrace& m_trace;
+    const EFrameTracePhase m_phase;
+};
+
+#endif /* INCLUDED_FRAMETRACEHANDLERS_H_1947725 */
@@ -0,0 +1,80 @@
+// Contains the buffers needed for measuring the contours of one frame.
+// The buffers are allocated once for the image size of the camera and reused for every frame,
+// so processing a frame doesn't allocate memory as long as the image size doesn't change.
+
+#ifndef INCLUDED_FRAMEWORKSPACE_H_1937546
+#define INCLUDED_FRAMEWORKSPACE_H_1937546
+
+#include <opencv2/core/core.hpp>
+#include <pylon/PylonImage.h>
+
+#include <vector>
+
+class CFrameWorkspace
+{
+public:
+    CFrameWorkspace()
+        : m_width( 0)
+        , m_height( 0)
+    {
+    }
+
+    // Allocates all buffers for the given image size.
+    // colorInput must be true if the frames are converted to BGR8, false if they are processed as gray images.
+    // Buffers needed for more than 8 bit per pixel are allocated on first use.
+    void Allocate( int width, int height, bool colorInput)
+    {
+        m_width = width;
+        m_height = height;
+
+        pylonImage.Reset( colorInput ? Pylon::PixelType_BGR8packed : Pylon::PixelType_Mono8, width, height);
+        unpackedImage.create( height, width, CV_8UC1);
+        grayImg.create( height, width, CV_8UC1);
+        gaussImg.create( height, width, CV_8UC1);
+        binary.create( height, width, CV_8UC1);
+        morphImg.create( height, width, CV_8UC1);
+        contoursImg.create( height, width, CV_8UC3);
+
+        // Reserve space for the typical number of contours. cv::findContours resizes the vectors,
+        // the point vectors of the contours that exist in consecutive frames keep their capacity.
+        contours.reserve( c_reservedContours);
+        hierarchy.reserve( c_reservedContours);
+
+        // Touch every buffer once so that page faults don't occur while grabbing.
+        cv::Mat* buffers[] = { &unpackedImage, &grayImg, &gaussImg, &binary, &morphImg, &contoursImg };
+        for ( size_t i = 0; i < sizeof( buffers) / sizeof( buffers[0]); ++i)
+        {
+            buffers[i]->setTo( cv::Scalar::all( 0));
+        }
+    }
+
+    int GetWidth() const
+    {
+        return m_width;
+    }
+
+    int GetHeight() const
+    {
+        return m_height;
+    }
+
+    Pylon::CPylonImage pylonImage;                  // Image created by the format converter.
+    cv::Mat unpackedImage;                          // Mono12p data unpacked to 8 bit.
+    cv::Mat gauss16Img;                             // Blurred image if the frame has 16 bit per pixel.
+    cv::Mat grayImg;                                // Input of the fused front end if the frame isn't 8 bit gray.
+    cv::Mat scaled8Img;                             // Frame scaled to 8 bit for saving and showing.
+    cv::Mat gaussImg;
+    cv::Mat binary;
+    cv::Mat morphImg;
+    cv::Mat contoursImg;
+    std::vector<std::vector<cv::Point> > contours;
+    std::vector<cv::Vec4i> hierarchy;
+
+private:
+    static const size_t c_reservedContours = 256;
+
+    int m_width;
+    int m_height;
+};
+
+#endif /* INCLUDED_FRAMEWORKSPACE_H_1937546 */
@@ -0,0 +1,590 @@
+// Contains a fused implementation of the filter chain used in front of the contour search:
+// 7x7 Gaussian blur, binarization using the triangle threshold and 5x5 rectangular closing.
+//
+// The chain is computed in two row-streaming sweeps instead of five full frame passes:
+// The first sweep blurs the image and builds the histogram of the blurred rows while they are still in the cache.
+// The second sweep binarizes, dilates and erodes the image using small ring buffers of rows.
+// Row operations are vectorized using AVX2, SSE2 or NEON if available.
+//
+// The blur uses the fixed point kernel cv::GaussianBlur uses for 8 bit images, ksize 7 and sigma 0.
+// Due to intermediate rounding, single gray values may differ by one from cv::GaussianBlur.
+// The triangle threshold and the closing produce the same results as cv::threshold and cv::morphologyEx
+// with their default border handling.
+
+#ifndef INCLUDED_FUSEDCONTOURFRONTEND_H_6620194
+#define INCLUDED_FUSEDCONTOURFRONTEND_H_6620194
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define FUSEDFRONTEND_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define FUSEDFRONTEND_USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define FUSEDFRONTEND_USE_NEON
+#endif
+
+class CFusedContourFrontEnd
+{
+public:
+    CFusedContourFrontEnd()
+        : m_width( 0)
+    {
+    }
+
+    // Processes an 8 bit single channel image.
+    // blurred receives the blurred image and closed the binarized and closed image.
+    // Returns the threshold that has been used for binarization.
+    int Process( const cv::Mat& source, cv::Mat& blurred, cv::Mat& closed)
+    {
+        CV_Assert( source.type() == CV_8UC1);
+
+        const int width = source.cols;
+        const int height = source.rows;
+        blurred.create( height, width, CV_8UC1);
+        closed.create( height, width, CV_8UC1);
+        Resize( width);
+
+        unsigned int histogram[256];
+        BlurAndCountHistogram( source, blurred, 0, height, histogram);
+
+        const int threshold = ComputeTriangleThreshold( histogram);
+        BinarizeAndClose( blurred, threshold, closed, 0, height);
+        return threshold;
+    }
+
+    // Band interface for processing the horizontal bands of an image by several threads.
+    // Each thread needs its own object. blurred and closed must have been created for the size of source.
+    // First call BlurBand() for all bands and add up the histograms. Then compute the threshold using
+    // ComputeTriangleThreshold() and call CloseBand() for all bands. The rows above and below a band
+    // are read as needed (halo), so the result is the same as the result of Process().
+
+    // Blurs the rows firstRow ... endRow - 1 and computes their histogram.
+    void BlurBand( const cv::Mat& source, cv::Mat& blurred, int firstRow, int endRow, unsigned int histogram[256])
+    {
+        CV_Assert( source.type() == CV_8UC1 && blurred.size() == source.size());
+        Resize( source.cols);
+        BlurAndCountHistogram( source, blurred, firstRow, endRow, histogram);
+    }
+
+    // Binarizes and closes the rows firstRow ... endRow - 1. Reads c_closeHalo rows above and below the band.
+    void CloseBand( const cv::Mat& blurred, int threshold, cv::Mat& closed, int firstRow, int endRow)
+    {
+        CV_Assert( blurred.type() == CV_8UC1 && closed.size() == blurred.size());
+        Resize( blurred.cols);
+        BinarizeAndClose( blurred, threshold, closed, firstRow, endRow);
+    }
+
+    // Computes the threshold like cv::threshold using THRESH_TRIANGLE.
+    // Pixels with a value greater than the returned threshold are foreground.
+    static int ComputeTriangleThreshold( const unsigned int histogram[256])
+    {
+        const int N = 256;
+        unsigned int h[N];
+        std::copy( histogram, histogram + N, h);
+
+        int leftBound = 0;
+        int rightBound = 0;
+        int maxIndex = 0;
+        unsigned int maxValue = 0;
+
+        for ( int i = 0; i < N; ++i)
+        {
+            if ( h[i] > 0)
+            {
+                leftBound = i;
+                break;
+            }
+        }
+        if ( leftBound > 0)
+        {
+            --leftBound;
+        }
+
+        for ( int i = N - 1; i > 0; --i)
+        {
+            if ( h[i] > 0)
+            {
+                rightBound = i;
+                break;
+            }
+        }
+        if ( rightBound < N - 1)
+        {
+            ++rightBound;
+        }
+
+        for ( int i = 0; i < N; ++i)
+        {
+            if ( h[i] > maxValue)
+            {
+                maxValue = h[i];
+                maxIndex = i;
+            }
+        }
+
+        // The triangle is always constructed on the longer side of the peak.
+        bool isFlipped = false;
+        if ( maxIndex - leftBound < rightBound - maxIndex)
+        {
+            isFlipped = true;
+            std::reverse( h, h + N);
+            leftBound = N - 1 - rightBound;
+            maxIndex = N - 1 - maxIndex;
+        }
+
+        int threshold = leftBound;
+        const double a = maxValue;
+        const double b = leftBound - maxIndex;
+        double distance = 0;
+        for ( int i = leftBound + 1; i <= maxIndex; ++i)
+        {
+            const double tempDistance = a * i + b * h[i];
+            if ( tempDistance > distance)
+            {
+                distance = tempDistance;
+                threshold = i;
+            }
+        }
+        --threshold;
+
+        if ( isFlipped)
+        {
+            threshold = N - 1 - threshold;
+        }
+        return threshold;
+    }
+
+    // Radius of the blur and the structuring element.
+    // A closed row depends on the blurred rows within c_closeHalo, which depend on the source rows within c_blurRadius.
+    enum
+    {
+        c_blurRadius = 3,
+        c_morphRadius = 2,
+        c_morphSize = 2 * c_morphRadius + 1,
+        c_closeHalo = 2 * c_morphRadius
+    };
+
+private:
+
+    void Resize( int width)
+    {
+        if ( width == m_width)
+        {
+            return;
+        }
+        m_width = width;
+        m_columnSums.assign( width + 2 * c_blurRadius, 0);
+        m_paddedRow.assign( width + 2 * c_morphRadius, 0);
+        m_prefix.assign( width + 2 * c_morphRadius, 0);
+        m_suffix.assign( width + 2 * c_morphRadius, 0);
+        m_dilatedRows.assign( c_morphSize * width, 0);
+        m_erodedRows.assign( c_morphSize * width, 0);
+    }
+
+    // Mirrors a coordinate at the image border like BORDER_REFLECT_101.
+    static int Reflect101( int p, int length)
+    {
+        if ( length == 1)
+        {
+            return 0;
+        }
+        while ( p < 0 || p >= length)
+        {
+            p = (p < 0) ? -p : 2 * length - 2 - p;
+        }
+        return p;
+    }
+
+    // First sweep: separable blur with the kernel {2, 7, 14, 18, 14, 7, 2} / 64
+    // and histogram of the result. Processes the rows firstRow ... endRow - 1.
+    void BlurAndCountHistogram( const cv::Mat& source, cv::Mat& blurred, int firstRow, int endRow, unsigned int histogram[256])
+    {
+        const int width = source.cols;
+        const int height = source.rows;
+
+        // Four partial histograms avoid stalls when neighboring pixels have the same value.
+        std::vector<unsigned int>& partial = m_partialHistograms;
+        partial.assign( 4 * 256, 0);
+
+        uint16_t* pSums = &m_columnSums[c_blurRadius];
+        for ( int y = firstRow; y < endRow; ++y)
+        {
+            const uint8_t* rows[2 * c_blurRadius + 1];
+            for ( int i = 0; i < 2 * c_blurRadius + 1; ++i)
+            {
+                rows[i] = source.ptr<uint8_t>( Reflect101( y + i - c_blurRadius, height));
+            }
+            BlurColumns( rows, pSums, width);
+
+            // Mirror the column sums at the left and right border.
+            for ( int i = 1; i <= c_blurRadius; ++i)
+            {
+                pSums[-i] = pSums[Reflect101( -i, width)];
+                pSums[width - 1 + i] = pSums[Reflect101( width - 1 + i, width)];
+            }
+
+            uint8_t* pBlurred = blurred.ptr<uint8_t>( y);
+            BlurRow( pSums, pBlurred, width);
+
+            int x = 0;
+            for ( ; x + 4 <= width; x += 4)
+            {
+                ++partial[pBlurred[x]];
+                ++partial[256 + pBlurred[x + 1]];
+                ++partial[512 + pBlurred[x + 2]];
+                ++partial[768 + pBlurred[x + 3]];
+            }
+            for ( ; x < width; ++x)
+            {
+                ++partial[pBlurred[x]];
+            }
+        }
+
+        for ( int i = 0; i < 256; ++i)
+        {
+            histogram[i] = partial[i] + partial[256 + i] + partial[512 + i] + partial[768 + i];
+        }
+    }
+
+    // Second sweep: binarization followed by dilation and erosion.
+    // Both morphological operations are separable. The horizontal part uses the van Herk/Gil-Werman algorithm,
+    // the vertical part combines the rows kept in a ring buffer.
+    // Processes the rows firstRow ... endRow - 1. The rows of the halo are binarized and dilated again
+    // if several bands are processed, the intermediate results of the bands are independent.
+    void BinarizeAndClose( const cv::Mat& blurred, int threshold, cv::Mat& closed, int firstRow, int endRow)
+    {
+        const int width = blurred.cols;
+        const int height = blurred.rows;
+
+        // Rows that are dilated and rows that are dilated and eroded.
+        const int dilateBegin = std::max( 0, firstRow - c_closeHalo);
+        const int dilateEnd = std::min( height, endRow + c_closeHalo);
+        const int erodeBegin = std::max( 0, firstRow - c_morphRadius);
+        const int erodeEnd = std::min( height, endRow + c_morphRadius);
+
+        const uint8_t* rows[c_morphSize];
+        for ( int y = dilateBegin; y < dilateEnd + 2 * c_morphRadius; ++y)
+        {
+            // Binarize row y and dilate it horizontally.
+            if ( y < dilateEnd)
+            {
+                // Pixels outside the image don't contribute to the dilation.
+                uint8_t* pPadded = &m_paddedRow[c_morphRadius];
+                Binarize( blurred.ptr<uint8_t>( y), pPadded, width, threshold);
+                std::fill( m_paddedRow.begin(), m_paddedRow.begin() + c_morphRadius, uint8_t( 0));
+                std::fill( m_paddedRow.end() - c_morphRadius, m_paddedRow.end(), uint8_t( 0));
+                FilterRowVanHerkGilWerman<true>( &m_dilatedRows[(y % c_morphSize) * width], width);
+            }
+
+            // All horizontally dilated rows needed for row d are available now.
+            // Dilate row d vertically and erode it horizontally.
+            const int d = y - c_morphRadius;
+            if ( d >= erodeBegin && d < erodeEnd)
+            {
+                const int count = CollectRows( m_dilatedRows, d, height, width, rows);
+                CombineRows<true>( rows, count, &m_paddedRow[c_morphRadius], width);
+
+                // Pixels outside the image don't contribute to the erosion.
+                std::fill( m_paddedRow.begin(), m_paddedRow.begin() + c_morphRadius, uint8_t( 255));
+                std::fill( m_paddedRow.end() - c_morphRadius, m_paddedRow.end(), uint8_t( 255));
+                FilterRowVanHerkGilWerman<false>( &m_erodedRows[(d % c_morphSize) * width], width);
+            }
+
+            // Erode row o vertically.
+            const int o = d - c_morphRadius;
+            if ( o >= firstRow && o < endRow)
+            {
+                const int count = CollectRows( m_erodedRows, o, height, width, rows);
+                CombineRows<false>( rows, count, closed.ptr<uint8_t>( o), width);
+            }
+        }
+    }
+
+    // Returns the rows of the ring buffer in the neighborhood of row y that are inside the image.
+    static int CollectRows( std::vector<uint8_t>& ring, int y, int height, int width, const uint8_t* rows[c_morphSize])
+    {
+        int count = 0;
+        for ( int i = std::max( 0, y - c_morphRadius); i <= std::min( height - 1, y + c_morphRadius); ++i)
+        {
+            rows[count++] = &ring[(i % c_morphSize) * width];
+        }
+        return count;
+    }
+
+    // Computes the maximum (isMax) or minimum of c_morphSize neighbors of each pixel in m_paddedRow.
+    // Needs about three comparisons per pixel independent of the size of the structuring element.
+    template <bool isMax>
+    void FilterRowVanHerkGilWerman( uint8_t* pDestination, int width)
+    {
+        const uint8_t* p = &m_paddedRow[0];
+        uint8_t* g = &m_prefix[0];
+        uint8_t* h = &m_suffix[0];
+        const int length = width + 2 * c_morphRadius;
+
+        // Running extremum from the start of each block.
+        for ( int j = 0; j < length; ++j)
+        {
+            g[j] = (j % c_morphSize == 0) ? p[j] : Select<isMax>( g[j - 1], p[j]);
+        }
+
+        // Running extremum from the end of each block.
+        for ( int j = length - 1; j >= 0; --j)
+        {
+            h[j] = (j % c_morphSize == c_morphSize - 1 || j == length - 1) ? p[j] : Select<isMax>( h[j + 1], p[j]);
+        }
+
+        // Each window spans at most two blocks.
+        for ( int x = 0; x < width; ++x)
+        {
+            pDestination[x] = Select<isMax>( h[x], g[x + c_morphSize - 1]);
+        }
+    }
+
+    template <bool isMax>
+    static uint8_t Select( uint8_t a, uint8_t b)
+    {
+        return isMax ? std::max( a, b) : std::min( a, b);
+    }
+
+    // Vertical blur pass. Computes (2*(r0+r6) + 7*(r1+r5) + 14*(r2+r4) + 18*r3 + 8) >> 4.
+    // The result has 10 significant bits so that the horizontal pass fits into 16 bit.
+    static void BlurColumns( const uint8_t* const rows[7], uint16_t* pDestination, int width)
+    {
+        int x = 0;
+#if defined(FUSEDFRONTEND_USE_AVX2)
+        const __m256i k2 = _mm256_set1_epi16( 2);
+        const __m256i k7 = _mm256_set1_epi16( 7);
+        const __m256i k14 = _mm256_set1_epi16( 14);
+        const __m256i k18 = _mm256_set1_epi16( 18);
+        const __m256i round = _mm256_set1_epi16( 8);
+        for ( ; x + 16 <= width; x += 16)
+        {
+            __m256i r[7];
+            for ( int i = 0; i < 7; ++i)
+            {
+                r[i] = _mm256_cvtepu8_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i*>(rows[i] + x)));
+            }
+            __m256i sum = _mm256_mullo_epi16( _mm256_add_epi16( r[0], r[6]), k2);
+            sum = _mm256_add_epi16( sum, _mm256_mullo_epi16( _mm256_add_epi16( r[1], r[5]), k7));
+            sum = _mm256_add_epi16( sum, _mm256_mullo_epi16( _mm256_add_epi16( r[2], r[4]), k14));
+            sum = _mm256_add_epi16( sum, _mm256_mullo_epi16( r[3], k18));
+            sum = _mm256_srli_epi16( _mm256_add_epi16( sum, round), 4);
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDestination + x), sum);
+        }
+#elif defined(FUSEDFRONTEND_USE_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i k2 = _mm_set1_epi16( 2);
+        const __m128i k7 = _mm_set1_epi16( 7);
+        const __m128i k14 = _mm_set1_epi16( 14);
+        const __m128i k18 = _mm_set1_epi16( 18);
+        const __m128i round = _mm_set1_epi16( 8);
+        for ( ; x + 8 <= width; x += 8)
+        {
+            __m128i r[7];
+            for ( int i = 0; i < 7; ++i)
+            {
+                r[i] = _mm_unpacklo_epi8( _mm_loadl_epi64( reinterpret_cast<const __m128i*>(rows[i] + x)), zero);
+            }
+            __m128i sum = _mm_mullo_epi16( _mm_add_epi16( r[0], r[6]), k2);
+            sum = _mm_add_epi16( sum, _mm_mullo_epi16( _mm_add_epi16( r[1], r[5]), k7));
+            sum = _mm_add_epi16( sum, _mm_mullo_epi16( _mm_add_epi16( r[2], r[4]), k14));
+            sum = _mm_add_epi16( sum, _mm_mullo_epi16( r[3], k18));
+            sum = _mm_srli_epi16( _mm_add_epi16( sum, round), 4);
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDestination + x), sum);
+        }
+#elif defined(FUSEDFRONTEND_USE_NEON)
+        for ( ; x + 8 <= width; x += 8)
+        {
+            uint16x8_t sum = vmulq_n_u16( vaddl_u8( vld1_u8( rows[0] + x), vld1_u8( rows[6] + x)), 2);
+            sum = vmlaq_n_u16( sum, vaddl_u8( vld1_u8( rows[1] + x), vld1_u8( rows[5] + x)), 7);
+            sum = vmlaq_n_u16( sum, vaddl_u8( vld1_u8( rows[2] + x), vld1_u8( rows[4] + x)), 14);
+            sum = vmlaq_n_u16( sum, vmovl_u8( vld1_u8( rows[3] + x)), 18);
+            vst1q_u16( pDestination + x, vrshrq_n_u16( sum, 4));
+        }
+#endif
+        for ( ; x < width; ++x)
+        {
+            const unsigned int sum = 2 * (rows[0][x] + rows[6][x]) + 7 * (rows[1][x] + rows[5][x])
+                + 14 * (rows[2][x] + rows[4][x]) + 18 * rows[3][x];
+            pDestination[x] = static_cast<uint16_t>((sum + 8) >> 4);
+        }
+    }
+
+    // Horizontal blur pass. pSource must be readable from index -3 to width + 2.
+    // Computes (2*(s[x-3]+s[x+3]) + 7*(s[x-2]+s[x+2]) + 14*(s[x-1]+s[x+1]) + 18*s[x] + 128) >> 8.
+    static void BlurRow( const uint16_t* pSource, uint8_t* pDestination, int width)
+    {
+        int x = 0;
+#if defined(FUSEDFRONTEND_USE_AVX2)
+        const __m256i k2 = _mm256_set1_epi16( 2);
+        const __m256i k7 = _mm256_set1_epi16( 7);
+        const __m256i k14 = _mm256_set1_epi16( 14);
+        const __m256i k18 = _mm256_set1_epi16( 18);
+        const __m256i round = _mm256_set1_epi16( 128);
+        for ( ; x + 16 <= width; x += 16)
+        {
+            const uint16_t* s = pSource + x;
+            __m256i sum = _mm256_mullo_epi16( _mm256_add_epi16( Load16( s - 3), Load16( s + 3)), k2);
+            sum = _mm256_add_epi16( sum, _mm256_mullo_epi16( _mm256_add_epi16( Load16( s - 2), Load16( s + 2)), k7));
+            sum = _mm256_add_epi16( sum, _mm256_mullo_epi16( _mm256_add_epi16( Load16( s - 1), Load16( s + 1)), k14));
+            sum = _mm256_add_epi16( sum, _mm256_mullo_epi16( Load16( s), k18));
+            sum = _mm256_srli_epi16( _mm256_add_epi16( sum, round), 8);
+            const __m128i packed = _mm_packus_epi16( _mm256_castsi256_si128( sum), _mm256_extracti128_si256( sum, 1));
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDestination + x), packed);
+        }
+#elif defined(FUSEDFRONTEND_USE_SSE2)
+        const __m128i k2 = _mm_set1_epi16( 2);
+        const __m128i k7 = _mm_set1_epi16( 7);
+        const __m128i k14 = _mm_set1_epi16( 14);
+        const __m128i k18 = _mm_set1_epi16( 18);
+        const __m128i round = _mm_set1_epi16( 128);
+        for ( ; x + 8 <= width; x += 8)
+        {
+            const uint16_t* s = pSource + x;
+            __m128i sum = _mm_mullo_epi16( _mm_add_epi16( Load8( s - 3), Load8( s + 3)), k2);
+            sum = _mm_add_epi16( sum, _mm_mullo_epi16( _mm_add_epi16( Load8( s - 2), Load8( s + 2)), k7));
+            sum = _mm_add_epi16( sum, _mm_mullo_epi16( _mm_add_epi16( Load8( s - 1), Load8( s + 1)), k14));
+            sum = _mm_add_epi16( sum, _mm_mullo_epi16( Load8( s), k18));
+            sum = _mm_srli_epi16( _mm_add_epi16( sum, round), 8);
+            _mm_storel_epi64( reinterpret_cast<__m128i*>(pDestination + x), _mm_packus_epi16( sum, sum));
+        }
+#elif defined(FUSEDFRONTEND_USE_NEON)
+        for ( ; x + 8 <= width; x += 8)
+        {
+            const uint16_t* s = pSource + x;
+            uint16x8_t sum = vmulq_n_u16( vaddq_u16( vld1q_u16( s - 3), vld1q_u16( s + 3)), 2);
+            sum = vmlaq_n_u16( sum, vaddq_u16( vld1q_u16( s - 2), vld1q_u16( s + 2)), 7);
+            sum = vmlaq_n_u16( sum, vaddq_u16( vld1q_u16( s - 1), vld1q_u16( s + 1)), 14);
+            sum = vmlaq_n_u16( sum, vld1q_u16( s), 18);
+            vst1_u8( pDestination + x, vrshrn_n_u16( sum, 8));
+        }
+#endif
+        for ( ; x < width; ++x)
+        {
+            const uint16_t* s = pSource + x;
+            const unsigned int sum = 2 * (s[-3] + s[3]) + 7 * (s[-2] + s[2]) + 14 * (s[-1] + s[1]) + 18 * s[0];
+            pDestination[x] = static_cast<uint8_t>((sum + 128) >> 8);
+        }
+    }
+
+    // Sets pixels greater than the threshold to 255 and all other pixels to 0.
+    static void Binarize( const uint8_t* pSource, uint8_t* pDestination, int width, int threshold)
+    {
+        if ( threshold < 0 || threshold >= 255)
+        {
+            std::fill( pDestination, pDestination + width, uint8_t( threshold < 0 ? 255 : 0));
+            return;
+        }
+
+        int x = 0;
+#if defined(FUSEDFRONTEND_USE_AVX2)
+        const __m256i t = _mm256_set1_epi8( static_cast<char>(threshold));
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ones = _mm256_set1_epi8( -1);
+        for ( ; x + 32 <= width; x += 32)
+        {
+            // x > t if the saturated difference isn't zero.
+            const __m256i difference = _mm256_subs_epu8( _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSource + x)), t);
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDestination + x), _mm256_xor_si256( _mm256_cmpeq_epi8( difference, zero), ones));
+        }
+#elif defined(FUSEDFRONTEND_USE_SSE2)
+        const __m128i t = _mm_set1_epi8( static_cast<char>(threshold));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi8( -1);
+        for ( ; x + 16 <= width; x += 16)
+        {
+            const __m128i difference = _mm_subs_epu8( _mm_loadu_si128( reinterpret_cast<const __m128i*>(pSource + x)), t);
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDestination + x), _mm_xor_si128( _mm_cmpeq_epi8( difference, zero), ones));
+        }
+#elif defined(FUSEDFRONTEND_USE_NEON)
+        const uint8x16_t t = vdupq_n_u8( static_cast<uint8_t>(threshold));
+        for ( ; x + 16 <= width; x += 16)
+        {
+            vst1q_u8( pDestination + x, vcgtq_u8( vld1q_u8( pSource + x), t));
+        }
+#endif
+        for ( ; x < width; ++x)
+        {
+            pDestination[x] = (pSource[x] > threshold) ? 255 : 0;
+        }
+    }
+
+    // Computes the pixel-wise maximum (isMax) or minimum of count rows.
+    template <bool isMax>
+    static void CombineRows( const uint8_t* const rows[], int count, uint8_t* pDestination, int width)
+    {
+        int x = 0;
+#if defined(FUSEDFRONTEND_USE_AVX2)
+        for ( ; x + 32 <= width; x += 32)
+        {
+            __m256i result = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(rows[0] + x));
+            for ( int i = 1; i < count; ++i)
+            {
+                const __m256i row = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(rows[i] + x));
+                result = isMax ? _mm256_max_epu8( result, row) : _mm256_min_epu8( result, row);
+            }
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDestination + x), result);
+        }
+#elif defined(FUSEDFRONTEND_USE_SSE2)
+        for ( ; x + 16 <= width; x += 16)
+        {
+            __m128i result = _mm_loadu_si128( reinterpret_cast<const __m128i*>(rows[0] + x));
+            for ( int i = 1; i < count; ++i)
+            {
+                const __m128i row = _mm_loadu_si128( reinterpret_cast<const __m128i*>(rows[i] + x));
+                result = isMax ? _mm_max_epu8( result, row) : _mm_min_epu8( result, row);
+            }
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDestination + x), result);
+        }
+#elif defined(FUSEDFRONTEND_USE_NEON)
+        for ( ; x + 16 <= width; x += 16)
+        {
+            uint8x16_t result = vld1q_u8( rows[0] + x);
+            for ( int i = 1; i < count; ++i)
+            {
+                result = isMax ? vmaxq_u8( result, vld1q_u8( rows[i] + x)) : vminq_u8( result, vld1q_u8( rows[i] + x));
+            }
+            vst1q_u8( pDestination + x, result);
+        }
+#endif
+        for ( ; x < width; ++x)
+        {
+            uint8_t result = rows[0][x];
+            for ( int i = 1; i < count; ++i)
+            {
+                result = Select<isMax>( result, rows[i][x]);
+            }
+            pDestination[x] = result;
+        }
+    }
+
+#if defined(FUSEDFRONTEND_USE_AVX2)
+    static __m256i Load16( const uint16_t* p)
+    {
+        return _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p));
+    }
+#elif defined(FUSEDFRONTEND_USE_SSE2)
+    static __m128i Load8( const uint16_t* p)
+    {
+        return _mm_loadu_si128( reinterpret_cast<const __m128i*>(p));
+    }
+#endif
+
+    int m_width;
+    std::vector<uint16_t> m_columnSums;             // Result of the vertical blur pass including the mirrored border.
+    std::vector<unsigned int> m_partialHistograms;
+    std::vector<uint8_t> m_paddedRow;               // Input of the horizontal morphology pass including the border.
+    std::vector<uint8_t> m_prefix;                  // Temporary buffers of the van Herk/Gil-Werman algorithm.
+    std::vector<uint8_t> m_suffix;
+    std::vector<uint8_t> m_dilatedRows;             // Ring buffer of horizontally dilated rows.
+    std::vector<uint8_t> m_erodedRows;              // Ring buffer of horizontally eroded rows.
+};
+
+#endif /* INCLUDED_FUSEDCONTOURFRONTEND_H_6620194 */
@@ -0,0 +1,295 @@
+// Contains a pool of threads that encode and save images in the background.
+// Images are copied into recycled buffers when they are submitted, so the caller can reuse its image immediately.
+// If all buffers are in use because the disk can't keep up, the image is dropped instead of blocking the caller.
+
+#ifndef INCLUDED_IMAGEWRITERPOOL_H_4417280
+#define INCLUDED_IMAGEWRITERPOOL_H_4417280
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// File formats supported by CImageWriterPool.
+enum EImageWriterFormat
+{
+    ImageWriterFormat_Raw,  // Pixel data without header, rows without padding.
+    ImageWriterFormat_Png,
+    ImageWriterFormat_Jpeg,
+    ImageWriterFormat_Tiff
+};
+
+
+// Settings of the image writer pool.
+struct SImageWriterConfiguration
+{
+    SImageWriterConfiguration()
+        : format( ImageWriterFormat_Jpeg)
+        , threadCount( 2)
+        , bufferCount( 8)
+        , jpegQuality( 95)
+        , pngCompression( 1)
+        , filePrefix( "image_")
+    {
+    }
+
+    EImageWriterFormat format;
+    size_t threadCount;         // Number of encoder threads.
+    size_t bufferCount;         // Maximum number of images waiting for or being written.
+    int jpegQuality;            // 0 - 100
+    int pngCompression;         // 0 - 9. Low values are faster.
+    std::string filePrefix;     // The file name is <filePrefix><index>.<extension>.
+};
+
+
+// Counters of the image writer pool.
+struct SImageWriterStatistics
+{
+    SImageWriterStatistics()
+        : submittedImages( 0)
+        , writtenImages( 0)
+        , droppedImages( 0)
+        , failedImages( 0)
+        , writtenBytes( 0)
+        , queueDepth( 0)
+        , maxQueueDepth( 0)
+    {
+    }
+
+    uint64_t submittedImages;
+    uint64_t writtenImages;
+    uint64_t droppedImages;     // Not written because all buffers were in use.
+    uint64_t failedImages;      // Encoding or writing failed.
+    uint64_t writtenBytes;      // Size of the pixel data written. Only counted for raw files.
+    size_t queueDepth;          // Images waiting for an encoder thread.
+    size_t maxQueueDepth;
+};
+
+
+class CImageWriterPool
+{
+public:
+    explicit CImageWriterPool( const SImageWriterConfiguration& configuration)
+        : m_configuration( configuration)
+        , m_jobs( configuration.bufferCount < 1 ? 1 : configuration.bufferCount)
+        , m_stop( false)
+    {
+        for ( size_t i = 0; i < m_jobs.size(); ++i)
+        {
+            m_freeJobs.push_back( &m_jobs[i]);
+        }
+
+        const size_t threadCount = configuration.threadCount < 1 ? 1 : configuration.threadCount;
+        for ( size_t i = 0; i < threadCount; ++i)
+        {
+            m_threads.push_back( std::thread( &CImageWriterPool::RunWriter, this));
+        }
+    }
+
+    // Writes all pending images.
+    ~CImageWriterPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_lock);
+            m_stop = true;
+        }
+        m_jobAvailable.notify_all();
+        for ( size_t i = 0; i < m_threads.size(); ++i)
+        {
+            m_threads[i].join();
+        }
+    }
+
+    // Queues an image for writing. Never blocks.
+    // Returns false if the image has been dropped because all buffers are in use.
+    bool Submit( const cv::Mat& image, uint64_t index)
+    {
+        SWriteJob* pJob = NULL;
+        {
+            std::lock_guard<std::mutex> lock( m_lock);
+            ++m_statistics.submittedImages;
+            if ( m_freeJobs.empty())
+            {
+                ++m_statistics.droppedImages;
+                return false;
+            }
+            pJob = m_freeJobs.back();
+            m_freeJobs.pop_back();
+        }
+
+        // Copy outside of the lock. The buffer of the job is reused if the image size hasn't changed.
+        image.copyTo( pJob->image);
+        pJob->index = index;
+
+        {
+            std::lock_guard<std::mutex> lock( m_lock);
+            m_pendingJobs.push_back( pJob);
+            m_statistics.queueDepth = m_pendingJobs.size();
+            if ( m_statistics.queueDepth > m_statistics.maxQueueDepth)
+            {
+                m_statistics.maxQueueDepth = m_statistics.queueDepth;
+            }
+        }
+        m_jobAvailable.notify_one();
+        return true;
+    }
+
+    // Waits until all submitted images have been written.
+    void Flush()
+    {
+        std::unique_lock<std::mutex> lock( m_lock);
+        m_jobDone.wait( lock, [this]{ return m_freeJobs.size() == m_jobs.size(); });
+    }
+
+    SImageWriterStatistics GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock( m_lock);
+        return m_statistics;
+    }
+
+    void PrintStatistics( std::ostream& os) const
+    {
+        const SImageWriterStatistics statistics = GetStatistics();
+        os << "Image writer: " << statistics.writtenImages << " written, "
+           << statistics.droppedImages << " dropped, "
+           << statistics.failedImages << " failed, "
+           << "queue depth " << statistics.queueDepth << " (max " << statistics.maxQueueDepth << ")" << std::endl;
+    }
+
+    static const char* GetFileExtension( EImageWriterFormat format)
+    {
+        switch ( format)
+        {
+        case ImageWriterFormat_Raw:
+            return ".raw";
+        case ImageWriterFormat_Png:
+            return ".png";
+        case ImageWriterFormat_Tiff:
+            return ".tiff";
+        default:
+            return ".jpg";
+        }
+    }
+
+private:
+    struct SWriteJob
+    {
+        SWriteJob()
+            : index( 0)
+        {
+        }
+
+        cv::Mat image;
+        uint64_t index;
+    };
+
+    void RunWriter()
+    {
+        // Each thread keeps its own encoder parameters and file name buffer.
+        std::vector<int> parameters;
+        if ( m_configuration.format == ImageWriterFormat_Jpeg)
+        {
+            parameters.push_back( cv::IMWRITE_JPEG_QUALITY);
+            parameters.push_back( m_configuration.jpegQuality);
+        }
+        else if ( m_configuration.format == ImageWriterFormat_Png)
+        {
+            parameters.push_back( cv::IMWRITE_PNG_COMPRESSION);
+            parameters.push_back( m_configuration.pngCompression);
+        }
+
+        for (;;)
+        {
+            SWriteJob* pJob = NULL;
+            {
+                std::unique_lock<std::mutex> lock( m_lock);
+                m_jobAvailable.wait( lock, [this]{ return m_stop || !m_pendingJobs.empty(); });
+                if ( m_pendingJobs.empty())
+                {
+                    // Stop has been requested and all images have been written.
+                    return;
+                }
+                pJob = m_pendingJobs.front();
+                m_pendingJobs.pop_front();
+                m_statistics.queueDepth = m_pendingJobs.size();
+            }
+
+            std::ostringstream s;
+            s << m_configuration.filePrefix << pJob->index << GetFileExtension( m_configuration.format);
+
+            uint64_t writtenBytes = 0;
+            bool succeeded = false;
+            try
+            {
+                succeeded = (m_configuration.format == ImageWriterFormat_Raw)
+                    ? WriteRaw( s.str(), pJob->image, writtenBytes)
+                    : cv::imwrite( s.str(), pJob->image, parameters);
+            }
+            catch (const cv::Exception& e)
+            {
+                std::cerr << "Could not write " << s.str() << ": " << e.what() << std::endl;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock( m_lock);
+                if ( succeeded)
+                {
+                    ++m_statistics.writtenImages;
+                    m_statistics.writtenBytes += writtenBytes;
+                }
+                else
+                {
+                    ++m_statistics.failedImages;
+                }
+                m_freeJobs.push_back( pJob);
+            }
+            m_jobDone.notify_all();
+        }
+    }
+
+    static bool WriteRaw( const std::string& fileName, const cv::Mat& image, uint64_t& writtenBytes)
+    {
+        FILE* pFile = fopen( fileName.c_str(), "wb");
+        if ( pFile == NULL)
+        {
+            return false;
+        }
+
+        const size_t lineSize = image.cols * image.elemSize();
+        bool succeeded = true;
+        for ( int y = 0; y < image.rows && succeeded; ++y)
+        {
+            succeeded = (fwrite( image.ptr( y), 1, lineSize, pFile) == lineSize);
+        }
+        succeeded = (fclose( pFile) == 0) && succeeded;
+        writtenBytes = succeeded ? static_cast<uint64_t>(lineSize) * image.rows : 0;
+        return succeeded;
+    }
+
+    // Not copyable.
+    CImageWriterPool( const CImageWriterPool&);
+    CImageWriterPool& operator=( const CImageWriterPool&);
+
+    const SImageWriterConfiguration m_configuration;
+    std::vector<SWriteJob> m_jobs;          // The buffers, allocated on first use and reused afterwards.
+    std::vector<SWriteJob*> m_freeJobs;
+    std::deque<SWriteJob*> m_pendingJobs;
+    std::vector<std::thread> m_threads;
+
+    mutable std::mutex m_lock;              // Protects all members below and the lists above.
+    std::condition_variable m_jobAvailable;
+    std::condition_variable m_jobDone;
+    SImageWriterStatistics m_statistics;
+    bool m_stop;
+};
+
+#endif /* INCLUDED_IMAGEWRITERPOOL_H_4417280 */
@@ -0,0 +1,133 @@
+// Contains a histogram of latencies for computing percentiles such as the median and the 99th percentile.
+// Recording a value increments a single counter. No memory is allocated after construction, so the histogram can
+// be used in the processing loops without disturbing the measurement.
+
+#ifndef INCLUDED_LATENCYHISTOGRAM_H_4471930
+#define INCLUDED_LATENCYHISTOGRAM_H_4471930
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear buckets: values below 64 ns have a bucket each, larger values are split into 32 buckets per power of two.
+// The relative error of a percentile is below 2 % for any value.
+// Written by a single thread and read by any thread. Values recorded while reading may or may not be included.
+class CLatencyHistogram
+{
+public:
+    CLatencyHistogram()
+    {
+        Reset();
+    }
+
+    // Not safe while another thread is recording.
+    void Reset()
+    {
+        for ( size_t i = 0; i < c_bucketCount; ++i)
+        {
+            m_buckets[i].store( 0, std::memory_order_relaxed);
+        }
+        m_count.store( 0, std::memory_order_relaxed);
+        m_maximum.store( 0, std::memory_order_relaxed);
+    }
+
+    void Record( uint64_t nanoseconds)
+    {
+        std::atomic<uint64_t>& bucket = m_buckets[GetBucketIndex( nanoseconds)];
+        bucket.store( bucket.load( std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_count.store( m_count.load( std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if ( nanoseconds > m_maximum.load( std::memory_order_relaxed))
+        {
+            m_maximum.store( nanoseconds, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t GetCount() const
+    {
+        return m_count.load( std::memory_order_relaxed);
+    }
+
+    uint64_t GetMaximum() const
+    {
+        return m_maximum.load( std::memory_order_relaxed);
+    }
+
+    // Returns the value in ns below which the given fraction (0 ... 1) of the recorded values lies.
+    // Returns 0 if no values have been recorded.
+    uint64_t GetPercentile( double fraction) const
+    {
+        uint64_t total = 0;
+        for ( size_t i = 0; i < c_bucketCount; ++i)
+        {
+            total += m_buckets[i].load( std::memory_order_relaxed);
+        }
+        if ( total == 0)
+        {
+            return 0;
+        }
+
+        // Rank of the value, starting at 1.
+        uint64_t rank = static_cast<uint64_t>( fraction * static_cast<double>(total) + 0.5);
+        rank = (rank < 1) ? 1 : (rank > total ? total : rank);
+
+        uint64_t count = 0;
+        for ( size_t i = 0; i < c_bucketCount; ++i)
+        {
+            count += m_buckets[i].load( std::memory_order_relaxed);
+            if ( count >= rank)
+            {
+                // The midpoint of the bucket, but never more than the largest value recorded.
+                const uint64_t value = GetBucketValue( i);
+                const uint64_t maximum = GetMaximum();
+                return (value < maximum) ? value : maximum;
+            }
+        }
+        return GetMaximum();
+    }
+
+private:
+    static const unsigned int c_subBucketBits = 5;
+    static const size_t c_linearBucketCount = 2 << c_subBucketBits;                        // 64
+    static const size_t c_bucketCount = c_linearBucketCount + ((64 - c_subBucketBits - 1) << c_subBucketBits);
+
+    static size_t GetBucketIndex( uint64_t value)
+    {
+        if ( value < c_linearBucketCount)
+        {
+            return static_cast<size_t>(value);
+        }
+
+        // The 6 most significant bits select the bucket within the power of two.
+        unsigned int highestBit = 0;
+        for ( uint64_t v = value; v > 1; v >>= 1)
+        {
+            ++highestBit;
+        }
+        const unsigned int shift = highestBit - c_subBucketBits;
+        const size_t subBucket = static_cast<size_t>((value >> shift) & ((1 << c_subBucketBits) - 1));
+        return c_linearBucketCount + ((shift - 1) << c_subBucketBits) + subBucket;
+    }
+
+    static uint64_t GetBucketValue( size_t index)
+    {
+        if ( index < c_linearBucketCount)
+        {
+            return index;
+        }
+
+        const unsigned int shift = static_cast<unsigned int>((index - c_linearBucketCount) >> c_subBucketBits) + 1;
+        const uint64_t subBucket = (index - c_linearBucketCount) & ((1 << c_subBucketBits) - 1);
+        const uint64_t lower = (subBucket + (1 << c_subBucketBits)) << shift;
+        return lower + ((uint64_t( 1) << shift) >> 1);
+    }
+
+    // Not copyable.
+    CLatencyHistogram( const CLatencyHistogram&);
+    CLatencyHistogram& operator=( const CLatencyHistogram&);
+
+    std::atomic<uint64_t> m_buckets[c_bucketCount];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_maximum;
+};
+
+#endif /* INCLUDED_LATENCYHISTOGRAM_H_4471930 */
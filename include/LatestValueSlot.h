@@ -0,0 +1,71 @@
+// Contains a slot passing the newest value from one producer thread to one consumer thread.
+// Unlike a queue, a slot holds a single value. Values that the consumer hasn't taken are overwritten,
+// so a slow consumer never slows down the producer.
+
+#ifndef INCLUDED_LATESTVALUESLOT_H_6184407
+#define INCLUDED_LATESTVALUESLOT_H_6184407
+
+#include <atomic>
+
+// Triple buffer. The producer writes to its back buffer and publishes it by exchanging it with the middle buffer.
+// The consumer takes the middle buffer by exchanging it with its front buffer. No locks are taken and
+// no values are copied by the slot, so the buffers keep their memory from value to value.
+template <typename T>
+class CLatestValueSlot
+{
+public:
+    CLatestValueSlot()
+        : m_back( 0)
+        , m_middle( 1)
+        , m_front( 2)
+    {
+    }
+
+    // Called by the producer. Returns the buffer to fill before calling Publish().
+    T& GetWriteBuffer()
+    {
+        return m_buffers[m_back];
+    }
+
+    // Called by the producer. Makes the buffer returned by GetWriteBuffer() the newest value.
+    // Returns false if the previous value has been overwritten before the consumer took it.
+    bool Publish()
+    {
+        const unsigned int previous = m_middle.exchange( m_back | c_newFlag, std::memory_order_acq_rel);
+        m_back = previous & c_indexMask;
+        return (previous & c_newFlag) == 0;
+    }
+
+    // Called by the consumer. Makes the newest value available using GetReadBuffer().
+    // Returns false if no value has been published since the last call.
+    bool Update()
+    {
+        if ( (m_middle.load( std::memory_order_relaxed) & c_newFlag) == 0)
+        {
+            return false;
+        }
+        m_front = m_middle.exchange( m_front, std::memory_order_acq_rel) & c_indexMask;
+        return true;
+    }
+
+    // Called by the consumer. Returns the value taken by the last successful call of Update().
+    const T& GetReadBuffer() const
+    {
+        return m_buffers[m_front];
+    }
+
+private:
+    static const unsigned int c_newFlag = 4;
+    static const unsigned int c_indexMask = 3;
+
+    // Not copyable.
+    CLatestValueSlot( const CLatestValueSlot&);
+    CLatestValueSlot& operator=( const CLatestValueSlot&);
+
+    T m_buffers[3];
+    unsigned int m_back;                    // Used by the producer only.
+    std::atomic<unsigned int> m_middle;     // Index of the middle buffer and c_newFlag if it hasn't been taken yet.
+    unsigned int m_front;                   // Used by the consumer only.
+};
+
+#endif /* INCLUDED_LATESTVALUESLOT_H_6184407 */
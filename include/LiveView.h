@@ -0,0 +1,110 @@
+// Contains a live view showing the newest processed image in OpenCV windows.
+// All GUI calls are made by a separate display thread at a limited frame rate. The processing thread copies every
+// image into a latest-value slot and never waits for the GUI, so the display always shows the newest image,
+// also when no more images arrive.
+
+#ifndef INCLUDED_LIVEVIEW_H_3390215
+#define INCLUDED_LIVEVIEW_H_3390215
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "LatestValueSlot.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+class CLiveView
+{
+public:
+    // Starts the display thread. maxFrameRate limits the number of images shown per second.
+    explicit CLiveView( double maxFrameRate)
+        : m_framePeriod( std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>( 1.0 / (maxFrameRate > 0 ? maxFrameRate : 25.0))))
+        , m_shownFrames( 0)
+        , m_stop( false)
+    {
+        m_thread = std::thread( &CLiveView::RunDisplay, this);
+    }
+
+    ~CLiveView()
+    {
+        m_stop = true;
+        m_thread.join();
+    }
+
+    // Called by a single processing thread. Copies the images for display. The buffers of the slot keep their memory,
+    // so copying doesn't allocate once the image size is stable.
+    // Returns false if the previously published images have been replaced before the display showed them.
+    bool Publish( const cv::Mat& image, const cv::Mat& contours)
+    {
+        SViewFrame& frame = m_slot.GetWriteBuffer();
+        image.copyTo( frame.image);
+        contours.copyTo( frame.contours);
+        return m_slot.Publish();
+    }
+
+    uint64_t GetShownFrames() const
+    {
+        return m_shownFrames;
+    }
+
+private:
+    struct SViewFrame
+    {
+        cv::Mat image;
+        cv::Mat contours;
+    };
+
+    void RunDisplay()
+    {
+        cv::namedWindow( "OpenCV Display Window", cv::WINDOW_NORMAL);
+        cv::namedWindow( "OpenCV Contours Window", cv::WINDOW_AUTOSIZE);
+
+        std::chrono::steady_clock::time_point nextFrame = std::chrono::steady_clock::now();
+        while ( !m_stop)
+        {
+            if ( m_slot.Update())
+            {
+                const SViewFrame& frame = m_slot.GetReadBuffer();
+                if ( !frame.image.empty())
+                {
+                    cv::imshow( "OpenCV Display Window", frame.image);
+                }
+                if ( !frame.contours.empty())
+                {
+                    cv::imshow( "OpenCV Contours Window", frame.contours);
+                }
+                ++m_shownFrames;
+            }
+
+            // Process the window events even if there isn't a new image.
+            cv::waitKey( 1);
+
+            nextFrame += m_framePeriod;
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if ( nextFrame < now)
+            {
+                // Don't try to catch up after a slow frame.
+                nextFrame = now;
+            }
+            std::this_thread::sleep_until( nextFrame);
+        }
+
+        cv::destroyWindow( "OpenCV Display Window");
+        cv::destroyWindow( "OpenCV Contours Window");
+    }
+
+    // Not copyable.
+    CLiveView( const CLiveView&);
+    CLiveView& operator=( const CLiveView&);
+
+    const std::chrono::steady_clock::duration m_framePeriod;
+    CLatestValueSlot<SViewFrame> m_slot;
+    std::atomic<uint64_t> m_shownFrames;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+};
+
+#endif /* INCLUDED_LIVEVIEW_H_3390215 */
@@ -0,0 +1,196 @@
+// Contains a file mapped into memory. Several processes mapping the same file share its memory.
+
+#ifndef INCLUDED_MAPPEDFILE_H_8041736
+#define INCLUDED_MAPPEDFILE_H_8041736
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+class CMappedFile
+{
+public:
+    CMappedFile()
+        : m_pData( NULL)
+        , m_size( 0)
+#if defined(_WIN32)
+        , m_file( INVALID_HANDLE_VALUE)
+        , m_mapping( NULL)
+#else
+        , m_file( -1)
+#endif
+    {
+    }
+
+    ~CMappedFile()
+    {
+        Close();
+    }
+
+    // Creates the file or resizes an existing file to size bytes and maps it for reading and writing.
+    // Returns false if the file can't be created or mapped.
+    bool Create( const std::string& fileName, size_t size)
+    {
+        return Open( fileName, size, true);
+    }
+
+    // Maps an existing file for reading. Returns false if the file doesn't exist or can't be mapped.
+    bool OpenForReading( const std::string& fileName)
+    {
+        return Open( fileName, 0, false);
+    }
+
+    void Close()
+    {
+#if defined(_WIN32)
+        if ( m_pData != NULL)
+        {
+            UnmapViewOfFile( m_pData);
+        }
+        if ( m_mapping != NULL)
+        {
+            CloseHandle( m_mapping);
+        }
+        if ( m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle( m_file);
+        }
+        m_mapping = NULL;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if ( m_pData != NULL)
+        {
+            munmap( m_pData, m_size);
+        }
+        if ( m_file >= 0)
+        {
+            close( m_file);
+        }
+        m_file = -1;
+#endif
+        m_pData = NULL;
+        m_size = 0;
+    }
+
+    // Writes the modified pages to the file. Other processes see the changes without calling Flush().
+    void Flush()
+    {
+        if ( m_pData == NULL)
+        {
+            return;
+        }
+#if defined(_WIN32)
+        FlushViewOfFile( m_pData, m_size);
+#else
+        msync( m_pData, m_size, MS_ASYNC);
+#endif
+    }
+
+    uint8_t* GetData() const
+    {
+        return m_pData;
+    }
+
+    size_t GetSize() const
+    {
+        return m_size;
+    }
+
+private:
+    bool Open( const std::string& fileName, size_t size, bool writable)
+    {
+        Close();
+#if defined(_WIN32)
+        m_file = CreateFileA( fileName.c_str(), writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if ( m_file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        if ( !writable)
+        {
+            LARGE_INTEGER fileSize;
+            if ( !GetFileSizeEx( m_file, &fileSize) || fileSize.QuadPart == 0)
+            {
+                Close();
+                return false;
+            }
+            size = static_cast<size_t>(fileSize.QuadPart);
+        }
+
+        const uint64_t mappingSize = size;
+        m_mapping = CreateFileMappingA( m_file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY,
+            static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize & 0xFFFFFFFF), NULL);
+        if ( m_mapping == NULL)
+        {
+            Close();
+            return false;
+        }
+
+        m_pData = static_cast<uint8_t*>(MapViewOfFile( m_mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+#else
+        m_file = open( fileName.c_str(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+        if ( m_file < 0)
+        {
+            return false;
+        }
+
+        if ( writable)
+        {
+            if ( ftruncate( m_file, static_cast<off_t>(size)) != 0)
+            {
+                Close();
+                return false;
+            }
+        }
+        else
+        {
+            struct stat status;
+            if ( fstat( m_file, &status) != 0 || status.st_size == 0)
+            {
+                Close();
+                return false;
+            }
+            size = static_cast<size_t>(status.st_size);
+        }
+
+        void* pData = mmap( NULL, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, m_file, 0);
+        m_pData = (pData == MAP_FAILED) ? NULL : static_cast<uint8_t*>(pData);
+#endif
+        if ( m_pData == NULL)
+        {
+            Close();
+            return false;
+        }
+        m_size = size;
+        return true;
+    }
+
+    // Not copyable.
+    CMappedFile( const CMappedFile&);
+    CMappedFile& operator=( const CMappedFile&);
+
+    uint8_t* m_pData;
+    size_t m_size;
+#if defined(_WIN32)
+    HANDLE m_file;
+    HANDLE m_mapping;
+#else
+    int m_file;
+#endif
+};
+
+#endif /* INCLUDED_MAPPEDFILE_H_8041736 */
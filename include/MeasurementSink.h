@@ -0,0 +1,366 @@
+// Contains sinks receiving the measurements of the contour pipeline as fixed-layout binary records.
+//
+// CMappedRingFileSink writes the records into a ring buffer in a memory-mapped file. Other processes can
+// tail the file using CMappedRingFileReader while it is written. Writing a record is a memory copy.
+// CCsvMeasurementSink hands the records over to a writer thread that formats them as CSV lines.
+//
+// Neither sink uses iostreams or blocks the calling thread.
+
+#ifndef INCLUDED_MEASUREMENTSINK_H_5097312
+#define INCLUDED_MEASUREMENTSINK_H_5097312
+
+#include "MappedFile.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#   error "The ring file needs lock-free 64 bit atomics for sharing the write position between processes."
+#endif
+
+// The measurement of one blob. Frames without blobs are recorded using a single record with blobCount 0.
+// The layout is fixed, all fields are little-endian on the supported platforms.
+struct SMeasurementRecord
+{
+    uint64_t frameIndex;        // Index of the frame in acquisition order.
+    uint64_t cameraTimestamp;   // Time stamp of the grab result in camera ticks.
+    uint64_t hostTimestamp;     // Time the frame has been received in ns, steady clock.
+    uint32_t blobIndex;         // Index of the blob within the frame.
+    uint32_t blobCount;         // Number of blobs of the frame.
+    double area;
+    double perimeter;
+    int32_t left;               // Bounding box.
+    int32_t top;
+    int32_t width;
+    int32_t height;
+    double centroidX;
+    double centroidY;
+};
+
+static_assert( sizeof( SMeasurementRecord) == 80, "The layout of SMeasurementRecord must not change.");
+
+
+// Receives the measurements of the pipeline. Write() is called by a single thread.
+class IMeasurementSink
+{
+public:
+    virtual ~IMeasurementSink()
+    {
+    }
+
+    // Stores the records. Must not block. Records that can't be stored are dropped.
+    virtual void Write( const SMeasurementRecord* pRecords, size_t count) = 0;
+
+    // Waits until all records have been stored.
+    virtual void Flush() = 0;
+};
+
+
+// Header at the start of the ring file.
+struct SMeasurementRingHeader
+{
+    char magic[8];                      // c_measurementRingMagic
+    uint32_t version;
+    uint32_t recordSize;                // sizeof( SMeasurementRecord)
+    uint64_t capacity;                  // Number of records in the ring.
+    std::atomic<uint64_t> writeCount;   // Number of records written. Record i is stored in slot i % capacity.
+    uint8_t padding[32];
+};
+
+static const char c_measurementRingMagic[8] = { 'B', 'L', 'O', 'B', 'R', 'I', 'N', 'G' };
+static const uint32_t c_measurementRingVersion = 1;
+
+static_assert( sizeof( SMeasurementRingHeader) == 64, "The layout of SMeasurementRingHeader must not change.");
+
+
+class CMappedRingFileSink : public IMeasurementSink
+{
+public:
+    CMappedRingFileSink()
+        : m_pHeader( NULL)
+        , m_pRecords( NULL)
+        , m_capacity( 0)
+    {
+    }
+
+    // Creates the ring file. An existing file is overwritten. Returns false if the file can't be created.
+    bool Create( const std::string& fileName, uint64_t capacity)
+    {
+        if ( capacity == 0 || !m_file.Create( fileName, sizeof( SMeasurementRingHeader) + capacity * sizeof( SMeasurementRecord)))
+        {
+            return false;
+        }
+
+        m_pHeader = new (m_file.GetData()) SMeasurementRingHeader;
+        memcpy( m_pHeader->magic, c_measurementRingMagic, sizeof( m_pHeader->magic));
+        m_pHeader->version = c_measurementRingVersion;
+        m_pHeader->recordSize = sizeof( SMeasurementRecord);
+        m_pHeader->capacity = capacity;
+        memset( m_pHeader->padding, 0, sizeof( m_pHeader->padding));
+        m_pHeader->writeCount.store( 0, std::memory_order_release);
+
+        m_pRecords = reinterpret_cast<SMeasurementRecord*>(m_file.GetData() + sizeof( SMeasurementRingHeader));
+        m_capacity = capacity;
+        return true;
+    }
+
+    virtual void Write( const SMeasurementRecord* pRecords, size_t count)
+    {
+        if ( m_pHeader == NULL)
+        {
+            return;
+        }
+
+        // Each record is published separately so that a reader never takes a slot that is being overwritten.
+        uint64_t writeCount = m_pHeader->writeCount.load( std::memory_order_relaxed);
+        for ( size_t i = 0; i < count; ++i, ++writeCount)
+        {
+            // A reader seeing any byte of the new record must also see the count stored before, which tells it
+            // that the slot is being overwritten. The release store of the count doesn't order the later slot stores.
+            std::atomic_thread_fence( std::memory_order_release);
+            m_pRecords[writeCount % m_capacity] = pRecords[i];
+            m_pHeader->writeCount.store( writeCount + 1, std::memory_order_release);
+        }
+    }
+
+    virtual void Flush()
+    {
+        m_file.Flush();
+    }
+
+private:
+    CMappedFile m_file;
+    SMeasurementRingHeader* m_pHeader;
+    SMeasurementRecord* m_pRecords;
+    uint64_t m_capacity;
+};
+
+
+// Reads the records of a ring file while it is being written, e.g. by another process.
+class CMappedRingFileReader
+{
+public:
+    CMappedRingFileReader()
+        : m_pHeader( NULL)
+        , m_pRecords( NULL)
+        , m_capacity( 0)
+        , m_readCount( 0)
+        , m_lostRecords( 0)
+    {
+    }
+
+    // Returns false if the file doesn't exist or isn't a ring file.
+    // If fromStart is false, only records written after opening are read.
+    bool Open( const std::string& fileName, bool fromStart)
+    {
+        if ( !m_file.OpenForReading( fileName) || m_file.GetSize() < sizeof( SMeasurementRingHeader))
+        {
+            return false;
+        }
+
+        m_pHeader = reinterpret_cast<const SMeasurementRingHeader*>(m_file.GetData());
+        if ( memcmp( m_pHeader->magic, c_measurementRingMagic, sizeof( m_pHeader->magic)) != 0
+            || m_pHeader->version != c_measurementRingVersion
+            || m_pHeader->recordSize != sizeof( SMeasurementRecord)
+            || m_pHeader->capacity == 0
+            || m_file.GetSize() < sizeof( SMeasurementRingHeader) + m_pHeader->capacity * sizeof( SMeasurementRecord))
+        {
+            m_file.Close();
+            m_pHeader = NULL;
+            return false;
+        }
+
+        m_pRecords = reinterpret_cast<const SMeasurementRecord*>(m_file.GetData() + sizeof( SMeasurementRingHeader));
+        m_capacity = m_pHeader->capacity;
+        const uint64_t writeCount = m_pHeader->writeCount.load( std::memory_order_acquire);
+        m_readCount = fromStart ? (writeCount > m_capacity ? writeCount - m_capacity : 0) : writeCount;
+        m_lostRecords = 0;
+        return true;
+    }
+
+    // Reads the next record. Returns false if no new record has been written.
+    // Records overwritten before they could be read are skipped and counted.
+    bool Read( SMeasurementRecord& record)
+    {
+        for (;;)
+        {
+            const uint64_t writeCount = m_pHeader->writeCount.load( std::memory_order_acquire);
+            if ( m_readCount == writeCount)
+            {
+                return false;
+            }
+            if ( writeCount - m_readCount >= m_capacity)
+            {
+                // The writer has overtaken the reader. The oldest slot may be being overwritten.
+                m_lostRecords += writeCount - m_readCount - m_capacity + 1;
+                m_readCount = writeCount - m_capacity + 1;
+                continue;
+            }
+
+            record = m_pRecords[m_readCount % m_capacity];
+
+            // Discard the copy if the slot has been overwritten while copying.
+            std::atomic_thread_fence( std::memory_order_acquire);
+            if ( m_pHeader->writeCount.load( std::memory_order_relaxed) - m_readCount >= m_capacity)
+            {
+                continue;
+            }
+            ++m_readCount;
+            return true;
+        }
+    }
+
+    uint64_t GetLostRecords() const
+    {
+        return m_lostRecords;
+    }
+
+private:
+    CMappedFile m_file;
+    const SMeasurementRingHeader* m_pHeader;
+    const SMeasurementRecord* m_pRecords;
+    uint64_t m_capacity;
+    uint64_t m_readCount;
+    uint64_t m_lostRecords;
+};
+
+
+class CCsvMeasurementSink : public IMeasurementSink
+{
+public:
+    // queueCapacity is the number of records that can wait for the writer thread.
+    explicit CCsvMeasurementSink( size_t queueCapacity = 4096)
+        : m_queue( queueCapacity)
+        , m_pFile( NULL)
+        , m_acceptedRecords( 0)
+        , m_writtenRecords( 0)
+        , m_droppedRecords( 0)
+        , m_stop( false)
+    {
+    }
+
+    ~CCsvMeasurementSink()
+    {
+        Close();
+    }
+
+    // Creates the file, writes the header line and starts the writer thread. Returns false if the file can't be created.
+    bool Create( const std::string& fileName)
+    {
+        Close();
+        m_pFile = fopen( fileName.c_str(), "w");
+        if ( m_pFile == NULL)
+        {
+            return false;
+        }
+        setvbuf( m_pFile, NULL, _IOFBF, 1 << 20);
+        fputs( "frameIndex,cameraTimestamp,hostTimestamp,blobIndex,blobCount,area,perimeter,left,top,width,height,centroidX,centroidY\n", m_pFile);
+
+        m_stop = false;
+        m_thread = std::thread( &CCsvMeasurementSink::RunWriter, this);
+        return true;
+    }
+
+    // Writes all queued records and closes the file.
+    void Close()
+    {
+        if ( m_thread.joinable())
+        {
+            m_stop = true;
+            m_thread.join();
+        }
+        if ( m_pFile != NULL)
+        {
+            fclose( m_pFile);
+            m_pFile = NULL;
+        }
+    }
+
+    virtual void Write( const SMeasurementRecord* pRecords, size_t count)
+    {
+        for ( size_t i = 0; i < count; ++i)
+        {
+            if ( m_queue.TryPush( pRecords[i]))
+            {
+                ++m_acceptedRecords;
+            }
+            else
+            {
+                ++m_droppedRecords;
+            }
+        }
+    }
+
+    virtual void Flush()
+    {
+        CBackoff backoff;
+        while ( m_thread.joinable() && m_writtenRecords < m_acceptedRecords)
+        {
+            backoff.Wait();
+        }
+    }
+
+    uint64_t GetWrittenRecords() const
+    {
+        return m_writtenRecords;
+    }
+
+    uint64_t GetDroppedRecords() const
+    {
+        return m_droppedRecords;
+    }
+
+private:
+    void RunWriter()
+    {
+        CBackoff backoff;
+        SMeasurementRecord record;
+        for (;;)
+        {
+            // Read the flag first. If it is set, all records are in the queue already.
+            const bool stop = m_stop;
+            if ( m_queue.TryPop( record))
+            {
+                backoff.Reset();
+                fprintf( m_pFile, "%llu,%llu,%llu,%u,%u,%.3f,%.3f,%d,%d,%d,%d,%.3f,%.3f\n",
+                    static_cast<unsigned long long>(record.frameIndex),
+                    static_cast<unsigned long long>(record.cameraTimestamp),
+                    static_cast<unsigned long long>(record.hostTimestamp),
+                    record.blobIndex, record.blobCount, record.area, record.perimeter,
+                    record.left, record.top, record.width, record.height, record.centroidX, record.centroidY);
+                ++m_writtenRecords;
+            }
+            else if ( stop)
+            {
+                break;
+            }
+            else
+            {
+                // Make the lines visible to readers of the file while the queue is empty.
+                fflush( m_pFile);
+                backoff.Wait();
+            }
+        }
+        fflush( m_pFile);
+    }
+
+    // Not copyable.
+    CCsvMeasurementSink( const CCsvMeasurementSink&);
+    CCsvMeasurementSink& operator=( const CCsvMeasurementSink&);
+
+    CSpscQueue<SMeasurementRecord> m_queue;
+    FILE* m_pFile;                          // Used by the writer thread only while it is running.
+    uint64_t m_acceptedRecords;             // Used by the thread calling Write() only.
+    std::atomic<uint64_t> m_writtenRecords;
+    std::atomic<uint64_t> m_droppedRecords;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+};
+
+#endif /* INCLUDED_MEASUREMENTSINK_H_5097312 */
@@ -0,0 +1,234 @@
+// Contains a buffer factory placing the grab buffers of a camera on the NUMA node of the thread processing them.
+// On hosts with several processor sockets, memory of another node is read over the interconnect with a lower
+// bandwidth. Every camera gets its own factory, created for the node of its processing thread, whose pooled
+// arena (see PooledBufferFactory.h) is bound to that node. The buffer context contains the node and the slot
+// of the buffer, so a grab result can be passed to a thread of the right node without looking up the buffer.
+// CNumaTopology finds the node of the calling thread and binds threads to the processors of a node.
+// Uses the system calls on Linux and the NUMA functions of the Windows API, so libnuma isn't needed.
+
+#ifndef INCLUDED_NUMABUFFERFACTORY_H_6173520
+#define INCLUDED_NUMABUFFERFACTORY_H_6173520
+
+#include "PooledBufferFactory.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if !defined(_WIN32)
+#   include <sched.h>
+#endif
+
+class CNumaTopology
+{
+public:
+    // The IDs of the nodes with memory, in ascending order. The IDs needn't be contiguous, e.g. if nodes are offline.
+    // Node 0 only on hosts without NUMA.
+    static void GetNodes( std::vector<int>& nodes)
+    {
+        nodes.clear();
+#if defined(_WIN32)
+        ULONG highestNode = 0;
+        if ( GetNumaHighestNodeNumber( &highestNode))
+        {
+            for ( ULONG node = 0; node <= highestNode; ++node)
+            {
+                ULONGLONG availableBytes = 0;
+                if ( GetNumaAvailableMemoryNodeEx( static_cast<USHORT>(node), &availableBytes))
+                {
+                    nodes.push_back( static_cast<int>(node));
+                }
+            }
+        }
+#else
+        // possible also lists nodes that aren't present. has_memory is missing on old kernels.
+        if ( !ReadList( "/sys/devices/system/node/has_memory", nodes))
+        {
+            ReadList( "/sys/devices/system/node/online", nodes);
+        }
+#endif
+        if ( nodes.empty())
+        {
+            nodes.push_back( 0);
+        }
+    }
+
+    // Number of nodes with memory. 1 on hosts without NUMA.
+    static int GetNodeCount()
+    {
+        std::vector<int> nodes;
+        GetNodes( nodes);
+        return static_cast<int>(nodes.size());
+    }
+
+    // The node of the processor the calling thread runs on. The thread should be bound to the node, see BindCurrentThread().
+    static int GetCurrentNode()
+    {
+#if defined(_WIN32)
+        PROCESSOR_NUMBER processor;
+        GetCurrentProcessorNumberEx( &processor);
+        USHORT node = 0;
+        return GetNumaProcessorNodeEx( &processor, &node) ? static_cast<int>(node) : 0;
+#elif defined(SYS_getcpu)
+        unsigned int cpu = 0;
+        unsigned int node = 0;
+        return syscall( SYS_getcpu, &cpu, &node, NULL) == 0 ? static_cast<int>(node) : 0;
+#else
+        return 0;
+#endif
+    }
+
+    // Lets the calling thread run only on the processors of a node. Returns false if the node doesn't exist
+    // or has no processors.
+    static bool BindCurrentThread( int node)
+    {
+#if defined(_WIN32)
+        GROUP_AFFINITY affinity = {};
+        if ( !GetNumaNodeProcessorMaskEx( static_cast<USHORT>(node), &affinity) || affinity.Mask == 0)
+        {
+            return false;
+        }
+        return SetThreadGroupAffinity( GetCurrentThread(), &affinity, NULL) != FALSE;
+#else
+        char fileName[64];
+        snprintf( fileName, sizeof( fileName), "/sys/devices/system/node/node%d/cpulist", node);
+        std::vector<int> cpus;
+        if ( !ReadList( fileName, cpus))
+        {
+            // Without NUMA support in the kernel, all processors belong to node 0.
+            return node == 0;
+        }
+        if ( cpus.empty())
+        {
+            // A node with memory only.
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO( &set);
+        for ( size_t i = 0; i < cpus.size(); ++i)
+        {
+            if ( cpus[i] < CPU_SETSIZE)
+            {
+                CPU_SET( cpus[i], &set);
+            }
+        }
+        // pid 0 is the calling thread.
+        return sched_setaffinity( 0, sizeof( set), &set) == 0;
+#endif
+    }
+
+private:
+#if !defined(_WIN32)
+    // Reads a list like "0-3,8-11" as written by the kernel.
+    static bool ReadList( const char* fileName, std::vector<int>& values)
+    {
+        FILE* pFile = fopen( fileName, "r");
+        if ( pFile == NULL)
+        {
+            return false;
+        }
+        char line[4096];
+        const bool isRead = (fgets( line, sizeof( line), pFile) != NULL);
+        fclose( pFile);
+        if ( !isRead)
+        {
+            return false;
+        }
+        values.clear();
+        for ( char* p = line; *p >= '0' && *p <= '9'; )
+        {
+            const int first = static_cast<int>(strtol( p, &p, 10));
+            int last = first;
+            if ( *p == '-')
+            {
+                last = static_cast<int>(strtol( p + 1, &p, 10));
+            }
+            for ( int value = first; value <= last; ++value)
+            {
+                values.push_back( value);
+            }
+            if ( *p == ',')
+            {
+                ++p;
+            }
+        }
+        return true;
+    }
+#endif
+};
+
+
+class CNumaBufferFactory : public Pylon::IBufferFactory
+{
+public:
+    // Binds the arena to node. Use CNumaTopology::GetCurrentNode() in the processing thread to find its node.
+    explicit CNumaBufferFactory( int node, const SPooledBufferFactoryConfiguration& configuration = SPooledBufferFactoryConfiguration())
+        : m_node( node)
+        , m_pool( OnNode( configuration, node))
+    {
+    }
+
+    virtual void AllocateBuffer( size_t bufferSize, void** pCreatedBuffer, intptr_t& bufferContext)
+    {
+        intptr_t slot = 0;
+        m_pool.AllocateBuffer( bufferSize, pCreatedBuffer, slot);
+        bufferContext = MakeContext( m_node, slot);
+    }
+
+    virtual void FreeBuffer( void* pCreatedBuffer, intptr_t bufferContext)
+    {
+        m_pool.FreeBuffer( pCreatedBuffer, GetSlot( bufferContext));
+    }
+
+    // Used if the ownership is passed to the Instant Camera by Cleanup_Delete.
+    virtual void DestroyBufferFactory()
+    {
+        delete this;
+    }
+
+    int GetNode() const
+    {
+        return m_node;
+    }
+
+    SPooledBufferFactoryStatistics GetStatistics() const
+    {
+        return m_pool.GetStatistics();
+    }
+
+    // The node of a buffer, e.g. of CGrabResultPtr::GetBufferContext().
+    static int GetNode( intptr_t bufferContext)
+    {
+        return static_cast<int>(bufferContext >> c_slotBits);
+    }
+
+    // The index of a buffer within the arena of its node.
+    static intptr_t GetSlot( intptr_t bufferContext)
+    {
+        return bufferContext & ((static_cast<intptr_t>(1) << c_slotBits) - 1);
+    }
+
+    static intptr_t MakeContext( int node, intptr_t slot)
+    {
+        return (static_cast<intptr_t>(node) << c_slotBits) | slot;
+    }
+
+private:
+    static SPooledBufferFactoryConfiguration OnNode( SPooledBufferFactoryConfiguration configuration, int node)
+    {
+        configuration.numaNode = node;
+        return configuration;
+    }
+
+    // The contexts stay positive with 32 bit intptr_t for up to 128 nodes.
+    static const int c_slotBits = 24;
+
+    // Not copyable.
+    CNumaBufferFactory( const CNumaBufferFactory&);
+    CNumaBufferFactory& operator=( const CNumaBufferFactory&);
+
+    const int m_node;
+    CPooledBufferFactory m_pool;
+};
+
+#endif /* INCLUDED_NUMABUFFERFACTORY_H_6173520 */
@@ -0,0 +1,446 @@
+// Contains a buffer factory for the Instant Camera that carves the grab buffers out of one memory arena.
+// The arena is reserved, touched and optionally locked into RAM when the factory is created, so grabbing never
+// causes page faults. Optionally the arena is backed by 2 MB huge pages, so the buffers need only a few TLB entries.
+// Buffers are aligned to 64 bytes or a page and are placed first fit. Freed buffers are merged with their free
+// neighbors, so the same memory is used again after StopGrabbing() and StartGrabbing(), also if the payload size
+// has changed in the meantime. If the arena is exhausted, buffers are allocated on the heap and counted.
+
+#ifndef INCLUDED_POOLEDBUFFERFACTORY_H_2958147
+#define INCLUDED_POOLEDBUFFERFACTORY_H_2958147
+
+#include <pylon/PylonIncludes.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#   include <malloc.h>
+#else
+#   include <sys/mman.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+struct SPooledBufferFactoryConfiguration
+{
+    SPooledBufferFactoryConfiguration()
+        : arenaSize( 256 * 1024 * 1024)
+        , alignment( 4096)
+        , useHugePages( true)
+        , lockMemory( true)
+        , allowHeapAllocation( true)
+        , numaNode( -1)
+    {
+    }
+
+    size_t arenaSize;           // Should be at least MaxNumBuffer times the largest payload size.
+    size_t alignment;           // Power of two from 64 to 4096. 4096 aligns the buffers to pages.
+    bool useHugePages;          // Falls back to normal pages if no huge pages are available.
+    bool lockMemory;            // Keeps the arena in RAM. Failing to lock it is not an error, see SPooledBufferFactoryStatistics.
+    bool allowHeapAllocation;   // If false, AllocateBuffer() throws when the arena is exhausted.
+    int numaNode;               // The NUMA node the arena is placed on. -1 places it on the node of the first access.
+};
+
+
+struct SPooledBufferFactoryStatistics
+{
+    size_t arenaSize;
+    bool usesHugePages;             // The arena is backed by huge pages.
+    bool isLocked;                  // The arena is locked into RAM.
+    int numaNode;                   // The NUMA node the arena is bound to, or -1.
+    uint64_t allocations;           // Buffers allocated from the arena.
+    uint64_t heapAllocations;       // Buffers allocated on the heap because the arena was exhausted.
+    uint64_t frees;
+    size_t buffersInUse;
+    size_t bytesInUse;              // Bytes of the arena used by buffers, including alignment.
+    size_t peakBytesInUse;
+    size_t largestFreeBlock;        // The largest buffer that can be allocated from the arena.
+};
+
+
+class CPooledBufferFactory : public Pylon::IBufferFactory
+{
+public:
+    // Reserves the arena. Throws if the memory can't be reserved.
+    explicit CPooledBufferFactory( const SPooledBufferFactoryConfiguration& configuration = SPooledBufferFactoryConfiguration())
+        : m_configuration( configuration)
+        , m_pArena( NULL)
+        , m_arenaSize( 0)
+        , m_usesHugePages( false)
+        , m_isLocked( false)
+        , m_numaNode( -1)
+        , m_allocations( 0)
+        , m_heapAllocations( 0)
+        , m_frees( 0)
+        , m_buffersInUse( 0)
+        , m_bytesInUse( 0)
+        , m_peakBytesInUse( 0)
+    {
+        if ( m_configuration.alignment < 64 || m_configuration.alignment > 4096 || (m_configuration.alignment & (m_configuration.alignment - 1)) != 0)
+        {
+            throw RUNTIME_EXCEPTION( "The buffer alignment must be a power of two from 64 to 4096. alignment=%u",
+                static_cast<unsigned int>(m_configuration.alignment));
+        }
+        ReserveArena();
+        m_freeBlocks.push_back( SBlock( 0, m_arenaSize));
+    }
+
+    // All buffers must have been freed, i.e. the cameras using the factory must have been destroyed or
+    // must use another buffer factory.
+    virtual ~CPooledBufferFactory()
+    {
+        for ( size_t i = 0; i < m_buffers.size(); ++i)
+        {
+            if ( m_buffers[i].inUse && m_buffers[i].onHeap)
+            {
+                FreeOnHeap( m_buffers[i].pBuffer);
+            }
+        }
+        ReleaseArena();
+    }
+
+    // Called by the Instant Camera, possibly by different threads. The buffer context is the index of the buffer.
+    virtual void AllocateBuffer( size_t bufferSize, void** pCreatedBuffer, intptr_t& bufferContext)
+    {
+        *pCreatedBuffer = NULL;
+        const size_t size = (bufferSize + m_configuration.alignment - 1) & ~(m_configuration.alignment - 1);
+
+        std::lock_guard<std::mutex> lock( m_lock);
+        SBuffer buffer;
+        for ( size_t i = 0; i < m_freeBlocks.size(); ++i)
+        {
+            if ( m_freeBlocks[i].size >= size)
+            {
+                buffer.offset = m_freeBlocks[i].offset;
+                buffer.size = size;
+                buffer.pBuffer = m_pArena + buffer.offset;
+                m_freeBlocks[i].offset += size;
+                m_freeBlocks[i].size -= size;
+                if ( m_freeBlocks[i].size == 0)
+                {
+                    m_freeBlocks.erase( m_freeBlocks.begin() + i);
+                }
+                break;
+            }
+        }
+
+        if ( buffer.pBuffer != NULL)
+        {
+            ++m_allocations;
+            m_bytesInUse += size;
+            m_peakBytesInUse = (m_bytesInUse > m_peakBytesInUse) ? m_bytesInUse : m_peakBytesInUse;
+        }
+        else if ( m_configuration.allowHeapAllocation)
+        {
+            buffer.pBuffer = AllocateOnHeap( size);
+            buffer.onHeap = true;
+            ++m_heapAllocations;
+        }
+        else
+        {
+            throw RUNTIME_EXCEPTION( "The buffer arena is exhausted. bufferSize=%u, arenaSize=%u",
+                static_cast<unsigned int>(bufferSize), static_cast<unsigned int>(m_arenaSize));
+        }
+
+        buffer.inUse = true;
+        ++m_buffersInUse;
+        if ( m_unusedIndexes.empty())
+        {
+            m_buffers.push_back( buffer);
+            bufferContext = static_cast<intptr_t>(m_buffers.size() - 1);
+        }
+        else
+        {
+            bufferContext = static_cast<intptr_t>(m_unusedIndexes.back());
+            m_unusedIndexes.pop_back();
+            m_buffers[bufferContext] = buffer;
+        }
+        *pCreatedBuffer = buffer.pBuffer;
+    }
+
+    // Called by the Instant Camera, possibly by different threads.
+    virtual void FreeBuffer( void* /*pCreatedBuffer*/, intptr_t bufferContext)
+    {
+        std::lock_guard<std::mutex> lock( m_lock);
+        SBuffer& buffer = m_buffers[static_cast<size_t>(bufferContext)];
+        if ( buffer.onHeap)
+        {
+            FreeOnHeap( buffer.pBuffer);
+        }
+        else
+        {
+            ReturnBlock( SBlock( buffer.offset, buffer.size));
+            m_bytesInUse -= buffer.size;
+        }
+        buffer = SBuffer();
+        m_unusedIndexes.push_back( static_cast<size_t>(bufferContext));
+        ++m_frees;
+        --m_buffersInUse;
+    }
+
+    // Used if the ownership is passed to the Instant Camera by Cleanup_Delete.
+    virtual void DestroyBufferFactory()
+    {
+        delete this;
+    }
+
+    SPooledBufferFactoryStatistics GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock( m_lock);
+        SPooledBufferFactoryStatistics statistics;
+        statistics.arenaSize = m_arenaSize;
+        statistics.usesHugePages = m_usesHugePages;
+        statistics.isLocked = m_isLocked;
+        statistics.numaNode = m_numaNode;
+        statistics.allocations = m_allocations;
+        statistics.heapAllocations = m_heapAllocations;
+        statistics.frees = m_frees;
+        statistics.buffersInUse = m_buffersInUse;
+        statistics.bytesInUse = m_bytesInUse;
+        statistics.peakBytesInUse = m_peakBytesInUse;
+        statistics.largestFreeBlock = 0;
+        for ( size_t i = 0; i < m_freeBlocks.size(); ++i)
+        {
+            statistics.largestFreeBlock = (m_freeBlocks[i].size > statistics.largestFreeBlock) ? m_freeBlocks[i].size : statistics.largestFreeBlock;
+        }
+        return statistics;
+    }
+
+private:
+    // A range of the arena.
+    struct SBlock
+    {
+        SBlock( size_t offset_, size_t size_)
+            : offset( offset_)
+            , size( size_)
+        {
+        }
+
+        size_t offset;
+        size_t size;
+    };
+
+    struct SBuffer
+    {
+        SBuffer()
+            : pBuffer( NULL)
+            , offset( 0)
+            , size( 0)
+            , inUse( false)
+            , onHeap( false)
+        {
+        }
+
+        uint8_t* pBuffer;
+        size_t offset;
+        size_t size;
+        bool inUse;
+        bool onHeap;
+    };
+
+    static const size_t c_hugePageSize = 2 * 1024 * 1024;
+
+    // Inserts a block into the free blocks sorted by offset and merges it with adjacent blocks.
+    void ReturnBlock( SBlock block)
+    {
+        size_t i = 0;
+        while ( i < m_freeBlocks.size() && m_freeBlocks[i].offset < block.offset)
+        {
+            ++i;
+        }
+        if ( i < m_freeBlocks.size() && block.offset + block.size == m_freeBlocks[i].offset)
+        {
+            block.size += m_freeBlocks[i].size;
+            m_freeBlocks.erase( m_freeBlocks.begin() + i);
+        }
+        if ( i > 0 && m_freeBlocks[i - 1].offset + m_freeBlocks[i - 1].size == block.offset)
+        {
+            m_freeBlocks[i - 1].size += block.size;
+            return;
+        }
+        m_freeBlocks.insert( m_freeBlocks.begin() + i, block);
+    }
+
+    uint8_t* AllocateOnHeap( size_t size) const
+    {
+#if defined(_WIN32)
+        void* pBuffer = _aligned_malloc( size, m_configuration.alignment);
+#else
+        void* pBuffer = NULL;
+        if ( posix_memalign( &pBuffer, m_configuration.alignment, size) != 0)
+        {
+            pBuffer = NULL;
+        }
+#endif
+        if ( pBuffer == NULL)
+        {
+            throw RUNTIME_EXCEPTION( "Could not allocate a buffer. size=%u", static_cast<unsigned int>(size));
+        }
+        return static_cast<uint8_t*>(pBuffer);
+    }
+
+    static void FreeOnHeap( void* pBuffer)
+    {
+#if defined(_WIN32)
+        _aligned_free( pBuffer);
+#else
+        free( pBuffer);
+#endif
+    }
+
+    void ReserveArena()
+    {
+        const size_t size = (m_configuration.arenaSize + c_hugePageSize - 1) & ~(c_hugePageSize - 1);
+#if defined(_WIN32)
+        // Large pages need the "Lock pages in memory" privilege and are always locked.
+        const SIZE_T largePageSize = GetLargePageMinimum();
+        if ( m_configuration.useHugePages && largePageSize != 0 && size % largePageSize == 0)
+        {
+            m_pArena = AllocateVirtual( size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES);
+            m_usesHugePages = m_isLocked = (m_pArena != NULL);
+        }
+        if ( m_pArena == NULL)
+        {
+            m_pArena = AllocateVirtual( size, MEM_RESERVE | MEM_COMMIT);
+        }
+        if ( m_pArena == NULL)
+        {
+            throw RUNTIME_EXCEPTION( "Could not reserve the buffer arena. size=%u, error=%u", static_cast<unsigned int>(size),
+                static_cast<unsigned int>(GetLastError()));
+        }
+        m_arenaSize = size;
+        m_numaNode = m_configuration.numaNode;
+        if ( m_configuration.lockMemory && !m_isLocked)
+        {
+            // The working set must be large enough to lock the arena.
+            SIZE_T minimumSize = 0;
+            SIZE_T maximumSize = 0;
+            GetProcessWorkingSetSize( GetCurrentProcess(), &minimumSize, &maximumSize);
+            SetProcessWorkingSetSize( GetCurrentProcess(), minimumSize + size, maximumSize + size);
+            m_isLocked = (VirtualLock( m_pArena, size) != FALSE);
+        }
+#else
+        if ( m_configuration.useHugePages)
+        {
+            void* pArena = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if ( pArena != MAP_FAILED)
+            {
+                m_pArena = static_cast<uint8_t*>(pArena);
+                m_usesHugePages = true;
+            }
+        }
+        if ( m_pArena == NULL)
+        {
+            void* pArena = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if ( pArena == MAP_FAILED)
+            {
+                throw RUNTIME_EXCEPTION( "Could not reserve the buffer arena. size=%u", static_cast<unsigned int>(size));
+            }
+            m_pArena = static_cast<uint8_t*>(pArena);
+#   if defined(MADV_HUGEPAGE)
+            if ( m_configuration.useHugePages)
+            {
+                // No huge pages are reserved. Transparent huge pages may still back the arena.
+                madvise( m_pArena, size, MADV_HUGEPAGE);
+            }
+#   endif
+        }
+        m_arenaSize = size;
+        if ( m_configuration.numaNode >= 0 && BindToNode( m_configuration.numaNode))
+        {
+            m_numaNode = m_configuration.numaNode;
+        }
+        if ( m_configuration.lockMemory)
+        {
+            // Fails if RLIMIT_MEMLOCK is too small.
+            m_isLocked = (mlock( m_pArena, size) == 0);
+        }
+#endif
+        // Touch every page, so grabbing doesn't cause page faults.
+        memset( m_pArena, 0, m_arenaSize);
+    }
+
+#if defined(_WIN32)
+    uint8_t* AllocateVirtual( size_t size, DWORD allocationType) const
+    {
+        if ( m_configuration.numaNode >= 0)
+        {
+            return static_cast<uint8_t*>(VirtualAllocExNuma( GetCurrentProcess(), NULL, size, allocationType, PAGE_READWRITE,
+                static_cast<DWORD>(m_configuration.numaNode)));
+        }
+        return static_cast<uint8_t*>(VirtualAlloc( NULL, size, allocationType, PAGE_READWRITE));
+    }
+#else
+    // Binds the pages of the arena to a node. Must be called before the pages are touched.
+    // Uses the system call, so libnuma isn't needed.
+    bool BindToNode( int node) const
+    {
+#   if defined(SYS_mbind)
+        const int c_mpolBind = 2;
+        const size_t c_bitsPerWord = sizeof( unsigned long) * 8;
+        unsigned long nodeMask[1024 / (sizeof( unsigned long) * 8)] = { 0 };
+        if ( node >= 1024)
+        {
+            return false;
+        }
+        nodeMask[node / c_bitsPerWord] = 1UL << (node % c_bitsPerWord);
+        return syscall( SYS_mbind, m_pArena, m_arenaSize, c_mpolBind, nodeMask, 1024 + 1, 0) == 0;
+#   else
+        (void)node;
+        return false;
+#   endif
+    }
+#endif
+
+    void ReleaseArena()
+    {
+        if ( m_pArena == NULL)
+        {
+            return;
+        }
+#if defined(_WIN32)
+        if ( m_isLocked && !m_usesHugePages)
+        {
+            VirtualUnlock( m_pArena, m_arenaSize);
+        }
+        VirtualFree( m_pArena, 0, MEM_RELEASE);
+#else
+        if ( m_isLocked)
+        {
+            munlock( m_pArena, m_arenaSize);
+        }
+        munmap( m_pArena, m_arenaSize);
+#endif
+        m_pArena = NULL;
+    }
+
+    // Not copyable.
+    CPooledBufferFactory( const CPooledBufferFactory&);
+    CPooledBufferFactory& operator=( const CPooledBufferFactory&);
+
+    const SPooledBufferFactoryConfiguration m_configuration;
+    uint8_t* m_pArena;
+    size_t m_arenaSize;
+    bool m_usesHugePages;
+    bool m_isLocked;
+    int m_numaNode;
+    mutable std::mutex m_lock;
+    std::vector<SBlock> m_freeBlocks;       // Sorted by offset, adjacent blocks are merged.
+    std::vector<SBuffer> m_buffers;         // Indexed by the buffer context.
+    std::vector<size_t> m_unusedIndexes;
+    uint64_t m_allocations;
+    uint64_t m_heapAllocations;
+    uint64_t m_frees;
+    size_t m_buffersInUse;
+    size_t m_bytesInUse;
+    size_t m_peakBytesInUse;
+};
+
+#endif /* INCLUDED_POOLEDBUFFERFACTORY_H_2958147 */
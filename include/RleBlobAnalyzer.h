@@ -0,0 +1,642 @@
+// Contains a single pass connected component analysis working on run-length encoded rows.
+//
+// The rows of a binary image are encoded as runs of foreground pixels and labeled using a union-find
+// structure (8-connectivity). Area, bounding box and moments are accumulated per run. The perimeter is
+// estimated from the 2x2 pixel patterns (bit quads) along the boundary, which are counted per run edge
+// while sweeping two consecutive rows. No contour polygons are built.
+//
+// Callers creating the runs themselves can pass the gray values of the runs, which yields intensity weighted centroids.
+//
+// A blob is reported as soon as a row doesn't continue it, so results are produced in the order
+// in which the blobs end when scanning the image top down. Blobs are filtered by size before they are reported.
+//
+// Horizontal bands of an image can be analyzed by several threads. The blobs touching the seam between
+// two bands are completed by merging the partial results of the bands afterwards.
+//
+// Differences to cv::findContours with RETR_EXTERNAL followed by cv::contourArea and cv::arcLength:
+// The area is the number of pixels, holes are not counted. Blobs lying in the holes of other blobs are
+// reported as separate blobs. The perimeter estimates the length of the pixel boundary, not of the polygon
+// connecting the centers of the boundary pixels, and is therefore slightly larger.
+
+#ifndef INCLUDED_RLEBLOBANALYZER_H_5520931
+#define INCLUDED_RLEBLOBANALYZER_H_5520931
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// A horizontal run of foreground pixels of one row. end is the first pixel after the run.
+struct SRleRun
+{
+    SRleRun()
+        : start( 0)
+        , end( 0)
+    {
+    }
+
+    SRleRun( int start_, int end_)
+        : start( start_)
+        , end( end_)
+    {
+    }
+
+    int start;
+    int end;
+};
+
+
+// Sums of the gray values of the pixels of a run, used for intensity weighted centroids.
+struct SRleRunIntensity
+{
+    SRleRunIntensity()
+        : sum( 0)
+        , sumX( 0)
+    {
+    }
+
+    double sum;             // Sum of the gray values.
+    double sumX;            // Sum of gray value * x.
+};
+
+
+// Result of measuring a single blob.
+struct SRleBlob
+{
+    uint64_t area;          // Number of pixels.
+    double perimeter;       // Estimated length of the boundary.
+    int left;               // Bounding box, right and bottom are inclusive.
+    int top;
+    int right;
+    int bottom;
+    double centroidX;
+    double centroidY;
+    double m10;             // Raw moments of the pixel positions. m00 is area.
+    double m01;
+    double m20;
+    double m11;
+    double m02;
+    double intensity;       // Sum of the gray values. 0 if no gray values have been passed to AddRow().
+    double weightedCentroidX; // Intensity weighted centroid. Equal to the centroid if no gray values have been passed.
+    double weightedCentroidY;
+
+    int Width() const
+    {
+        return right - left + 1;
+    }
+
+    int Height() const
+    {
+        return bottom - top + 1;
+    }
+};
+
+
+// Blobs not meeting all conditions are not reported.
+struct SRleBlobFilter
+{
+    SRleBlobFilter()
+        : minArea( 0)
+        , minWidth( 0)
+        , minHeight( 0)
+    {
+    }
+
+    uint64_t minArea;
+    int minWidth;
+    int minHeight;
+};
+
+
+class CRleBlobAnalyzer
+{
+public:
+    CRleBlobAnalyzer()
+        : m_width( 0)
+        , m_row( 0)
+        , m_firstRow( 0)
+        , m_topIsSeam( false)
+        , m_bottomIsSeam( false)
+        , m_pBlobs( NULL)
+    {
+    }
+
+    // Analyzes an 8 bit single channel image. Pixels that aren't 0 are foreground.
+    // blobs is cleared and receives the blobs passing the filter.
+    void Analyze( const uint8_t* pImage, int width, int height, size_t stride, const SRleBlobFilter& filter, std::vector<SRleBlob>& blobs)
+    {
+        BeginFrame( width, filter, blobs);
+        for ( int y = 0; y < height; ++y)
+        {
+            ExtractRuns( pImage + y * stride, width, m_rowRuns);
+            AddRow( m_rowRuns.empty() ? NULL : &m_rowRuns[0], m_rowRuns.size());
+        }
+        EndFrame();
+    }
+
+    // Incremental interface for callers creating the runs themselves, e.g. using a different foreground condition.
+    // Call BeginFrame() once, AddRow() for every row top down and EndFrame() after the last row.
+    // The runs of a row must be sorted and must not touch or overlap.
+    void BeginFrame( int width, const SRleBlobFilter& filter, std::vector<SRleBlob>& blobs)
+    {
+        BeginBand( width, 0, false, false, filter, blobs);
+    }
+
+    // Analyzes the rows firstRow ... endRow - 1 of an image using one object per band.
+    // pImage points to the first row of the image. topIsSeam and bottomIsSeam tell whether another band follows
+    // above or below. Blobs not touching a seam are filtered and stored in blobs. The other blobs are kept
+    // for MergeBands().
+    void AnalyzeBand( const uint8_t* pImage, int width, int firstRow, int endRow, size_t stride,
+        bool topIsSeam, bool bottomIsSeam, const SRleBlobFilter& filter, std::vector<SRleBlob>& blobs)
+    {
+        BeginBand( width, firstRow, topIsSeam, bottomIsSeam, filter, blobs);
+        for ( int y = firstRow; y < endRow; ++y)
+        {
+            ExtractRuns( pImage + y * stride, width, m_rowRuns);
+            AddRow( m_rowRuns.empty() ? NULL : &m_rowRuns[0], m_rowRuns.size());
+        }
+        EndFrame();
+    }
+
+    // Joins the blobs of adjacent bands that touch at the seams and stores those passing the filter in blobs.
+    // The bands must have been analyzed using AnalyzeBand() and must be passed top down.
+    // blobs isn't cleared, so the blobs reported by the bands can be collected in the same vector.
+    void MergeBands( CRleBlobAnalyzer* const* pBands, size_t count, const SRleBlobFilter& filter, std::vector<SRleBlob>& blobs)
+    {
+        m_filter = filter;
+        m_pBlobs = &blobs;
+        m_parents.clear();
+        m_accumulators.clear();
+        m_bandOffsets.resize( count);
+
+        // Take over the labels of all bands. The labels of band k are offset by the number of labels of the bands above.
+        for ( size_t k = 0; k < count; ++k)
+        {
+            const CRleBlobAnalyzer& band = *pBands[k];
+            const uint32_t offset = static_cast<uint32_t>(m_parents.size());
+            m_bandOffsets[k] = offset;
+            for ( size_t i = 0; i < band.m_parents.size(); ++i)
+            {
+                m_parents.push_back( band.m_parents[i] + offset);
+            }
+            m_accumulators.insert( m_accumulators.end(), band.m_accumulators.begin(), band.m_accumulators.end());
+        }
+
+        // Connect the last row of each band with the first row of the band below.
+        for ( size_t k = 1; k < count; ++k)
+        {
+            CopyRuns( pBands[k - 1]->m_previousRuns, m_bandOffsets[k - 1], m_previousRuns);
+            CopyRuns( pBands[k]->m_firstRowRuns, m_bandOffsets[k], m_currentRuns);
+            ConnectRuns( m_currentRuns, 0, false);
+            CountQuads( m_previousRuns, m_currentRuns);
+        }
+
+        // All blobs are complete now.
+        for ( size_t i = 0; i < m_parents.size(); ++i)
+        {
+            if ( m_parents[i] == i && m_accumulators[i].open)
+            {
+                m_accumulators[i].open = false;
+                Emit( static_cast<uint32_t>(i));
+            }
+        }
+        m_previousRuns.clear();
+        m_currentRuns.clear();
+    }
+
+    void AddRow( const SRleRun* pRuns, size_t count)
+    {
+        AddRow( pRuns, NULL, count);
+    }
+
+    // pIntensities holds the gray value sums of the runs for computing intensity weighted centroids. Can be NULL.
+    void AddRow( const SRleRun* pRuns, const SRleRunIntensity* pIntensities, size_t count)
+    {
+        const int y = m_row++;
+
+        m_currentRuns.resize( count);
+        for ( size_t i = 0; i < count; ++i)
+        {
+            m_currentRuns[i].start = pRuns[i].start;
+            m_currentRuns[i].end = pRuns[i].end;
+        }
+        ConnectRuns( m_currentRuns, y, true);
+
+        if ( pIntensities != NULL)
+        {
+            // Runs later in the row may have merged the blob of a run, so the root is looked up again.
+            for ( size_t i = 0; i < count; ++i)
+            {
+                SAccumulator& accumulator = m_accumulators[Find( m_currentRuns[i].label)];
+                accumulator.intensity += pIntensities[i].sum;
+                accumulator.intensityX += pIntensities[i].sumX;
+                accumulator.intensityY += pIntensities[i].sum * y;
+            }
+        }
+
+        // The boundary between the previous and the current row.
+        // At a seam the previous row belongs to another band, the quads are counted by MergeBands().
+        if ( y == m_firstRow && m_topIsSeam)
+        {
+            m_firstRowRuns = m_currentRuns;
+        }
+        else
+        {
+            CountQuads( m_previousRuns, m_currentRuns);
+        }
+
+        // Blobs that aren't continued by the current row are complete.
+        for ( size_t i = 0; i < m_previousRuns.size(); ++i)
+        {
+            const uint32_t root = Find( m_previousRuns[i].label);
+            if ( m_accumulators[root].lastRow < y)
+            {
+                Emit( root);
+            }
+        }
+
+        m_previousRuns.swap( m_currentRuns);
+    }
+
+    void EndFrame()
+    {
+        if ( m_bottomIsSeam)
+        {
+            // The blobs of the last row are completed by MergeBands(), which needs the runs of the last row.
+            for ( size_t i = 0; i < m_previousRuns.size(); ++i)
+            {
+                m_accumulators[Find( m_previousRuns[i].label)].open = true;
+            }
+            return;
+        }
+
+        // The boundary below the last row.
+        m_currentRuns.clear();
+        CountQuads( m_previousRuns, m_currentRuns);
+
+        for ( size_t i = 0; i < m_previousRuns.size(); ++i)
+        {
+            Emit( Find( m_previousRuns[i].label));
+        }
+        m_previousRuns.clear();
+    }
+
+    // Encodes the foreground pixels of a row as runs. Pixels that aren't 0 are foreground.
+    static void ExtractRuns( const uint8_t* pRow, int width, std::vector<SRleRun>& runs)
+    {
+        runs.clear();
+        int x = 0;
+        while ( x < width)
+        {
+            // Binary images contain 0 and 255 only. Skip 8 equal pixels at once.
+            while ( x + 8 <= width && LoadWord( pRow + x) == 0)
+            {
+                x += 8;
+            }
+            while ( x < width && pRow[x] == 0)
+            {
+                ++x;
+            }
+            if ( x == width)
+            {
+                break;
+            }
+
+            const int start = x;
+            while ( x + 8 <= width && LoadWord( pRow + x) == ~static_cast<uint64_t>(0))
+            {
+                x += 8;
+            }
+            while ( x < width && pRow[x] != 0)
+            {
+                ++x;
+            }
+            runs.push_back( SRleRun( start, x));
+        }
+    }
+
+private:
+    static const uint32_t c_noLabel = 0xFFFFFFFF;
+
+    struct SLabeledRun
+    {
+        int start;
+        int end;
+        uint32_t label;
+    };
+
+    // Sums of a blob that is still being scanned.
+    struct SAccumulator
+    {
+        uint64_t area;
+        double m10;
+        double m01;
+        double m20;
+        double m11;
+        double m02;
+        double intensity;
+        double intensityX;
+        double intensityY;
+        int left;
+        int top;
+        int right;
+        int bottom;
+        int lastRow;            // Last row containing a run of the blob.
+        uint64_t cornerQuads;   // 2x2 patterns with one or three foreground pixels.
+        uint64_t edgeQuads;     // 2x2 patterns with two adjacent foreground pixels.
+        uint64_t diagonalQuads; // 2x2 patterns with two diagonal foreground pixels.
+        bool open;              // Touches the seam to another band.
+        bool emitted;
+    };
+
+    void BeginBand( int width, int firstRow, bool topIsSeam, bool bottomIsSeam, const SRleBlobFilter& filter, std::vector<SRleBlob>& blobs)
+    {
+        m_width = width;
+        m_row = firstRow;
+        m_firstRow = firstRow;
+        m_topIsSeam = topIsSeam;
+        m_bottomIsSeam = bottomIsSeam;
+        m_filter = filter;
+        m_pBlobs = &blobs;
+        m_pBlobs->clear();
+        m_parents.clear();
+        m_accumulators.clear();
+        m_previousRuns.clear();
+        m_firstRowRuns.clear();
+    }
+
+    // Labels the runs of row y. A run is connected to all runs of the previous row it overlaps or touches diagonally.
+    // If createLabels is false, the runs are labeled already and only the connections are added.
+    void ConnectRuns( std::vector<SLabeledRun>& runs, int y, bool createLabels)
+    {
+        size_t first = 0;
+        for ( size_t i = 0; i < runs.size(); ++i)
+        {
+            SLabeledRun& run = runs[i];
+            while ( first < m_previousRuns.size() && m_previousRuns[first].end < run.start)
+            {
+                ++first;
+            }
+
+            uint32_t root = createLabels ? c_noLabel : Find( run.label);
+            for ( size_t k = first; k < m_previousRuns.size() && m_previousRuns[k].start <= run.end; ++k)
+            {
+                root = (root == c_noLabel) ? Find( m_previousRuns[k].label) : Union( root, m_previousRuns[k].label);
+            }
+
+            if ( createLabels)
+            {
+                if ( root == c_noLabel)
+                {
+                    root = CreateLabel( y);
+                }
+                run.label = root;
+                AccumulateRun( m_accumulators[root], run.start, run.end, y);
+            }
+        }
+    }
+
+    static void CopyRuns( const std::vector<SLabeledRun>& source, uint32_t labelOffset, std::vector<SLabeledRun>& destination)
+    {
+        destination = source;
+        for ( size_t i = 0; i < destination.size(); ++i)
+        {
+            destination[i].label += labelOffset;
+        }
+    }
+
+    static uint64_t LoadWord( const uint8_t* p)
+    {
+        uint64_t word;
+        memcpy( &word, p, sizeof( word));
+        return word;
+    }
+
+    uint32_t CreateLabel( int y)
+    {
+        const uint32_t label = static_cast<uint32_t>(m_parents.size());
+        m_parents.push_back( label);
+
+        SAccumulator accumulator;
+        memset( &accumulator, 0, sizeof( accumulator));
+        accumulator.left = m_width;
+        accumulator.top = y;
+        accumulator.right = -1;
+        accumulator.bottom = -1;
+        accumulator.lastRow = -1;
+        accumulator.open = (y == m_firstRow && m_topIsSeam);
+        m_accumulators.push_back( accumulator);
+        return label;
+    }
+
+    uint32_t Find( uint32_t label)
+    {
+        while ( m_parents[label] != label)
+        {
+            m_parents[label] = m_parents[m_parents[label]];
+            label = m_parents[label];
+        }
+        return label;
+    }
+
+    // Merges the blob of label into the blob with the given root. Returns the root of the merged blob.
+    uint32_t Union( uint32_t root, uint32_t label)
+    {
+        uint32_t other = Find( label);
+        if ( other == root)
+        {
+            return root;
+        }
+
+        // The older label stays the root.
+        if ( other < root)
+        {
+            const uint32_t temp = root;
+            root = other;
+            other = temp;
+        }
+        m_parents[other] = root;
+
+        SAccumulator& target = m_accumulators[root];
+        const SAccumulator& source = m_accumulators[other];
+        target.area += source.area;
+        target.m10 += source.m10;
+        target.m01 += source.m01;
+        target.m20 += source.m20;
+        target.m11 += source.m11;
+        target.m02 += source.m02;
+        target.intensity += source.intensity;
+        target.intensityX += source.intensityX;
+        target.intensityY += source.intensityY;
+        target.left = source.left < target.left ? source.left : target.left;
+        target.top = source.top < target.top ? source.top : target.top;
+        target.right = source.right > target.right ? source.right : target.right;
+        target.bottom = source.bottom > target.bottom ? source.bottom : target.bottom;
+        target.lastRow = source.lastRow > target.lastRow ? source.lastRow : target.lastRow;
+        target.cornerQuads += source.cornerQuads;
+        target.edgeQuads += source.edgeQuads;
+        target.diagonalQuads += source.diagonalQuads;
+        target.open = target.open || source.open;
+        return root;
+    }
+
+    static void AccumulateRun( SAccumulator& accumulator, int start, int end, int y)
+    {
+        // Closed forms of the sums over x and x^2 for x = start ... end - 1.
+        const double n = end - start;
+        const double last = end - 1;
+        const double beforeFirst = start - 1;
+        const double sumX = n * (start + last) / 2;
+        const double sumX2 = (last * (last + 1) * (2 * last + 1) - beforeFirst * (beforeFirst + 1) * (2 * beforeFirst + 1)) / 6;
+
+        accumulator.area += end - start;
+        accumulator.m10 += sumX;
+        accumulator.m01 += n * y;
+        accumulator.m20 += sumX2;
+        accumulator.m11 += sumX * y;
+        accumulator.m02 += n * y * y;
+        accumulator.left = start < accumulator.left ? start : accumulator.left;
+        accumulator.right = end - 1 > accumulator.right ? end - 1 : accumulator.right;
+        accumulator.bottom = y;
+        accumulator.lastRow = y;
+    }
+
+    // Counts the 2x2 patterns between two rows that contain foreground pixels of at least one row.
+    // The pattern of the quads only changes where a run of either row starts or ends,
+    // all quads in between see the same two pixels left and right.
+    void CountQuads( const std::vector<SLabeledRun>& upper, const std::vector<SLabeledRun>& lower)
+    {
+        const int c_none = 0x7FFFFFFF;
+        size_t upperIndex = 0;
+        size_t lowerIndex = 0;
+        bool inUpper = false;
+        bool inLower = false;
+        const SLabeledRun* pSegmentUpper = NULL;
+        const SLabeledRun* pSegmentLower = NULL;
+        int segmentStart = 0;
+
+        for (;;)
+        {
+            const int nextUpper = upperIndex < upper.size() ? (inUpper ? upper[upperIndex].end : upper[upperIndex].start) : c_none;
+            const int nextLower = lowerIndex < lower.size() ? (inLower ? lower[lowerIndex].end : lower[lowerIndex].start) : c_none;
+            const int x = nextUpper < nextLower ? nextUpper : nextLower;
+            if ( x == c_none)
+            {
+                break;
+            }
+
+            // Quads inside the segment ending at x. Only one row covered means a horizontal edge.
+            if ( (pSegmentUpper != NULL) != (pSegmentLower != NULL))
+            {
+                const uint32_t root = Find( pSegmentUpper != NULL ? pSegmentUpper->label : pSegmentLower->label);
+                m_accumulators[root].edgeQuads += x - segmentStart - 1;
+            }
+
+            const SLabeledRun* pLeftUpper = pSegmentUpper;
+            const SLabeledRun* pLeftLower = pSegmentLower;
+            if ( nextUpper == x)
+            {
+                upperIndex += inUpper ? 1 : 0;
+                inUpper = !inUpper;
+            }
+            if ( nextLower == x)
+            {
+                lowerIndex += inLower ? 1 : 0;
+                inLower = !inLower;
+            }
+            pSegmentUpper = inUpper ? &upper[upperIndex] : NULL;
+            pSegmentLower = inLower ? &lower[lowerIndex] : NULL;
+
+            // The quad straddling x.
+            CountQuad( pLeftUpper, pSegmentUpper, pLeftLower, pSegmentLower);
+            segmentStart = x;
+        }
+    }
+
+    void CountQuad( const SLabeledRun* pA, const SLabeledRun* pB, const SLabeledRun* pC, const SLabeledRun* pD)
+    {
+        // a b
+        // c d
+        const SLabeledRun* pAny = pA != NULL ? pA : (pB != NULL ? pB : (pC != NULL ? pC : pD));
+        const int count = (pA != NULL) + (pB != NULL) + (pC != NULL) + (pD != NULL);
+        if ( count == 0 || count == 4)
+        {
+            return;
+        }
+
+        // All foreground pixels of a quad are 8-connected and belong to the same blob.
+        SAccumulator& accumulator = m_accumulators[Find( pAny->label)];
+        if ( count != 2)
+        {
+            ++accumulator.cornerQuads;
+        }
+        else if ( (pA != NULL && pD != NULL) || (pB != NULL && pC != NULL))
+        {
+            ++accumulator.diagonalQuads;
+        }
+        else
+        {
+            ++accumulator.edgeQuads;
+        }
+    }
+
+    void Emit( uint32_t root)
+    {
+        SAccumulator& accumulator = m_accumulators[root];
+        if ( accumulator.emitted || accumulator.open)
+        {
+            return;
+        }
+        accumulator.emitted = true;
+
+        if ( accumulator.area < m_filter.minArea
+            || accumulator.right - accumulator.left + 1 < m_filter.minWidth
+            || accumulator.bottom - accumulator.top + 1 < m_filter.minHeight)
+        {
+            return;
+        }
+
+        // Perimeter estimate by Duda: edges count 1, corners and diagonals count 1/sqrt(2) per pixel pair.
+        const double c_inverseSqrt2 = 0.70710678118654752;
+        SRleBlob blob;
+        blob.area = accumulator.area;
+        blob.perimeter = accumulator.edgeQuads + (accumulator.cornerQuads + 2.0 * accumulator.diagonalQuads) * c_inverseSqrt2;
+        blob.left = accumulator.left;
+        blob.top = accumulator.top;
+        blob.right = accumulator.right;
+        blob.bottom = accumulator.bottom;
+        blob.centroidX = accumulator.m10 / accumulator.area;
+        blob.centroidY = accumulator.m01 / accumulator.area;
+        blob.m10 = accumulator.m10;
+        blob.m01 = accumulator.m01;
+        blob.m20 = accumulator.m20;
+        blob.m11 = accumulator.m11;
+        blob.m02 = accumulator.m02;
+        blob.intensity = accumulator.intensity;
+        blob.weightedCentroidX = (accumulator.intensity > 0) ? accumulator.intensityX / accumulator.intensity : blob.centroidX;
+        blob.weightedCentroidY = (accumulator.intensity > 0) ? accumulator.intensityY / accumulator.intensity : blob.centroidY;
+        m_pBlobs->push_back( blob);
+    }
+
+    // Not copyable.
+    CRleBlobAnalyzer( const CRleBlobAnalyzer&);
+    CRleBlobAnalyzer& operator=( const CRleBlobAnalyzer&);
+
+    // All vectors keep their capacity from frame to frame.
+    int m_width;
+    int m_row;
+    int m_firstRow;
+    bool m_topIsSeam;
+    bool m_bottomIsSeam;
+    SRleBlobFilter m_filter;
+    std::vector<SRleBlob>* m_pBlobs;
+    std::vector<SRleRun> m_rowRuns;
+    std::vector<SLabeledRun> m_previousRuns;
+    std::vector<SLabeledRun> m_currentRuns;
+    std::vector<SLabeledRun> m_firstRowRuns;    // Kept if the top of the band is a seam.
+    std::vector<uint32_t> m_bandOffsets;        // Used by MergeBands() only.
+    std::vector<uint32_t> m_parents;
+    std::vector<SAccumulator> m_accumulators;
+};
+
+#endif /* INCLUDED_RLEBLOBANALYZER_H_5520931 */
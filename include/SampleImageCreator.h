@@ -1,4 +1,7 @@
 // Contains functions for creating sample images.
+// The fractals are computed for several pixels at once using AVX or SSE2 if available, and the rows are distributed
+// over all hardware threads. Mono8, Mono16, RGB8, BGR8 and 8 or 16 bit Bayer images are written directly,
+// other pixel types are converted from RGB8 using CImageFormatConverter.
 
 #ifndef INCLUDED_SAMPLEIMAGECREATOR_H_2792867
 #define INCLUDED_SAMPLEIMAGECREATOR_H_2792867
@@ -7,157 +10,387 @@
 #include <pylon/Pixel.h>
 #include <pylon/ImageFormatConverter.h>
 
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX__)
+#   include <immintrin.h>
+#   define SAMPLEIMAGECREATOR_USE_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define SAMPLEIMAGECREATOR_USE_SSE2
+#endif
+
 namespace SampleImageCreator
 {
-    Pylon::CPylonImage CreateJuliaFractal( Pylon::EPixelType pixelType, uint32_t width, uint32_t height)
+    namespace Detail
     {
-        // Allow all the names in the namespace Pylon to be used without qualification.
-        using namespace Pylon;
+        // Maximum number of iterations. Points that haven't escaped after this are considered inside the set.
+        static const uint32_t c_maxIterations = 50;
 
-        // Define Constants.
-        static const SRGB8Pixel palette[]=
-        {
-            {0, 28, 50}, {0, 42, 75}, {0, 56, 100}, {0, 70, 125}, {0, 84, 150},
-            {0, 50, 0}, {0, 100, 0}, {0, 150, 0}, {0, 200, 0}, {0, 250, 0},
-            {50, 0, 0}, {100, 0, 0}, {150, 0, 0}, {200, 0, 0}, {250, 0, 0}
-        };
-        uint32_t numColors = sizeof( palette) / sizeof( palette[0]);
+        // Number of rows a thread computes at once.
+        static const uint32_t c_rowsPerTask = 8;
 
-        const double cX = -0.735;
-        const double cY = 0.11;
-        const double cMaxX = 1.6;
-        const double cMinX = -1.6;
-        const double cMaxY = 1;
-        const double cMinY = -1;
-        const uint32_t cMaxIterations = 50;
+        // Images with fewer pixels are computed by the calling thread only.
+        static const uint64_t c_minParallelPixels = 64 * 1024;
 
-        // Create image.
-        CPylonImage juliaFractal( CPylonImage::Create( PixelType_RGB8packed, width, height));
+        // Iterates z = z * z + c. For a Julia fractal, z starts at the pixel and c is constant.
+        // For a Mandelbrot fractal, z and c start at the pixel.
+        struct SFractal
+        {
+            double minX;
+            double maxX;
+            double minY;
+            double maxY;
+            bool isJulia;
+            double cX;
+            double cY;
+        };
 
-        // Get the pointer to the first pixel.
-        SRGB8Pixel* pCurrentPixel = (SRGB8Pixel*) juliaFractal.GetBuffer();
+        inline const Pylon::SRGB8Pixel* GetPalette( uint32_t& numColors)
+        {
+            static const Pylon::SRGB8Pixel palette[]=
+            {
+                {0, 28, 50}, {0, 42, 75}, {0, 56, 100}, {0, 70, 125}, {0, 84, 150},
+                {0, 50, 0}, {0, 100, 0}, {0, 150, 0}, {0, 200, 0}, {0, 250, 0},
+                {50, 0, 0}, {100, 0, 0}, {150, 0, 0}, {200, 0, 0}, {250, 0, 0}
+            };
+            numColors = sizeof( palette) / sizeof( palette[0]);
+            return palette;
+        }
 
-        // Compute the fractal.
-        for ( uint32_t pixelY = 0; pixelY < height; ++pixelY )
+        // Returns the number of iterations until the point escapes the circle of radius 2.
+        inline uint32_t Iterate( const SFractal& fractal, double x, double y)
         {
-            for ( uint32_t pixelX = 0; pixelX < width; ++pixelX, ++pCurrentPixel )
+            const double cX = fractal.isJulia ? fractal.cX : x;
+            const double cY = fractal.isJulia ? fractal.cY : y;
+            uint32_t i = 0;
+            for ( ; i < c_maxIterations; ++i)
             {
-                long double x = ((cMaxX-cMinX) / width) * pixelX + cMinX;
-                long double y = cMaxY - pixelY * ((cMaxY-cMinY) / height);
-                long double xd = 0;
-                long double yd = 0;
-                uint32_t i = 0;
+                const double xd = x * x - y * y + cX;
+                const double yd = 2 * x * y + cY;
+                x = xd;
+                y = yd;
+                if ( (x * x + y * y) > 4)
+                {
+                    break;
+                }
+            }
+            return i;
+        }
 
-                for(; i < cMaxIterations; ++i)
+        // Computes the number of iterations of each pixel of a row.
+        inline void ComputeRow( const SFractal& fractal, uint32_t width, uint32_t height, uint32_t pixelY, uint8_t* pIterations)
+        {
+            const double stepX = (fractal.maxX - fractal.minX) / width;
+            const double y = fractal.maxY - pixelY * ((fractal.maxY - fractal.minY) / height);
+            uint32_t pixelX = 0;
+
+#if defined(SAMPLEIMAGECREATOR_USE_AVX)
+            // Lanes that have escaped keep iterating until all have escaped, but their count isn't increased anymore.
+            const __m256d four = _mm256_set1_pd( 4);
+            const __m256d one = _mm256_set1_pd( 1);
+            const __m256d vY = _mm256_set1_pd( y);
+            for ( ; pixelX + 4 <= width; pixelX += 4)
+            {
+                const __m256d vX = _mm256_add_pd( _mm256_mul_pd( _mm256_set_pd( pixelX + 3, pixelX + 2, pixelX + 1, pixelX),
+                    _mm256_set1_pd( stepX)), _mm256_set1_pd( fractal.minX));
+                const __m256d cX = fractal.isJulia ? _mm256_set1_pd( fractal.cX) : vX;
+                const __m256d cY = fractal.isJulia ? _mm256_set1_pd( fractal.cY) : vY;
+                __m256d zX = vX;
+                __m256d zY = vY;
+                __m256d active = _mm256_castsi256_pd( _mm256_set1_epi32( -1));
+                __m256d count = _mm256_setzero_pd();
+                for ( uint32_t i = 0; i < c_maxIterations; ++i)
                 {
-                    xd = x * x - y * y + cX;
-                    yd = 2 *x * y + cY;
-                    x = xd;
-                    y = yd;
-                    if ( (x * x + y * y) > 4 )
+                    const __m256d xy = _mm256_mul_pd( zX, zY);
+                    zX = _mm256_add_pd( _mm256_sub_pd( _mm256_mul_pd( zX, zX), _mm256_mul_pd( zY, zY)), cX);
+                    zY = _mm256_add_pd( _mm256_add_pd( xy, xy), cY);
+                    const __m256d magnitude = _mm256_add_pd( _mm256_mul_pd( zX, zX), _mm256_mul_pd( zY, zY));
+                    active = _mm256_andnot_pd( _mm256_cmp_pd( magnitude, four, _CMP_GT_OQ), active);
+                    if ( _mm256_movemask_pd( active) == 0)
                     {
                         break;
                     }
+                    count = _mm256_add_pd( count, _mm256_and_pd( active, one));
                 }
-
-                if ( i >= cMaxIterations)
-                {
-                    *pCurrentPixel = palette[0];
-                }
-                else
+                const __m128i counts = _mm256_cvtpd_epi32( count);
+                pIterations[pixelX] = static_cast<uint8_t>(_mm_cvtsi128_si32( counts));
+                pIterations[pixelX + 1] = static_cast<uint8_t>(_mm_cvtsi128_si32( _mm_srli_si128( counts, 4)));
+                pIterations[pixelX + 2] = static_cast<uint8_t>(_mm_cvtsi128_si32( _mm_srli_si128( counts, 8)));
+                pIterations[pixelX + 3] = static_cast<uint8_t>(_mm_cvtsi128_si32( _mm_srli_si128( counts, 12)));
+            }
+#elif defined(SAMPLEIMAGECREATOR_USE_SSE2)
+            const __m128d four = _mm_set1_pd( 4);
+            const __m128d one = _mm_set1_pd( 1);
+            const __m128d vY = _mm_set1_pd( y);
+            for ( ; pixelX + 2 <= width; pixelX += 2)
+            {
+                const __m128d vX = _mm_add_pd( _mm_mul_pd( _mm_set_pd( pixelX + 1, pixelX), _mm_set1_pd( stepX)), _mm_set1_pd( fractal.minX));
+                const __m128d cX = fractal.isJulia ? _mm_set1_pd( fractal.cX) : vX;
+                const __m128d cY = fractal.isJulia ? _mm_set1_pd( fractal.cY) : vY;
+                __m128d zX = vX;
+                __m128d zY = vY;
+                __m128d active = _mm_castsi128_pd( _mm_set1_epi32( -1));
+                __m128d count = _mm_setzero_pd();
+                for ( uint32_t i = 0; i < c_maxIterations; ++i)
                 {
-                    *pCurrentPixel = palette[ i % numColors ];
+                    const __m128d xy = _mm_mul_pd( zX, zY);
+                    zX = _mm_add_pd( _mm_sub_pd( _mm_mul_pd( zX, zX), _mm_mul_pd( zY, zY)), cX);
+                    zY = _mm_add_pd( _mm_add_pd( xy, xy), cY);
+                    const __m128d magnitude = _mm_add_pd( _mm_mul_pd( zX, zX), _mm_mul_pd( zY, zY));
+                    active = _mm_andnot_pd( _mm_cmpgt_pd( magnitude, four), active);
+                    if ( _mm_movemask_pd( active) == 0)
+                    {
+                        break;
+                    }
+                    count = _mm_add_pd( count, _mm_and_pd( active, one));
                 }
+                const __m128i counts = _mm_cvtpd_epi32( count);
+                pIterations[pixelX] = static_cast<uint8_t>(_mm_cvtsi128_si32( counts));
+                pIterations[pixelX + 1] = static_cast<uint8_t>(_mm_cvtsi128_si32( _mm_srli_si128( counts, 4)));
             }
-        }
+#endif
 
-        // Convert the image to the target format if needed.
-        if ( juliaFractal.GetPixelType() != pixelType)
-        {
-            CImageFormatConverter converter;
-            converter.OutputPixelFormat = pixelType;
-            converter.OutputBitAlignment = OutputBitAlignment_MsbAligned;
-            converter.Convert( juliaFractal, CPylonImage( juliaFractal));
+            for ( ; pixelX < width; ++pixelX)
+            {
+                pIterations[pixelX] = static_cast<uint8_t>(Iterate( fractal, stepX * pixelX + fractal.minX, y));
+            }
         }
 
-        // Return the image.
-        return juliaFractal;
-    }
+        // Writes a row of the target pixel type. The colors of all iteration counts are looked up in tables
+        // prepared once per image.
+        class CRowWriter
+        {
+        public:
+            // Returns false if the pixel type isn't written directly.
+            bool Init( Pylon::EPixelType pixelType)
+            {
+                using namespace Pylon;
 
+                m_pixelType = pixelType;
+                switch ( pixelType)
+                {
+                case PixelType_Mono8:
+                case PixelType_Mono16:
+                case PixelType_RGB8packed:
+                case PixelType_BGR8packed:
+                    break;
+                // Channel of the pixels at (even x, even y), (odd x, even y), (even x, odd y), (odd x, odd y). R = 0, G = 1, B = 2.
+                case PixelType_BayerRG8:
+                case PixelType_BayerRG16:
+                    SetBayerPattern( 0, 1, 1, 2);
+                    break;
+                case PixelType_BayerGR8:
+                case PixelType_BayerGR16:
+                    SetBayerPattern( 1, 0, 2, 1);
+                    break;
+                case PixelType_BayerGB8:
+                case PixelType_BayerGB16:
+                    SetBayerPattern( 1, 2, 0, 1);
+                    break;
+                case PixelType_BayerBG8:
+                case PixelType_BayerBG16:
+                    SetBayerPattern( 2, 1, 1, 0);
+                    break;
+                default:
+                    return false;
+                }
 
-    Pylon::CPylonImage CreateMandelbrotFractal( Pylon::EPixelType pixelType, uint32_t width, uint32_t height)
-    {
-        // Allow all the names in the namespace Pylon to be used without qualification.
-        using namespace Pylon;
+                uint32_t numColors = 0;
+                const SRGB8Pixel* palette = GetPalette( numColors);
+                for ( uint32_t i = 0; i <= c_maxIterations; ++i)
+                {
+                    const SRGB8Pixel& color = (i >= c_maxIterations) ? palette[0] : palette[ i % numColors ];
+                    m_colors[i][0] = color.R;
+                    m_colors[i][1] = color.G;
+                    m_colors[i][2] = color.B;
+                    // ITU-R BT.601 luma.
+                    m_gray[i] = static_cast<uint8_t>((77 * color.R + 150 * color.G + 29 * color.B + 128) >> 8);
+                }
+                return true;
+            }
 
-        // Define constants.
-        static const SRGB8Pixel palette[]=
-        {
-            {0, 28, 50}, {0, 42, 75}, {0, 56, 100}, {0, 70, 125}, {0, 84, 150},
-            {0, 50, 0}, {0, 100, 0}, {0, 150, 0}, {0, 200, 0}, {0, 250, 0},
-            {50, 0, 0}, {100, 0, 0}, {150, 0, 0}, {200, 0, 0}, {250, 0, 0}
-        };
-        uint32_t numColors = sizeof( palette) / sizeof( palette[0]);
+            void Write( const uint8_t* pIterations, uint32_t width, uint32_t pixelY, uint8_t* pRow) const
+            {
+                using namespace Pylon;
 
-        const double  cMaxX = 1.0;
-        const double  cMinX = -2.0;
-        const double  cMaxY = 1.2;
-        const double  cMinY = -1.2;
-        const uint32_t cMaxIterations = 50;
+                switch ( m_pixelType)
+                {
+                case PixelType_Mono8:
+                    for ( uint32_t x = 0; x < width; ++x)
+                    {
+                        pRow[x] = m_gray[pIterations[x]];
+                    }
+                    break;
+                case PixelType_Mono16:
+                    // MSB aligned like the output of CImageFormatConverter.
+                    for ( uint32_t x = 0; x < width; ++x)
+                    {
+                        reinterpret_cast<uint16_t*>(pRow)[x] = static_cast<uint16_t>(m_gray[pIterations[x]] << 8);
+                    }
+                    break;
+                case PixelType_RGB8packed:
+                case PixelType_BGR8packed:
+                    {
+                        const int first = (m_pixelType == PixelType_RGB8packed) ? 0 : 2;
+                        for ( uint32_t x = 0; x < width; ++x, pRow += 3)
+                        {
+                            const uint8_t* pColor = m_colors[pIterations[x]];
+                            pRow[0] = pColor[first];
+                            pRow[1] = pColor[1];
+                            pRow[2] = pColor[2 - first];
+                        }
+                    }
+                    break;
+                default:
+                    {
+                        const int* pChannels = &m_bayerChannels[(pixelY & 1) * 2];
+                        const bool is16Bit = BitPerPixel( m_pixelType) == 16;
+                        for ( uint32_t x = 0; x < width; ++x)
+                        {
+                            const uint8_t value = m_colors[pIterations[x]][pChannels[x & 1]];
+                            if ( is16Bit)
+                            {
+                                reinterpret_cast<uint16_t*>(pRow)[x] = static_cast<uint16_t>(value << 8);
+                            }
+                            else
+                            {
+                                pRow[x] = value;
+                            }
+                        }
+                    }
+                    break;
+                }
+            }
 
-        // Create image.
-        CPylonImage mandelbrotFractal( CPylonImage::Create( PixelType_RGB8packed, width, height));
+        private:
+            void SetBayerPattern( int evenEven, int oddEven, int evenOdd, int oddOdd)
+            {
+                m_bayerChannels[0] = evenEven;
+                m_bayerChannels[1] = oddEven;
+                m_bayerChannels[2] = evenOdd;
+                m_bayerChannels[3] = oddOdd;
+            }
 
-        // Get the pointer to the first pixel.
-        SRGB8Pixel* pCurrentPixel = (SRGB8Pixel*) mandelbrotFractal.GetBuffer();
+            Pylon::EPixelType m_pixelType;
+            int m_bayerChannels[4];
+            uint8_t m_colors[c_maxIterations + 1][3];
+            uint8_t m_gray[c_maxIterations + 1];
+        };
 
-        // Compute the fractal.
-        for ( uint32_t pixelY = 0; pixelY < height; ++pixelY )
+        // Computes the rows of the image on all hardware threads.
+        inline void Render( const SFractal& fractal, const CRowWriter& writer, Pylon::CPylonImage& image)
         {
-            for ( uint32_t pixelX = 0; pixelX < width; ++pixelX, ++pCurrentPixel )
+            const uint32_t width = image.GetWidth();
+            const uint32_t height = image.GetHeight();
+            size_t stride = 0;
+            image.GetStride( stride);
+            uint8_t* pBuffer = static_cast<uint8_t*>(image.GetBuffer());
+
+            std::atomic<uint32_t> nextRow( 0);
+            auto computeRows = [&]()
             {
-                long double xStart = ((cMaxX-cMinX) / width) * pixelX + cMinX;
-                long double yStart = cMaxY - pixelY * ((cMaxY-cMinY) / height);
-                long double x = xStart;
-                long double y = yStart;
-                long double xd =0;
-                long double yd =0;
-                uint32_t i = 0;
-
-                for(; i < cMaxIterations; ++i)
+                std::vector<uint8_t> iterations( width);
+                for ( uint32_t firstRow = nextRow.fetch_add( c_rowsPerTask); firstRow < height; firstRow = nextRow.fetch_add( c_rowsPerTask))
                 {
-                    xd = x * x - y * y + xStart;
-                    yd = 2 *x * y + yStart;
-                    x = xd;
-                    y = yd;
-                    if ( (x * x + y * y) > 4 )
+                    const uint32_t endRow = (height - firstRow < c_rowsPerTask) ? height : firstRow + c_rowsPerTask;
+                    for ( uint32_t pixelY = firstRow; pixelY < endRow; ++pixelY)
                     {
-                        break;
+                        ComputeRow( fractal, width, height, pixelY, iterations.data());
+                        writer.Write( iterations.data(), width, pixelY, pBuffer + pixelY * stride);
                     }
                 }
+            };
 
-                if ( i >= cMaxIterations)
-                {
-                    *pCurrentPixel = palette[0];
-                }
-                else
-                {
-                    *pCurrentPixel = palette[ i % numColors ];
-                }
+            size_t threadCount = std::thread::hardware_concurrency();
+            if ( static_cast<uint64_t>(width) * height < c_minParallelPixels)
+            {
+                threadCount = 1;
+            }
+            std::vector<std::thread> threads;
+            for ( size_t i = 1; i < threadCount; ++i)
+            {
+                threads.push_back( std::thread( computeRows));
+            }
+            computeRows();
+            for ( size_t i = 0; i < threads.size(); ++i)
+            {
+                threads[i].join();
             }
         }
 
-        // Convert the image to the target format if needed.
-        if ( mandelbrotFractal.GetPixelType() != pixelType)
+        inline Pylon::CPylonImage CreateFractal( const SFractal& fractal, Pylon::EPixelType pixelType, uint32_t width, uint32_t height)
         {
+            // Allow all the names in the namespace Pylon to be used without qualification.
+            using namespace Pylon;
+
+            CRowWriter writer;
+            if ( writer.Init( pixelType))
+            {
+                CPylonImage image( CPylonImage::Create( pixelType, width, height));
+                Render( fractal, writer, image);
+                return image;
+            }
+
+            // Compute an RGB8 image and convert it to the target format.
+            writer.Init( PixelType_RGB8packed);
+            CPylonImage image( CPylonImage::Create( PixelType_RGB8packed, width, height));
+            Render( fractal, writer, image);
             CImageFormatConverter converter;
             converter.OutputPixelFormat = pixelType;
             converter.OutputBitAlignment = OutputBitAlignment_MsbAligned;
-            converter.Convert( mandelbrotFractal, CPylonImage( mandelbrotFractal));
+            converter.Convert( image, CPylonImage( image));
+            return image;
         }
+    }
 
-        // Return the image.
-        return mandelbrotFractal;
+
+    inline Pylon::CPylonImage CreateJuliaFractal( Pylon::EPixelType pixelType, uint32_t width, uint32_t height)
+    {
+        Detail::SFractal fractal;
+        fractal.minX = -1.6;
+        fractal.maxX = 1.6;
+        fractal.minY = -1;
+        fractal.maxY = 1;
+        fractal.isJulia = true;
+        fractal.cX = -0.735;
+        fractal.cY = 0.11;
+        return Detail::CreateFractal( fractal, pixelType, width, height);
+    }
+
+
+    inline Pylon::CPylonImage CreateMandelbrotFractal( Pylon::EPixelType pixelType, uint32_t width, uint32_t height)
+    {
+        Detail::SFractal fractal;
+        fractal.minX = -2.0;
+        fractal.maxX = 1.0;
+        fractal.minY = -1.2;
+        fractal.maxY = 1.2;
+        fractal.isJulia = false;
+        fractal.cX = 0;
+        fractal.cY = 0;
+        return Detail::CreateFractal( fractal, pixelType, width, height);
+    }
+
+
+    // Mandelbrot fractal magnified zoom times around a point on the border of the set. Images with slightly different
+    // zoom factors can be used as a sequence of frames.
+    inline Pylon::CPylonImage CreateMandelbrotFractal( Pylon::EPixelType pixelType, uint32_t width, uint32_t height, double zoom)
+    {
+        const double centerX = -0.743643;
+        const double centerY = 0.131825;
+        Detail::SFractal fractal;
+        fractal.minX = centerX - 1.5 / zoom;
+        fractal.maxX = centerX + 1.5 / zoom;
+        fractal.minY = centerY - 1.2 / zoom;
+        fractal.maxY = centerY + 1.2 / zoom;
+        fractal.isJulia = false;
+        fractal.cX = 0;
+        fractal.cY = 0;
+        return Detail::CreateFractal( fractal, pixelType, width, height);
     }
 
 }
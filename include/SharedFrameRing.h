@@ -0,0 +1,373 @@
+// Contains the layout of a named shared memory segment passing grab buffers between processes without copying.
+//
+// The segment holds a header, a ring of frame records, one state per buffer slot and the buffer slots.
+// The acquisition process grabs directly into the slots (see SharedMemoryBufferFactory.h) and publishes a
+// record for every frame. Consumer processes map the same segment using CSharedFrameConsumer, take records
+// from the ring, read the image in place and release the slot, which returns the buffer to the Instant Camera
+// of the acquisition process. Every frame is received by one consumer, so several consumers share the load.
+//
+// The ring is a bounded lock-free queue with one producer and several consumers. Each cell carries a sequence
+// number telling whether it is free or holds a record of the current lap. When the producer has published its
+// last frame, it sets the closed flag of the header, so consumers can stop once the ring is empty.
+// Doesn't need pylon.
+
+#ifndef INCLUDED_SHAREDFRAMERING_H_4419268
+#define INCLUDED_SHAREDFRAMERING_H_4419268
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#if ATOMIC_LLONG_LOCK_FREE != 2 || ATOMIC_INT_LOCK_FREE != 2
+#   error "The shared frame ring needs lock-free atomics for sharing them between processes."
+#endif
+
+// The metadata of a grabbed frame. The layout is fixed.
+struct SSharedFrameRecord
+{
+    uint32_t slot;              // The buffer slot holding the image.
+    uint32_t pixelType;         // Pylon::EPixelType
+    int64_t bufferContext;      // The buffer context of the grab result.
+    uint64_t blockId;
+    uint64_t timestamp;         // Camera time stamp.
+    uint64_t publishTime;       // Time the frame has been published in ns, steady clock. Comparable between processes of a host.
+    uint64_t payloadSize;       // Bytes of image data at the start of the slot.
+    uint32_t width;
+    uint32_t height;
+    uint32_t offsetX;
+    uint32_t paddingX;
+};
+
+static_assert( sizeof( SSharedFrameRecord) == 64, "The layout of SSharedFrameRecord must not change.");
+
+
+// A cell of the ring. Cell i is free for the record with number n if sequence == n and
+// holds it if sequence == n + 1, where n % capacity == i.
+struct SSharedFrameCell
+{
+    std::atomic<uint64_t> sequence;
+    uint8_t padding[56];
+    SSharedFrameRecord record;
+};
+
+static_assert( sizeof( SSharedFrameCell) == 128, "The layout of SSharedFrameCell must not change.");
+
+
+// States of a buffer slot.
+enum ESharedFrameSlotState
+{
+    SharedFrameSlotState_Grabbing = 0,  // Owned by the Instant Camera.
+    SharedFrameSlotState_Published = 1, // Published, not yet released by a consumer.
+    SharedFrameSlotState_Released = 2   // Released by a consumer, to be returned to the Instant Camera.
+};
+
+
+// Header at the start of the segment. Records, slot states and slots follow at the given offsets.
+struct SSharedFrameSegmentHeader
+{
+    char magic[8];                          // c_sharedFrameMagic, written last when the segment is created.
+    uint32_t version;
+    uint32_t slotCount;
+    uint64_t slotSize;                      // Aligned to 4096 bytes.
+    uint64_t ringCapacity;                  // Power of two.
+    uint64_t ringOffset;
+    uint64_t slotStateOffset;
+    uint64_t slotOffset;
+    uint64_t segmentSize;
+    std::atomic<uint32_t> isClosed;         // Set to 1 by the producer after publishing its last frame.
+    uint8_t padding1[60];
+    std::atomic<uint64_t> writeCount;       // Records published, written by the producer only.
+    uint8_t padding2[56];
+    std::atomic<uint64_t> readCount;        // Records taken, advanced by the consumers.
+    uint8_t padding3[56];
+};
+
+static const char c_sharedFrameMagic[8] = { 'S', 'H', 'M', 'F', 'R', 'A', 'M', 'E' };
+static const uint32_t c_sharedFrameVersion = 1;
+
+static_assert( sizeof( SSharedFrameSegmentHeader) == 256, "The layout of SSharedFrameSegmentHeader must not change.");
+
+
+// A named shared memory segment. The name should start with a slash, e.g. "/camera0".
+class CSharedMemorySegment
+{
+public:
+    CSharedMemorySegment()
+        : m_pData( NULL)
+        , m_size( 0)
+        , m_isOwner( false)
+#if defined(_WIN32)
+        , m_mapping( NULL)
+#endif
+    {
+    }
+
+    ~CSharedMemorySegment()
+    {
+        Close();
+    }
+
+    // Creates the segment, replacing a segment of the same name. The memory is zeroed.
+    bool Create( const std::string& name, size_t size)
+    {
+        Close();
+#if defined(_WIN32)
+        const uint64_t mappingSize = size;
+        m_mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+            static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize & 0xFFFFFFFF), GetWindowsName( name).c_str());
+        if ( m_mapping == NULL)
+        {
+            return false;
+        }
+        m_pData = static_cast<uint8_t*>(MapViewOfFile( m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+#else
+        shm_unlink( name.c_str());
+        const int file = shm_open( name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if ( file < 0)
+        {
+            return false;
+        }
+        void* pData = MAP_FAILED;
+        if ( ftruncate( file, static_cast<off_t>(size)) == 0)
+        {
+            pData = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        }
+        close( file);
+        if ( pData == MAP_FAILED)
+        {
+            shm_unlink( name.c_str());
+            return false;
+        }
+        m_pData = static_cast<uint8_t*>(pData);
+#endif
+        if ( m_pData == NULL)
+        {
+            Close();
+            return false;
+        }
+        m_name = name;
+        m_size = size;
+        m_isOwner = true;
+        return true;
+    }
+
+    // Maps an existing segment for reading and writing.
+    bool Open( const std::string& name)
+    {
+        Close();
+#if defined(_WIN32)
+        m_mapping = OpenFileMappingA( FILE_MAP_ALL_ACCESS, FALSE, GetWindowsName( name).c_str());
+        if ( m_mapping == NULL)
+        {
+            return false;
+        }
+        m_pData = static_cast<uint8_t*>(MapViewOfFile( m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+        MEMORY_BASIC_INFORMATION information;
+        if ( m_pData != NULL && VirtualQuery( m_pData, &information, sizeof( information)) != 0)
+        {
+            m_size = information.RegionSize;
+        }
+#else
+        const int file = shm_open( name.c_str(), O_RDWR, 0);
+        if ( file < 0)
+        {
+            return false;
+        }
+        struct stat status;
+        void* pData = MAP_FAILED;
+        if ( fstat( file, &status) == 0 && status.st_size > 0)
+        {
+            m_size = static_cast<size_t>(status.st_size);
+            pData = mmap( NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        }
+        close( file);
+        m_pData = (pData == MAP_FAILED) ? NULL : static_cast<uint8_t*>(pData);
+#endif
+        if ( m_pData == NULL)
+        {
+            Close();
+            return false;
+        }
+        m_name = name;
+        return true;
+    }
+
+    // Unmaps the segment. The creator also removes the name; processes that have mapped it keep their mapping.
+    void Close()
+    {
+#if defined(_WIN32)
+        if ( m_pData != NULL)
+        {
+            UnmapViewOfFile( m_pData);
+        }
+        if ( m_mapping != NULL)
+        {
+            CloseHandle( m_mapping);
+        }
+        m_mapping = NULL;
+#else
+        if ( m_pData != NULL)
+        {
+            munmap( m_pData, m_size);
+        }
+        if ( m_isOwner)
+        {
+            shm_unlink( m_name.c_str());
+        }
+#endif
+        m_pData = NULL;
+        m_size = 0;
+        m_isOwner = false;
+        m_name.clear();
+    }
+
+    uint8_t* GetData() const
+    {
+        return m_pData;
+    }
+
+    size_t GetSize() const
+    {
+        return m_size;
+    }
+
+private:
+#if defined(_WIN32)
+    // Names of file mappings must not contain backslashes, a leading slash is dropped.
+    static std::string GetWindowsName( const std::string& name)
+    {
+        return (!name.empty() && name[0] == '/') ? name.substr( 1) : name;
+    }
+#endif
+
+    // Not copyable.
+    CSharedMemorySegment( const CSharedMemorySegment&);
+    CSharedMemorySegment& operator=( const CSharedMemorySegment&);
+
+    uint8_t* m_pData;
+    size_t m_size;
+    bool m_isOwner;
+    std::string m_name;
+#if defined(_WIN32)
+    HANDLE m_mapping;
+#endif
+};
+
+
+// Receives the frames published into a segment. Several consumers, also in different processes, can receive
+// from the same segment. An instance must be used by one thread.
+class CSharedFrameConsumer
+{
+public:
+    CSharedFrameConsumer()
+        : m_pHeader( NULL)
+        , m_pCells( NULL)
+        , m_pSlotStates( NULL)
+        , m_pSlots( NULL)
+    {
+    }
+
+    // Returns false if the segment doesn't exist or hasn't been initialized completely.
+    bool Open( const std::string& name)
+    {
+        m_pHeader = NULL;
+        if ( !m_segment.Open( name) || m_segment.GetSize() < sizeof( SSharedFrameSegmentHeader))
+        {
+            return false;
+        }
+        SSharedFrameSegmentHeader* pHeader = reinterpret_cast<SSharedFrameSegmentHeader*>(m_segment.GetData());
+        if ( memcmp( pHeader->magic, c_sharedFrameMagic, sizeof( pHeader->magic)) != 0)
+        {
+            m_segment.Close();
+            return false;
+        }
+        std::atomic_thread_fence( std::memory_order_acquire);
+        if ( pHeader->version != c_sharedFrameVersion || pHeader->segmentSize > m_segment.GetSize())
+        {
+            m_segment.Close();
+            return false;
+        }
+        m_pHeader = pHeader;
+        m_pCells = reinterpret_cast<SSharedFrameCell*>(m_segment.GetData() + pHeader->ringOffset);
+        m_pSlotStates = reinterpret_cast<std::atomic<uint32_t>*>(m_segment.GetData() + pHeader->slotStateOffset);
+        m_pSlots = m_segment.GetData() + pHeader->slotOffset;
+        return true;
+    }
+
+    // Takes the next frame. Returns false if no frame is waiting. The image stays valid until Release() is called.
+    bool Receive( SSharedFrameRecord& record, const uint8_t*& pImage)
+    {
+        const uint64_t mask = m_pHeader->ringCapacity - 1;
+        uint64_t position = m_pHeader->readCount.load( std::memory_order_relaxed);
+        for (;;)
+        {
+            SSharedFrameCell& cell = m_pCells[position & mask];
+            const uint64_t sequence = cell.sequence.load( std::memory_order_acquire);
+            const int64_t difference = static_cast<int64_t>(sequence - (position + 1));
+            if ( difference < 0)
+            {
+                return false;
+            }
+            if ( difference > 0)
+            {
+                // Another consumer has taken the record.
+                position = m_pHeader->readCount.load( std::memory_order_relaxed);
+                continue;
+            }
+            if ( m_pHeader->readCount.compare_exchange_weak( position, position + 1, std::memory_order_relaxed))
+            {
+                record = cell.record;
+                // Frees the cell for the record of the next lap.
+                cell.sequence.store( position + m_pHeader->ringCapacity, std::memory_order_release);
+                pImage = m_pSlots + record.slot * m_pHeader->slotSize;
+                return true;
+            }
+        }
+    }
+
+    // Returns the slot of a received frame to the acquisition process. The image must not be accessed afterwards.
+    void Release( const SSharedFrameRecord& record)
+    {
+        m_pSlotStates[record.slot].store( SharedFrameSlotState_Released, std::memory_order_release);
+    }
+
+    // True if the producer won't publish any more frames. Frames already published can still be received,
+    // so read the flag before calling Receive() and stop if the flag has been set and no frame has been received.
+    bool IsProducerClosed() const
+    {
+        return m_pHeader->isClosed.load( std::memory_order_acquire) != 0;
+    }
+
+    // Frames published but not yet received.
+    uint64_t GetWaitingFrames() const
+    {
+        return m_pHeader->writeCount.load( std::memory_order_relaxed) - m_pHeader->readCount.load( std::memory_order_relaxed);
+    }
+
+private:
+    // Not copyable.
+    CSharedFrameConsumer( const CSharedFrameConsumer&);
+    CSharedFrameConsumer& operator=( const CSharedFrameConsumer&);
+
+    CSharedMemorySegment m_segment;
+    SSharedFrameSegmentHeader* m_pHeader;
+    SSharedFrameCell* m_pCells;
+    std::atomic<uint32_t>* m_pSlotStates;
+    uint8_t* m_pSlots;
+};
+
+#endif /* INCLUDED_SHAREDFRAMERING_H_4419268 */
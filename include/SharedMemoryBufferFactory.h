@@ -0,0 +1,231 @@
+// Contains a buffer factory allocating the grab buffers in a named shared memory segment, and publishing the
+// grabbed frames to consumer processes without copying them. See SharedFrameRing.h for the layout and the consumer.
+//
+// The Instant Camera reuses a buffer as soon as its grab result is released. Therefore Publish() keeps the grab
+// result until a consumer has released the slot. Released slots are returned to the Instant Camera by Publish()
+// and ReclaimReleasedSlots(), which must be called by the thread retrieving the grab results. Close() tells the
+// consumers that no more frames will be published.
+// Frames held by consumers are missing from the buffers of the camera, so the segment should have more slots
+// than consumers can hold frames at a time plus the buffers the camera needs.
+
+#ifndef INCLUDED_SHAREDMEMORYBUFFERFACTORY_H_8827305
+#define INCLUDED_SHAREDMEMORYBUFFERFACTORY_H_8827305
+
+#include "SharedFrameRing.h"
+
+#include <pylon/PylonIncludes.h>
+
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+class CSharedMemoryBufferFactory : public Pylon::IBufferFactory
+{
+public:
+    // Creates the segment with slotCount buffers of up to maxPayloadSize bytes and a ring of at least
+    // ringCapacity records. Throws if the segment can't be created.
+    CSharedMemoryBufferFactory( const std::string& name, uint32_t slotCount, size_t maxPayloadSize, uint64_t ringCapacity = 64)
+        : m_pHeader( NULL)
+        , m_pCells( NULL)
+        , m_pSlotStates( NULL)
+        , m_pSlots( NULL)
+        , m_heldResults( slotCount)
+        , m_publishedFrames( 0)
+        , m_droppedFrames( 0)
+    {
+        uint64_t capacity = 1;
+        while ( capacity < ringCapacity || capacity < slotCount)
+        {
+            capacity *= 2;
+        }
+        const uint64_t slotSize = (maxPayloadSize + 4095) & ~static_cast<uint64_t>(4095);
+        const uint64_t ringOffset = sizeof( SSharedFrameSegmentHeader);
+        const uint64_t slotStateOffset = ringOffset + capacity * sizeof( SSharedFrameCell);
+        const uint64_t slotOffset = (slotStateOffset + slotCount * sizeof( uint32_t) + 4095) & ~static_cast<uint64_t>(4095);
+        const uint64_t segmentSize = slotOffset + slotCount * slotSize;
+        if ( slotCount == 0 || !m_segment.Create( name, static_cast<size_t>(segmentSize)))
+        {
+            throw RUNTIME_EXCEPTION( "Could not create the shared memory segment %s. size=%u", name.c_str(),
+                static_cast<unsigned int>(segmentSize));
+        }
+
+        uint8_t* pData = m_segment.GetData();
+        m_pHeader = new (pData) SSharedFrameSegmentHeader;
+        m_pHeader->version = c_sharedFrameVersion;
+        m_pHeader->slotCount = slotCount;
+        m_pHeader->slotSize = slotSize;
+        m_pHeader->ringCapacity = capacity;
+        m_pHeader->ringOffset = ringOffset;
+        m_pHeader->slotStateOffset = slotStateOffset;
+        m_pHeader->slotOffset = slotOffset;
+        m_pHeader->segmentSize = segmentSize;
+        new (&m_pHeader->isClosed) std::atomic<uint32_t>( 0);
+        m_pHeader->writeCount.store( 0, std::memory_order_relaxed);
+        m_pHeader->readCount.store( 0, std::memory_order_relaxed);
+
+        m_pCells = reinterpret_cast<SSharedFrameCell*>(pData + ringOffset);
+        for ( uint64_t i = 0; i < capacity; ++i)
+        {
+            new (&m_pCells[i].sequence) std::atomic<uint64_t>( i);
+        }
+        m_pSlotStates = reinterpret_cast<std::atomic<uint32_t>*>(pData + slotStateOffset);
+        for ( uint32_t i = 0; i < slotCount; ++i)
+        {
+            new (&m_pSlotStates[i]) std::atomic<uint32_t>( SharedFrameSlotState_Grabbing);
+            m_freeSlots.push_back( slotCount - 1 - i);
+        }
+        m_pSlots = pData + slotOffset;
+
+        // Consumers accept the segment once the magic is visible.
+        std::atomic_thread_fence( std::memory_order_release);
+        memcpy( m_pHeader->magic, c_sharedFrameMagic, sizeof( m_pHeader->magic));
+    }
+
+    // Also closes the ring if grabbing has been aborted. Consumers keep their mapping and receive the frames left in the ring.
+    virtual ~CSharedMemoryBufferFactory()
+    {
+        Close();
+    }
+
+    // Called by the Instant Camera, possibly by different threads. The buffer context is the slot.
+    virtual void AllocateBuffer( size_t bufferSize, void** pCreatedBuffer, intptr_t& bufferContext)
+    {
+        *pCreatedBuffer = NULL;
+        if ( bufferSize > m_pHeader->slotSize)
+        {
+            throw RUNTIME_EXCEPTION( "The payload size exceeds the slots of the shared memory segment. bufferSize=%u, slotSize=%u",
+                static_cast<unsigned int>(bufferSize), static_cast<unsigned int>(m_pHeader->slotSize));
+        }
+        std::lock_guard<std::mutex> lock( m_lock);
+        if ( m_freeSlots.empty())
+        {
+            throw RUNTIME_EXCEPTION( "All slots of the shared memory segment are in use. slotCount=%u", m_pHeader->slotCount);
+        }
+        const uint32_t slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        bufferContext = static_cast<intptr_t>(slot);
+        *pCreatedBuffer = m_pSlots + slot * m_pHeader->slotSize;
+    }
+
+    // Called by the Instant Camera, possibly by different threads.
+    virtual void FreeBuffer( void* /*pCreatedBuffer*/, intptr_t bufferContext)
+    {
+        std::lock_guard<std::mutex> lock( m_lock);
+        m_freeSlots.push_back( static_cast<uint32_t>(bufferContext));
+    }
+
+    // Used if the ownership is passed to the Instant Camera by Cleanup_Delete.
+    virtual void DestroyBufferFactory()
+    {
+        delete this;
+    }
+
+    // Publishes a frame grabbed into a buffer of this factory and keeps the grab result until a consumer releases it.
+    // Returns false if the ring is full. The grab result is released then, so the camera can reuse the buffer.
+    bool Publish( const Pylon::CGrabResultPtr& ptrGrabResult)
+    {
+        ReclaimReleasedSlots();
+
+        const uint64_t position = m_pHeader->writeCount.load( std::memory_order_relaxed);
+        SSharedFrameCell& cell = m_pCells[position & (m_pHeader->ringCapacity - 1)];
+        if ( cell.sequence.load( std::memory_order_acquire) != position)
+        {
+            // The consumers haven't taken the record of the previous lap.
+            ++m_droppedFrames;
+            return false;
+        }
+
+        const uint32_t slot = static_cast<uint32_t>(ptrGrabResult->GetBufferContext());
+        m_heldResults[slot] = ptrGrabResult;
+        m_pSlotStates[slot].store( SharedFrameSlotState_Published, std::memory_order_relaxed);
+
+        SSharedFrameRecord& record = cell.record;
+        record.slot = slot;
+        record.pixelType = static_cast<uint32_t>(ptrGrabResult->GetPixelType());
+        record.bufferContext = static_cast<int64_t>(ptrGrabResult->GetBufferContext());
+        record.blockId = ptrGrabResult->GetBlockID();
+        record.timestamp = ptrGrabResult->GetTimeStamp();
+        record.publishTime = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+        record.payloadSize = ptrGrabResult->GetPayloadSize();
+        record.width = ptrGrabResult->GetWidth();
+        record.height = ptrGrabResult->GetHeight();
+        record.offsetX = ptrGrabResult->GetOffsetX();
+        record.paddingX = ptrGrabResult->GetPaddingX();
+        cell.sequence.store( position + 1, std::memory_order_release);
+        m_pHeader->writeCount.store( position + 1, std::memory_order_relaxed);
+        ++m_publishedFrames;
+        return true;
+    }
+
+    // Tells the consumers that no more frames will be published. Call after publishing the last frame.
+    void Close()
+    {
+        m_pHeader->isClosed.store( 1, std::memory_order_release);
+    }
+
+    // Returns the buffers of the slots released by consumers to the Instant Camera.
+    void ReclaimReleasedSlots()
+    {
+        for ( size_t slot = 0; slot < m_heldResults.size(); ++slot)
+        {
+            if ( m_pSlotStates[slot].load( std::memory_order_acquire) == SharedFrameSlotState_Released)
+            {
+                m_pSlotStates[slot].store( SharedFrameSlotState_Grabbing, std::memory_order_relaxed);
+                m_heldResults[slot].Release();
+            }
+        }
+    }
+
+    // Releases all grab results, also those not released by consumers. Call before stopping grabbing for good.
+    void ReleaseAll()
+    {
+        for ( size_t slot = 0; slot < m_heldResults.size(); ++slot)
+        {
+            m_pSlotStates[slot].store( SharedFrameSlotState_Grabbing, std::memory_order_relaxed);
+            m_heldResults[slot].Release();
+        }
+    }
+
+    uint64_t GetPublishedFrames() const
+    {
+        return m_publishedFrames;
+    }
+
+    // Frames not published because the ring was full.
+    uint64_t GetDroppedFrames() const
+    {
+        return m_droppedFrames;
+    }
+
+    // Frames published and not yet returned to the Instant Camera.
+    size_t GetHeldFrames() const
+    {
+        size_t count = 0;
+        for ( size_t slot = 0; slot < m_heldResults.size(); ++slot)
+        {
+            count += m_heldResults[slot].IsValid() ? 1 : 0;
+        }
+        return count;
+    }
+
+private:
+    // Not copyable.
+    CSharedMemoryBufferFactory( const CSharedMemoryBufferFactory&);
+    CSharedMemoryBufferFactory& operator=( const CSharedMemoryBufferFactory&);
+
+    CSharedMemorySegment m_segment;
+    SSharedFrameSegmentHeader* m_pHeader;
+    SSharedFrameCell* m_pCells;
+    std::atomic<uint32_t>* m_pSlotStates;
+    uint8_t* m_pSlots;
+    std::mutex m_lock;
+    std::vector<uint32_t> m_freeSlots;
+    std::vector<Pylon::CGrabResultPtr> m_heldResults;   // Indexed by slot.
+    uint64_t m_publishedFrames;
+    uint64_t m_droppedFrames;
+};
+
+#endif /* INCLUDED_SHAREDMEMORYBUFFERFACTORY_H_8827305 */
@@ -0,0 +1,448 @@
+// Contains a file storing the bright spots found in many images, e.g. by a batch scan of an image archive.
+//
+// CSpotResultWriter appends one record per image. An interrupted scan can be resumed: reopening the file drops
+// a partially written last record and returns the images already done. Images that couldn't be decoded are not
+// returned, so they are tried again. Closing the file appends an index sorted by image path. If an image has been
+// written more than once, the index refers to its last record. CSpotResultReader maps the file and finds the record of an image by binary search.
+//
+// Layout: SSpotResultFileHeader, records, index, SSpotResultFileTrailer. A record is an SSpotResultRecordHeader,
+// the path padded to 8 bytes and spotCount SSpotResult. The index is an array of uint64_t record offsets.
+// All fields are little-endian on the supported platforms.
+
+#ifndef INCLUDED_SPOTRESULTFILE_H_6150274
+#define INCLUDED_SPOTRESULTFILE_H_6150274
+
+#include "BrightSpotExtractor.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#   include <io.h>
+#else
+#   include <unistd.h>
+#endif
+
+struct SSpotResultFileHeader
+{
+    char magic[8];              // c_spotResultFileMagic
+    uint32_t version;
+    uint32_t spotSize;          // sizeof( SSpotResult)
+};
+
+struct SSpotResultFileTrailer
+{
+    uint64_t indexOffset;       // Offset of the index, i.e. the end of the records.
+    uint64_t recordCount;
+    char magic[8];              // c_spotResultIndexMagic
+};
+
+enum ESpotResultStatus
+{
+    SpotResultStatus_Ok = 0,
+    SpotResultStatus_DecodeFailed = 1,      // The image couldn't be read.
+    SpotResultStatus_UnsupportedFormat = 2  // The pixel format isn't supported by CBrightSpotExtractor.
+};
+
+struct SSpotResultRecordHeader
+{
+    uint32_t magic;             // c_spotResultRecordMagic
+    uint32_t status;            // ESpotResultStatus
+    uint32_t pathLength;        // In bytes, without terminating zero.
+    uint32_t spotCount;
+    uint32_t imageWidth;
+    uint32_t imageHeight;
+};
+
+// SBrightSpot with a fixed layout.
+struct SSpotResult
+{
+    double centroidX;
+    double centroidY;
+    double intensity;
+    uint64_t area;
+    int32_t left;
+    int32_t top;
+    int32_t width;
+    int32_t height;
+};
+
+static const char c_spotResultFileMagic[8] = { 'S', 'P', 'O', 'T', 'R', 'S', 'L', 'T' };
+static const char c_spotResultIndexMagic[8] = { 'S', 'P', 'O', 'T', 'I', 'N', 'D', 'X' };
+static const uint32_t c_spotResultRecordMagic = 0x544F5053;    // "SPOT"
+static const uint32_t c_spotResultFileVersion = 1;
+
+static_assert( sizeof( SSpotResultFileHeader) == 16, "The layout of SSpotResultFileHeader must not change.");
+static_assert( sizeof( SSpotResultFileTrailer) == 24, "The layout of SSpotResultFileTrailer must not change.");
+static_assert( sizeof( SSpotResultRecordHeader) == 24, "The layout of SSpotResultRecordHeader must not change.");
+static_assert( sizeof( SSpotResult) == 48, "The layout of SSpotResult must not change.");
+
+
+// A record of a mapped file. The pointers are valid while the reader is open.
+struct SSpotResultEntry
+{
+    const SSpotResultRecordHeader* pHeader;
+    const char* pPath;
+    const SSpotResult* pSpots;
+
+    std::string GetPath() const
+    {
+        return std::string( pPath, pHeader->pathLength);
+    }
+};
+
+
+class CSpotResultWriter
+{
+public:
+    CSpotResultWriter()
+        : m_pFile( NULL)
+        , m_size( 0)
+    {
+    }
+
+    ~CSpotResultWriter()
+    {
+        Close();
+    }
+
+    // Creates the file or continues an existing file. The paths of the images already stored are added to donePaths,
+    // except for images stored with SpotResultStatus_DecodeFailed, e.g. because they were still being copied.
+    // Returns false if the file can't be opened or isn't a spot result file.
+    bool Open( const std::string& fileName, std::vector<std::string>& donePaths)
+    {
+        Close();
+        uint64_t end = 0;
+        if ( !ReadExisting( fileName, donePaths, end))
+        {
+            return false;
+        }
+
+        // Drops the index and a partially written last record. They are written again.
+        if ( end == 0)
+        {
+            m_pFile = fopen( fileName.c_str(), "wb");
+            SSpotResultFileHeader header;
+            memcpy( header.magic, c_spotResultFileMagic, sizeof( header.magic));
+            header.version = c_spotResultFileVersion;
+            header.spotSize = sizeof( SSpotResult);
+            if ( m_pFile == NULL || fwrite( &header, sizeof( header), 1, m_pFile) != 1)
+            {
+                Close();
+                return false;
+            }
+            m_size = sizeof( header);
+        }
+        else
+        {
+            m_pFile = fopen( fileName.c_str(), "r+b");
+            if ( m_pFile == NULL || !Truncate( end) || fseek( m_pFile, 0, SEEK_END) != 0)
+            {
+                Close();
+                return false;
+            }
+            m_size = end;
+        }
+        return true;
+    }
+
+    // Appends the spots of an image. Returns false if writing fails.
+    bool Write( const std::string& path, ESpotResultStatus status, int imageWidth, int imageHeight, const std::vector<SBrightSpot>& spots)
+    {
+        if ( m_pFile == NULL)
+        {
+            return false;
+        }
+
+        SSpotResultRecordHeader header;
+        header.magic = c_spotResultRecordMagic;
+        header.status = static_cast<uint32_t>(status);
+        header.pathLength = static_cast<uint32_t>(path.size());
+        header.spotCount = static_cast<uint32_t>(spots.size());
+        header.imageWidth = static_cast<uint32_t>(imageWidth);
+        header.imageHeight = static_cast<uint32_t>(imageHeight);
+
+        m_buffer.resize( GetRecordSize( header));
+        memcpy( &m_buffer[0], &header, sizeof( header));
+        memcpy( &m_buffer[sizeof( header)], path.data(), path.size());
+        for ( size_t i = 0; i < spots.size(); ++i)
+        {
+            SSpotResult result;
+            result.centroidX = spots[i].centroidX;
+            result.centroidY = spots[i].centroidY;
+            result.intensity = spots[i].intensity;
+            result.area = spots[i].area;
+            result.left = spots[i].left;
+            result.top = spots[i].top;
+            result.width = spots[i].width;
+            result.height = spots[i].height;
+            memcpy( &m_buffer[sizeof( header) + PadPath( path.size()) + i * sizeof( SSpotResult)], &result, sizeof( result));
+        }
+
+        if ( fwrite( &m_buffer[0], m_buffer.size(), 1, m_pFile) != 1)
+        {
+            return false;
+        }
+        m_records.push_back( SIndexEntry( path, m_size));
+        m_size += m_buffer.size();
+        return true;
+    }
+
+    // Writes the buffered records to the file, so they survive if the process is terminated.
+    bool Flush()
+    {
+        return m_pFile != NULL && fflush( m_pFile) == 0;
+    }
+
+    // Appends the index and closes the file. Returns false if writing fails.
+    bool Close()
+    {
+        if ( m_pFile == NULL)
+        {
+            return true;
+        }
+
+        // Images tried again have more than one record. The record written last is the valid one.
+        std::sort( m_records.begin(), m_records.end());
+        std::vector<uint64_t> index;
+        index.reserve( m_records.size());
+        for ( size_t i = 0; i < m_records.size(); ++i)
+        {
+            if ( i + 1 == m_records.size() || m_records[i + 1].path != m_records[i].path)
+            {
+                index.push_back( m_records[i].offset);
+            }
+        }
+        SSpotResultFileTrailer trailer;
+        trailer.indexOffset = m_size;
+        trailer.recordCount = index.size();
+        memcpy( trailer.magic, c_spotResultIndexMagic, sizeof( trailer.magic));
+
+        bool ok = index.empty() || fwrite( &index[0], sizeof( uint64_t), index.size(), m_pFile) == index.size();
+        ok = ok && fwrite( &trailer, sizeof( trailer), 1, m_pFile) == 1;
+        ok = (fclose( m_pFile) == 0) && ok;
+        m_pFile = NULL;
+        m_size = 0;
+        m_records.clear();
+        return ok;
+    }
+
+    static size_t PadPath( size_t pathLength)
+    {
+        return (pathLength + 7) & ~static_cast<size_t>(7);
+    }
+
+    static uint64_t GetRecordSize( const SSpotResultRecordHeader& header)
+    {
+        return sizeof( header) + PadPath( header.pathLength) + static_cast<uint64_t>(header.spotCount) * sizeof( SSpotResult);
+    }
+
+private:
+    struct SIndexEntry
+    {
+        SIndexEntry( const std::string& path_, uint64_t offset_)
+            : path( path_)
+            , offset( offset_)
+        {
+        }
+
+        bool operator<( const SIndexEntry& other) const
+        {
+            return (path != other.path) ? path < other.path : offset < other.offset;
+        }
+
+        std::string path;
+        uint64_t offset;
+    };
+
+    // Reads the complete records of an existing file. end is set to the end of the last complete record, 0 if the file
+    // doesn't exist or is empty. Returns false if the file isn't a spot result file.
+    bool ReadExisting( const std::string& fileName, std::vector<std::string>& donePaths, uint64_t& end)
+    {
+        end = 0;
+        CMappedFile file;
+        if ( !file.OpenForReading( fileName))
+        {
+            return true;
+        }
+
+        const uint8_t* pData = file.GetData();
+        const uint64_t size = file.GetSize();
+        SSpotResultFileHeader header;
+        if ( size < sizeof( header))
+        {
+            return true;
+        }
+        memcpy( &header, pData, sizeof( header));
+        if ( memcmp( header.magic, c_spotResultFileMagic, sizeof( header.magic)) != 0 || header.spotSize != sizeof( SSpotResult))
+        {
+            return false;
+        }
+
+        // The index, if any, is behind the records.
+        uint64_t recordsEnd = size;
+        SSpotResultFileTrailer trailer;
+        if ( size >= sizeof( header) + sizeof( trailer))
+        {
+            memcpy( &trailer, pData + size - sizeof( trailer), sizeof( trailer));
+            if ( memcmp( trailer.magic, c_spotResultIndexMagic, sizeof( trailer.magic)) == 0 && trailer.indexOffset <= size)
+            {
+                recordsEnd = trailer.indexOffset;
+            }
+        }
+
+        end = sizeof( header);
+        while ( end + sizeof( SSpotResultRecordHeader) <= recordsEnd)
+        {
+            SSpotResultRecordHeader record;
+            memcpy( &record, pData + end, sizeof( record));
+            if ( record.magic != c_spotResultRecordMagic || end + GetRecordSize( record) > recordsEnd)
+            {
+                break;
+            }
+            const std::string path( reinterpret_cast<const char*>(pData + end + sizeof( record)), record.pathLength);
+            if ( record.status != SpotResultStatus_DecodeFailed)
+            {
+                donePaths.push_back( path);
+            }
+            m_records.push_back( SIndexEntry( path, end));
+            end += GetRecordSize( record);
+        }
+        return true;
+    }
+
+    bool Truncate( uint64_t size)
+    {
+        fflush( m_pFile);
+#if defined(_WIN32)
+        return _chsize_s( _fileno( m_pFile), static_cast<__int64>(size)) == 0;
+#else
+        return ftruncate( fileno( m_pFile), static_cast<off_t>(size)) == 0;
+#endif
+    }
+
+    // Not copyable.
+    CSpotResultWriter( const CSpotResultWriter&);
+    CSpotResultWriter& operator=( const CSpotResultWriter&);
+
+    FILE* m_pFile;
+    uint64_t m_size;
+    std::vector<SIndexEntry> m_records;
+    std::vector<uint8_t> m_buffer;
+};
+
+
+class CSpotResultReader
+{
+public:
+    CSpotResultReader()
+        : m_pIndex( NULL)
+        , m_recordCount( 0)
+    {
+    }
+
+    // Maps a closed file. Returns false if the file can't be mapped or has no index, e.g. because the scan was interrupted.
+    bool Open( const std::string& fileName)
+    {
+        m_pIndex = NULL;
+        m_recordCount = 0;
+        if ( !m_file.OpenForReading( fileName))
+        {
+            return false;
+        }
+
+        const uint8_t* pData = m_file.GetData();
+        const uint64_t size = m_file.GetSize();
+        SSpotResultFileHeader header;
+        SSpotResultFileTrailer trailer;
+        if ( size < sizeof( header) + sizeof( trailer))
+        {
+            return false;
+        }
+        memcpy( &header, pData, sizeof( header));
+        memcpy( &trailer, pData + size - sizeof( trailer), sizeof( trailer));
+        if ( memcmp( header.magic, c_spotResultFileMagic, sizeof( header.magic)) != 0 || header.spotSize != sizeof( SSpotResult)
+            || memcmp( trailer.magic, c_spotResultIndexMagic, sizeof( trailer.magic)) != 0
+            || trailer.indexOffset + trailer.recordCount * sizeof( uint64_t) + sizeof( trailer) != size)
+        {
+            m_file.Close();
+            return false;
+        }
+        m_pIndex = reinterpret_cast<const uint64_t*>(pData + trailer.indexOffset);
+        m_recordCount = static_cast<size_t>(trailer.recordCount);
+        return true;
+    }
+
+    // Number of images.
+    size_t GetRecordCount() const
+    {
+        return m_recordCount;
+    }
+
+    // Returns the record at position i of the index, i.e. sorted by path.
+    SSpotResultEntry GetRecord( size_t i) const
+    {
+        const uint8_t* pRecord = m_file.GetData() + m_pIndex[i];
+        SSpotResultEntry entry;
+        entry.pHeader = reinterpret_cast<const SSpotResultRecordHeader*>(pRecord);
+        entry.pPath = reinterpret_cast<const char*>(pRecord + sizeof( SSpotResultRecordHeader));
+        entry.pSpots = reinterpret_cast<const SSpotResult*>(pRecord + sizeof( SSpotResultRecordHeader)
+            + CSpotResultWriter::PadPath( entry.pHeader->pathLength));
+        return entry;
+    }
+
+    // Finds the record of an image. Returns false if the image isn't in the file.
+    bool Find( const std::string& path, SSpotResultEntry& entry) const
+    {
+        size_t first = 0;
+        size_t count = m_recordCount;
+        while ( count > 0)
+        {
+            const size_t half = count / 2;
+            const SSpotResultEntry middle = GetRecord( first + half);
+            if ( Compare( middle, path) < 0)
+            {
+                first += half + 1;
+                count -= half + 1;
+            }
+            else
+            {
+                count = half;
+            }
+        }
+        if ( first == m_recordCount)
+        {
+            return false;
+        }
+        entry = GetRecord( first);
+        return Compare( entry, path) == 0;
+    }
+
+private:
+    // Compares like std::string.
+    static int Compare( const SSpotResultEntry& entry, const std::string& path)
+    {
+        const size_t length = entry.pHeader->pathLength;
+        const int result = memcmp( entry.pPath, path.data(), std::min( length, path.size()));
+        if ( result != 0)
+        {
+            return result;
+        }
+        return (length < path.size()) ? -1 : (length > path.size() ? 1 : 0);
+    }
+
+    // Not copyable.
+    CSpotResultReader( const CSpotResultReader&);
+    CSpotResultReader& operator=( const CSpotResultReader&);
+
+    CMappedFile m_file;
+    const uint64_t* m_pIndex;
+    size_t m_recordCount;
+};
+
+#endif /* INCLUDED_SPOTRESULTFILE_H_6150274 */
@@ -0,0 +1,149 @@
+// Contains a bounded lock-free queue for passing items from one producer thread to one consumer thread.
+
+#ifndef INCLUDED_SPSCQUEUE_H_3051877
+#define INCLUDED_SPSCQUEUE_H_3051877
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Size used for padding members that are written by different threads.
+static const size_t c_cacheLineSize = 64;
+
+// Bounded single-producer/single-consumer ring buffer.
+// TryPush() must only be called by one thread and TryPop() must only be called by one other thread.
+// No locks are taken and no memory is allocated after construction.
+template <typename T>
+class CSpscQueue
+{
+public:
+    // The capacity is rounded up to the next power of two.
+    explicit CSpscQueue( size_t capacity)
+        : m_mask( RoundUpToPowerOfTwo( capacity < 2 ? 2 : capacity) - 1)
+        , m_items( m_mask + 1)
+        , m_head( 0)
+        , m_cachedTail( 0)
+        , m_tail( 0)
+        , m_cachedHead( 0)
+    {
+    }
+
+    // Called by the producer. Returns false if the queue is full.
+    bool TryPush( const T& item)
+    {
+        const size_t head = m_head.load( std::memory_order_relaxed);
+        if ( head - m_cachedTail > m_mask)
+        {
+            m_cachedTail = m_tail.load( std::memory_order_acquire);
+            if ( head - m_cachedTail > m_mask)
+            {
+                return false;
+            }
+        }
+        m_items[head & m_mask] = item;
+        m_head.store( head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Called by the consumer. Returns false if the queue is empty.
+    bool TryPop( T& item)
+    {
+        const size_t tail = m_tail.load( std::memory_order_relaxed);
+        if ( tail == m_cachedHead)
+        {
+            m_cachedHead = m_head.load( std::memory_order_acquire);
+            if ( tail == m_cachedHead)
+            {
+                return false;
+            }
+        }
+        item = m_items[tail & m_mask];
+        m_tail.store( tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns the number of queued items. The value is only a snapshot when called concurrently.
+    size_t Size() const
+    {
+        const size_t tail = m_tail.load( std::memory_order_acquire);
+        const size_t head = m_head.load( std::memory_order_acquire);
+        return head - tail;
+    }
+
+    size_t Capacity() const
+    {
+        return m_mask + 1;
+    }
+
+private:
+    static size_t RoundUpToPowerOfTwo( size_t value)
+    {
+        size_t result = 1;
+        while ( result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    // Not copyable.
+    CSpscQueue( const CSpscQueue&);
+    CSpscQueue& operator=( const CSpscQueue&);
+
+    const size_t m_mask;
+    std::vector<T> m_items;
+
+    // The padding keeps the members written by the producer and the consumer on different cache lines.
+    char m_padding0[c_cacheLineSize];
+
+    // Written by the producer.
+    std::atomic<size_t> m_head;
+    size_t m_cachedTail;
+    char m_padding1[c_cacheLineSize];
+
+    // Written by the consumer.
+    std::atomic<size_t> m_tail;
+    size_t m_cachedHead;
+    char m_padding2[c_cacheLineSize];
+};
+
+
+// Waiting strategy for threads polling a lock-free queue.
+// Spins first, then yields the time slice and finally sleeps shortly so that idle stages don't burn a core.
+class CBackoff
+{
+public:
+    CBackoff()
+        : m_count( 0)
+    {
+    }
+
+    void Wait()
+    {
+        if ( m_count < 64)
+        {
+            ++m_count;
+        }
+        else if ( m_count < 128)
+        {
+            ++m_count;
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for( std::chrono::microseconds( 100));
+        }
+    }
+
+    void Reset()
+    {
+        m_count = 0;
+    }
+
+private:
+    unsigned int m_count;
+};
+
+#endif /* INCLUDED_SPSCQUEUE_H_3051877 */
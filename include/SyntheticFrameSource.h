@@ -0,0 +1,313 @@
+// Contains a frame source emulating a camera, for load testing the processing without hardware.
+// A cycle of images is rendered once using SampleImageCreator. A thread then emits frames referring to these images
+// at the target frame rate with block IDs, time stamps and chunk data like a grab result. Drops and corrupted
+// frames can be injected at random. Frames are passed to the consumer using a lock-free queue whose capacity
+// corresponds to the number of buffers of a camera, so rates of several thousand frames per second are possible.
+
+#ifndef INCLUDED_SYNTHETICFRAMESOURCE_H_1840593
+#define INCLUDED_SYNTHETICFRAMESOURCE_H_1840593
+
+#include "SampleImageCreator.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+struct SSyntheticFrameSourceConfiguration
+{
+    SSyntheticFrameSourceConfiguration()
+        : pixelType( Pylon::PixelType_Mono8)
+        , width( 2048)
+        , height( 1536)
+        , cycleLength( 16)
+        , bufferCount( 16)
+        , frameRate( 1000)
+        , dropProbability( 0)
+        , corruptionProbability( 0)
+        , exposureTime( 100)
+        , seed( 1)
+    {
+    }
+
+    Pylon::EPixelType pixelType;
+    uint32_t width;
+    uint32_t height;
+    size_t cycleLength;             // Number of different images. They are emitted in turn.
+    size_t bufferCount;             // Frames that can wait for the consumer. Further frames are lost like on a camera without free buffers.
+    double frameRate;               // Frames per second. 0 emits the frames as fast as they are consumed.
+    double dropProbability;         // Probability of a frame being skipped, e.g. a lost packet. The block ID shows the gap.
+    double corruptionProbability;   // Probability of a frame being emitted with damaged image data.
+    double exposureTime;            // Reported in the chunk data in us.
+    uint32_t seed;                  // Seed of the random drops and corruptions. The same seed gives the same sequence.
+};
+
+
+// Chunk data as reported by a camera, e.g. ChunkFramecounter and ChunkExposureTime.
+struct SSyntheticChunkData
+{
+    int64_t frameCounter;
+    uint64_t timestamp;
+    double exposureTime;
+    int64_t lineStatusAll;
+    uint32_t payloadChecksum;       // Checksum of the undamaged image. It doesn't match for corrupted frames.
+};
+
+
+struct SSyntheticFrame
+{
+    const Pylon::CPylonImage* pImage;   // Owned by the source and valid until it is destroyed. Must not be modified.
+    uint64_t blockId;                   // Increments by one for every frame, including dropped frames. Starts at 1.
+    uint64_t timestamp;                 // Time the frame has been emitted in ns since Start().
+    int64_t skippedFrames;              // Frames dropped or lost since the previous frame.
+    bool isCorrupted;                   // Part of the image is overwritten, like an incompletely received buffer.
+    SSyntheticChunkData chunk;
+};
+
+
+class CSyntheticFrameSource
+{
+public:
+    // Renders the images. Takes as long as rendering cycleLength images, and twice as long if corruptions are enabled.
+    explicit CSyntheticFrameSource( const SSyntheticFrameSourceConfiguration& configuration)
+        : m_configuration( configuration)
+        , m_queue( configuration.bufferCount)
+        , m_stop( false)
+        , m_running( false)
+        , m_emittedFrames( 0)
+        , m_droppedFrames( 0)
+        , m_lostFrames( 0)
+        , m_corruptedFrames( 0)
+    {
+        const size_t cycleLength = configuration.cycleLength < 1 ? 1 : configuration.cycleLength;
+        std::mt19937 random( configuration.seed);
+        for ( size_t i = 0; i < cycleLength; ++i)
+        {
+            // Zoom in a little further for every image, so consecutive frames differ.
+            m_images.push_back( SampleImageCreator::CreateMandelbrotFractal( configuration.pixelType, configuration.width, configuration.height,
+                1.0 + 0.05 * static_cast<double>(i)));
+            m_checksums.push_back( ComputeChecksum( m_images.back()));
+            if ( configuration.corruptionProbability > 0)
+            {
+                Pylon::CPylonImage corruptedImage;
+                corruptedImage.CopyImage( m_images.back());
+                Corrupt( corruptedImage, random);
+                m_corruptedImages.push_back( corruptedImage);
+            }
+        }
+    }
+
+    ~CSyntheticFrameSource()
+    {
+        Stop();
+    }
+
+    // Starts emitting frames. Block IDs and time stamps start again.
+    void Start()
+    {
+        if ( m_running)
+        {
+            return;
+        }
+        SSyntheticFrame frame;
+        while ( m_queue.TryPop( frame))
+        {
+        }
+        m_stop = false;
+        m_running = true;
+        m_thread = std::thread( &CSyntheticFrameSource::Run, this);
+    }
+
+    // Stops emitting frames. Frames already emitted can still be retrieved.
+    void Stop()
+    {
+        if ( !m_running)
+        {
+            return;
+        }
+        m_stop = true;
+        m_thread.join();
+        m_running = false;
+    }
+
+    // Waits for the next frame. Returns false on timeout. Start(), Stop() and RetrieveFrame() must be called by the same thread.
+    bool RetrieveFrame( unsigned int timeoutMs, SSyntheticFrame& frame)
+    {
+        if ( m_queue.TryPop( frame))
+        {
+            return true;
+        }
+        const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( timeoutMs);
+        while ( !m_queue.TryPop( frame))
+        {
+            if ( std::chrono::steady_clock::now() >= deadline)
+            {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    const SSyntheticFrameSourceConfiguration& GetConfiguration() const
+    {
+        return m_configuration;
+    }
+
+    // Frames passed to the consumer.
+    uint64_t GetEmittedFrames() const
+    {
+        return m_emittedFrames.load( std::memory_order_relaxed);
+    }
+
+    // Frames skipped on purpose, see dropProbability.
+    uint64_t GetDroppedFrames() const
+    {
+        return m_droppedFrames.load( std::memory_order_relaxed);
+    }
+
+    // Frames lost because the consumer didn't keep up and all buffers were in use.
+    uint64_t GetLostFrames() const
+    {
+        return m_lostFrames.load( std::memory_order_relaxed);
+    }
+
+    uint64_t GetCorruptedFrames() const
+    {
+        return m_corruptedFrames.load( std::memory_order_relaxed);
+    }
+
+    // Sum of the bytes of an image. Used for the chunk data, consumers can verify the image data with it.
+    static uint32_t ComputeChecksum( const Pylon::CPylonImage& image)
+    {
+        const uint8_t* pData = static_cast<const uint8_t*>(image.GetBuffer());
+        const size_t size = image.GetImageSize();
+        uint32_t sum = 0;
+        for ( size_t i = 0; i < size; ++i)
+        {
+            sum += pData[i];
+        }
+        return sum;
+    }
+
+private:
+    // Overwrites a band of rows at a random position like a lost range of packets.
+    static void Corrupt( Pylon::CPylonImage& image, std::mt19937& random)
+    {
+        size_t stride = 0;
+        image.GetStride( stride);
+        const uint32_t height = image.GetHeight();
+        const uint32_t bandHeight = height / 8 + 1;
+        const uint32_t top = std::uniform_int_distribution<uint32_t>( 0, height - 1)( random);
+        const uint32_t bottom = (top + bandHeight < height) ? top + bandHeight : height;
+        memset( static_cast<uint8_t*>(image.GetBuffer()) + top * stride, 0, (bottom - top) * stride);
+    }
+
+    void Run()
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const std::chrono::nanoseconds period( m_configuration.frameRate > 0 ? static_cast<int64_t>(1e9 / m_configuration.frameRate) : 0);
+        std::mt19937 random( m_configuration.seed);
+        std::uniform_real_distribution<double> uniform( 0, 1);
+        int64_t skipped = 0;
+
+        for ( uint64_t blockId = 1; !m_stop; ++blockId)
+        {
+            if ( period.count() > 0 && !WaitUntil( start + period * static_cast<int64_t>(blockId - 1)))
+            {
+                break;
+            }
+
+            if ( uniform( random) < m_configuration.dropProbability)
+            {
+                m_droppedFrames.store( m_droppedFrames.load( std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                ++skipped;
+                continue;
+            }
+
+            const size_t imageIndex = static_cast<size_t>((blockId - 1) % m_images.size());
+            const bool isCorrupted = !m_corruptedImages.empty() && uniform( random) < m_configuration.corruptionProbability;
+            SSyntheticFrame frame;
+            frame.pImage = isCorrupted ? &m_corruptedImages[imageIndex] : &m_images[imageIndex];
+            frame.blockId = blockId;
+            frame.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            frame.skippedFrames = skipped;
+            frame.isCorrupted = isCorrupted;
+            frame.chunk.frameCounter = static_cast<int64_t>(blockId - 1);
+            frame.chunk.timestamp = frame.timestamp;
+            frame.chunk.exposureTime = m_configuration.exposureTime;
+            frame.chunk.lineStatusAll = static_cast<int64_t>(blockId & 1);
+            frame.chunk.payloadChecksum = m_checksums[imageIndex];
+
+            // Without a target frame rate, wait for the consumer instead of losing the frame.
+            bool pushed = m_queue.TryPush( frame);
+            while ( !pushed && period.count() == 0 && !m_stop)
+            {
+                std::this_thread::yield();
+                pushed = m_queue.TryPush( frame);
+            }
+            if ( !pushed)
+            {
+                m_lostFrames.store( m_lostFrames.load( std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                ++skipped;
+                continue;
+            }
+
+            skipped = 0;
+            m_emittedFrames.store( m_emittedFrames.load( std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if ( isCorrupted)
+            {
+                m_corruptedFrames.store( m_corruptedFrames.load( std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Sleeps until shortly before the deadline and spins for the rest, because sleeping is too coarse for
+    // periods below a millisecond. Returns false if the source is stopped while waiting.
+    bool WaitUntil( std::chrono::steady_clock::time_point deadline) const
+    {
+        for ( ;;)
+        {
+            if ( m_stop)
+            {
+                return false;
+            }
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if ( now >= deadline)
+            {
+                return true;
+            }
+            if ( deadline - now > std::chrono::milliseconds( 2))
+            {
+                std::this_thread::sleep_for( std::chrono::milliseconds( 1));
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Not copyable.
+    CSyntheticFrameSource( const CSyntheticFrameSource&);
+    CSyntheticFrameSource& operator=( const CSyntheticFrameSource&);
+
+    const SSyntheticFrameSourceConfiguration m_configuration;
+    std::vector<Pylon::CPylonImage> m_images;
+    std::vector<Pylon::CPylonImage> m_corruptedImages;
+    std::vector<uint32_t> m_checksums;
+    CSpscQueue<SSyntheticFrame> m_queue;
+    std::thread m_thread;
+    std::atomic<bool> m_stop;
+    bool m_running;
+    std::atomic<uint64_t> m_emittedFrames;
+    std::atomic<uint64_t> m_droppedFrames;
+    std::atomic<uint64_t> m_lostFrames;
+    std::atomic<uint64_t> m_corruptedFrames;
+};
+
+#endif /* INCLUDED_SYNTHETICFRAMESOURCE_H_1840593 */
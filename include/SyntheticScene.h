@@ -0,0 +1,494 @@
+// Contains a generator of synthetic scenes with objects of known geometry, for checking measurements and tracking.
+// Rectangles and circles have a known area and perimeter, bright spots a known centre. Objects can move and bounce
+// off the image borders. The background with noise and vignetting is rendered once. For every frame only the
+// regions covered by moving objects before and after the move are restored from the background and drawn again,
+// so the time per frame depends on the size of the moving objects instead of the size of the image.
+// Mono8, RGB8, BGR8 and 8 bit Bayer images are written directly; Bayer images sample one color per pixel.
+
+#ifndef INCLUDED_SYNTHETICSCENE_H_7402816
+#define INCLUDED_SYNTHETICSCENE_H_7402816
+
+#include <pylon/PylonImage.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+enum ESceneObjectType
+{
+    SceneObjectType_Rectangle,      // Axis-aligned, width x height.
+    SceneObjectType_Circle,         // Diameter width.
+    SceneObjectType_Spot            // Gaussian profile with standard deviation width, added to the background.
+};
+
+struct SSceneObject
+{
+    SSceneObject()
+        : type( SceneObjectType_Rectangle)
+        , x( 0)
+        , y( 0)
+        , width( 0)
+        , height( 0)
+        , velocityX( 0)
+        , velocityY( 0)
+        , red( 255)
+        , green( 255)
+        , blue( 255)
+    {
+    }
+
+    ESceneObjectType type;
+    double x;                   // Centre in pixels. The pixel (0, 0) covers 0 ... 1.
+    double y;
+    double width;
+    double height;
+    double velocityX;           // Pixels per frame.
+    double velocityY;
+    uint8_t red;                // Fill color, or peak color of a spot.
+    uint8_t green;
+    uint8_t blue;
+};
+
+
+struct SSyntheticSceneConfiguration
+{
+    SSyntheticSceneConfiguration()
+        : pixelType( Pylon::PixelType_Mono8)
+        , width( 2048)
+        , height( 1536)
+        , background( 40)
+        , noiseAmplitude( 8)
+        , vignetting( 0.3)
+        , seed( 1)
+    {
+    }
+
+    Pylon::EPixelType pixelType;    // Mono8, RGB8packed, BGR8packed or an 8 bit Bayer type.
+    uint32_t width;
+    uint32_t height;
+    uint8_t background;             // Gray level of the background in the image centre.
+    uint8_t noiseAmplitude;         // The background varies by up to this amount per pixel.
+    double vignetting;              // Relative loss of brightness in the image corners. Applies to objects too.
+    uint32_t seed;
+};
+
+
+class CSyntheticScene
+{
+public:
+    // Renders the background. Throws if the pixel type isn't supported.
+    explicit CSyntheticScene( const SSyntheticSceneConfiguration& configuration)
+        : m_configuration( configuration)
+        , m_bytesPerPixel( GetBytesPerPixel( configuration.pixelType))
+        , m_isFirstFrame( true)
+        , m_renderedPixels( 0)
+    {
+        if ( m_bytesPerPixel == 0)
+        {
+            throw std::invalid_argument( "CSyntheticScene: unsupported pixel type");
+        }
+        SetBayerPattern( configuration.pixelType);
+        m_background = Pylon::CPylonImage::Create( configuration.pixelType, configuration.width, configuration.height);
+        m_image = Pylon::CPylonImage::Create( configuration.pixelType, configuration.width, configuration.height);
+        m_background.GetStride( m_stride);
+        RenderBackground();
+    }
+
+    // Returns the index of the object. Objects added later are drawn on top.
+    size_t AddObject( const SSceneObject& object)
+    {
+        m_objects.push_back( object);
+        m_bounds.push_back( GetBounds( object));
+        return m_objects.size() - 1;
+    }
+
+    size_t GetObjectCount() const
+    {
+        return m_objects.size();
+    }
+
+    // The object at its position in the last frame rendered.
+    const SSceneObject& GetObject( size_t index) const
+    {
+        return m_objects[index];
+    }
+
+    // Area of the ideal shape in pixels. Drawn shapes cover the pixels whose centres lie inside, so the pixel count
+    // differs by a fraction of the perimeter.
+    static double GetExpectedArea( const SSceneObject& object)
+    {
+        switch ( object.type)
+        {
+        case SceneObjectType_Rectangle:
+            return object.width * object.height;
+        case SceneObjectType_Circle:
+            return 3.14159265358979323846 * object.width * object.width / 4;
+        default:
+            return 0;
+        }
+    }
+
+    static double GetExpectedPerimeter( const SSceneObject& object)
+    {
+        switch ( object.type)
+        {
+        case SceneObjectType_Rectangle:
+            return 2 * (object.width + object.height);
+        case SceneObjectType_Circle:
+            return 3.14159265358979323846 * object.width;
+        default:
+            return 0;
+        }
+    }
+
+    // Moves the objects and renders the next frame. The first call renders the whole image.
+    // The image is overwritten by the next call.
+    const Pylon::CPylonImage& RenderFrame()
+    {
+        if ( m_isFirstFrame)
+        {
+            memcpy( m_image.GetBuffer(), m_background.GetBuffer(), m_stride * m_configuration.height);
+            m_renderedPixels = static_cast<uint64_t>(m_configuration.width) * m_configuration.height;
+            for ( size_t i = 0; i < m_objects.size(); ++i)
+            {
+                DrawObject( m_objects[i], m_bounds[i]);
+            }
+            m_isFirstFrame = false;
+            return m_image;
+        }
+
+        // The regions before and after the move of every moving object. Overlapping regions are merged, so every pixel
+        // is restored and drawn once and spots aren't added twice.
+        m_dirty.clear();
+        for ( size_t i = 0; i < m_objects.size(); ++i)
+        {
+            SSceneObject& object = m_objects[i];
+            if ( object.velocityX == 0 && object.velocityY == 0)
+            {
+                continue;
+            }
+            const SRect oldBounds = m_bounds[i];
+            Move( object);
+            m_bounds[i] = GetBounds( object);
+            AddDirty( oldBounds.Union( m_bounds[i]));
+        }
+
+        m_renderedPixels = 0;
+        for ( size_t i = 0; i < m_dirty.size(); ++i)
+        {
+            Restore( m_dirty[i]);
+        }
+
+        // Objects intersecting a restored region are drawn again, clipped to the region, so objects on top stay on top.
+        for ( size_t i = 0; i < m_objects.size(); ++i)
+        {
+            for ( size_t j = 0; j < m_dirty.size(); ++j)
+            {
+                const SRect clip = m_bounds[i].Intersect( m_dirty[j]);
+                if ( !clip.IsEmpty())
+                {
+                    DrawObject( m_objects[i], clip);
+                }
+            }
+        }
+        return m_image;
+    }
+
+    // Number of pixels written by the last call of RenderFrame().
+    uint64_t GetRenderedPixels() const
+    {
+        return m_renderedPixels;
+    }
+
+    const SSyntheticSceneConfiguration& GetConfiguration() const
+    {
+        return m_configuration;
+    }
+
+private:
+    // Pixels left <= x < right, top <= y < bottom.
+    struct SRect
+    {
+        SRect()
+            : left( 0)
+            , top( 0)
+            , right( 0)
+            , bottom( 0)
+        {
+        }
+
+        SRect( int left_, int top_, int right_, int bottom_)
+            : left( left_)
+            , top( top_)
+            , right( right_)
+            , bottom( bottom_)
+        {
+        }
+
+        bool IsEmpty() const
+        {
+            return right <= left || bottom <= top;
+        }
+
+        SRect Union( const SRect& other) const
+        {
+            if ( IsEmpty())
+            {
+                return other;
+            }
+            if ( other.IsEmpty())
+            {
+                return *this;
+            }
+            return SRect( left < other.left ? left : other.left, top < other.top ? top : other.top,
+                right > other.right ? right : other.right, bottom > other.bottom ? bottom : other.bottom);
+        }
+
+        SRect Intersect( const SRect& other) const
+        {
+            return SRect( left > other.left ? left : other.left, top > other.top ? top : other.top,
+                right < other.right ? right : other.right, bottom < other.bottom ? bottom : other.bottom);
+        }
+
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+
+    static uint32_t GetBytesPerPixel( Pylon::EPixelType pixelType)
+    {
+        using namespace Pylon;
+
+        switch ( pixelType)
+        {
+        case PixelType_Mono8:
+        case PixelType_BayerRG8:
+        case PixelType_BayerGR8:
+        case PixelType_BayerGB8:
+        case PixelType_BayerBG8:
+            return 1;
+        case PixelType_RGB8packed:
+        case PixelType_BGR8packed:
+            return 3;
+        default:
+            return 0;
+        }
+    }
+
+    // Channel of the pixels at (even x, even y), (odd x, even y), (even x, odd y), (odd x, odd y). R = 0, G = 1, B = 2.
+    void SetBayerPattern( Pylon::EPixelType pixelType)
+    {
+        using namespace Pylon;
+
+        static const int rg[4] = { 0, 1, 1, 2 };
+        static const int gr[4] = { 1, 0, 2, 1 };
+        static const int gb[4] = { 1, 2, 0, 1 };
+        static const int bg[4] = { 2, 1, 1, 0 };
+        const int* pPattern = (pixelType == PixelType_BayerRG8) ? rg : (pixelType == PixelType_BayerGR8) ? gr
+            : (pixelType == PixelType_BayerGB8) ? gb : (pixelType == PixelType_BayerBG8) ? bg : NULL;
+        m_isBayer = (pPattern != NULL);
+        for ( int i = 0; i < 4; ++i)
+        {
+            m_bayerChannels[i] = m_isBayer ? pPattern[i] : 0;
+        }
+    }
+
+    // The extent of the pixels an object writes, clipped to the image.
+    SRect GetBounds( const SSceneObject& object) const
+    {
+        double halfWidth = object.width / 2;
+        double halfHeight = (object.type == SceneObjectType_Rectangle) ? object.height / 2 : halfWidth;
+        if ( object.type == SceneObjectType_Spot)
+        {
+            // The profile is cut off at 4 standard deviations.
+            halfWidth = halfHeight = 4 * object.width;
+        }
+        const SRect bounds( static_cast<int>(std::floor( object.x - halfWidth)), static_cast<int>(std::floor( object.y - halfHeight)),
+            static_cast<int>(std::ceil( object.x + halfWidth)) + 1, static_cast<int>(std::ceil( object.y + halfHeight)) + 1);
+        return bounds.Intersect( SRect( 0, 0, static_cast<int>(m_configuration.width), static_cast<int>(m_configuration.height)));
+    }
+
+    // Moves the object by its velocity and reverses the velocity at the image borders.
+    void Move( SSceneObject& object) const
+    {
+        const double halfWidth = (object.type == SceneObjectType_Spot) ? 4 * object.width : object.width / 2;
+        const double halfHeight = (object.type == SceneObjectType_Rectangle) ? object.height / 2 : halfWidth;
+        object.x += object.velocityX;
+        object.y += object.velocityY;
+        if ( (object.x - halfWidth < 0 && object.velocityX < 0) || (object.x + halfWidth > m_configuration.width && object.velocityX > 0))
+        {
+            object.velocityX = -object.velocityX;
+        }
+        if ( (object.y - halfHeight < 0 && object.velocityY < 0) || (object.y + halfHeight > m_configuration.height && object.velocityY > 0))
+        {
+            object.velocityY = -object.velocityY;
+        }
+    }
+
+    // Brightness factor of the lens at a pixel, 1 in the centre and 1 - vignetting in the corners.
+    double GetGain( int x, int y) const
+    {
+        const double dx = (x + 0.5) / m_configuration.width - 0.5;
+        const double dy = (y + 0.5) / m_configuration.height - 0.5;
+        return 1 - m_configuration.vignetting * (dx * dx + dy * dy) * 2;
+    }
+
+    static uint8_t Saturate( double value)
+    {
+        return static_cast<uint8_t>(value <= 0 ? 0 : (value >= 255 ? 255 : value + 0.5));
+    }
+
+    uint8_t* GetPixel( Pylon::CPylonImage& image, int x, int y) const
+    {
+        return static_cast<uint8_t*>(image.GetBuffer()) + y * m_stride + x * m_bytesPerPixel;
+    }
+
+    // Writes a color in the pixel format. Mono8 uses ITU-R BT.601 luma.
+    void WritePixel( uint8_t* pPixel, int x, int y, double red, double green, double blue) const
+    {
+        using namespace Pylon;
+
+        if ( m_isBayer)
+        {
+            const int channel = m_bayerChannels[(y & 1) * 2 + (x & 1)];
+            *pPixel = Saturate( channel == 0 ? red : (channel == 1 ? green : blue));
+        }
+        else if ( m_configuration.pixelType == PixelType_Mono8)
+        {
+            *pPixel = Saturate( 0.299 * red + 0.587 * green + 0.114 * blue);
+        }
+        else
+        {
+            const bool isRgb = (m_configuration.pixelType == PixelType_RGB8packed);
+            pPixel[0] = Saturate( isRgb ? red : blue);
+            pPixel[1] = Saturate( green);
+            pPixel[2] = Saturate( isRgb ? blue : red);
+        }
+    }
+
+    void RenderBackground()
+    {
+        std::mt19937 random( m_configuration.seed);
+        std::uniform_real_distribution<double> noise( -static_cast<double>(m_configuration.noiseAmplitude), m_configuration.noiseAmplitude);
+        for ( int y = 0; y < static_cast<int>(m_configuration.height); ++y)
+        {
+            for ( int x = 0; x < static_cast<int>(m_configuration.width); ++x)
+            {
+                const double level = m_configuration.background * GetGain( x, y);
+                WritePixel( GetPixel( m_background, x, y), x, y, level + noise( random), level + noise( random), level + noise( random));
+            }
+        }
+    }
+
+    // Adds a region to the dirty regions, merging it with every region it overlaps.
+    void AddDirty( SRect rect)
+    {
+        if ( rect.IsEmpty())
+        {
+            return;
+        }
+        for ( size_t i = 0; i < m_dirty.size(); )
+        {
+            if ( !rect.Intersect( m_dirty[i]).IsEmpty())
+            {
+                // The merged region can overlap regions checked before, so start again.
+                rect = rect.Union( m_dirty[i]);
+                m_dirty.erase( m_dirty.begin() + i);
+                i = 0;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        m_dirty.push_back( rect);
+    }
+
+    void Restore( const SRect& rect)
+    {
+        const size_t rowSize = (rect.right - rect.left) * m_bytesPerPixel;
+        for ( int y = rect.top; y < rect.bottom; ++y)
+        {
+            memcpy( GetPixel( m_image, rect.left, y), GetPixel( m_background, rect.left, y), rowSize);
+        }
+        m_renderedPixels += static_cast<uint64_t>(rect.right - rect.left) * (rect.bottom - rect.top);
+    }
+
+    // Draws the part of an object inside clip. A pixel belongs to a shape if its centre lies inside.
+    void DrawObject( const SSceneObject& object, const SRect& clip)
+    {
+        const double radiusSquared = object.width * object.width / 4;
+        const double twoSigmaSquared = 2 * object.width * object.width;
+        for ( int y = clip.top; y < clip.bottom; ++y)
+        {
+            const double dy = y + 0.5 - object.y;
+            for ( int x = clip.left; x < clip.right; ++x)
+            {
+                const double dx = x + 0.5 - object.x;
+                double factor = 0;
+                switch ( object.type)
+                {
+                case SceneObjectType_Rectangle:
+                    if ( 2 * std::fabs( dx) >= object.width || 2 * std::fabs( dy) >= object.height)
+                    {
+                        continue;
+                    }
+                    factor = GetGain( x, y);
+                    break;
+                case SceneObjectType_Circle:
+                    if ( dx * dx + dy * dy >= radiusSquared)
+                    {
+                        continue;
+                    }
+                    factor = GetGain( x, y);
+                    break;
+                case SceneObjectType_Spot:
+                    {
+                        // Added to the pixel as it is, so spots can overlap the background and other objects.
+                        factor = GetGain( x, y) * std::exp( -(dx * dx + dy * dy) / twoSigmaSquared);
+                        uint8_t* pPixel = GetPixel( m_image, x, y);
+                        if ( m_isBayer || m_bytesPerPixel == 1)
+                        {
+                            const int channel = m_isBayer ? m_bayerChannels[(y & 1) * 2 + (x & 1)] : -1;
+                            const double peak = (channel == 0) ? object.red : (channel == 1) ? object.green : (channel == 2) ? object.blue
+                                : 0.299 * object.red + 0.587 * object.green + 0.114 * object.blue;
+                            *pPixel = Saturate( *pPixel + peak * factor);
+                        }
+                        else
+                        {
+                            const bool isRgb = (m_configuration.pixelType == Pylon::PixelType_RGB8packed);
+                            pPixel[0] = Saturate( pPixel[0] + (isRgb ? object.red : object.blue) * factor);
+                            pPixel[1] = Saturate( pPixel[1] + object.green * factor);
+                            pPixel[2] = Saturate( pPixel[2] + (isRgb ? object.blue : object.red) * factor);
+                        }
+                    }
+                    continue;
+                }
+                WritePixel( GetPixel( m_image, x, y), x, y, object.red * factor, object.green * factor, object.blue * factor);
+            }
+        }
+    }
+
+    // Not copyable.
+    CSyntheticScene( const CSyntheticScene&);
+    CSyntheticScene& operator=( const CSyntheticScene&);
+
+    const SSyntheticSceneConfiguration m_configuration;
+    const uint32_t m_bytesPerPixel;
+    bool m_isBayer;
+    int m_bayerChannels[4];
+    size_t m_stride;
+    Pylon::CPylonImage m_background;
+    Pylon::CPylonImage m_image;
+    std::vector<SSceneObject> m_objects;
+    std::vector<SRect> m_bounds;
+    std::vector<SRect> m_dirty;
+    bool m_isFirstFrame;
+    uint64_t m_renderedPixels;
+};
+
+#endif /* INCLUDED_SYNTHETICSCENE_H_7402816 */
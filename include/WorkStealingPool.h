@@ -0,0 +1,231 @@
+// Contains a thread pool executing parallel loops.
+// Every worker thread has its own task queue. A worker takes tasks from the back of its own queue and,
+// when it runs out of work, steals tasks from the front of the queues of the other workers.
+// This balances the load if tasks take different amounts of time, e.g. image bands containing many objects.
+
+#ifndef INCLUDED_WORKSTEALINGPOOL_H_7725048
+#define INCLUDED_WORKSTEALINGPOOL_H_7725048
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CWorkStealingPool
+{
+public:
+    // If threadCount is 0, one thread per hardware thread is started.
+    explicit CWorkStealingPool( size_t threadCount = 0)
+        : m_queuedTasks( 0)
+        , m_nextQueue( 0)
+        , m_stop( false)
+    {
+        if ( threadCount == 0)
+        {
+            threadCount = std::thread::hardware_concurrency();
+        }
+        if ( threadCount == 0)
+        {
+            threadCount = 1;
+        }
+
+        for ( size_t i = 0; i < threadCount; ++i)
+        {
+            m_queues.push_back( std::unique_ptr<SWorkerQueue>( new SWorkerQueue));
+        }
+        for ( size_t i = 0; i < threadCount; ++i)
+        {
+            m_threads.push_back( std::thread( &CWorkStealingPool::RunWorker, this, i));
+        }
+    }
+
+    ~CWorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_sleepLock);
+            m_stop = true;
+        }
+        m_workAvailable.notify_all();
+        for ( size_t i = 0; i < m_threads.size(); ++i)
+        {
+            m_threads[i].join();
+        }
+    }
+
+    size_t GetThreadCount() const
+    {
+        return m_threads.size();
+    }
+
+    // Calls function( i) for i = 0 ... count - 1 and returns when all calls have returned.
+    // The calling thread executes tasks while waiting. Can be called by several threads at the same time.
+    // If function throws, the first exception is rethrown after all calls have returned.
+    void ParallelFor( size_t count, const std::function<void( size_t)>& function)
+    {
+        if ( count == 0)
+        {
+            return;
+        }
+
+        STaskGroup group;
+        group.remaining = count;
+
+        // Distribute the tasks round robin. Neighboring tasks end up in different queues.
+        // The counter is increased first so that it never drops below the number of queued tasks.
+        const size_t firstQueue = m_nextQueue++;
+        m_queuedTasks += count;
+        for ( size_t i = 0; i < count; ++i)
+        {
+            SWorkerQueue& queue = *m_queues[(firstQueue + i) % m_queues.size()];
+            STask task;
+            task.pFunction = &function;
+            task.index = i;
+            task.pGroup = &group;
+            std::lock_guard<std::mutex> lock( queue.lock);
+            queue.tasks.push_back( task);
+        }
+        {
+            std::lock_guard<std::mutex> lock( m_sleepLock);
+        }
+        m_workAvailable.notify_all();
+
+        // Help instead of waiting idly.
+        STask task;
+        while ( TryGetTask( firstQueue % m_queues.size(), task))
+        {
+            Execute( task);
+        }
+
+        std::unique_lock<std::mutex> lock( group.lock);
+        group.done.wait( lock, [&group]{ return group.remaining == 0; });
+        if ( group.error)
+        {
+            std::rethrow_exception( group.error);
+        }
+    }
+
+private:
+    // The tasks of one ParallelFor() call.
+    struct STaskGroup
+    {
+        STaskGroup()
+            : remaining( 0)
+        {
+        }
+
+        std::mutex lock;            // Protects all members.
+        std::condition_variable done;
+        size_t remaining;
+        std::exception_ptr error;
+    };
+
+    struct STask
+    {
+        const std::function<void( size_t)>* pFunction;
+        size_t index;
+        STaskGroup* pGroup;
+    };
+
+    struct SWorkerQueue
+    {
+        std::mutex lock;
+        std::deque<STask> tasks;
+    };
+
+    // Takes a task from the back of the own queue or steals one from the front of another queue.
+    bool TryGetTask( size_t ownQueue, STask& task)
+    {
+        if ( m_queuedTasks == 0)
+        {
+            return false;
+        }
+
+        for ( size_t i = 0; i < m_queues.size(); ++i)
+        {
+            SWorkerQueue& queue = *m_queues[(ownQueue + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock( queue.lock);
+            if ( !queue.tasks.empty())
+            {
+                if ( i == 0)
+                {
+                    task = queue.tasks.back();
+                    queue.tasks.pop_back();
+                }
+                else
+                {
+                    task = queue.tasks.front();
+                    queue.tasks.pop_front();
+                }
+                --m_queuedTasks;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void Execute( const STask& task)
+    {
+        STaskGroup& group = *task.pGroup;
+        std::exception_ptr error;
+        try
+        {
+            (*task.pFunction)( task.index);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        // The group is destroyed as soon as the caller sees that all tasks are done.
+        // It must not be accessed after the lock has been released.
+        std::lock_guard<std::mutex> lock( group.lock);
+        if ( error && !group.error)
+        {
+            group.error = error;
+        }
+        if ( --group.remaining == 0)
+        {
+            group.done.notify_all();
+        }
+    }
+
+    void RunWorker( size_t index)
+    {
+        for (;;)
+        {
+            STask task;
+            if ( TryGetTask( index, task))
+            {
+                Execute( task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock( m_sleepLock);
+            m_workAvailable.wait( lock, [this]{ return m_stop || m_queuedTasks > 0; });
+            if ( m_stop && m_queuedTasks == 0)
+            {
+                return;
+            }
+        }
+    }
+
+    // Not copyable.
+    CWorkStealingPool( const CWorkStealingPool&);
+    CWorkStealingPool& operator=( const CWorkStealingPool&);
+
+    std::vector<std::unique_ptr<SWorkerQueue> > m_queues;  // One queue per worker thread.
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_queuedTasks;                      // Tasks in all queues, not counting running tasks.
+    std::atomic<size_t> m_nextQueue;                        // Queue receiving the first task of the next ParallelFor() call.
+
+    std::mutex m_sleepLock;                                 // Protects m_stop.
+    std::condition_variable m_workAvailable;
+    bool m_stop;
+};
+
+#endif /* INCLUDED_WORKSTEALINGPOOL_H_7725048 */
@@ -9,6 +9,18 @@
 #define saveImages 1
 //定义是否记录视频
 #define recordVideo 0
+//定义是否直接处理相机原始数据（Mono8/Mono12p/Bayer等，不转换为BGR8）
+#define zeroCopyGrab 1
+//定义是否用融合的SIMD内核完成高斯模糊、三角法二值化和闭运算
+#define fusedFrontEnd 1
+//定义是否用游程编码的连通域分析代替findContours测量面积、周长和外接矩形
+#define rleBlobAnalysis 1
+//定义是否把每一帧分成多个水平条带，由线程池并行完成滤波和连通域分析
+#define bandParallel 1
+//定义是否不显示图像（没有显示器的生产机器），流水线全速运行
+#define headless 0
+//定义测量结果的输出方式：0 打印到控制台，1 写入内存映射的环形文件（用MeasurementReader读取），2 由后台线程写入CSV文件
+#define measurementOutput 1
 
 //加载OpenCV API
 #include <opencv2/core/core.hpp>
@@ -26,6 +38,9 @@
 #include <pylon/PylonGUI.h>    
 #endif
 
+//多线程流水线：采集、格式转换、滤波、轮廓分析、保存、显示
+#include "include/ContourPipeline.h"
+
 //命名空间.
 using namespace Pylon;
 using namespace cv;
@@ -52,22 +67,36 @@ void main()
         GenApi::CIntegerPtr width = nodemap.GetNode("Width");
         GenApi::CIntegerPtr height = nodemap.GetNode("Height");
 
-        //设置相机最大缓冲区,默认为10
-        camera.MaxNumBuffer = 5;
-        //新建pylon ImageFormatConverter对象.
-        CImageFormatConverter formatConverter;
-        //确定输出像素格式
-        formatConverter.OutputPixelFormat = PixelType_BGR8packed;
-        //创建一个Pylonlmage后续将用来创建OpenCV images
-        CPylonImage pylonImage;
+        //配置流水线：每个阶段一个线程，阶段之间用无锁队列连接
+        //帧池用完时采集阶段丢弃图像，不阻塞抓取循环
+        SContourPipelineConfiguration pipelineConfiguration;
+        pipelineConfiguration.framePoolSize = 8;
+        pipelineConfiguration.queueCapacity = 4;
+        //按相机的图像尺寸预先分配每一帧的工作缓冲区，抓取过程中不再分配内存
+        pipelineConfiguration.imageWidth = (int)width->GetValue();
+        pipelineConfiguration.imageHeight = (int)height->GetValue();
+        pipelineConfiguration.saveImageFiles = (saveImages != 0);
+        //图片由后台线程池编码保存，磁盘跟不上时丢弃图片而不阻塞流水线
+        pipelineConfiguration.imageWriter.format = ImageWriterFormat_Jpeg;
+        pipelineConfiguration.imageWriter.threadCount = 2;
+        pipelineConfiguration.imageWriter.bufferCount = 8;
+        pipelineConfiguration.appendToVideo = (recordVideo != 0);
+        pipelineConfiguration.useNativePixelData = (zeroCopyGrab != 0);
+        pipelineConfiguration.useFusedFrontEnd = (fusedFrontEnd != 0);
+        pipelineConfiguration.useRleBlobAnalysis = (rleBlobAnalysis != 0);
+        //线程数为0时每个硬件线程启动一个工作线程
+        pipelineConfiguration.useBandParallelism = (bandParallel != 0);
+        pipelineConfiguration.bandThreadCount = 0;
+        //图像由单独的显示线程按限定的帧率显示，只显示最新的一帧
+        pipelineConfiguration.showImages = (headless == 0);
+        pipelineConfiguration.displayFrameRate = 25.0;
 
-        //声明一个整形变量用来计数抓取的图像，以及创建文件名索引
-        int grabbedlmages = 0;
+        //设置相机最大缓冲区,默认为10
+        //直接处理原始数据时，流水线中每一帧都占用一个抓取缓冲区，缓冲区数必须大于帧池大小
+        camera.MaxNumBuffer = zeroCopyGrab ? static_cast<int>(pipelineConfiguration.framePoolSize) + 3 : 5;
 
         //新建一个OpenCV video creator对象.
         VideoWriter cvVideoCreator;
-        //新建一个OpenCV image对象.
-        Mat openCvImage;
         //视频文件名
         std::string videoFileName = "openCvVideo.avi";
         //定义视频帧大小
@@ -75,10 +104,32 @@ void main()
 
         //设置视频编码类型和帧率，有三种选择
         //帧率必须小于等于相机成像帧率
-        cvVideoCreator.open(videoFileName, CAP_OPENCV_MJPEG, 10, frameSize, true);
+        //直接处理原始数据时图像为单通道
+        cvVideoCreator.open(videoFileName, CAP_OPENCV_MJPEG, 10, frameSize, !zeroCopyGrab);
         //cvVideoCreator.open(videoFileName, CV_F0URCC('M','P',,4','2’), 20, frameSize, true);
         //cvVideoCreator.open(videoFileName, CV_FOURCC('M', '3', 'P', 'G'), 20, frameSize, true);
 
+        //视频只在保存阶段写入
+        pipelineConfiguration.pVideoWriter = &cvVideoCreator;
+
+        //测量结果以固定格式的二进制记录写入，保存阶段不再逐行打印
+        CMappedRingFileSink ringFileSink;
+        CCsvMeasurementSink csvSink;
+        if (measurementOutput == 1 && ringFileSink.Create("measurements.bin", 1 << 16))
+        {
+            pipelineConfiguration.pMeasurementSink = &ringFileSink;
+        }
+        else if (measurementOutput == 2 && csvSink.Create("measurements.csv"))
+        {
+            pipelineConfiguration.pMeasurementSink = &csvSink;
+        }
+        else if (measurementOutput != 0)
+        {
+            cerr << "无法创建测量结果文件，结果将打印到控制台" << endl;
+        }
+        CContourPipeline pipeline(pipelineConfiguration);
+        pipeline.Start();
+
         //开始抓取c_countOfImagesToGrab images.
         //相机默认设置连续抓取模式
         camera.StartGrabbing(c_countOfImagesToGrab, GrabStrategy_LatestImageOnly);
@@ -95,106 +146,24 @@ void main()
             //等待接收和恢复图像，超时时间设置为5000 ms.
             camera.RetrieveResult(5000, ptrGrabResult, TimeoutHandling_ThrowException);
 
-            //如果图像抓取成功
-            if (ptrGrabResult->GrabSucceeded())
+            //如果图像抓取成功（测量结果写入文件时抓取循环中不打印）
+            if (ptrGrabResult->GrabSucceeded() && pipelineConfiguration.pMeasurementSink == NULL)
             {
                 //获取图像数据
                 cout << "SizeX: " << ptrGrabResult->GetWidth() << endl;
                 cout << "SizeY: " << ptrGrabResult->GetHeight() << endl;
-
-                //将抓取的缓冲数据转化成pylon image.
-                formatConverter.Convert(pylonImage, ptrGrabResult);
-
-                // 将pylon image转成OpenCV image.
-                openCvImage = cv::Mat(ptrGrabResult->GetHeight(), ptrGrabResult->GetWidth(), CV_8UC3, (uint8_t*)pylonImage.GetBuffer());
-
-
-
-                //对OpenCV image进行处理
-                //高斯模糊
-                //Mat openCvImage;
-                Mat GaussImg;
-                GaussianBlur(openCvImage, GaussImg, Size(7, 7), 0, 0);
-                //imshow("Gauss Image", GaussImg);
-                //imwrite("D:/images/test0510/Gauss Image.jpg", GaussImg);
-                cvtColor(GaussImg, GaussImg, CV_BGR2GRAY);
-
-                //二值化操作
-                Mat binary;
-                threshold(GaussImg, binary, 0, 255, THRESH_BINARY | THRESH_TRIANGLE);
-                //imshow("binary Image", binary);
-                //imwrite("D:/images/test0510/binary Image.jpg", binary);
-
-                //形态学操作
-                Mat morphImg;
-                Mat kernel = getStructuringElement(MORPH_RECT, Size(5, 5), Point(-1, -1));
-                morphologyEx(binary, morphImg, MORPH_CLOSE, kernel, Point(-1, -1), 1);
-                //imshow("morph Image", morphImg);
-                //imwrite("D:/images/test0510/morph Image.jpg", morphImg);
-
-                //轮廓发现
-                Mat contoursImg = Mat::zeros(openCvImage.size(), CV_8UC3);
-                vector<vector<Point>>contours;
-                vector<Vec4i>hireachy;
-                findContours(morphImg, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE, Point(-1, -1));
-
-                for (size_t i = 0; i < contours.size(); i++)
-                {
-                    Rect rect = boundingRect(contours[i]);
-                    if (rect.width < openCvImage.cols / 2)
-                        continue;
-
-                    drawContours(contoursImg, contours, static_cast<int>(i),
-                        Scalar(0, 0, 255), 2, 8, hireachy, 0, Point(0, 0));
-                    
-                    //计算面积与周长
-                    float area = contourArea(contours[i]);
-                    float length = arcLength(contours[i], true);
-                    printf("对象图像面积为:%f\n", area);
-                    printf("对象图像周长为:%f\n", length);
-                    //输出轮廓坐标
-                    std::cout << ("轮廓的坐标为：%f\n", contours[0]) << endl;
-                }
-                //imwrite("D:/images/test0510/contours Image.jpg", contoursImg);
-                
-
-
-
-
-                //如果需要保存图片
-                if (saveImages)
-                {
-                    std::ostringstream s;
-                    // 按索引定义文件名存储图片
-                    s << "image_" << grabbedlmages << ".jpg";
-                    std::string imageName(s.str());
-                    //保存OpenCV image.
-                    imwrite(imageName, openCvImage);
-                    grabbedlmages++;
-                }
-
-                //如果需要记录视频
-                if (recordVideo)
-                {
-
-                    cvVideoCreator.write(openCvImage);
-                }
-
-                //新建OpenCV display window
-                namedWindow("OpenCV Display Window", CV_WINDOW_NORMAL); // other options: CV_AUTOSIZE, CV_FREERATIO
-                //显示及时影像
-                imshow("OpenCV Display Window", openCvImage);
-                imshow("OpenCV Contours Window", contoursImg);
-
-                // Define a timeout for customer's input in
-                // '0' means indefinite, i.e. the next image will be displayed after closing the window.
-                // '1' means live stream
-                waitKey(1);//这里必须是1。0则需要单击关闭窗口按钮才能采集下一个图像
-
             }
 
+            //交给流水线处理（格式转换、高斯模糊、二值化、形态学操作、轮廓发现、保存和显示）
+            pipeline.Push(ptrGrabResult);
         }
 
+        //等待流水线处理完所有图像
+        pipeline.Stop();
+
+        //输出各阶段处理和丢弃的帧数
+        pipeline.PrintStatistics(cout);
+
     }
     catch (GenICam::GenericException& e)
     {